@@ -0,0 +1,190 @@
+/** @file keccak.cc
+ *  @brief Benchmark of the Keccak-f[1600] implementations against the
+ *		   Crypto++ SHA3-256 the module used before
+ *
+ *  Built and run from the repository root, once the dependencies are
+ *  installed, with 'npm run benchmark', i.e.:
+ *
+ *  g++ -O3 -std=c++11 -Isrc -Ideps/seifrng/3rdParty/cryptopp
+ *      benchmark/keccak.cc src/keccak.cc
+ *      deps/seifrng/3rdParty/cryptopp/libcryptopp.a -o build/keccak-bench
+ *
+ *  Every implementation is first checked against Crypto++ on inputs of
+ *  all lengths up to a few blocks.
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+// -----------------
+// standard includes
+// -----------------
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// -----------------
+// cryptopp includes
+// -----------------
+#include "sha3.h"
+
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
+
+
+// implementations of Keccak::permute, as named by Keccak::permutePath
+static const char* PATHS[] = {"bmi", "portable"};
+
+// input sizes timed, from a key to a large buffer
+static const size_t SIZES[] = {32, 1024, 64 * 1024, 1024 * 1024};
+
+// bytes hashed per measurement
+static const size_t BYTES_PER_RUN = 64 * 1024 * 1024;
+
+
+// --------
+// cryptopp
+// --------
+/**
+ * @brief Computes SHA3-256 with Crypto++, the previous code path.
+ *
+ * @param input input bytes
+ * @param length number of bytes
+ * @param digest container for the 32-byte hash
+ *
+ * @return void
+ */
+static void cryptopp(const uint8_t* input, size_t length, uint8_t* digest) {
+    CryptoPP::SHA3_256 hash;
+    hash.Update(input, length);
+    hash.Final(digest);
+}
+
+
+// -------
+// measure
+// -------
+/**
+ * @brief Hashes BYTES_PER_RUN bytes in inputs of the given size.
+ *
+ * @param sha3 SHA3-256 function to time
+ * @param input input bytes
+ * @param size bytes per hash
+ *
+ * @return throughput in MB/s
+ */
+static double measure(void (*sha3)(const uint8_t*, size_t, uint8_t*),
+    const uint8_t* input, size_t size) {
+
+    uint8_t digest[32];
+    size_t count = BYTES_PER_RUN / size;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        sha3(input, size, digest);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return double(count * size) / elapsed.count() / 1e6;
+}
+
+
+// -----
+// agree
+// -----
+/**
+ * @brief Checks the current implementation against Crypto++ on every
+ *        length up to four blocks.
+ *
+ * @param input input bytes, at least 4 * 136 + 1 of them
+ *
+ * @return true if all hashes match
+ */
+static bool agree(const uint8_t* input) {
+
+    uint8_t expected[32];
+    uint8_t actual[32];
+
+    for (size_t length = 0; length <= 4 * Keccak::SHA3_256_RATE; ++length) {
+        cryptopp(input, length, expected);
+        Keccak::sha3_256(input, length, actual);
+        if (std::memcmp(expected, actual, sizeof(actual)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int main() {
+
+    std::vector<uint8_t> input(SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1]);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = uint8_t(i * 131 + 7);
+    }
+
+    std::printf("%-10s", "bytes");
+    for (size_t size : SIZES) {
+        std::printf("%12zu", size);
+    }
+    std::printf("   (MB/s)\n");
+
+    std::printf("%-10s", "cryptopp");
+    for (size_t size : SIZES) {
+        std::printf("%12.1f", measure(cryptopp, input.data(), size));
+    }
+    std::printf("\n");
+
+    const char* best = Keccak::permutePath();
+    int failures = 0;
+
+    for (const char* path : PATHS) {
+
+        if (!Keccak::usePermutePath(path)) {
+            std::printf("%-10s   not supported by this CPU\n", path);
+            continue;
+        }
+
+        if (!agree(input.data())) {
+            std::printf("%-10s   MISMATCH with Crypto++\n", path);
+            ++failures;
+            continue;
+        }
+
+        std::printf("%-10s", path);
+        for (size_t size : SIZES) {
+            std::printf("%12.1f",
+                measure(Keccak::sha3_256, input.data(), size));
+        }
+        std::printf("%s\n",
+            std::strcmp(path, best) == 0 ? "   (selected)" : "");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -6,8 +6,15 @@
                 "src/addon.cc",
                 "src/seifecc.cc",
                 "src/aesxor.cc",
+                "src/chacha20poly1305.cc",
                 "src/rng.cc",
-                "src/seifsha3.cc"
+                "src/seifsha3.cc",
+                "src/keccak.cc",
+                "src/parallelhash.cc",
+                "src/mac.cc",
+                "src/capabilities.cc",
+                "src/scratchpool.cc",
+                "src/prefetchring.cc"
             ],
             "cflags_cc!": [
                 "-fno-rtti",
@@ -1,3 +1,267 @@
+var stream = require("stream");
+
 var addon = require("./build/Release/seifnode");
 
-module.exports = addon;
\ No newline at end of file
+/* Strict mode: refuse to load when a primitive with an accelerated code path
+ * would run on a portable one (see addon.capabilities()), e.g. because the
+ * linked Crypto++ was built without AES-NI.
+ */
+if (process.env.SEIFNODE_STRICT_ACCELERATION === "1") {
+	var missing = addon.capabilities().missing;
+	if (missing.length > 0) {
+		throw new Error("seifnode: hardware acceleration unavailable for " +
+			missing.join(", ") + " (SEIFNODE_STRICT_ACCELERATION is set)");
+	}
+}
+
+/* Messages of at least this many bytes are encrypted/decrypted on the libuv
+ * thread pool by AESXOR256 encryptAsync/decryptAsync, smaller ones inline
+ * where the thread pool round trip would cost more than the work itself.
+ * Can be overridden per call with the 'asyncThreshold' option.
+ */
+var AESXOR_ASYNC_THRESHOLD_BYTES = 256 * 1024;
+
+/* SEIFSHA3 hashAsync hashes buffers of at least this many bytes on the libuv
+ * thread pool, smaller ones (and strings) inline. Can be overridden per call
+ * with the 'asyncThreshold' option.
+ */
+var SHA3_ASYNC_THRESHOLD_BYTES = 64 * 1024;
+
+/* RNG getBytesAsync generates at least this many bytes on the libuv thread
+ * pool, fewer inline. Can be overridden per call with the 'asyncThreshold'
+ * option.
+ */
+var RNG_ASYNC_THRESHOLD_BYTES = 64 * 1024;
+
+/* Completes a call either inline with 'runSync' (still calling back on the
+ * next tick) or on the thread pool with 'runAsync', and returns a Promise
+ * when no callback is given. Callbacks receive (status, result) with status
+ * of the form {code: [statusCode], message: [statusMessage]}.
+ */
+function dispatch(useAsync, runSync, runAsync, callback) {
+
+	var run = function(done) {
+
+		if (useAsync) {
+			runAsync(done);
+			return;
+		}
+
+		var status = {code: 0, message: "Success"};
+		var result;
+		try {
+			result = runSync();
+		} catch (err) {
+			status = {code: -1, message: err.message};
+		}
+		process.nextTick(done, status, result);
+	};
+
+	if (typeof callback === "function") {
+		run(callback);
+		return;
+	}
+
+	return new Promise(function(resolve, reject) {
+		run(function(status, result) {
+			if (status.code === 0) {
+				resolve(result);
+			} else {
+				reject(new Error(status.message));
+			}
+		});
+	});
+}
+
+/* Wraps a native AESXOR256 async method so that small buffers take the sync
+ * path (still completing asynchronously) and a Promise is returned when no
+ * callback is given. While earlier async calls are pending the sync path
+ * would throw rather than wait for them, so small buffers queue behind them.
+ */
+function aesxorAsync(syncMethod, asyncMethod) {
+
+	return function(key, data, options, callback) {
+
+		if (typeof options === "function") {
+			callback = options;
+			options = undefined;
+		}
+
+		var self = this;
+		var threshold = AESXOR_ASYNC_THRESHOLD_BYTES;
+		if (options && options.asyncThreshold !== undefined) {
+			threshold = options.asyncThreshold;
+		}
+
+		return dispatch(!Buffer.isBuffer(data) || data.length >= threshold
+			|| self.asyncPending() > 0,
+			function() {
+				return syncMethod.call(self, key, data, options);
+			},
+			function(done) {
+				asyncMethod.call(self, key, data, options || {}, done);
+			},
+			callback);
+	};
+}
+
+var aesxorPrototype = addon.AESXOR256.prototype;
+aesxorPrototype.encryptAsync = aesxorAsync(aesxorPrototype.encrypt,
+	aesxorPrototype.encryptAsync);
+aesxorPrototype.decryptAsync = aesxorAsync(aesxorPrototype.decrypt,
+	aesxorPrototype.decryptAsync);
+
+var sha3Prototype = addon.SEIFSHA3.prototype;
+var sha3HashAsync = sha3Prototype.hashAsync;
+sha3Prototype.hashAsync = function(data, options, callback) {
+
+	if (typeof options === "function") {
+		callback = options;
+		options = undefined;
+	}
+
+	var self = this;
+	var threshold = SHA3_ASYNC_THRESHOLD_BYTES;
+	if (options && options.asyncThreshold !== undefined) {
+		threshold = options.asyncThreshold;
+	}
+	var outputLength = options ? options.outputLength : undefined;
+
+	return dispatch(Buffer.isBuffer(data) && data.length >= threshold,
+		function() {
+			return self.hash(data, outputLength);
+		},
+		function(done) {
+			sha3HashAsync.call(self, data, outputLength, done);
+		},
+		callback);
+};
+
+var rngPrototype = addon.RNG.prototype;
+var rngGetBytesAsync = rngPrototype.getBytesAsync;
+rngPrototype.getBytesAsync = function(numBytes, options, callback) {
+
+	if (typeof options === "function") {
+		callback = options;
+		options = undefined;
+	}
+
+	var self = this;
+	var threshold = RNG_ASYNC_THRESHOLD_BYTES;
+	if (options && options.asyncThreshold !== undefined) {
+		threshold = options.asyncThreshold;
+	}
+
+	return dispatch(typeof numBytes !== "number" || numBytes >= threshold,
+		function() {
+			return self.getBytes(numBytes);
+		},
+		function(done) {
+			rngGetBytesAsync.call(self, numBytes, done);
+		},
+		callback);
+};
+
+/* Seeds the RNG on the thread pool. 'options.onProgress' is called after
+ * every entropy gathering attempt and 'options.signal' (an AbortSignal)
+ * cancels the seeding before the next attempt, as does cancelInitialize().
+ */
+var rngInitializeAsync = rngPrototype.initializeAsync;
+rngPrototype.initializeAsync = function(key, filename, options, callback) {
+
+	if (typeof options === "function") {
+		callback = options;
+		options = undefined;
+	}
+
+	var self = this;
+	var onProgress = options && options.onProgress;
+	var signal = options && options.signal;
+
+	return dispatch(true, null,
+		function(done) {
+
+			var cancel = function() {
+				self.cancelInitialize();
+			};
+
+			rngInitializeAsync.call(self, key, filename,
+				typeof onProgress === "function" ? onProgress : function() {},
+				function(status) {
+					if (signal) {
+						signal.removeEventListener("abort", cancel);
+					}
+					done(status);
+				});
+
+			if (signal) {
+				signal.addEventListener("abort", cancel);
+				if (signal.aborted) {
+					cancel();
+				}
+			}
+		},
+		callback);
+};
+
+/* Streams data through a SEIFSHA3 object: every chunk written is absorbed by
+ * the native state in place, without being copied or concatenated in
+ * javascript, and passed on unchanged so that the stream can sit in a pipe,
+ * e.g. between an upload and the file it is written to. When the input ends
+ * the digest is emitted as a 'digest' event and kept in the 'digest'
+ * property. With {passThrough: false} the chunks are not passed on and the
+ * digest is the only output, as with crypto.createHash.
+ */
+function hashStream(hasher, options) {
+
+	var passThrough = !options || options.passThrough !== false;
+	var outputLength = options ? options.outputLength : undefined;
+
+	var transform = new stream.Transform({
+
+		transform: function(chunk, encoding, done) {
+			try {
+				hasher.update(chunk);
+			} catch (err) {
+				done(err);
+				return;
+			}
+			done(null, passThrough ? chunk : undefined);
+		},
+
+		flush: function(done) {
+			var digest;
+			try {
+				digest = hasher.digest(outputLength);
+			} catch (err) {
+				done(err);
+				return;
+			}
+			transform.digest = digest;
+			transform.emit("digest", digest);
+			done(null, passThrough ? undefined : digest);
+		}
+	});
+
+	transform.digest = null;
+	return transform;
+}
+
+/* The stream hashes with a copy of the object, so a prefix absorbed with
+ * update (or a key) is kept and the object itself stays usable.
+ */
+sha3Prototype.createHashStream = function(options) {
+	return hashStream(this.clone(), options);
+};
+
+addon.createHashStream = function(algorithm, options) {
+
+	if (typeof algorithm === "object" && algorithm !== null) {
+		options = algorithm;
+		algorithm = undefined;
+	}
+
+	return hashStream(new addon.SEIFSHA3(algorithm, options), options);
+};
+
+module.exports = addon;
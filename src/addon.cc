@@ -39,6 +39,8 @@
 #include "aesxor.h"
 #include "rng.h"
 #include "seifsha3.h"
+#include "capabilities.h"
+#include "scratchpool.h"
 
 
 // ----------
@@ -57,6 +59,8 @@ void Initialize(v8::Local<v8::Object> target) {
 	AESXOR256::Init(target);
 	RNG::Init(target);
 	SEIFSHA3::Init(target);
+	Capabilities::Init(target);
+	ScratchPool::Init(target);
 }
 
 
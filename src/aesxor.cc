@@ -31,9 +31,13 @@
 // -----------------
 // standard includes
 // -----------------
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -46,55 +50,64 @@
 // -----------------
 // cryptopp includes
 // -----------------
-#include "filters.h"
-using CryptoPP::StringSink;
-using CryptoPP::StringSource;
-using CryptoPP::ArraySink;
-using CryptoPP::ArraySource;
 #include "modes.h"
 #include "aes.h"
 #include "gcm.h"
+#include "misc.h"
+#include "secblock.h"
 
 // ----------------
 // library includes
 // ----------------
 #include "aesxor.h"
+#include "chacha20poly1305.h"
+#include "compression.h"
+#include "cpufeatures.h"
+#include "fileio.h"
+#include "mac.h"
+#include "parallel.h"
+#include "records.h"
+#include "scratchpool.h"
+#include "securewipe.h"
 
 
 // javascript object constructor
 Nan::Persistent<v8::Function> AESXOR256::constructor;
 // AES key length
 const int AESXOR256::AESNODE_DEFAULT_KEY_LENGTH_BYTES = 32;
-
-
-// -------------
-// uInt64toBytes
-// -------------
-/**
- * @brief Convert uint64 array to an array of bytes.
- *
- * We traverse the input container from 'begin' to 'end' and store the
- * extracted bytes into 'out'
- *
- * @param begin beginning of container of uint64 values
- * @param end end of container of uint64 values
- * @param out beginning of container of resulting byte values
- *
- * @return void
- */
-template <typename II, typename OI>
-void uInt64toBytes(II begin, II end, OI out) {
-    // traverse bytes in uint64 values and store in 'out'
-    while (begin != end) {
-        for (int i = 0; i < 8; ++i) {
-            *out = static_cast<uint8_t> (
-                (*begin & (uint64_t(0x00000000000000FF) << (8 * i))) >> (8 * i)
-            );
-            ++out;
-        }
-        ++begin;
-    }
-}
+// GCM nonce and authentication tag lengths
+const int AESXOR256::GCM_NONCE_BYTES = 12;
+const int AESXOR256::GCM_TAG_BYTES = 16;
+// all-zero GCM IV of the original format
+const uint8_t AESXOR256::LEGACY_IV[GCM_NONCE_BYTES] = {};
+// versioned message format identifier and header size
+const int AESXOR256::VERSIONED_FORMAT = 0x01;
+const int AESXOR256::VERSIONED_HEADER_BYTES = 14;
+
+// versioned header flag selecting ChaCha20-Poly1305 over AES-256-GCM
+const int AESXOR256::VERSIONED_FLAG_CHACHA20 = 0x01;
+
+// versioned header flag marking a deflated message
+const int AESXOR256::VERSIONED_FLAG_DEFLATE = 0x02;
+
+// zlib level used for {compress: true}
+const int AESXOR256::DEFAULT_COMPRESSION_LEVEL = 6;
+// segmented container format identifier, header and key salt size
+const int AESXOR256::SEGMENT_FORMAT = 0x03;
+const int AESXOR256::SEGMENT_HEADER_BYTES = 21;
+const int AESXOR256::SEGMENT_SALT_BYTES = 16;
+// KMAC256 customization of the per-container segment key
+static const char SEGMENT_KEY_CUSTOMIZATION[] = "SEIF segment key";
+// default, minimum and maximum segment plaintext size
+const uint32_t AESXOR256::SEGMENT_DEFAULT_BYTES = 64 * 1024;
+const uint32_t AESXOR256::SEGMENT_MIN_BYTES = 16;
+const uint32_t AESXOR256::SEGMENT_MAX_BYTES = 16 * 1024 * 1024;
+// number of segments addressable by the 32-bit segment counter
+const uint64_t AESXOR256::SEGMENT_MAX_COUNT = uint64_t(1) << 32;
+// minimum number of segments handed to each encryption thread
+const size_t AESXOR256::SEGMENTS_PER_THREAD = 4;
+// bytes read from disk at a time by encryptFile/decryptFile
+const size_t AESXOR256::FILE_CHUNK_BYTES = 8 * 1024 * 1024;
 
 
 // -------------
@@ -124,6 +137,43 @@ uint64_t bytesToUInt64(uint8_t* bufferData, size_t bufferLength) {
 }
 
 
+// ------------
+// readUInt32BE
+// ------------
+/**
+ * @brief Read a big endian uint32 value from an array of bytes
+ *
+ * @param bufferData container of at least 4 byte values
+ *
+ * @return uint32 value stored in the first 4 bytes
+ */
+static uint32_t readUInt32BE(const uint8_t* bufferData) {
+    return (uint32_t(bufferData[0]) << 24)
+        | (uint32_t(bufferData[1]) << 16)
+        | (uint32_t(bufferData[2]) << 8)
+        | uint32_t(bufferData[3]);
+}
+
+
+// -------------
+// writeUInt32BE
+// -------------
+/**
+ * @brief Write a uint32 value as 4 big endian bytes
+ *
+ * @param value uint32 value to be stored
+ * @param bufferData container of at least 4 byte values
+ *
+ * @return void
+ */
+static void writeUInt32BE(uint32_t value, uint8_t* bufferData) {
+    bufferData[0] = static_cast<uint8_t>(value >> 24);
+    bufferData[1] = static_cast<uint8_t>(value >> 16);
+    bufferData[2] = static_cast<uint8_t>(value >> 8);
+    bufferData[3] = static_cast<uint8_t>(value);
+}
+
+
 // -----------
 // Constructor
 // -----------
@@ -138,417 +188,3071 @@ uint64_t bytesToUInt64(uint8_t* bufferData, size_t bufferLength) {
  * @return
  */
 AESXOR256::AESXOR256(std::vector<uint64_t> seed):
-    _rng(seed) {
+    _rng(seed),
+    _seed(seed) {
 
 }
 
 
-// ---------
-// getRandom
-// ---------
+// --------------
+// WhiteningQueue
+// --------------
+AESXOR256::WhiteningQueue::WhiteningQueue(): _next(0), _serving(0) {}
+
+
+// -------
+// reserve
+// -------
 /**
- * @brief Gets random uint64 values from pcg and stores them in a byte
- *        array.
+ * @brief Hands out the next ticket, called on the main thread when the
+ *        call is made.
  *
- * @param random container for resulting random bytes
- * @param len number of random bytes required
- *
- * @return void
+ * @return ticket
  */
-void AESXOR256::getRandom(uint8_t* random, int len) {
-    /* Getting the number of random uint64 values required based on
-     * the number of bytes asked for.
-     */
-    int numRand = len % 8 == 0 ? len / 8 : len / 8 + 1;
+uint64_t AESXOR256::WhiteningQueue::reserve() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _next++;
+}
 
-    std::vector<uint64_t> randomVector(numRand);
 
-    for (int i = 0; i < numRand; ++i) {
-        /* Getting random uint64 value from pcg random number generator
-         * using operator().
-         */
-        randomVector[i] = _rng();
+// ----------
+// tryReserve
+// ----------
+/**
+ * @brief Hands out the next ticket only if no earlier ticket is
+ *        outstanding, so that a sync call never waits on the main thread
+ *        for the thread pool.
+ *
+ * @param ticket resulting ticket, already being served
+ *
+ * @return true if a ticket was handed out
+ */
+bool AESXOR256::WhiteningQueue::tryReserve(uint64_t& ticket) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_serving != _next) {
+        return false;
     }
-
-    // Convert uint64 container to a byte array containing random values.
-    uInt64toBytes(randomVector.begin(), randomVector.end(), random);
+    ticket = _next++;
+    return true;
 }
 
 
-
-// ------------
-// encryptBlock
-// ------------
+// -------
+// pending
+// -------
 /**
- * @brief Encrypts the given message using AES in GCM mode to provide
- *        confidentiality and authenticity using the given key resulting
- *        in the cipher block.
+ * @brief Returns the number of tickets handed out and not yet released.
  *
- * @param cipher byte container for the resulting cipher
- * @param key byte container for the AES key
- * @param message byte container for the message
+ * @return number of outstanding tickets
+ */
+uint64_t AESXOR256::WhiteningQueue::pending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _next - _serving;
+}
+
+
+// ----
+// wait
+// ----
+/**
+ * @brief Blocks until all earlier tickets have been released.
  *
- * @throw Cryptopp:Exception in case of encryption errors
+ * @param ticket ticket obtained from reserve
  *
  * @return void
  */
-void AESXOR256::encryptBlock(std::vector<uint8_t>& cipher,
-    const std::vector<uint8_t>& key, const std::vector<uint8_t>& message) {
-
-    // initial vector (IV) for AES to XOR
-    std::vector<uint8_t> iv(CryptoPP::AES::BLOCKSIZE);
+void AESXOR256::WhiteningQueue::wait(uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _turn.wait(lock, [this, ticket]() { return _serving == ticket; });
+}
 
-    std::string ciphertext; //store encrypted message
 
+// -------
+// release
+// -------
+/**
+ * @brief Passes '_rng' on to the next ticket.
+ *
+ * @return void
+ */
+void AESXOR256::WhiteningQueue::release() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_serving;
+    }
+    _turn.notify_all();
+}
 
-    // Initialize AES with GCM mode
-    CryptoPP::GCM<AES>::Encryption e;
 
-    // Set AES Key and load IV.
-    e.SetKeyWithIV(key.data(), key.size(), iv.data());
+// -------------
+// WhiteningTurn
+// -------------
+AESXOR256::WhiteningTurn::WhiteningTurn(WhiteningQueue& queue,
+    uint64_t ticket): _queue(queue), _ticket(ticket), _taken(false),
+    _passed(false) {}
 
-    /* Apply the Cryptopp AuthenticatedEncryptionFilter to the message buffer
-     * using ArraySource, to transform it into an encrypted string 'ciphertext'.
-     */
-    ArraySource ss1(
-        message.data(),
-        message.size(),
-        true,
-        new CryptoPP::AuthenticatedEncryptionFilter(e,
-            new StringSink( ciphertext )
-        ) // AuthenticatedEncryptionFilter
-    ); // ArraySource
-
-    // Store the string cipher into the cipher byte vector.
-    cipher.resize(ciphertext.size());
-    StringSource ss2(
-        ciphertext,
-        true,
-        new ArraySink(cipher.data(), cipher.size())
-    );
-    return;
+AESXOR256::WhiteningTurn::~WhiteningTurn() {
+    pass();
 }
 
 
-// ------------
-// decryptBlock
-// ------------
+// ----
+// take
+// ----
 /**
- * @brief Decrypts the given cipher using AES in GCM mode to provide
- *        confidentiality and authenticity using the given key resulting
- *        in the message block.
- *
- * @param message byte container for the resulting decrypted message
- * @param cipher byte container for the input cipher
- * @param key byte container for the AES key
- *
- * @throw Cryptopp:Exception in case of decryption errors
+ * @brief Blocks until it is this ticket's turn on '_rng'.
  *
  * @return void
  */
-void AESXOR256::decryptBlock(std::vector<uint8_t>& message,
-    const std::vector<uint8_t>& key, const std::vector<uint8_t>& cipher) {
-
-    // initial vector (IV) for AES to XOR
-    std::vector<uint8_t> iv(CryptoPP::AES::BLOCKSIZE);
-
-    std::string decryptedtext; //store decrypted message
-
-    // initialize AES
-    CryptoPP::GCM< AES >::Decryption e;
-
-    // Set AES Key and load IV.
-    e.SetKeyWithIV(key.data(), key.size(), iv.data());
+void AESXOR256::WhiteningTurn::take() {
+    if (!_taken) {
+        _queue.wait(_ticket);
+        _taken = true;
+    }
+}
 
-    /* Apply the Cryptopp AuthenticatedDecryptionFilter to the cipher buffer
-     * using ArraySource, to transform it into the decrypted string.
-     */
-    ArraySource ss1(
-        cipher.data(),
-        cipher.size(),
-        true,
-        new CryptoPP::AuthenticatedDecryptionFilter(e,
-            new StringSink( decryptedtext )
-        ) // AuthenticatedDecryptionFilter
-    ); // ArraySource
-
-    // Store the decrypted string into the message byte vector.
-    message.resize(decryptedtext.size());
-    StringSource ss2(
-        decryptedtext,
-        true,
-        new ArraySink(message.data(), message.size())
-    );
 
-    return;
+// ----
+// pass
+// ----
+/**
+ * @brief Passes '_rng' on to the next ticket once this one is done with
+ *        it, taking the turn first if needed.
+ *
+ * @return void
+ */
+void AESXOR256::WhiteningTurn::pass() {
+    if (!_passed) {
+        take();
+        _queue.release();
+        _passed = true;
+    }
 }
 
 
 
-// -------------
-// xorRandomData
-// -------------
+// --------
+// syncTurn
+// --------
 /**
- * @brief XORs the given input container with requal number of random
- *        bytes obtained using the PCG random number generator.
+ * @brief Takes a ticket on '_rng' for a sync call, throwing a node.js error
+ *        instead of blocking when async calls are still queued ahead of it.
  *
- * @param output byte container for the resulting XOR'd output
- * @param input byte container for the input data to be XOR'd with
- *        random bytes
+ * @param ticket resulting ticket, whose turn it already is
  *
- * @return void
+ * @return true if the call may go ahead
  */
-void AESXOR256::xorRandomData(std::vector<uint8_t>& output,
-    const std::vector<uint8_t>& input) {
+bool AESXOR256::syncTurn(uint64_t& ticket) {
 
-    // Get PCG random bytes based on the size of the input vector.
-    std::vector<uint8_t> random(input.size());
-    getRandom(random.data(), random.size());
+    if (!_whitening.tryReserve(ticket)) {
+        Nan::ThrowError("encryptAsync/decryptAsync calls are still pending on "
+                        "this object, use the async functions until they "
+                        "complete");
+        return false;
+    }
 
-    /* XOR the random bytes with the input vector and store the result in the
-     * output vector
-     */
-    std::transform(input.begin(), input.begin() + input.size(),
-        random.data(), output.begin(), std::bit_xor<uint8_t>());
+    return true;
 }
 
 
-// ---
-// New
-// ---
+// --------
+// getNonce
+// --------
 /**
- * @brief Creates the wrapped object and corresponding underlying
- *        object with provided arguments - seed buffer and block size.
- *
- * Invoked as:
- * 'let obj = new AESXOR256(seed)' or
- * 'let obj = AESXOR256(seed)'
- * 'seed' is a buffer containing bytes representing the uint64 pcg seed
+ * @brief Gets nonce bytes from the instance's dedicated CSPRNG, leaving
+ *        the whitening stream untouched. Called on the main thread only.
  *
- * @param info node.js arguments wrapper containing seed buffer and
- *        block size
+ * @param nonce container for resulting nonce bytes
+ * @param len number of nonce bytes required
  *
  * @return void
  */
-NAN_METHOD(AESXOR256::New) {
-
-    v8::Local<v8::Context> context = Nan::GetCurrentContext();
+void AESXOR256::getNonce(uint8_t* nonce, int len) {
+    _nonceRng.GenerateBlock(nonce, size_t(len));
+}
 
-    if (info.IsConstructCall()) {
-        // Invoked as constructor: `new AESXOR256(...)`.
 
-        // Checking if first argument (seed) is a valid node.js buffer.
-        if (!node::Buffer::HasInstance(info[0])) {
 
-            Nan::ThrowError("Incorrect Arguments. Seed buffer not provided");
-            return;
+// ---------
+// xorRandom
+// ---------
+/**
+ * @brief XORs the given bytes in place with the whitening stream,
+ *        without intermediate containers.
+ *
+ * @param data bytes to be XOR'd in place
+ * @param len number of bytes
+ *
+ * @return void
+ */
+void AESXOR256::xorRandom(uint8_t* data, size_t len) {
+
+    // XOR whole uint64 values first, then the remaining tail bytes.
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t value = _rng();
+        for (int b = 0; b < 8; ++b) {
+            data[i + b] ^= static_cast<uint8_t>(value >> (8 * b));
         }
+    }
 
-        // Generating the uin64 seed from the node.js seed buffer.
-        v8::Local<v8::Object> bufferObj =
-            Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    if (i < len) {
+        uint64_t value = _rng();
+        for (int b = 0; i < len; ++i, ++b) {
+            data[i] ^= static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+}
 
-        uint8_t* bufferData = (uint8_t*)node::Buffer::Data(bufferObj);
-        size_t bufferLength = node::Buffer::Length(bufferObj);
 
-        std::vector<uint64_t> seed(2);
-        seed[0] = bytesToUInt64(bufferData, bufferLength);
-        seed[1] = bytesToUInt64(bufferData + 8, bufferLength);
+// ---------------
+// keyedEncryption
+// ---------------
+/**
+ * @brief Returns the cached GCM encryption object, re-keying it only
+ *        when the key differs, in constant time, from the one it was last
+ *        keyed with.
+ *
+ * @param key AES key
+ * @param keyLength AES key length
+ *
+ * @return GCM encryption object keyed with 'key'
+ */
+CryptoPP::GCM<AES>::Encryption& AESXOR256::keyedEncryption(
+    const uint8_t* key, size_t keyLength) {
 
-        // Initializing the wrapped object with given seed.
-        AESXOR256* obj = new AESXOR256(seed);
+    if (_encryptionKey.size() != keyLength
+        || !CryptoPP::VerifyBufsEqual(key, _encryptionKey.begin(), keyLength)) {
 
-        obj->Wrap(info.This());
+        _encryption.SetKey(key, keyLength);
+        _encryptionKey.Assign(key, keyLength);
+    }
 
-        info.GetReturnValue().Set(info.This());
+    return _encryption;
+}
 
-    } else {
-        // Invoked as plain function `AESXOR256(...)`, turn into construct call.
-        const int argc = info.Length();
 
-        // Creating argument array for construct call.
-        std::vector<v8::Local<v8::Value> > argv;
-        argv.reserve(argc);
-        for (int i = 0; i < argc; ++i) {
-            argv.push_back(info[i]);
-        }
+// ---------------
+// keyedDecryption
+// ---------------
+/**
+ * @brief Returns the cached GCM decryption object, re-keying it only
+ *        when the key differs, in constant time, from the one it was last
+ *        keyed with.
+ *
+ * @param key AES key
+ * @param keyLength AES key length
+ *
+ * @return GCM decryption object keyed with 'key'
+ */
+CryptoPP::GCM<AES>::Decryption& AESXOR256::keyedDecryption(
+    const uint8_t* key, size_t keyLength) {
 
-        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv.data()));
+    if (_decryptionKey.size() != keyLength
+        || !CryptoPP::VerifyBufsEqual(key, _decryptionKey.begin(), keyLength)) {
 
+        _decryption.SetKey(key, keyLength);
+        _decryptionKey.Assign(key, keyLength);
     }
+
+    return _decryption;
 }
 
 
+// ----------------
+// encryptVersioned
+// ----------------
+/**
+ * @brief Whitens and encrypts the message into the versioned format
+ *        [format][flags][nonce][ciphertext][tag], drawing a fresh
+ *        96-bit nonce for every message so one key can be reused.
+ *
+ * @param cipher container for the resulting cipher of
+ *        VERSIONED_HEADER_BYTES + messageLength + GCM_TAG_BYTES bytes
+ * @param key AES key
+ * @param keyLength AES key length
+ * @param message message bytes
+ * @param messageLength number of message bytes
+ * @param options cipher options naming the authenticated cipher and the
+ *        associated data
+ * @param deflated true if the message is a compressed payload
+ *
+ * @throw Cryptopp:Exception in case of encryption errors
+ *
+ * @return void
+ */
+void AESXOR256::encryptVersioned(uint8_t* cipher,
+    const uint8_t* key, size_t keyLength,
+    const uint8_t* message, size_t messageLength,
+    const CipherOptions& options, bool deflated) {
+
+    bool chacha = options.aead == AEAD_CHACHA20_POLY1305;
+
+    // Header: [format][flags][nonce], authenticated along with the message.
+    cipher[0] = VERSIONED_FORMAT;
+    cipher[1] = (chacha ? VERSIONED_FLAG_CHACHA20 : 0)
+        | (deflated ? VERSIONED_FLAG_DEFLATE : 0);
+    uint8_t* nonce = cipher + 2;
+    getNonce(nonce, GCM_NONCE_BYTES);
+
+    // XOR random bytes with a copy of the message, then encrypt in place.
+    uint8_t* body = cipher + VERSIONED_HEADER_BYTES;
+    std::copy(message, message + messageLength, body);
+    xorRandom(body, messageLength);
+
+    if (chacha) {
+        sealChaCha20(cipher, key, messageLength,
+            options.aad, options.aadLength);
+        return;
+    }
+
+    sealGcm(keyedEncryption(key, keyLength), nonce,
+        cipher, VERSIONED_HEADER_BYTES,
+        options.aad, options.aadLength,
+        body, messageLength);
+}
 
 
-// -------
-// encrypt
-// -------
+// ----------------
+// decryptVersioned
+// ----------------
 /**
- * @brief Unwraps the arguments to get the AES encryption key and
- *        message, and encrypts the message block by block to return
- *        the cipher.
+ * @brief Decrypts and verifies a cipher in the versioned format and
+ *        unwhitens it to return the original message, still compressed
+ *        if the header says it is deflated.
  *
- * Invoked as:
- * 'let cipher = obj.encrypt(key, message)'
- * 'key' is the buffer containing the AES key
- * 'message' is the buffer containing the message to be encrypted
- * 'cipher' is the buffer containing the encrypted cipher
- * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ * @param message container for the resulting message of
+ *        cipherLength - VERSIONED_HEADER_BYTES - GCM_TAG_BYTES bytes
+ * @param key AES key
+ * @param keyLength AES key length
+ * @param cipher cipher bytes
+ * @param cipherLength number of cipher bytes
+ * @param options cipher options naming the associated data
  *
- * @param info node.js arguments wrapper for AES key and message to be
- *        encrypted
+ * @throw std::runtime_error if the cipher is malformed or fails
+ *        authentication
  *
  * @return void
  */
-NAN_METHOD(AESXOR256::encrypt) {
+void AESXOR256::decryptVersioned(uint8_t* message,
+    const uint8_t* key, size_t keyLength,
+    const uint8_t* cipher, size_t cipherLength,
+    const CipherOptions& options) {
 
-    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+    openVersioned(message, key, keyLength, cipher, cipherLength, options);
 
-    // Checking arguments.
-    if (info.Length() < 2
-        || !node::Buffer::HasInstance(info[0])
-        || !node::Buffer::HasInstance(info[1])) {
+    // XOR random bytes with the decrypted message in place.
+    xorRandom(message, cipherLength - VERSIONED_HEADER_BYTES - GCM_TAG_BYTES);
+}
 
-        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
-                        "and 'message' function encrypt(key, message)'");
-        return;
-    }
 
-    /* Unwrap the first argument to get the AES key buffer and validate
-     * that the key length = AESNODE_DEFAULT_KEY_LENGTH_BYTES.
-     */
-    v8::Local<v8::Object> bufferObj0 =
-                Nan::To<v8::Object>(info[0]).ToLocalChecked();
-    uint8_t* keyData = (uint8_t *)node::Buffer::Data(bufferObj0);
-    size_t keyLength = node::Buffer::Length(bufferObj0);
+// -------------
+// openVersioned
+// -------------
+/**
+ * @brief Decrypts and verifies a cipher in the versioned format without
+ *        unwhitening it, so '_rng' is left untouched if it fails.
+ *
+ * @param message container for the resulting whitened message of
+ *        cipherLength - VERSIONED_HEADER_BYTES - GCM_TAG_BYTES bytes
+ * @param key AES key
+ * @param keyLength AES key length
+ * @param cipher cipher bytes
+ * @param cipherLength number of cipher bytes
+ * @param options cipher options naming the associated data
+ *
+ * @throw std::runtime_error if the cipher is malformed or fails
+ *        authentication
+ *
+ * @return void
+ */
+void AESXOR256::openVersioned(uint8_t* message,
+    const uint8_t* key, size_t keyLength,
+    const uint8_t* cipher, size_t cipherLength,
+    const CipherOptions& options) {
 
-    if (keyLength != AESNODE_DEFAULT_KEY_LENGTH_BYTES) {
-        Nan::ThrowError("Incorrect Arguments. Please provide a key of size "
-                        "32 bytes");
-        return;
-    }
+    if (cipherLength < size_t(VERSIONED_HEADER_BYTES + GCM_TAG_BYTES)
+        || cipher[0] != VERSIONED_FORMAT) {
 
-    // Unwrap the second argument to get the message buffer.
-    v8::Local<v8::Object> bufferObj1 =
-                Nan::To<v8::Object>(info[1]).ToLocalChecked();
-    uint8_t* messageData = (uint8_t *)node::Buffer::Data(bufferObj1);
-    size_t messageLength = node::Buffer::Length(bufferObj1);
+        throw std::runtime_error("Unsupported cipher format");
+    }
 
-    // XOR random bytes with the given message buffer before encrypting it.
-    std::vector<uint8_t> temp(messageLength);
-    obj->xorRandomData(temp,
-        std::vector<uint8_t>(messageData, messageData + messageLength)
-    );
+    const uint8_t* nonce = cipher + 2;
+    const uint8_t* body = cipher + VERSIONED_HEADER_BYTES;
+    size_t messageLength = cipherLength - VERSIONED_HEADER_BYTES
+        - GCM_TAG_BYTES;
 
+    bool authentic;
+    if (versionedAead(cipher) == AEAD_CHACHA20_POLY1305) {
+        authentic = openChaCha20(message, key, cipher, messageLength,
+            options.aad, options.aadLength);
+    } else {
+        authentic = openGcm(keyedDecryption(key, keyLength), nonce,
+            cipher, VERSIONED_HEADER_BYTES,
+            options.aad, options.aadLength,
+            body, messageLength, message);
+    }
 
-    // Encrypt the XOR'd bytes using the given key and store in ciper data.
-    std::vector<uint8_t> cipherData;
-    try {
+    if (!authentic) {
+        throw std::runtime_error("Message authentication failed");
+    }
+}
 
-        obj->encryptBlock(cipherData,
-            std::vector<uint8_t>(keyData, keyData + keyLength), temp
-        );
 
-    } catch (const CryptoPP::Exception& e) {
+// -------------
+// versionedAead
+// -------------
+/**
+ * @brief Reads the authenticated cipher from the flags of a versioned
+ *        header.
+ *
+ * @param header versioned header
+ *
+ * @throw std::runtime_error if the flags are not supported
+ *
+ * @return authenticated cipher
+ */
+AESXOR256::Aead AESXOR256::versionedAead(const uint8_t* header) {
 
-        // Throw an error to node.js in case of encryption errors.
-        Nan::ThrowError(e.what());
-        return;
+    if ((header[1] & ~(VERSIONED_FLAG_CHACHA20 | VERSIONED_FLAG_DEFLATE)) != 0) {
+        throw std::runtime_error("Unsupported cipher flags");
     }
 
-    // Copy cipherData vector into a node.js buffer.
-    auto slowBuffer = Nan::CopyBuffer((const char*)cipherData.data(),
-        cipherData.size()).ToLocalChecked();
-
-    // Set node.js buffer as return value of the function
-    info.GetReturnValue().Set(slowBuffer);
+    return (header[1] & VERSIONED_FLAG_CHACHA20) != 0 ? AEAD_CHACHA20_POLY1305
+        : AEAD_AES_256_GCM;
 }
 
 
-
-// -------
-// decrypt
-// -------
+// ----------
+// isDeflated
+// ----------
+/**
+ * @brief Tells whether a versioned header marks the message as
+ *        compressed.
+ *
+ * @param header versioned header
+ *
+ * @return true if the decrypted message must be inflated
+ */
+bool AESXOR256::isDeflated(const uint8_t* header) {
+    return (header[1] & VERSIONED_FLAG_DEFLATE) != 0;
+}
+
+
+// -------
+// sealGcm
+// -------
+/**
+ * @brief Encrypts a whitened body in place with AES-GCM and appends the
+ *        tag, authenticating the header and the associated data along with
+ *        it without copying them.
+ *
+ * @param gcm keyed AES-GCM encryption
+ * @param iv GCM_NONCE_BYTES nonce
+ * @param header header bytes, may be empty
+ * @param headerLength number of header bytes
+ * @param aad associated data, may be empty
+ * @param aadLength number of associated data bytes
+ * @param body whitened body followed by room for the tag
+ * @param bodyLength number of body bytes
+ *
+ * @throw Cryptopp:Exception in case of encryption errors
+ *
+ * @return void
+ */
+void AESXOR256::sealGcm(CryptoPP::GCM<AES>::Encryption& gcm,
+    const uint8_t* iv,
+    const uint8_t* header, size_t headerLength,
+    const uint8_t* aad, size_t aadLength,
+    uint8_t* body, size_t bodyLength) {
+
+    // Same as EncryptAndAuthenticate, fed through the AAD channel twice.
+    gcm.Resynchronize(iv, GCM_NONCE_BYTES);
+    gcm.Update(header, headerLength);
+    gcm.Update(aad, aadLength);
+    gcm.ProcessData(body, body, bodyLength);
+    gcm.TruncatedFinal(body + bodyLength, GCM_TAG_BYTES);
+}
+
+
+// -------
+// openGcm
+// -------
+/**
+ * @brief Decrypts and verifies an AES-GCM body followed by its tag,
+ *        authenticating the header and the associated data along with it,
+ *        leaving the message whitened.
+ *
+ * @param gcm keyed AES-GCM decryption
+ * @param iv GCM_NONCE_BYTES nonce
+ * @param header header bytes, may be empty
+ * @param headerLength number of header bytes
+ * @param aad associated data, may be empty
+ * @param aadLength number of associated data bytes
+ * @param body encrypted body followed by the tag
+ * @param bodyLength number of body bytes
+ * @param message container for the whitened message
+ *
+ * @throw Cryptopp:Exception in case of decryption errors
+ *
+ * @return true if the cipher is authentic
+ */
+bool AESXOR256::openGcm(CryptoPP::GCM<AES>::Decryption& gcm,
+    const uint8_t* iv,
+    const uint8_t* header, size_t headerLength,
+    const uint8_t* aad, size_t aadLength,
+    const uint8_t* body, size_t bodyLength,
+    uint8_t* message) {
+
+    // Same as DecryptAndVerify, fed through the AAD channel twice.
+    gcm.Resynchronize(iv, GCM_NONCE_BYTES);
+    gcm.Update(header, headerLength);
+    gcm.Update(aad, aadLength);
+    gcm.ProcessData(message, body, bodyLength);
+    return gcm.TruncatedVerify(body + bodyLength, GCM_TAG_BYTES);
+}
+
+
+// ------------
+// sealChaCha20
+// ------------
+/**
+ * @brief Encrypts the whitened body of a versioned cipher in place with
+ *        ChaCha20-Poly1305 and appends the tag, authenticating the header
+ *        along with it.
+ *
+ * @param cipher versioned cipher with the header and whitened body filled
+ *        in and room for the tag
+ * @param key 32-byte key
+ * @param messageLength number of body bytes
+ * @param aad associated data, may be empty
+ * @param aadLength number of associated data bytes
+ *
+ * @throw std::length_error if the message is too long
+ *
+ * @return void
+ */
+void AESXOR256::sealChaCha20(uint8_t* cipher, const uint8_t* key,
+    size_t messageLength, const uint8_t* aad, size_t aadLength) {
+
+    uint8_t* body = cipher + VERSIONED_HEADER_BYTES;
+
+    ChaCha20Poly1305 aead(key, cipher + 2);
+    aead.updateAad(cipher, VERSIONED_HEADER_BYTES);
+    aead.updateAad(aad, aadLength);
+    aead.encrypt(body, messageLength, body);
+    aead.finish(body + messageLength);
+}
+
+
+// ------------
+// openChaCha20
+// ------------
+/**
+ * @brief Decrypts and verifies the body of a versioned ChaCha20-Poly1305
+ *        cipher, leaving it whitened.
+ *
+ * @param message container for the whitened message
+ * @param key 32-byte key
+ * @param cipher versioned cipher bytes
+ * @param messageLength number of body bytes
+ * @param aad associated data, may be empty
+ * @param aadLength number of associated data bytes
+ *
+ * @throw std::length_error if the message is too long
+ *
+ * @return true if the cipher is authentic
+ */
+bool AESXOR256::openChaCha20(uint8_t* message, const uint8_t* key,
+    const uint8_t* cipher, size_t messageLength,
+    const uint8_t* aad, size_t aadLength) {
+
+    const uint8_t* body = cipher + VERSIONED_HEADER_BYTES;
+
+    ChaCha20Poly1305 aead(key, cipher + 2);
+    aead.updateAad(cipher, VERSIONED_HEADER_BYTES);
+    aead.updateAad(aad, aadLength);
+    aead.decrypt(body, messageLength, message);
+    return aead.verify(body + messageLength);
+}
+
+
+// ------------
+// segmentNonce
+// ------------
+/**
+ * @brief Builds the 96-bit GCM nonce of a segment as
+ *        [first 7 salt bytes][segment counter (4 bytes BE)][final flag].
+ *        Nonces only need to be unique under the container's segment
+ *        key, so the salt bytes just vary the whitening per container.
+ *
+ * @param header container header holding the salt
+ * @param index segment counter
+ * @param last true if this is the final segment of the container
+ * @param nonce container for the resulting GCM_NONCE_BYTES nonce
+ *
+ * @return void
+ */
+void AESXOR256::segmentNonce(const uint8_t* header, uint64_t index,
+    bool last, uint8_t* nonce) {
+
+    const uint8_t* salt = header + SEGMENT_HEADER_BYTES - SEGMENT_SALT_BYTES;
+    std::copy(salt, salt + 7, nonce);
+
+    writeUInt32BE(static_cast<uint32_t>(index), nonce + 7);
+
+    /* The final flag is part of the nonce so that a container truncated at
+     * a segment boundary fails authentication instead of decrypting short.
+     */
+    nonce[11] = last ? 1 : 0;
+}
+
+
+// ----------
+// segmentKey
+// ----------
+/**
+ * @brief Derives the AES key of a container as
+ *        KMAC256(key, salt, "SEIF segment key"), so every container is
+ *        sealed under its own key and its segment nonces never repeat
+ *        under the caller's key.
+ *
+ * @param key caller's AES key
+ * @param keyLength AES key length
+ * @param header container header holding the salt
+ * @param segmentKey container for the keyLength byte derived key
+ *
+ * @return void
+ */
+void AESXOR256::segmentKey(const uint8_t* key, size_t keyLength,
+    const uint8_t* header, uint8_t* segmentKey) {
+
+    Kmac kmac(Keccak::SHAKE256_RATE, key, keyLength,
+        reinterpret_cast<const uint8_t*>(SEGMENT_KEY_CUSTOMIZATION),
+        sizeof(SEGMENT_KEY_CUSTOMIZATION) - 1);
+
+    kmac.absorb(header + SEGMENT_HEADER_BYTES - SEGMENT_SALT_BYTES,
+        SEGMENT_SALT_BYTES);
+    kmac.finish(uint64_t(keyLength) * 8);
+    kmac.squeeze(segmentKey, keyLength);
+}
+
+
+// -------------
+// whitenSegment
+// -------------
+/**
+ * @brief XORs a segment in place with xorShift128 bytes derived from
+ *        the instance seed and the segment nonce, so any segment can
+ *        be whitened without replaying the ones before it.
+ *
+ * @param seed instance seed
+ * @param nonce segment nonce
+ * @param data segment bytes to be XOR'd in place
+ * @param len number of segment bytes
+ *
+ * @return void
+ */
+void AESXOR256::whitenSegment(const std::vector<uint64_t>& seed,
+    const uint8_t* nonce, uint8_t* data, size_t len) {
+
+    // Both halves of the nonce overlap the counter, so no two segments match.
+    std::vector<uint64_t> state(2);
+    state[0] = seed[0] ^ bytesToUInt64(const_cast<uint8_t*>(nonce), 8);
+    state[1] = seed[1] ^ bytesToUInt64(const_cast<uint8_t*>(nonce) + 4, 8);
+    if (state[0] == 0 && state[1] == 0) {
+        state[1] = 1;
+    }
+
+    XORShift128 rng(state);
+
+    // XOR whole uint64 values first, then the remaining tail bytes.
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t value = rng();
+        for (int b = 0; b < 8; ++b) {
+            data[i + b] ^= static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+
+    if (i < len) {
+        uint64_t value = rng();
+        for (int b = 0; i < len; ++i, ++b) {
+            data[i] ^= static_cast<uint8_t>(value >> (8 * b));
+        }
+    }
+}
+
+
+// -------------
+// segmentLayout
+// -------------
+/**
+ * @brief Validates a container header and length and derives the
+ *        segment layout from them.
+ *
+ * @param container container bytes starting with the header
+ * @param containerLength total number of container bytes
+ * @param layout resulting segment layout
+ *
+ * @return true if the container is well formed
+ */
+bool AESXOR256::segmentLayout(const uint8_t* container,
+    uint64_t containerLength, SegmentLayout& layout) {
+
+    // Every container holds the header and at least one (final) tag.
+    if (containerLength < uint64_t(SEGMENT_HEADER_BYTES + GCM_TAG_BYTES)
+        || container[0] != SEGMENT_FORMAT) {
+
+        return false;
+    }
+
+    layout.segmentSize = readUInt32BE(container + 1);
+
+    if (layout.segmentSize < SEGMENT_MIN_BYTES
+        || layout.segmentSize > SEGMENT_MAX_BYTES) {
+
+        return false;
+    }
+
+    uint64_t body = containerLength - SEGMENT_HEADER_BYTES;
+    uint64_t stride = uint64_t(layout.segmentSize) + GCM_TAG_BYTES;
+
+    layout.segmentCount = (body + stride - 1) / stride;
+
+    // The final segment must at least hold its tag.
+    uint64_t finalLength = body - (layout.segmentCount - 1) * stride;
+    if (finalLength < uint64_t(GCM_TAG_BYTES)
+        || layout.segmentCount > SEGMENT_MAX_COUNT) {
+
+        return false;
+    }
+
+    layout.plainLength = body - layout.segmentCount * GCM_TAG_BYTES;
+
+    return true;
+}
+
+
+// ------------
+// sealSegments
+// ------------
+/**
+ * @brief Whitens and encrypts a run of consecutive segments, spread
+ *        across the available cores.
+ *
+ * @param header container header (authenticated with every segment)
+ * @param seed instance seed used for whitening
+ * @param key caller's AES key the segment key is derived from
+ * @param keyLength AES key length
+ * @param firstSegment counter of the first segment in the run
+ * @param totalSegments number of segments in the whole container
+ * @param input plaintext of the run
+ * @param inputLength number of plaintext bytes in the run
+ * @param output container for the encrypted segments of the run
+ *
+ * @throw Cryptopp:Exception in case of encryption errors
+ *
+ * @return void
+ */
+void AESXOR256::sealSegments(const uint8_t* header,
+    const std::vector<uint64_t>& seed,
+    const uint8_t* key, size_t keyLength,
+    uint64_t firstSegment, uint64_t totalSegments,
+    const uint8_t* input, size_t inputLength, uint8_t* output) {
+
+    size_t segmentSize = readUInt32BE(header + 1);
+    size_t stride = segmentSize + GCM_TAG_BYTES;
+    size_t count = inputLength == 0 ? 1
+        : (inputLength + segmentSize - 1) / segmentSize;
+
+    CryptoPP::SecByteBlock containerKey(keyLength);
+    segmentKey(key, keyLength, header, containerKey.begin());
+
+    parallelFor(count, SEGMENTS_PER_THREAD, [&](size_t begin, size_t end) {
+
+        // One keyed GCM object per thread, resynchronized for each segment.
+        CryptoPP::GCM<AES>::Encryption e;
+        e.SetKey(containerKey.begin(), keyLength);
+
+        uint8_t nonce[GCM_NONCE_BYTES];
+
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t index = firstSegment + i;
+            size_t offset = i * segmentSize;
+            size_t length = std::min(segmentSize, inputLength - offset);
+            uint8_t* segment = output + i * stride;
+
+            segmentNonce(header, index, index + 1 == totalSegments, nonce);
+
+            // Whiten a copy of the plaintext, then encrypt it in place.
+            std::copy(input + offset, input + offset + length, segment);
+            whitenSegment(seed, nonce, segment, length);
+
+            e.EncryptAndAuthenticate(segment, segment + length,
+                GCM_TAG_BYTES, nonce, GCM_NONCE_BYTES,
+                header, SEGMENT_HEADER_BYTES, segment, length);
+        }
+    });
+}
+
+
+// ------------
+// openSegments
+// ------------
+/**
+ * @brief Decrypts, verifies and unwhitens a run of consecutive
+ *        segments, spread across the available cores.
+ *
+ * @param header container header (authenticated with every segment)
+ * @param seed instance seed used for whitening
+ * @param key caller's AES key the segment key is derived from
+ * @param keyLength AES key length
+ * @param firstSegment counter of the first segment in the run
+ * @param totalSegments number of segments in the whole container
+ * @param input encrypted segments of the run
+ * @param inputLength number of encrypted bytes in the run
+ * @param output container for the plaintext of the run
+ *
+ * @throw std::runtime_error if any segment fails authentication
+ *
+ * @return void
+ */
+void AESXOR256::openSegments(const uint8_t* header,
+    const std::vector<uint64_t>& seed,
+    const uint8_t* key, size_t keyLength,
+    uint64_t firstSegment, uint64_t totalSegments,
+    const uint8_t* input, size_t inputLength, uint8_t* output) {
+
+    size_t segmentSize = readUInt32BE(header + 1);
+
+    size_t stride = segmentSize + GCM_TAG_BYTES;
+    size_t count = (inputLength + stride - 1) / stride;
+
+    CryptoPP::SecByteBlock containerKey(keyLength);
+    segmentKey(key, keyLength, header, containerKey.begin());
+
+    parallelFor(count, SEGMENTS_PER_THREAD, [&](size_t begin, size_t end) {
+
+        // One keyed GCM object per thread, resynchronized for each segment.
+        CryptoPP::GCM<AES>::Decryption d;
+        d.SetKey(containerKey.begin(), keyLength);
+
+        uint8_t nonce[GCM_NONCE_BYTES];
+
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t index = firstSegment + i;
+            const uint8_t* segment = input + i * stride;
+            size_t length = std::min(stride, inputLength - i * stride)
+                - GCM_TAG_BYTES;
+            uint8_t* plain = output + i * segmentSize;
+
+            segmentNonce(header, index, index + 1 == totalSegments, nonce);
+
+            if (!d.DecryptAndVerify(plain, segment + length, GCM_TAG_BYTES,
+                    nonce, GCM_NONCE_BYTES, header, SEGMENT_HEADER_BYTES,
+                    segment, length)) {
+
+                throw std::runtime_error("Segment authentication failed");
+            }
+
+            whitenSegment(seed, nonce, plain, length);
+        }
+    });
+}
+
+
+// --------------
+// getKeyArgument
+// --------------
+/**
+ * @brief Unwraps an AES key argument and validates that its length is
+ *        'keyLength', throwing a node.js error otherwise.
+ *
+ * @param value node.js value expected to be the key buffer
+ * @param keyLength required key length
+ * @param keyData resulting pointer to the key bytes
+ *
+ * @return true if the argument is a key of the required length
+ */
+static bool getKeyArgument(v8::Local<v8::Value> value, size_t keyLength,
+    uint8_t*& keyData) {
+
+    if (!node::Buffer::HasInstance(value)) {
+        Nan::ThrowError("Incorrect Arguments. Please provide a buffer for "
+                        "'key'");
+        return false;
+    }
+
+    v8::Local<v8::Object> bufferObj = Nan::To<v8::Object>(value).ToLocalChecked();
+    if (node::Buffer::Length(bufferObj) != keyLength) {
+        Nan::ThrowError("Incorrect Arguments. Please provide a key of size "
+                        "32 bytes");
+        return false;
+    }
+
+    keyData = (uint8_t *)node::Buffer::Data(bufferObj);
+    return true;
+}
+
+
+// --------------
+// getSegmentSize
+// --------------
+/**
+ * @brief Unwraps an optional segment size argument, defaulting to
+ *        SEGMENT_DEFAULT_BYTES, throwing a node.js error if it is not
+ *        between SEGMENT_MIN_BYTES and SEGMENT_MAX_BYTES.
+ *
+ * @param value node.js value expected to be the segment size
+ * @param segmentSize resulting segment size
+ *
+ * @return true if the argument is a valid segment size
+ */
+bool AESXOR256::getSegmentSize(v8::Local<v8::Value> value,
+    uint32_t& segmentSize) {
+
+    segmentSize = SEGMENT_DEFAULT_BYTES;
+    if (value->IsUndefined()) {
+        return true;
+    }
+
+    if (!value->IsUint32()) {
+        Nan::ThrowError("Incorrect Arguments. 'segmentSize' must be a "
+                        "positive integer");
+        return false;
+    }
+
+    segmentSize = Nan::To<uint32_t>(value).FromJust();
+
+    if (segmentSize < SEGMENT_MIN_BYTES || segmentSize > SEGMENT_MAX_BYTES) {
+
+        Nan::ThrowError("Incorrect Arguments. 'segmentSize' must be between "
+                        "16 bytes and 16 MiB");
+        return false;
+    }
+
+    return true;
+}
+
+
+// -----------
+// defaultAead
+// -----------
+/**
+ * @brief Picks the faster authenticated cipher for this CPU: AES-256-GCM
+ *        when AES-NI and PCLMULQDQ are available, ChaCha20-Poly1305 (which
+ *        stays constant time without them) otherwise.
+ *
+ * @return authenticated cipher
+ */
+AESXOR256::Aead AESXOR256::defaultAead() {
+    const CpuFeatures& features = cpuFeatures();
+    return features.aesni && features.pclmul ? AEAD_AES_256_GCM
+        : AEAD_CHACHA20_POLY1305;
+}
+
+
+// ----------------
+// getCipherOptions
+// ----------------
+/**
+ * @brief Unwraps an optional options object passed to encrypt or
+ *        decrypt, throwing a node.js error if it is not an object or
+ *        names an unknown cipher.
+ *
+ * @param value node.js value expected to be the options object
+ * @param options resulting options
+ *
+ * @return true if the options could be unwrapped
+ */
+bool AESXOR256::getCipherOptions(v8::Local<v8::Value> value,
+    CipherOptions& options) {
+
+    options.versioned = false;
+    options.aead = defaultAead();
+    options.compressionLevel = 0;
+    options.aad = nullptr;
+    options.aadLength = 0;
+
+    if (value->IsUndefined()) {
+        return true;
+    }
+
+    if (!value->IsObject()) {
+        Nan::ThrowError("Incorrect Arguments. 'options' must be an object");
+        return false;
+    }
+
+    v8::Local<v8::Object> optionsObj = Nan::To<v8::Object>(value).ToLocalChecked();
+
+    v8::Local<v8::Value> versioned = Nan::Get(optionsObj,
+        Nan::New("versioned").ToLocalChecked()).ToLocalChecked();
+    options.versioned = versioned->IsTrue();
+
+    // Choosing a cipher implies the versioned format, which records it.
+    v8::Local<v8::Value> cipher = Nan::Get(optionsObj,
+        Nan::New("cipher").ToLocalChecked()).ToLocalChecked();
+
+    if (!cipher->IsUndefined()) {
+        std::string name = *Nan::Utf8String(cipher);
+
+        if (name == "aes-256-gcm") {
+            options.aead = AEAD_AES_256_GCM;
+        } else if (name == "chacha20-poly1305") {
+            options.aead = AEAD_CHACHA20_POLY1305;
+        } else if (name != "auto") {
+            Nan::ThrowError("Incorrect Arguments. 'cipher' must be 'auto', "
+                            "'aes-256-gcm' or 'chacha20-poly1305'");
+            return false;
+        }
+
+        options.versioned = true;
+    }
+
+    // Compression is recorded in the versioned header as well.
+    v8::Local<v8::Value> compress = Nan::Get(optionsObj,
+        Nan::New("compress").ToLocalChecked()).ToLocalChecked();
+
+    if (compress->IsTrue()) {
+        options.compressionLevel = DEFAULT_COMPRESSION_LEVEL;
+    } else if (compress->IsInt32()) {
+        options.compressionLevel = Nan::To<int32_t>(compress).FromJust();
+        if (options.compressionLevel < 1 || options.compressionLevel > 9) {
+            Nan::ThrowError("Incorrect Arguments. 'compress' must be a boolean "
+                            "or a level from 1 to 9");
+            return false;
+        }
+    } else if (!compress->IsUndefined() && !compress->IsFalse()) {
+        Nan::ThrowError("Incorrect Arguments. 'compress' must be a boolean "
+                        "or a level from 1 to 9");
+        return false;
+    }
+
+    // Associated data is bound by the versioned format only.
+    v8::Local<v8::Value> aad = Nan::Get(optionsObj,
+        Nan::New("aad").ToLocalChecked()).ToLocalChecked();
+
+    if (node::Buffer::HasInstance(aad)) {
+        options.aad = (const uint8_t *)node::Buffer::Data(aad);
+        options.aadLength = node::Buffer::Length(aad);
+        options.versioned = true;
+    } else if (!aad->IsUndefined()) {
+        Nan::ThrowError("Incorrect Arguments. 'aad' must be a buffer");
+        return false;
+    }
+
+    if (options.compressionLevel != 0) {
+        options.versioned = true;
+    }
+
+    return true;
+}
+
+
+// ---
+// New
+// ---
+/**
+ * @brief Creates the wrapped object and corresponding underlying
+ *        object with provided arguments - seed buffer and block size.
+ *
+ * Invoked as:
+ * 'let obj = new AESXOR256(seed)' or
+ * 'let obj = AESXOR256(seed)'
+ * 'seed' is a buffer containing bytes representing the uint64 pcg seed
+ *
+ * @param info node.js arguments wrapper containing seed buffer and
+ *        block size
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::New) {
+
+    v8::Local<v8::Context> context = Nan::GetCurrentContext();
+
+    if (info.IsConstructCall()) {
+        // Invoked as constructor: `new AESXOR256(...)`.
+
+        // Checking if first argument (seed) is a valid node.js buffer.
+        if (!node::Buffer::HasInstance(info[0])) {
+
+            Nan::ThrowError("Incorrect Arguments. Seed buffer not provided");
+            return;
+        }
+
+        // Generating the uin64 seed from the node.js seed buffer.
+        v8::Local<v8::Object> bufferObj =
+            Nan::To<v8::Object>(info[0]).ToLocalChecked();
+
+        uint8_t* bufferData = (uint8_t*)node::Buffer::Data(bufferObj);
+        size_t bufferLength = node::Buffer::Length(bufferObj);
+
+        std::vector<uint64_t> seed(2);
+        seed[0] = bytesToUInt64(bufferData, bufferLength);
+        seed[1] = bytesToUInt64(bufferData + 8, bufferLength);
+
+        // Initializing the wrapped object with given seed.
+        AESXOR256* obj = new AESXOR256(seed);
+
+        obj->Wrap(info.This());
+
+        info.GetReturnValue().Set(info.This());
+
+    } else {
+        // Invoked as plain function `AESXOR256(...)`, turn into construct call.
+        const int argc = info.Length();
+
+        // Creating argument array for construct call.
+        std::vector<v8::Local<v8::Value> > argv;
+        argv.reserve(argc);
+        for (int i = 0; i < argc; ++i) {
+            argv.push_back(info[i]);
+        }
+
+        v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+        info.GetReturnValue().Set(cons->NewInstance(context, argc, argv.data()));
+
+    }
+}
+
+
+
+
+// -------
+// encrypt
+// -------
+/**
+ * @brief Unwraps the arguments to get the AES encryption key and
+ *        message, and encrypts the message block by block to return
+ *        the cipher.
+ *
+ * Invoked as:
+ * 'let cipher = obj.encrypt(key, message, options)'
+ * 'key' is the buffer containing the AES key
+ * 'message' is the buffer containing the message to be encrypted
+ * 'options' (optional) is an object, {versioned: true} selects the
+ * versioned format with a random nonce per message, {cipher: [name]}
+ * also picks 'aes-256-gcm' or 'chacha20-poly1305' ('auto' by default)
+ * and {compress: true} (or a zlib level) deflates the message first
+ * and {aad: [buffer]} authenticates associated data without storing it
+ * 'cipher' is the buffer containing the encrypted cipher
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper for AES key and message to be
+ *        encrypted
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::encrypt) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2
+        || !node::Buffer::HasInstance(info[0])
+        || !node::Buffer::HasInstance(info[1])) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
+                        "and 'message' function encrypt(key, message)'");
+        return;
+    }
+
+    /* Unwrap the first argument to get the AES key buffer and validate
+     * that the key length = AESNODE_DEFAULT_KEY_LENGTH_BYTES.
+     */
+    v8::Local<v8::Object> bufferObj0 =
+                Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    uint8_t* keyData = (uint8_t *)node::Buffer::Data(bufferObj0);
+    size_t keyLength = node::Buffer::Length(bufferObj0);
+
+    if (keyLength != AESNODE_DEFAULT_KEY_LENGTH_BYTES) {
+        Nan::ThrowError("Incorrect Arguments. Please provide a key of size "
+                        "32 bytes");
+        return;
+    }
+
+    // Unwrap the second argument to get the message buffer.
+    v8::Local<v8::Object> bufferObj1 =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    uint8_t* messageData = (uint8_t *)node::Buffer::Data(bufferObj1);
+    size_t messageLength = node::Buffer::Length(bufferObj1);
+
+    // Unwrap the optional third argument to get the cipher options.
+    CipherOptions options;
+    if (!getCipherOptions(info[2], options)) {
+        return;
+    }
+
+    if (options.versioned) {
+
+        // Deflate first, whitening and encrypting the compressed payload.
+        ScratchBuffer payload;
+        bool deflated = false;
+        if (options.compressionLevel != 0) {
+            try {
+                deflated = compressPayload(messageData, messageLength,
+                    options.compressionLevel, payload);
+            } catch (const std::exception& e) {
+                Nan::ThrowError(e.what());
+                return;
+            }
+        }
+
+        if (deflated) {
+            messageData = payload.data();
+            messageLength = payload.size();
+        }
+
+        if (!fitsNodeBuffer(uint64_t(VERSIONED_HEADER_BYTES)
+                + messageLength + GCM_TAG_BYTES)) {
+            Nan::ThrowError("Message too large");
+            return;
+        }
+
+        // Encrypt straight into the node.js buffer returned to the caller.
+        v8::Local<v8::Object> cipher = Nan::NewBuffer(
+            VERSIONED_HEADER_BYTES + messageLength + GCM_TAG_BYTES
+        ).ToLocalChecked();
+
+        // Fail rather than wait for pending async calls to finish with '_rng'.
+        uint64_t ticket;
+        if (!obj->syncTurn(ticket)) {
+            return;
+        }
+        WhiteningTurn turn(obj->_whitening, ticket);
+        turn.take();
+
+        try {
+
+            obj->encryptVersioned((uint8_t *)node::Buffer::Data(cipher),
+                keyData, keyLength, messageData, messageLength,
+                options, deflated);
+
+        } catch (const std::exception& e) {
+
+            // Throw an error to node.js in case of encryption errors.
+            Nan::ThrowError(e.what());
+            return;
+        }
+
+        info.GetReturnValue().Set(cipher);
+        return;
+    }
+
+    if (!fitsNodeBuffer(uint64_t(messageLength) + GCM_TAG_BYTES)) {
+        Nan::ThrowError("Message too large");
+        return;
+    }
+
+    // Whiten and encrypt in place in the node.js buffer returned.
+    v8::Local<v8::Object> cipher = Nan::NewBuffer(
+        messageLength + GCM_TAG_BYTES).ToLocalChecked();
+    uint8_t* cipherData = (uint8_t *)node::Buffer::Data(cipher);
+    std::copy(messageData, messageData + messageLength, cipherData);
+
+    {
+        uint64_t ticket;
+        if (!obj->syncTurn(ticket)) {
+            return;
+        }
+        WhiteningTurn turn(obj->_whitening, ticket);
+        turn.take();
+        obj->xorRandom(cipherData, messageLength);
+    }
+
+    // The original format uses the all-zero IV and no header.
+    try {
+
+        sealGcm(obj->keyedEncryption(keyData, keyLength), LEGACY_IV,
+            nullptr, 0, nullptr, 0, cipherData, messageLength);
+
+    } catch (const std::exception& e) {
+
+        // Throw an error to node.js in case of encryption errors.
+        Nan::ThrowError(e.what());
+        return;
+    }
+
+    // Set node.js buffer as return value of the function
+    info.GetReturnValue().Set(cipher);
+}
+
+
+
+// -------
+// decrypt
+// -------
 /**
  * @brief Unwraps the arguments to get the AES decryption key and
  *        cipher, and decrypts the cipher block by block to return the
  *        original message.
  *
  * Invoked as:
- * 'let message = obj.decrypt(key, cipher)'
+ * 'let message = obj.decrypt(key, cipher, options)'
+ * 'key' is the buffer containing the AES key
+ * 'cipher' is the buffer containing the cipher to be decrypted
+ * 'options' (optional) is an object, {versioned: true} expects the
+ * versioned format and {aad: [buffer]} gives the associated data it was
+ * encrypted with
+ * 'message' is the buffer containing the original decypted message
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper for AES key and cipher to be
+ *        decrypted
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::decrypt) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2
+        || !node::Buffer::HasInstance(info[0])
+        || !node::Buffer::HasInstance(info[1])) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
+                        "and 'message' -> 'function encrypt(key, message)'");
+        return;
+    }
+
+    /* Unwrap the first argument to get the AES key buffer and validate
+     * that the key length = AESNODE_DEFAULT_KEY_LENGTH_BYTES.
+     */
+    v8::Local<v8::Object> bufferObj0 =
+                Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    uint8_t* keyData = (uint8_t *)node::Buffer::Data(bufferObj0);
+    size_t keyLength = node::Buffer::Length(bufferObj0);
+
+    if (keyLength != AESNODE_DEFAULT_KEY_LENGTH_BYTES) {
+        Nan::ThrowError("Incorrect Arguments. Please provide a key of size "
+                        "32 bytes");
+        return;
+    }
+
+    // Unwrap the second argument to get the message buffer.
+    v8::Local<v8::Object> bufferObj1 =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    uint8_t* cipherData = (uint8_t *)node::Buffer::Data(bufferObj1);
+    size_t cipherLength = node::Buffer::Length(bufferObj1);
+
+    // Unwrap the optional third argument to get the cipher options.
+    CipherOptions options;
+    if (!getCipherOptions(info[2], options)) {
+        return;
+    }
+
+    if (options.versioned) {
+
+        if (cipherLength < size_t(VERSIONED_HEADER_BYTES + GCM_TAG_BYTES)) {
+            Nan::ThrowError("Unsupported cipher format");
+            return;
+        }
+
+        size_t payloadLength = cipherLength - VERSIONED_HEADER_BYTES
+            - GCM_TAG_BYTES;
+
+        if (isDeflated(cipherData)) {
+
+            // Decrypt the compressed payload, then inflate it.
+            ScratchBuffer payload(payloadLength);
+            v8::Local<v8::Object> message;
+
+            try {
+
+                {
+                    uint64_t ticket;
+                    if (!obj->syncTurn(ticket)) {
+                        return;
+                    }
+                    WhiteningTurn turn(obj->_whitening, ticket);
+                    turn.take();
+                    obj->decryptVersioned(payload.data(), keyData, keyLength,
+                        cipherData, cipherLength, options);
+                }
+
+                size_t inflatedLength = decompressedLength(payload.data(),
+                    payload.size());
+                if (!fitsNodeBuffer(inflatedLength)) {
+                    throw std::length_error("Message too large");
+                }
+
+                message = Nan::NewBuffer(inflatedLength).ToLocalChecked();
+                decompressPayload(payload.data(), payload.size(),
+                    (uint8_t *)node::Buffer::Data(message));
+
+            } catch (const std::exception& e) {
+
+                // throw an error to node.js in case of decryption errors
+                Nan::ThrowError(e.what());
+                return;
+            }
+
+            info.GetReturnValue().Set(message);
+            return;
+        }
+
+        // Decrypt straight into the node.js buffer returned to the caller.
+        v8::Local<v8::Object> message = Nan::NewBuffer(payloadLength)
+            .ToLocalChecked();
+
+        // Fail rather than wait for pending async calls to finish with '_rng'.
+        uint64_t ticket;
+        if (!obj->syncTurn(ticket)) {
+            return;
+        }
+        WhiteningTurn turn(obj->_whitening, ticket);
+        turn.take();
+
+        try {
+
+            obj->decryptVersioned((uint8_t *)node::Buffer::Data(message),
+                keyData, keyLength, cipherData, cipherLength, options);
+
+        } catch (const std::exception& e) {
+
+            // throw an error to node.js in case of decryption errors
+            Nan::ThrowError(e.what());
+            return;
+        }
+
+        info.GetReturnValue().Set(message);
+        return;
+    }
+
+
+    if (cipherLength < size_t(GCM_TAG_BYTES)) {
+        Nan::ThrowError("Unsupported cipher format");
+        return;
+    }
+
+    // Decrypt straight into the node.js buffer returned to the caller.
+    size_t messageLength = cipherLength - GCM_TAG_BYTES;
+    v8::Local<v8::Object> message = Nan::NewBuffer(messageLength)
+        .ToLocalChecked();
+    uint8_t* messageData = (uint8_t *)node::Buffer::Data(message);
+
+    // The original format uses the all-zero IV and no header.
+    try {
+
+        if (!openGcm(obj->keyedDecryption(keyData, keyLength), LEGACY_IV,
+                nullptr, 0, nullptr, 0, cipherData, messageLength,
+                messageData)) {
+
+            Nan::ThrowError("Message authentication failed");
+            return;
+        }
+
+    } catch (const std::exception& e) {
+
+        // throw an error to node.js in case of decryption errors
+        Nan::ThrowError(e.what());
+        return;
+    }
+
+    // XOR random bytes with the decrypted message in place.
+    {
+        uint64_t ticket;
+        if (!obj->syncTurn(ticket)) {
+            return;
+        }
+        WhiteningTurn turn(obj->_whitening, ticket);
+        turn.take();
+        obj->xorRandom(messageData, messageLength);
+    }
+
+    // Set node.js buffer as return value of the function.
+    info.GetReturnValue().Set(message);
+}
+
+
+
+// ----------------
+// encryptSegmented
+// ----------------
+/**
+ * @brief Unwraps the arguments to get the AES key, message and
+ *        optional segment size, and encrypts the message into a
+ *        segmented container whose segments are sealed in parallel.
+ *
+ * Invoked as:
+ * 'let container = obj.encryptSegmented(key, message, segmentSize)'
+ * 'key' is the buffer containing the AES key
+ * 'message' is the buffer containing the message to be encrypted
+ * 'segmentSize' (optional) is the plaintext size of each segment
+ * 'container' is the buffer containing the segmented cipher
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper for AES key, message and
+ *        segment size
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::encryptSegmented) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2 || !node::Buffer::HasInstance(info[1])) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
+                        "and 'message' -> 'function encryptSegmented(key, "
+                        "message, segmentSize)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    // Unwrap the second argument to get the message buffer.
+    v8::Local<v8::Object> bufferObj1 =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    uint8_t* messageData = (uint8_t *)node::Buffer::Data(bufferObj1);
+    size_t messageLength = node::Buffer::Length(bufferObj1);
+
+    // Unwrap the optional third argument to get the segment size.
+    uint32_t segmentSize;
+    if (!getSegmentSize(info[2], segmentSize)) {
+        return;
+    }
+
+    // An empty message is still sealed as a single (final) segment.
+    uint64_t segmentCount = messageLength == 0 ? 1
+        : (uint64_t(messageLength) + segmentSize - 1) / segmentSize;
+    uint64_t containerLength = SEGMENT_HEADER_BYTES + uint64_t(messageLength)
+        + segmentCount * GCM_TAG_BYTES;
+
+    if (segmentCount > SEGMENT_MAX_COUNT
+        || !fitsNodeBuffer(containerLength)) {
+
+        Nan::ThrowError("Message too large for the given segment size");
+        return;
+    }
+
+    // Allocate the node.js buffer up front and seal straight into it.
+    v8::Local<v8::Object> container =
+        Nan::NewBuffer(containerLength).ToLocalChecked();
+    uint8_t* containerData = (uint8_t *)node::Buffer::Data(container);
+
+    // Header: [format][segment size (4 bytes BE)][random key salt].
+    containerData[0] = SEGMENT_FORMAT;
+    writeUInt32BE(segmentSize, containerData + 1);
+    obj->getNonce(containerData + SEGMENT_HEADER_BYTES
+        - SEGMENT_SALT_BYTES, SEGMENT_SALT_BYTES);
+
+    try {
+
+        sealSegments(containerData, obj->_seed,
+            keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+            0, segmentCount, messageData, messageLength,
+            containerData + SEGMENT_HEADER_BYTES);
+
+    } catch (const std::exception& e) {
+
+        // Throw an error to node.js in case of encryption errors.
+        Nan::ThrowError(e.what());
+        return;
+    }
+
+    // Set node.js buffer as return value of the function
+    info.GetReturnValue().Set(container);
+}
+
+
+
+// ----------------
+// decryptSegmented
+// ----------------
+/**
+ * @brief Unwraps the arguments to get the AES key and segmented
+ *        container, and decrypts every segment in parallel to return
+ *        the original message.
+ *
+ * Invoked as:
+ * 'let message = obj.decryptSegmented(key, container)'
+ * 'key' is the buffer containing the AES key
+ * 'container' is the buffer containing the segmented cipher
+ * 'message' is the buffer containing the original decrypted message
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper for AES key and container
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::decryptSegmented) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2 || !node::Buffer::HasInstance(info[1])) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
+                        "and 'container' -> 'function decryptSegmented(key, "
+                        "container)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    // Unwrap the second argument to get the container buffer.
+    v8::Local<v8::Object> bufferObj1 =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    uint8_t* containerData = (uint8_t *)node::Buffer::Data(bufferObj1);
+    size_t containerLength = node::Buffer::Length(bufferObj1);
+
+    SegmentLayout layout;
+    if (!segmentLayout(containerData, containerLength, layout)) {
+        Nan::ThrowError("Malformed segmented container");
+        return;
+    }
+
+    if (!fitsNodeBuffer(layout.plainLength)) {
+        Nan::ThrowError("Message too large");
+        return;
+    }
+
+    // Decrypt every segment straight into the returned node.js buffer.
+    v8::Local<v8::Object> message =
+        Nan::NewBuffer(layout.plainLength).ToLocalChecked();
+
+    try {
+
+        openSegments(containerData, obj->_seed,
+            keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+            0, layout.segmentCount,
+            containerData + SEGMENT_HEADER_BYTES,
+            containerLength - SEGMENT_HEADER_BYTES,
+            (uint8_t *)node::Buffer::Data(message));
+
+    } catch (const std::exception& e) {
+
+        // throw an error to node.js in case of decryption errors
+        Nan::ThrowError(e.what());
+        return;
+    }
+
+    // Set node.js buffer as return value of the function.
+    info.GetReturnValue().Set(message);
+}
+
+
+
+// ------------
+// decryptRange
+// ------------
+/**
+ * @brief Unwraps the arguments to get the AES key, segmented
+ *        container and plaintext range, and decrypts only the
+ *        segments overlapping that range.
+ *
+ * Invoked as:
+ * 'let slice = obj.decryptRange(key, container, offset, length)'
+ * 'key' is the buffer containing the AES key
+ * 'container' is the buffer containing the segmented cipher
+ * 'offset' is the plaintext offset of the first byte required
+ * 'length' is the number of plaintext bytes required
+ * 'slice' is the buffer containing the decrypted plaintext range
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper for AES key, container and
+ *        plaintext range
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::decryptRange) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 4
+        || !node::Buffer::HasInstance(info[1])
+        || !info[2]->IsNumber()
+        || !info[3]->IsUint32()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide 'key', "
+                        "'container', 'offset' and 'length' -> 'function "
+                        "decryptRange(key, container, offset, length)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    // Unwrap the second argument to get the container buffer.
+    v8::Local<v8::Object> bufferObj1 =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+    uint8_t* containerData = (uint8_t *)node::Buffer::Data(bufferObj1);
+    size_t containerLength = node::Buffer::Length(bufferObj1);
+
+    SegmentLayout layout;
+    if (!segmentLayout(containerData, containerLength, layout)) {
+        Nan::ThrowError("Malformed segmented container");
+        return;
+    }
+
+    /* Unwrap the plaintext range and check it lies inside the message. The
+     * offset may exceed 32 bits in large containers but must be a
+     * non-negative integer; the length is that of the returned buffer.
+     */
+    double offsetValue = Nan::To<double>(info[2]).FromJust();
+    if (!(offsetValue >= 0 && offsetValue < 18446744073709551616.0)
+        || offsetValue != double(uint64_t(offsetValue))) {
+
+        Nan::ThrowError("Incorrect Arguments. 'offset' must be a "
+                        "non-negative integer");
+        return;
+    }
+
+    uint64_t offset = uint64_t(offsetValue);
+    uint64_t length = Nan::To<uint32_t>(info[3]).FromJust();
+
+    if (offset > layout.plainLength || length > layout.plainLength - offset) {
+
+        Nan::ThrowError("Incorrect Arguments. Range lies outside of the "
+                        "message");
+        return;
+    }
+
+    if (length == 0) {
+        info.GetReturnValue().Set(Nan::NewBuffer(0).ToLocalChecked());
+        return;
+    }
+
+    // Segments overlapping [offset, offset + length).
+    uint64_t segmentSize = layout.segmentSize;
+    uint64_t first = uint64_t(offset) / segmentSize;
+    uint64_t last = (uint64_t(offset) + uint64_t(length) - 1) / segmentSize;
+
+    uint64_t stride = segmentSize + GCM_TAG_BYTES;
+    uint64_t runStart = SEGMENT_HEADER_BYTES + first * stride;
+    uint64_t runEnd = std::min<uint64_t>(containerLength,
+        SEGMENT_HEADER_BYTES + (last + 1) * stride);
+
+    // Decrypt only the overlapping segments, then copy out the range.
+    ScratchBuffer plain((last - first + 1) * segmentSize);
+    try {
+
+        openSegments(containerData, obj->_seed,
+            keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+            first, layout.segmentCount,
+            containerData + runStart, runEnd - runStart, plain.data());
+
+    } catch (const std::exception& e) {
+
+        // throw an error to node.js in case of decryption errors
+        Nan::ThrowError(e.what());
+        return;
+    }
+
+    auto slowBuffer = Nan::CopyBuffer(
+        (const char*)plain.data() + (uint64_t(offset) - first * segmentSize),
+        length).ToLocalChecked();
+
+    // Set node.js buffer as return value of the function.
+    info.GetReturnValue().Set(slowBuffer);
+}
+
+
+
+// -------------
+// EncryptWorker
+// -------------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data, reserving the
+ *        whitening ticket and the nonce on the main thread.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param obj AESXOR256 object the call was made on
+ * @param key AES key bytes
+ * @param keyLength AES key length
+ * @param message message buffer, kept alive until completion
+ * @param options cipher options
+ */
+AESXOR256::EncryptWorker::EncryptWorker(Nan::Callback* callback,
+    AESXOR256* obj,
+    const uint8_t* key, size_t keyLength,
+    v8::Local<v8::Object> message,
+    const CipherOptions& options
+): Nan::AsyncWorker(callback),
+    _obj(obj),
+    _key(key, keyLength),
+    _message((const uint8_t *)node::Buffer::Data(message)),
+    _messageLength(node::Buffer::Length(message)),
+    _options(options),
+    _aad(options.aad, options.aad + options.aadLength),
+    _ticket(obj->_whitening.reserve()),
+    _cipher(nullptr),
+    _cipherLength(0) {
+
+    // Keep the message buffer and the object alive without copying.
+    SaveToPersistent("message", message);
+    SaveToPersistent("object", obj->handle());
+    _options.aad = _aad.data();
+
+    if (_options.versioned) {
+        _header.resize(VERSIONED_HEADER_BYTES);
+        _header[0] = VERSIONED_FORMAT;
+        _header[1] = _options.aead == AEAD_CHACHA20_POLY1305
+            ? VERSIONED_FLAG_CHACHA20 : 0;
+        obj->getNonce(_header.data() + 2, GCM_NONCE_BYTES);
+    }
+}
+
+AESXOR256::EncryptWorker::~EncryptWorker() {
+    // Still set if the call failed, possibly holding whitened plaintext.
+    if (_cipher != nullptr) {
+        secureWipe(_cipher, _cipherLength);
+        free(_cipher);
+    }
+}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the
+ *        cipher buffer, handing the cipher memory to node.js without
+ *        copying it.
+ *
+ * @return void
+ */
+void AESXOR256::EncryptWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Object> cipher =
+        Nan::NewBuffer(_cipher, _cipherLength).ToLocalChecked();
+    _cipher = nullptr;
+
+    v8::Local<v8::Value> argv[] = {status, cipher};
+
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void AESXOR256::EncryptWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, whitening the message once it
+ *        is this call's turn on '_rng' and encrypting it.
+ *
+ * @return void
+ */
+void AESXOR256::EncryptWorker::Execute() {
+
+    // Passed on when leaving, whatever happens below.
+    WhiteningTurn turn(_obj->_whitening, _ticket);
+
+    // Deflate first, whitening and encrypting the compressed payload.
+    const uint8_t* message = _message;
+    size_t messageLength = _messageLength;
+    ScratchBuffer payload;
+
+    if (_options.versioned && _options.compressionLevel != 0) {
+        try {
+            if (compressPayload(_message, _messageLength,
+                    _options.compressionLevel, payload)) {
+
+                _header[1] |= VERSIONED_FLAG_DEFLATE;
+                message = payload.data();
+                messageLength = payload.size();
+            }
+        } catch (const std::exception& e) {
+            SetErrorMessage(e.what());
+            return;
+        }
+    }
+
+    size_t headerLength = _header.size();
+    if (!fitsNodeBuffer(uint64_t(headerLength) + messageLength
+            + GCM_TAG_BYTES)) {
+        SetErrorMessage("Message too large");
+        return;
+    }
+
+    _cipherLength = headerLength + messageLength + GCM_TAG_BYTES;
+    _cipher = (char *)malloc(_cipherLength);
+    if (_cipher == nullptr) {
+        SetErrorMessage("Unable to allocate the cipher");
+        return;
+    }
+
+    uint8_t* cipher = (uint8_t *)_cipher;
+    uint8_t* body = cipher + headerLength;
+    std::copy(_header.begin(), _header.end(), cipher);
+    std::copy(message, message + messageLength, body);
+
+    // Whiten in call order, then let the next call have '_rng'.
+    turn.take();
+    _obj->xorRandom(body, messageLength);
+    turn.pass();
+
+    // The original format uses the all-zero IV and no header.
+    const uint8_t* iv = _options.versioned ? cipher + 2 : LEGACY_IV;
+
+    try {
+
+        if (_options.versioned && _options.aead == AEAD_CHACHA20_POLY1305) {
+            sealChaCha20(cipher, _key.begin(), messageLength,
+                _options.aad, _options.aadLength);
+            return;
+        }
+
+        CryptoPP::GCM<AES>::Encryption e;
+        e.SetKey(_key.begin(), _key.size());
+        sealGcm(e, iv, cipher, headerLength,
+            _options.aad, _options.aadLength,
+            body, messageLength);
+
+    } catch (const std::exception& e) {
+        SetErrorMessage(e.what());
+    }
+}
+
+
+// -------------
+// DecryptWorker
+// -------------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data, reserving the
+ *        whitening ticket on the main thread.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param obj AESXOR256 object the call was made on
+ * @param key AES key bytes
+ * @param keyLength AES key length
+ * @param cipher cipher buffer, kept alive until completion
+ * @param options cipher options
+ */
+AESXOR256::DecryptWorker::DecryptWorker(Nan::Callback* callback,
+    AESXOR256* obj,
+    const uint8_t* key, size_t keyLength,
+    v8::Local<v8::Object> cipher,
+    const CipherOptions& options
+): Nan::AsyncWorker(callback),
+    _obj(obj),
+    _key(key, keyLength),
+    _cipher((const uint8_t *)node::Buffer::Data(cipher)),
+    _cipherLength(node::Buffer::Length(cipher)),
+    _options(options),
+    _aad(options.aad, options.aad + options.aadLength),
+    _ticket(obj->_whitening.reserve()),
+    _message(nullptr),
+    _messageLength(0) {
+
+    // Keep the cipher buffer and the object alive without copying.
+    SaveToPersistent("cipher", cipher);
+    SaveToPersistent("object", obj->handle());
+    _options.aad = _aad.data();
+}
+
+AESXOR256::DecryptWorker::~DecryptWorker() {
+    // Still set if the call failed, possibly holding unverified plaintext.
+    if (_message != nullptr) {
+        secureWipe(_message, _messageLength);
+        free(_message);
+    }
+}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the
+ *        message buffer, handing the message memory to node.js without
+ *        copying it.
+ *
+ * @return void
+ */
+void AESXOR256::DecryptWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Object> message =
+        Nan::NewBuffer(_message, _messageLength).ToLocalChecked();
+    _message = nullptr;
+
+    v8::Local<v8::Value> argv[] = {status, message};
+
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void AESXOR256::DecryptWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, decrypting and verifying the
+ *        cipher and unwhitening it once it is this call's turn on
+ *        '_rng'.
+ *
+ * @return void
+ */
+void AESXOR256::DecryptWorker::Execute() {
+
+    // Passed on when leaving, whatever happens below.
+    WhiteningTurn turn(_obj->_whitening, _ticket);
+
+    size_t headerLength = _options.versioned ? VERSIONED_HEADER_BYTES : 0;
+    if (_cipherLength < headerLength + GCM_TAG_BYTES
+        || (_options.versioned && _cipher[0] != VERSIONED_FORMAT)) {
+
+        SetErrorMessage("Unsupported cipher format");
+        return;
+    }
+
+    Aead aead = AEAD_AES_256_GCM;
+    if (_options.versioned) {
+        try {
+            aead = versionedAead(_cipher);
+        } catch (const std::exception& e) {
+            SetErrorMessage(e.what());
+            return;
+        }
+    }
+
+    _messageLength = _cipherLength - headerLength - GCM_TAG_BYTES;
+    _message = (char *)malloc(std::max<size_t>(1, _messageLength));
+    if (_message == nullptr) {
+        SetErrorMessage("Unable to allocate the message");
+        return;
+    }
+
+    // The original format uses the all-zero IV and no header.
+    const uint8_t* iv = _options.versioned ? _cipher + 2 : LEGACY_IV;
+    const uint8_t* body = _cipher + headerLength;
+    uint8_t* message = (uint8_t *)_message;
+
+    try {
+
+        bool authentic;
+        if (aead == AEAD_CHACHA20_POLY1305) {
+            authentic = openChaCha20(message, _key.begin(), _cipher,
+                _messageLength, _options.aad, _options.aadLength);
+        } else {
+            CryptoPP::GCM<AES>::Decryption d;
+            d.SetKey(_key.begin(), _key.size());
+            authentic = openGcm(d, iv, _cipher, headerLength,
+                _options.aad, _options.aadLength,
+                body, _messageLength, message);
+        }
+
+        if (!authentic) {
+            SetErrorMessage("Message authentication failed");
+            return;
+        }
+
+    } catch (const std::exception& e) {
+        SetErrorMessage(e.what());
+        return;
+    }
+
+    // Unwhiten in call order.
+    turn.take();
+    _obj->xorRandom(message, _messageLength);
+    turn.pass();
+
+    if (!_options.versioned || !isDeflated(_cipher)) {
+        return;
+    }
+
+    // Swap the compressed payload for the inflated message.
+    try {
+
+        size_t inflatedLength = decompressedLength(message, _messageLength);
+        if (!fitsNodeBuffer(inflatedLength)) {
+            SetErrorMessage("Message too large");
+            return;
+        }
+
+        char* inflated = (char *)malloc(std::max<size_t>(1, inflatedLength));
+        if (inflated == nullptr) {
+            SetErrorMessage("Unable to allocate the message");
+            return;
+        }
+
+        try {
+            decompressPayload(message, _messageLength, (uint8_t *)inflated);
+        } catch (...) {
+            secureWipe(inflated, inflatedLength);
+            free(inflated);
+            throw;
+        }
+
+        // The compressed payload is plaintext too.
+        secureWipe(_message, _messageLength);
+        free(_message);
+        _message = inflated;
+        _messageLength = inflatedLength;
+
+    } catch (const std::exception& e) {
+        SetErrorMessage(e.what());
+    }
+}
+
+
+
+// ----------
+// FileWorker
+// ----------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param encrypt true to encrypt, false to decrypt
+ * @param source path of the file to read
+ * @param target path of the file to create or replace
+ * @param key AES key bytes
+ * @param keyLength AES key length
+ * @param seed seed used for segment whitening
+ * @param header container header when encrypting, else empty
+ * @param direct true to read 'source' with O_DIRECT
+ */
+AESXOR256::FileWorker::FileWorker(Nan::Callback* callback,
+    bool encrypt,
+    const std::string& source,
+    const std::string& target,
+    const uint8_t* key, size_t keyLength,
+    const std::vector<uint64_t>& seed,
+    const std::vector<uint8_t>& header,
+    bool direct
+): Nan::AsyncWorker(callback),
+    _encrypt(encrypt),
+    _source(source),
+    _target(target),
+    _key(key, keyLength),
+    _seed(seed),
+    _header(header),
+    _direct(direct),
+    _bytes(0),
+    _seconds(0) {}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the
+ *        throughput of the operation
+ * {bytes: [plaintextBytes], seconds: [seconds], throughput: [bytesPerSecond]}
+ *
+ * @return void
+ */
+void AESXOR256::FileWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+    Nan::Set(stats,
+        Nan::New<v8::String>("bytes").ToLocalChecked(),
+        Nan::New<v8::Number>(double(_bytes))
+    );
+    Nan::Set(stats,
+        Nan::New<v8::String>("seconds").ToLocalChecked(),
+        Nan::New<v8::Number>(_seconds)
+    );
+    Nan::Set(stats,
+        Nan::New<v8::String>("throughput").ToLocalChecked(),
+        Nan::New<v8::Number>(_seconds > 0 ? double(_bytes) / _seconds : 0)
+    );
+
+    v8::Local<v8::Value> argv[] = {status, stats};
+
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void AESXOR256::FileWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, streaming 'source' into a
+ *        temporary file that atomically replaces 'target' once complete.
+ *
+ * @return void
+ */
+void AESXOR256::FileWorker::Execute() {
+
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+
+        uint64_t inputLength;
+        FileDescriptor input(openForReading(_source, _direct, inputLength));
+
+        // Removed again unless everything below succeeds.
+        ReplacingFile output(_target);
+
+        stream(input.get(), inputLength, output.get());
+
+        output.commit();
+
+    } catch (const std::exception& e) {
+        SetErrorMessage(e.what());
+        return;
+    }
+
+    _seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+
+// ------
+// stream
+// ------
+/**
+ * @brief Reads 'source' in aligned chunks, seals or opens the whole
+ *        segments in each chunk in parallel and writes the result to
+ *        'target'.
+ *
+ * @param input file descriptor of 'source'
+ * @param inputLength size of 'source'
+ * @param output file descriptor of the temporary target
+ *
+ * @throw std::runtime_error on I/O or authentication errors
+ *
+ * @return void
+ */
+void AESXOR256::FileWorker::stream(int input, uint64_t inputLength,
+    int output) {
+
+    uint64_t remaining = inputLength;
+    uint64_t totalSegments;
+    size_t segmentSize;
+
+    // Bytes read along with the container header, still to be processed.
+    AlignedBuffer first(FILEIO_ALIGNMENT_BYTES);
+    const uint8_t* initial = first.data();
+    size_t initialLength = 0;
+
+    if (_encrypt) {
+
+        segmentSize = readUInt32BE(_header.data() + 1);
+        totalSegments = inputLength == 0 ? 1
+            : (inputLength + segmentSize - 1) / segmentSize;
+
+        if (totalSegments > SEGMENT_MAX_COUNT) {
+            throw std::runtime_error("File too large for the given segment "
+                                     "size");
+        }
+
+        writeFull(output, _header.data(), _header.size());
+        _bytes = inputLength;
+
+    } else {
+
+        // One aligned block holds the header, keeping later reads aligned.
+        size_t got = size_t(std::min<uint64_t>(remaining,
+            readFull(input, first.data(), first.size())));
+
+        SegmentLayout layout;
+        if (got < size_t(SEGMENT_HEADER_BYTES)
+            || !segmentLayout(first.data(), inputLength, layout)) {
+
+            throw std::runtime_error("Malformed segmented container");
+        }
+
+        _header.assign(first.data(), first.data() + SEGMENT_HEADER_BYTES);
+        initial = first.data() + SEGMENT_HEADER_BYTES;
+        initialLength = got - SEGMENT_HEADER_BYTES;
+        remaining -= got;
+
+        segmentSize = layout.segmentSize;
+        totalSegments = layout.segmentCount;
+        _bytes = layout.plainLength;
+    }
+
+    size_t stride = segmentSize + GCM_TAG_BYTES;
+    size_t inputUnit = _encrypt ? segmentSize : stride;
+    size_t outputUnit = _encrypt ? stride : segmentSize;
+
+    /* Whole segments are processed straight from the staging buffer and the
+     * partial one left over is carried in front of the next read, so reads
+     * always land on the same aligned address at aligned file offsets.
+     */
+    size_t carryRoom = (std::max<size_t>(inputUnit, FILEIO_ALIGNMENT_BYTES)
+        + FILEIO_ALIGNMENT_BYTES - 1)
+        / FILEIO_ALIGNMENT_BYTES * FILEIO_ALIGNMENT_BYTES;
+    AlignedBuffer staging(carryRoom + FILE_CHUNK_BYTES);
+    uint8_t* readArea = staging.data() + carryRoom;
+
+    AlignedBuffer processed(
+        ((carryRoom + FILE_CHUNK_BYTES) / inputUnit + 1) * outputUnit);
+
+    uint8_t* pending = readArea - initialLength;
+    size_t pendingLength = initialLength;
+    std::copy(initial, initial + initialLength, pending);
+
+    uint64_t segment = 0;
+
+    auto process = [&](const uint8_t* data, size_t length) {
+
+        size_t count;
+        size_t outputLength;
+
+        if (_encrypt) {
+            count = length == 0 ? 1 : (length + segmentSize - 1) / segmentSize;
+            outputLength = length + count * GCM_TAG_BYTES;
+            sealSegments(_header.data(), _seed, _key.begin(), _key.size(),
+                segment, totalSegments, data, length, processed.data());
+        } else {
+            count = (length + stride - 1) / stride;
+            outputLength = length - count * GCM_TAG_BYTES;
+            openSegments(_header.data(), _seed, _key.begin(), _key.size(),
+                segment, totalSegments, data, length, processed.data());
+        }
+
+        writeFull(output, processed.data(), outputLength);
+        segment += count;
+    };
+
+    while (true) {
+
+        if (remaining > 0) {
+            size_t got = readFull(input, readArea, FILE_CHUNK_BYTES);
+            if (got == 0) {
+                throw std::runtime_error("Unexpected end of '" + _source + "'");
+            }
+
+            got = size_t(std::min<uint64_t>(got, remaining));
+            remaining -= got;
+            pendingLength += got;
+        }
+
+        // Whole segments only, unless this was the last chunk.
+        size_t length = remaining == 0 ? pendingLength
+            : pendingLength / inputUnit * inputUnit;
+
+        if (length > 0) {
+            process(pending, length);
+            pending += length;
+            pendingLength -= length;
+        }
+
+        if (remaining == 0) {
+            break;
+        }
+
+        std::memmove(readArea - pendingLength, pending, pendingLength);
+        pending = readArea - pendingLength;
+    }
+
+    // An empty file is still sealed as a single (final) segment.
+    if (segment < totalSegments) {
+        if (!_encrypt) {
+            throw std::runtime_error("Malformed segmented container");
+        }
+        process(pending, 0);
+    }
+}
+
+
+
+// ------------
+// encryptAsync
+// ------------
+/**
+ * @brief Unwraps the arguments to get the AES key, message and options
+ *        and encrypts the message on the libuv thread pool, keeping a
+ *        reference to the message buffer instead of copying it.
+ *
+ * Invoked as:
+ * 'obj.encryptAsync(key, message, options, function(status, cipher){})'
+ * 'key' is the buffer containing the AES key
+ * 'message' is the buffer containing the message to be encrypted
+ * 'options' (optional) is an object as accepted by encrypt
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'cipher' is the buffer containing the encrypted cipher
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::encryptAsync) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // The callback is the last argument, options may be left out.
+    int callbackIndex = info.Length() - 1;
+
+    // Checking arguments.
+    if (info.Length() < 3 || info.Length() > 4
+        || !node::Buffer::HasInstance(info[1])
+        || !info[callbackIndex]->IsFunction()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
+                        "and 'message' and a callback function -> 'function "
+                        "encryptAsync(key, message, options, callback)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    CipherOptions options;
+    if (!getCipherOptions(callbackIndex == 3 ? info[2]
+            : v8::Local<v8::Value>(Nan::Undefined()), options)) {
+        return;
+    }
+
+    Nan::Callback *callback =
+        new Nan::Callback(info[callbackIndex].As<v8::Function>());
+
+    EncryptWorker* worker = new EncryptWorker(callback, obj,
+        keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+        Nan::To<v8::Object>(info[1]).ToLocalChecked(), options);
+
+    Nan::AsyncQueueWorker(worker);
+}
+
+
+
+// ------------
+// decryptAsync
+// ------------
+/**
+ * @brief Unwraps the arguments to get the AES key, cipher and options
+ *        and decrypts the cipher on the libuv thread pool, keeping a
+ *        reference to the cipher buffer instead of copying it.
+ *
+ * Invoked as:
+ * 'obj.decryptAsync(key, cipher, options, function(status, message){})'
  * 'key' is the buffer containing the AES key
  * 'cipher' is the buffer containing the cipher to be decrypted
- * 'message' is the buffer containing the original decypted message
+ * 'options' (optional) is an object as accepted by decrypt
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'message' is the buffer containing the decrypted message
  * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
  *
- * @param info node.js arguments wrapper for AES key and cipher to be
- *        decrypted
+ * @param info node.js arguments wrapper
  *
  * @return void
  */
-NAN_METHOD(AESXOR256::decrypt) {
+NAN_METHOD(AESXOR256::decryptAsync) {
 
     AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
 
+    // The callback is the last argument, options may be left out.
+    int callbackIndex = info.Length() - 1;
+
     // Checking arguments.
-    if (info.Length() < 2
-        || !node::Buffer::HasInstance(info[0])
-        || !node::Buffer::HasInstance(info[1])) {
+    if (info.Length() < 3 || info.Length() > 4
+        || !node::Buffer::HasInstance(info[1])
+        || !info[callbackIndex]->IsFunction()) {
 
         Nan::ThrowError("Incorrect Arguments. Please provide buffers for 'key' "
-                        "and 'message' -> 'function encrypt(key, message)'");
+                        "and 'cipher' and a callback function -> 'function "
+                        "decryptAsync(key, cipher, options, callback)'");
         return;
     }
 
-    /* Unwrap the first argument to get the AES key buffer and validate
-     * that the key length = AESNODE_DEFAULT_KEY_LENGTH_BYTES.
-     */
-    v8::Local<v8::Object> bufferObj0 =
-                Nan::To<v8::Object>(info[0]).ToLocalChecked();
-    uint8_t* keyData = (uint8_t *)node::Buffer::Data(bufferObj0);
-    size_t keyLength = node::Buffer::Length(bufferObj0);
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
 
-    if (keyLength != AESNODE_DEFAULT_KEY_LENGTH_BYTES) {
-        Nan::ThrowError("Incorrect Arguments. Please provide a key of size "
-                        "32 bytes");
+    CipherOptions options;
+    if (!getCipherOptions(callbackIndex == 3 ? info[2]
+            : v8::Local<v8::Value>(Nan::Undefined()), options)) {
         return;
     }
 
-    // Unwrap the second argument to get the message buffer.
-    v8::Local<v8::Object> bufferObj1 =
-                Nan::To<v8::Object>(info[1]).ToLocalChecked();
-    uint8_t* cipherData = (uint8_t *)node::Buffer::Data(bufferObj1);
-    size_t cipherLength = node::Buffer::Length(bufferObj1);
+    Nan::Callback *callback =
+        new Nan::Callback(info[callbackIndex].As<v8::Function>());
+
+    DecryptWorker* worker = new DecryptWorker(callback, obj,
+        keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+        Nan::To<v8::Object>(info[1]).ToLocalChecked(), options);
+
+    Nan::AsyncQueueWorker(worker);
+}
+
+
+
+// -----------
+// encryptMany
+// -----------
+/**
+ * @brief Unwraps the arguments to get the AES key and a batch of records
+ *        and encrypts every record in the versioned format with a single
+ *        key setup, into one contiguous buffer.
+ *
+ * Invoked as:
+ * 'let result = obj.encryptMany(key, records, options)'
+ * 'key' is the buffer containing the AES key
+ * 'records' is an array of buffers or a packed {data, offsets} object
+ * 'options' (optional) is an object, {cipher: [name]} selects the cipher
+ * 'result' is of the form {data: [ciphers], offsets: [Uint32Array]} where
+ * cipher i is data[offsets[i], offsets[i + 1]); the ciphers are whitened in
+ * sequence, so they can also be decrypted one by one with
+ * decrypt(key, cipher, {versioned: true}), but only in batch order
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::encryptMany) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2) {
+        Nan::ThrowError("Incorrect Arguments. Please provide 'key' and "
+                        "'records' -> 'function encryptMany(key, records)'");
+        return;
+    }
 
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    std::vector<Record> records;
+    if (!getRecordsArgument(info[1], records)) {
+        return;
+    }
+
+    CipherOptions options;
+    if (!getCipherOptions(info[2], options)) {
+        return;
+    }
 
-    // Decrypt the given cipher buffer using the given key.
-    std::vector<uint8_t> temp;
+    // Deflate the records that shrink, encrypting their payloads instead.
+    std::vector<ScratchBuffer> payloads(
+        options.compressionLevel != 0 ? records.size() : 0);
+    std::vector<bool> deflated(records.size(), false);
     try {
+        for (size_t i = 0; i < payloads.size(); ++i) {
+            if (compressPayload(records[i].data, records[i].length,
+                    options.compressionLevel, payloads[i])) {
+
+                deflated[i] = true;
+                records[i].data = payloads[i].data();
+                records[i].length = payloads[i].size();
+            }
+        }
+    } catch (const std::exception& e) {
+        Nan::ThrowError(e.what());
+        return;
+    }
 
-        obj->decryptBlock(temp,
-            std::vector<uint8_t>(keyData, keyData + keyLength),
-            std::vector<uint8_t>(cipherData, cipherData + cipherLength)
-        );
+    // Lay the ciphers out back to back.
+    const size_t overhead = VERSIONED_HEADER_BYTES + GCM_TAG_BYTES;
+    std::vector<uint32_t> offsets(records.size() + 1);
+    uint64_t total = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        offsets[i] = uint32_t(total);
+        total += records[i].length + overhead;
+        if (!fitsNodeBuffer(total)) {
+            Nan::ThrowError("Incorrect Arguments. Batch is too large");
+            return;
+        }
+    }
+    offsets[records.size()] = uint32_t(total);
 
-    } catch (const CryptoPP::Exception& e) {
+    v8::Local<v8::Object> data = Nan::NewBuffer(total).ToLocalChecked();
+    uint8_t* cipherData = (uint8_t *)node::Buffer::Data(data);
 
-        // throw an error to node.js in case of decryption errors
+    // Fail rather than wait for pending async calls to finish with '_rng'.
+    uint64_t ticket;
+    if (!obj->syncTurn(ticket)) {
+        return;
+    }
+    WhiteningTurn turn(obj->_whitening, ticket);
+    turn.take();
+
+    try {
+
+        // The cached GCM object keeps the key schedule for the whole batch.
+        for (size_t i = 0; i < records.size(); ++i) {
+            obj->encryptVersioned(cipherData + offsets[i],
+                keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+                records[i].data, records[i].length, options,
+                deflated[i]);
+        }
+
+    } catch (const std::exception& e) {
+
+        // Throw an error to node.js in case of encryption errors.
         Nan::ThrowError(e.what());
         return;
     }
 
-    // XOR random bytes with the decrypted message buffer.
-    std::vector<uint8_t> messageData(temp.size());
-    obj->xorRandomData(messageData, temp);
+    info.GetReturnValue().Set(packedRecords(data, offsets));
+}
 
-    // Copy messageData vector into a node.js buffer.
-    auto slowBuffer = Nan::CopyBuffer((const char*)messageData.data(),
-        messageData.size()).ToLocalChecked();;
 
-    // Set node.js buffer as return value of the function.
-    info.GetReturnValue().Set(slowBuffer);
+
+// -----------
+// decryptMany
+// -----------
+/**
+ * @brief Unwraps the arguments to get the AES key and a batch of
+ *        versioned ciphers and decrypts every cipher with a single key
+ *        setup, into one contiguous buffer.
+ *
+ * Invoked as:
+ * 'let result = obj.decryptMany(key, records, options)'
+ * 'key' is the buffer containing the AES key
+ * 'records' is an array of buffers or a packed {data, offsets} object
+ * 'options' (optional) is an object, {aad: [buffer]} gives the associated
+ * data shared by all records
+ * 'result' is of the form {data: [messages], offsets: [Uint32Array]}
+ * If any record fails authentication nothing is unwhitened, so the
+ * whitening stream is not advanced by the failed batch.
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::decryptMany) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 2) {
+        Nan::ThrowError("Incorrect Arguments. Please provide 'key' and "
+                        "'records' -> 'function decryptMany(key, records, "
+                        "options)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[0], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    std::vector<Record> records;
+    if (!getRecordsArgument(info[1], records)) {
+        return;
+    }
+
+    CipherOptions options;
+    if (!getCipherOptions(info[2], options)) {
+        return;
+    }
+
+    // Lay the messages out back to back.
+    const size_t overhead = VERSIONED_HEADER_BYTES + GCM_TAG_BYTES;
+    std::vector<uint32_t> offsets(records.size() + 1);
+    uint64_t total = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].length < overhead) {
+            Nan::ThrowError(("Record " + std::to_string(i)
+                + ": Unsupported cipher format").c_str());
+            return;
+        }
+        offsets[i] = uint32_t(total);
+        total += records[i].length - overhead;
+        if (!fitsNodeBuffer(total)) {
+            Nan::ThrowError("Incorrect Arguments. Batch is too large");
+            return;
+        }
+    }
+    offsets[records.size()] = uint32_t(total);
+
+    v8::Local<v8::Object> data = Nan::NewBuffer(total).ToLocalChecked();
+    uint8_t* messageData = (uint8_t *)node::Buffer::Data(data);
+
+    /* Every record is verified before any is unwhitened, so a batch that
+     * fails authentication leaves '_rng' where it was and the receiver
+     * stays in step with the sender.
+     */
+    bool anyDeflated = false;
+    for (size_t i = 0; i < records.size(); ++i) {
+        try {
+
+            obj->openVersioned(messageData + offsets[i],
+                keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+                records[i].data, records[i].length, options);
+
+        } catch (const std::exception& e) {
+
+            // throw an error to node.js naming the failing record
+            Nan::ThrowError(("Record " + std::to_string(i) + ": "
+                + e.what()).c_str());
+            return;
+        }
+
+        anyDeflated = anyDeflated || isDeflated(records[i].data);
+    }
+
+    // Fail rather than wait for pending async calls to finish with '_rng'.
+    uint64_t ticket;
+    if (!obj->syncTurn(ticket)) {
+        return;
+    }
+    WhiteningTurn turn(obj->_whitening, ticket);
+    turn.take();
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        obj->xorRandom(messageData + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    turn.pass();
+
+    if (!anyDeflated) {
+        info.GetReturnValue().Set(packedRecords(data, offsets));
+        return;
+    }
+
+    /* Inflated sizes are only known once decrypted, so lay the messages out
+     * again with the compressed payloads inflated.
+     */
+    std::vector<uint32_t> inflatedOffsets(records.size() + 1);
+    total = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        size_t length = offsets[i + 1] - offsets[i];
+        if (isDeflated(records[i].data)) {
+            try {
+                length = decompressedLength(messageData + offsets[i], length);
+            } catch (const std::exception& e) {
+                Nan::ThrowError(("Record " + std::to_string(i) + ": "
+                    + e.what()).c_str());
+                return;
+            }
+        }
+        inflatedOffsets[i] = uint32_t(total);
+        total += length;
+        if (!fitsNodeBuffer(total)) {
+            Nan::ThrowError("Incorrect Arguments. Batch is too large");
+            return;
+        }
+    }
+    inflatedOffsets[records.size()] = uint32_t(total);
+
+    v8::Local<v8::Object> inflated = Nan::NewBuffer(total).ToLocalChecked();
+    uint8_t* inflatedData = (uint8_t *)node::Buffer::Data(inflated);
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        const uint8_t* payload = messageData + offsets[i];
+        size_t length = offsets[i + 1] - offsets[i];
+
+        if (!isDeflated(records[i].data)) {
+            std::copy(payload, payload + length,
+                inflatedData + inflatedOffsets[i]);
+            continue;
+        }
+
+        try {
+            decompressPayload(payload, length,
+                inflatedData + inflatedOffsets[i]);
+        } catch (const std::exception& e) {
+            Nan::ThrowError(("Record " + std::to_string(i) + ": "
+                + e.what()).c_str());
+            return;
+        }
+    }
+
+    info.GetReturnValue().Set(packedRecords(inflated, inflatedOffsets));
+}
+
+
+
+// -----------
+// encryptFile
+// -----------
+/**
+ * @brief Unwraps the arguments and encrypts the source file into a
+ *        segmented container written to the target file, streaming it
+ *        on the libuv thread pool.
+ *
+ * Invoked as:
+ * 'obj.encryptFile(source, target, key, options, function(status, stats){})'
+ * 'source' is the path of the file to encrypt
+ * 'target' is the path of the container file to create or replace
+ * 'key' is the buffer containing the AES key
+ * 'options' (optional) is of the form {segmentSize, direct}
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'stats' is of the form {bytes, seconds, throughput}
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::encryptFile) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // The callback is the last argument, options may be left out.
+    int callbackIndex = info.Length() - 1;
+
+    // Checking arguments.
+    if (info.Length() < 4 || info.Length() > 5
+        || !info[0]->IsString() || !info[1]->IsString()
+        || !info[callbackIndex]->IsFunction()
+        || (callbackIndex == 4 && !info[3]->IsObject())) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide 'source', "
+                        "'target', 'key' and a callback function -> "
+                        "'function encryptFile(source, target, key, options, "
+                        "callback)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[2], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    uint32_t segmentSize = SEGMENT_DEFAULT_BYTES;
+    bool direct = false;
+    if (callbackIndex == 4) {
+        v8::Local<v8::Object> options =
+            Nan::To<v8::Object>(info[3]).ToLocalChecked();
+
+        if (!getSegmentSize(Nan::Get(options,
+                Nan::New("segmentSize").ToLocalChecked()).ToLocalChecked(),
+                segmentSize)) {
+            return;
+        }
+
+        direct = Nan::Get(options,
+            Nan::New("direct").ToLocalChecked()).ToLocalChecked()->IsTrue();
+    }
+
+    // Header: [format][segment size (4 bytes BE)][random key salt].
+    std::vector<uint8_t> header(SEGMENT_HEADER_BYTES);
+    header[0] = SEGMENT_FORMAT;
+    writeUInt32BE(segmentSize, header.data() + 1);
+    obj->getNonce(header.data() + SEGMENT_HEADER_BYTES
+        - SEGMENT_SALT_BYTES, SEGMENT_SALT_BYTES);
+
+    Nan::Callback *callback =
+        new Nan::Callback(info[callbackIndex].As<v8::Function>());
+
+    FileWorker* worker = new FileWorker(callback, true,
+        *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]),
+        keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+        obj->_seed, header, direct);
+
+    Nan::AsyncQueueWorker(worker);
+}
+
+
+
+// -----------
+// decryptFile
+// -----------
+/**
+ * @brief Unwraps the arguments and decrypts the segmented container in
+ *        the source file into the target file, streaming it on the
+ *        libuv thread pool. The target is only replaced once every
+ *        segment has been verified.
+ *
+ * Invoked as:
+ * 'obj.decryptFile(source, target, key, options, function(status, stats){})'
+ * 'source' is the path of the container file to decrypt
+ * 'target' is the path of the file to create or replace
+ * 'key' is the buffer containing the AES key
+ * 'options' (optional) is of the form {direct}
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'stats' is of the form {bytes, seconds, throughput}
+ * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::decryptFile) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    // The callback is the last argument, options may be left out.
+    int callbackIndex = info.Length() - 1;
+
+    // Checking arguments.
+    if (info.Length() < 4 || info.Length() > 5
+        || !info[0]->IsString() || !info[1]->IsString()
+        || !info[callbackIndex]->IsFunction()
+        || (callbackIndex == 4 && !info[3]->IsObject())) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide 'source', "
+                        "'target', 'key' and a callback function -> "
+                        "'function decryptFile(source, target, key, options, "
+                        "callback)'");
+        return;
+    }
+
+    uint8_t* keyData;
+    if (!getKeyArgument(info[2], AESNODE_DEFAULT_KEY_LENGTH_BYTES, keyData)) {
+        return;
+    }
+
+    bool direct = false;
+    if (callbackIndex == 4) {
+        v8::Local<v8::Object> options =
+            Nan::To<v8::Object>(info[3]).ToLocalChecked();
+        direct = Nan::Get(options,
+            Nan::New("direct").ToLocalChecked()).ToLocalChecked()->IsTrue();
+    }
+
+    Nan::Callback *callback =
+        new Nan::Callback(info[callbackIndex].As<v8::Function>());
+
+    FileWorker* worker = new FileWorker(callback, false,
+        *Nan::Utf8String(info[0]), *Nan::Utf8String(info[1]),
+        keyData, AESNODE_DEFAULT_KEY_LENGTH_BYTES,
+        obj->_seed, std::vector<uint8_t>(), direct);
+
+    Nan::AsyncQueueWorker(worker);
+}
+
+
+
+// ------------
+// asyncPending
+// ------------
+/**
+ * @brief Returns the number of encryptAsync/decryptAsync calls still
+ *        waiting for or using the whitening stream. While it is not 0,
+ *        encrypt, decrypt, encryptMany and decryptMany throw instead of
+ *        blocking the event loop.
+ *
+ * Invoked as:
+ * 'let pending = obj.asyncPending()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(AESXOR256::asyncPending) {
+
+    AESXOR256* obj = ObjectWrap::Unwrap<AESXOR256>(info.Holder());
+
+    info.GetReturnValue().Set(
+        Nan::New<v8::Number>(double(obj->_whitening.pending())));
 }
 
 
@@ -578,6 +3282,16 @@ void AESXOR256::Init(v8::Local<v8::Object> exports) {
     // Prototype
     Nan::SetPrototypeMethod(tpl, "encrypt", encrypt);
     Nan::SetPrototypeMethod(tpl, "decrypt", decrypt);
+    Nan::SetPrototypeMethod(tpl, "encryptSegmented", encryptSegmented);
+    Nan::SetPrototypeMethod(tpl, "decryptSegmented", decryptSegmented);
+    Nan::SetPrototypeMethod(tpl, "decryptRange", decryptRange);
+    Nan::SetPrototypeMethod(tpl, "encryptAsync", encryptAsync);
+    Nan::SetPrototypeMethod(tpl, "decryptAsync", decryptAsync);
+    Nan::SetPrototypeMethod(tpl, "encryptMany", encryptMany);
+    Nan::SetPrototypeMethod(tpl, "decryptMany", decryptMany);
+    Nan::SetPrototypeMethod(tpl, "encryptFile", encryptFile);
+    Nan::SetPrototypeMethod(tpl, "decryptFile", decryptFile);
+    Nan::SetPrototypeMethod(tpl, "asyncPending", asyncPending);
 
     constructor.Reset(context->GetIsolate(), tpl->GetFunction(context));
 
@@ -38,11 +38,23 @@
 #include <node_object_wrap.h>
 #include <nan.h>
 
+// -----------------
+// standard includes
+// -----------------
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
 // -----------------
 // cryptopp includes
 // -----------------
 #include "aes.h"
 using CryptoPP::AES;
+#include "gcm.h"
+#include "osrng.h"
+#include "secblock.h"
 
 // ----------------
 // xor shift 128 includes
@@ -58,8 +70,23 @@ using CryptoPP::AES;
  *		  wrapped in a javascript object.
  *
  * 		  The functions exposed to node.js are:
- *		  function encrypt(key, message) -> returns cipher
- *		  function decrypt(key, cipher) -> returns message
+ *		  function encrypt(key, message, options) -> returns cipher
+ *		  function decrypt(key, cipher, options) -> returns message
+ *		  function encryptSegmented(key, message, segmentSize) -> returns
+ *		  	container
+ *		  function decryptSegmented(key, container) -> returns message
+ *		  function decryptRange(key, container, offset, length) -> returns
+ *		  	message slice
+ *		  function encryptAsync(key, message, options, callback)
+ *		  function decryptAsync(key, cipher, options, callback)
+ *		  function encryptMany(key, records, options) -> returns
+ *		  	{data, offsets}
+ *		  function decryptMany(key, records, options) -> returns
+ *		  	{data, offsets}
+ *		  function encryptFile(source, target, key, options, callback)
+ *		  function decryptFile(source, target, key, options, callback)
+ *		  function asyncPending() -> returns number of encryptAsync/
+ *		  	decryptAsync calls not yet done with the whitening stream
  */
 class AESXOR256 : public Nan::ObjectWrap {
 
@@ -69,6 +96,134 @@ class AESXOR256 : public Nan::ObjectWrap {
 		static Nan::Persistent<v8::Function> constructor;
 
 
+		// --------------
+		// WhiteningQueue
+		// --------------
+		/*
+		 * @class Hands out tickets so that whitening bytes are drawn from
+		 *		  '_rng' in the order the calls were made, even when the
+		 *		  work itself runs on the libuv thread pool.
+		 */
+		class WhiteningQueue {
+
+			private:
+				// guards the ticket counters
+				std::mutex _mutex;
+				// signalled whenever a ticket is done with '_rng'
+				std::condition_variable _turn;
+				// next ticket to hand out and ticket currently served
+				uint64_t _next;
+				uint64_t _serving;
+
+			public:
+				// -----------
+				// Constructor
+				// -----------
+				WhiteningQueue();
+
+				// -------
+				// reserve
+				// -------
+				/**
+				 * @brief Hands out the next ticket, called on the main thread
+				 *		  when the call is made.
+				 *
+				 * @return ticket
+				 */
+				uint64_t reserve();
+
+				// ----------
+				// tryReserve
+				// ----------
+				/**
+				 * @brief Hands out the next ticket only if no earlier ticket
+				 *		  is outstanding, so that a sync call never waits on
+				 *		  the main thread for the thread pool.
+				 *
+				 * @param ticket resulting ticket, already being served
+				 *
+				 * @return true if a ticket was handed out
+				 */
+				bool tryReserve(uint64_t& ticket);
+
+				// -------
+				// pending
+				// -------
+				/**
+				 * @brief Returns the number of tickets handed out and not
+				 *		  yet released.
+				 *
+				 * @return number of outstanding tickets
+				 */
+				uint64_t pending();
+
+				// ----
+				// wait
+				// ----
+				/**
+				 * @brief Blocks until all earlier tickets have been released.
+				 *
+				 * @param ticket ticket obtained from reserve
+				 *
+				 * @return void
+				 */
+				void wait(uint64_t ticket);
+
+				// -------
+				// release
+				// -------
+				/**
+				 * @brief Passes '_rng' on to the next ticket.
+				 *
+				 * @return void
+				 */
+				void release();
+		};
+
+
+		// -------------
+		// WhiteningTurn
+		// -------------
+		/*
+		 * @class Scoped turn on '_rng' for one ticket. The turn is always
+		 *		  passed on when the scope ends, waiting for it first if it
+		 *		  was never taken, so a failed call cannot stall later ones.
+		 */
+		class WhiteningTurn {
+
+			private:
+				WhiteningQueue& _queue;
+				uint64_t _ticket;
+				bool _taken;
+				bool _passed;
+
+			public:
+				WhiteningTurn(WhiteningQueue& queue, uint64_t ticket);
+				~WhiteningTurn();
+
+				// ----
+				// take
+				// ----
+				/**
+				 * @brief Blocks until it is this ticket's turn on '_rng'.
+				 *
+				 * @return void
+				 */
+				void take();
+
+				// ----
+				// pass
+				// ----
+				/**
+				 * @brief Passes '_rng' on to the next ticket once this one
+				 *		  is done with it, taking the turn first if needed.
+				 *
+				 * @return void
+				 */
+				void pass();
+		};
+
+
 		// ----
 		// data
 		// ----
@@ -76,9 +231,126 @@ class AESXOR256 : public Nan::ObjectWrap {
 		// xorShift128
 		XORShift128 _rng;
 
+		// seed the instance was created with, used for segment whitening
+		std::vector<uint64_t> _seed;
+
+		/* operating system seeded CSPRNG reserved for nonces, so that they
+		 * are unpredictable and '_rng' stays in step with peers
+		 */
+		CryptoPP::AutoSeededRandomPool _nonceRng;
+
+		/* GCM objects keyed with the most recently used key, and that key,
+		 * wiped when replaced or destroyed
+		 */
+		CryptoPP::GCM<AES>::Encryption _encryption;
+		CryptoPP::SecByteBlock _encryptionKey;
+		CryptoPP::GCM<AES>::Decryption _decryption;
+		CryptoPP::SecByteBlock _decryptionKey;
+
+		// orders access to '_rng' between sync and async calls
+		WhiteningQueue _whitening;
+
 	 	// AES key length
 	 	static const int AESNODE_DEFAULT_KEY_LENGTH_BYTES;
 
+	 	// GCM nonce and authentication tag lengths
+	 	static const int GCM_NONCE_BYTES;
+	 	static const int GCM_TAG_BYTES;
+
+	 	// all-zero GCM IV of the original format
+	 	static const uint8_t LEGACY_IV[];
+
+	 	// versioned message format identifier and header size
+	 	static const int VERSIONED_FORMAT;
+	 	static const int VERSIONED_HEADER_BYTES;
+
+	 	// versioned header flag selecting ChaCha20-Poly1305 over AES-256-GCM
+	 	static const int VERSIONED_FLAG_CHACHA20;
+
+	 	// versioned header flag marking a deflated message
+	 	static const int VERSIONED_FLAG_DEFLATE;
+
+	 	// zlib level used for {compress: true}
+	 	static const int DEFAULT_COMPRESSION_LEVEL;
+
+	 	// bytes read from disk at a time by encryptFile/decryptFile
+	 	static const size_t FILE_CHUNK_BYTES;
+
+	 	// segmented container format identifier, header and key salt size
+	 	static const int SEGMENT_FORMAT;
+	 	static const int SEGMENT_HEADER_BYTES;
+	 	static const int SEGMENT_SALT_BYTES;
+
+	 	// default, minimum and maximum segment plaintext size
+	 	static const uint32_t SEGMENT_DEFAULT_BYTES;
+	 	static const uint32_t SEGMENT_MIN_BYTES;
+	 	static const uint32_t SEGMENT_MAX_BYTES;
+
+	 	// number of segments addressable by the 32-bit segment counter
+	 	static const uint64_t SEGMENT_MAX_COUNT;
+
+	 	// minimum number of segments handed to each encryption thread
+	 	static const size_t SEGMENTS_PER_THREAD;
+
+
+	 	// ----
+		// Aead
+		// ----
+		/*
+		 * @enum Authenticated ciphers available in the versioned format.
+		 */
+		enum Aead {
+			AEAD_AES_256_GCM,
+			AEAD_CHACHA20_POLY1305
+		};
+
+
+	 	// -------------
+		// CipherOptions
+		// -------------
+		/*
+		 * @struct Options accepted by encrypt and decrypt.
+		 */
+		struct CipherOptions {
+			/* true to use the versioned format
+			 * [format][flags][random nonce][ciphertext][tag] instead of the
+			 * original format with the fixed all-zero IV
+			 */
+			bool versioned;
+			// cipher used by encrypt in the versioned format
+			Aead aead;
+			/* zlib level the message is deflated with before being
+			 * whitened in the versioned format, 0 to leave it as is; the
+			 * cipher length then depends on the content, so it must not be
+			 * used on messages mixing secrets with attacker data (CRIME)
+			 */
+			int compressionLevel;
+			/* associated data authenticated along with the versioned
+			 * header but neither encrypted nor stored in the cipher
+			 */
+			const uint8_t* aad;
+			size_t aadLength;
+		};
+
+
+	 	// -------------
+		// SegmentLayout
+		// -------------
+		/*
+		 * @struct Sizes describing a segmented container:
+		 *		  [header][segment 0][segment 1]...[final segment] where the
+		 *		  header is [format][segment size (4 bytes BE)][key salt
+		 *		  (16 bytes)] and every segment is [ciphertext][tag].
+		 */
+		struct SegmentLayout {
+			// plaintext bytes per segment (the final one may be shorter)
+			uint32_t segmentSize;
+			// number of segments, always at least one
+			uint64_t segmentCount;
+			// total plaintext bytes across all segments
+			uint64_t plainLength;
+		};
+
 
 	 	// -----------
 		// Constructor
@@ -96,80 +368,779 @@ class AESXOR256 : public Nan::ObjectWrap {
 	    explicit AESXOR256(std::vector<uint64_t> seed);
 
 
-	    // ---------
-		// getRandom
+		// --------
+		// syncTurn
+		// --------
+		/**
+		 * @brief Takes a ticket on '_rng' for a sync call, throwing a
+		 *		  node.js error instead of blocking when async calls are
+		 *		  still queued ahead of it.
+		 *
+		 * @param ticket resulting ticket, whose turn it already is
+		 *
+		 * @return true if the call may go ahead
+		 */
+		bool syncTurn(uint64_t& ticket);
+
+
+	 	// --------
+		// getNonce
+		// --------
+	 	/**
+		 * @brief Gets nonce bytes from the instance's dedicated CSPRNG,
+		 *		  leaving the whitening stream untouched. Called on the main
+		 *		  thread only.
+		 *
+		 * @param nonce container for resulting nonce bytes
+		 * @param len number of nonce bytes required
+		 *
+		 * @return void
+		 */
+	 	void getNonce(uint8_t* nonce, int len);
+
+
+	 	// ---------
+		// xorRandom
 		// ---------
 	 	/**
-		 * @brief Gets random uint64 values from pcg and stores them in a byte
-		 *		  array.
+		 * @brief XORs the given bytes in place with the whitening stream,
+		 *		  without intermediate containers.
 		 *
-		 * @param random container for resulting random bytes
-		 * @param len number of random bytes required
+		 * @param data bytes to be XOR'd in place
+		 * @param len number of bytes
 		 *
 		 * @return void
 		 */
-	 	void getRandom(uint8_t* random, int len);
+	 	void xorRandom(uint8_t* data, size_t len);
+
+
+	 	// ---------------
+		// keyedEncryption
+		// ---------------
+	 	/**
+		 * @brief Returns the cached GCM encryption object, re-keying it only
+		 *		  when the key differs, in constant time, from the one it was
+		 *		  last keyed with.
+		 *
+		 * @param key AES key
+		 * @param keyLength AES key length
+		 *
+		 * @return GCM encryption object keyed with 'key'
+		 */
+	 	CryptoPP::GCM<AES>::Encryption& keyedEncryption(const uint8_t* key,
+	 		size_t keyLength);
+
+
+	 	// ---------------
+		// keyedDecryption
+		// ---------------
+	 	/**
+		 * @brief Returns the cached GCM decryption object, re-keying it only
+		 *		  when the key differs, in constant time, from the one it was
+		 *		  last keyed with.
+		 *
+		 * @param key AES key
+		 * @param keyLength AES key length
+		 *
+		 * @return GCM decryption object keyed with 'key'
+		 */
+	 	CryptoPP::GCM<AES>::Decryption& keyedDecryption(const uint8_t* key,
+	 		size_t keyLength);
 
 
-	 	// ------------
-		// encryptBlock
 		// ------------
+		// segmentNonce
+		// ------------
+		/**
+		 * @brief Builds the 96-bit GCM nonce of a segment as
+		 *		  [first 7 salt bytes][segment counter (4 bytes BE)]
+		 *		  [final flag].
+		 *
+		 * @param header container header holding the salt
+		 * @param index segment counter
+		 * @param last true if this is the final segment of the container
+		 * @param nonce container for the resulting GCM_NONCE_BYTES nonce
+		 *
+		 * @return void
+		 */
+		static void segmentNonce(const uint8_t* header, uint64_t index,
+			bool last, uint8_t* nonce);
+
+
+		// ----------
+		// segmentKey
+		// ----------
 		/**
-		 * @brief Encrypts the given message using AES in GCM mode to provide
-		 *        confidentiality and authenticity using the given key resulting
-		 *        in the cipher block.
+		 * @brief Derives the AES key of a container from the caller's key
+		 *		  and the random salt in its header with KMAC256.
 		 *
-		 * @param cipher byte container for the resulting cipher
-		 * @param key byte container for the AES key
-		 * @param message byte container for the message
+		 * @param key caller's AES key
+		 * @param keyLength AES key length
+		 * @param header container header holding the salt
+		 * @param segmentKey container for the keyLength byte derived key
+		 *
+		 * @return void
+		 */
+		static void segmentKey(const uint8_t* key, size_t keyLength,
+			const uint8_t* header, uint8_t* segmentKey);
+
+
+		// -------------
+		// whitenSegment
+		// -------------
+		/**
+		 * @brief XORs a segment in place with xorShift128 bytes derived from
+		 *		  the instance seed and the segment nonce, so any segment can
+		 *		  be whitened without replaying the ones before it.
+		 *
+		 * @param seed instance seed
+		 * @param nonce segment nonce
+		 * @param data segment bytes to be XOR'd in place
+		 * @param len number of segment bytes
+		 *
+		 * @return void
+		 */
+		static void whitenSegment(const std::vector<uint64_t>& seed,
+			const uint8_t* nonce, uint8_t* data, size_t len);
+
+
+		// -------------
+		// segmentLayout
+		// -------------
+		/**
+		 * @brief Validates a container header and length and derives the
+		 *		  segment layout from them.
+		 *
+		 * @param container container bytes starting with the header
+		 * @param containerLength total number of container bytes
+		 * @param layout resulting segment layout
+		 *
+		 * @return true if the container is well formed
+		 */
+		static bool segmentLayout(const uint8_t* container,
+			uint64_t containerLength, SegmentLayout& layout);
+
+
+		// ------------
+		// sealSegments
+		// ------------
+		/**
+		 * @brief Whitens and encrypts a run of consecutive segments, spread
+		 *		  across the available cores.
+		 *
+		 * @param header container header (authenticated with every segment)
+		 * @param seed instance seed used for whitening
+		 * @param key caller's AES key the segment key is derived from
+		 * @param keyLength AES key length
+		 * @param firstSegment counter of the first segment in the run
+		 * @param totalSegments number of segments in the whole container
+		 * @param input plaintext of the run
+		 * @param inputLength number of plaintext bytes in the run
+		 * @param output container for the encrypted segments of the run
 		 *
 		 * @throw Cryptopp:Exception in case of encryption errors
 		 *
 		 * @return void
 		 */
-	 	void encryptBlock(std::vector<uint8_t>& cipher,
-	 		const std::vector<uint8_t>& key,
-	 		const std::vector<uint8_t>& message);
+		static void sealSegments(const uint8_t* header,
+			const std::vector<uint64_t>& seed,
+			const uint8_t* key, size_t keyLength,
+			uint64_t firstSegment, uint64_t totalSegments,
+			const uint8_t* input, size_t inputLength, uint8_t* output);
 
 
-	 	// ------------
-		// decryptBlock
+		// ------------
+		// openSegments
 		// ------------
 		/**
-		 * @brief Decrypts the given cipher using AES in GCM mode to provide
-		 *        confidentiality and authenticity using the given key resulting
-		 *        in the message block.
+		 * @brief Decrypts, verifies and unwhitens a run of consecutive
+		 *		  segments, spread across the available cores.
 		 *
-		 * @param message byte container for the resulting decrypted message
-		 * @param cipher byte container for the input cipher
-		 * @param key byte container for the AES key
+		 * @param header container header (authenticated with every segment)
+		 * @param seed instance seed used for whitening
+		 * @param key caller's AES key the segment key is derived from
+		 * @param keyLength AES key length
+		 * @param firstSegment counter of the first segment in the run
+		 * @param totalSegments number of segments in the whole container
+		 * @param input encrypted segments of the run
+		 * @param inputLength number of encrypted bytes in the run
+		 * @param output container for the plaintext of the run
 		 *
-		 * @throw Cryptopp:Exception in case of decryption errors
+		 * @throw std::runtime_error if any segment fails authentication
 		 *
 		 * @return void
 		 */
-	 	void decryptBlock(std::vector<uint8_t>& message,
-	 		const std::vector<uint8_t>& key,
-	 		const std::vector<uint8_t>& cipher);
+		static void openSegments(const uint8_t* header,
+			const std::vector<uint64_t>& seed,
+			const uint8_t* key, size_t keyLength,
+			uint64_t firstSegment, uint64_t totalSegments,
+			const uint8_t* input, size_t inputLength, uint8_t* output);
 
 
-	 	// -------------
-		// xorRandomData
+	 	// ----------------
+		// encryptVersioned
+		// ----------------
+		/**
+		 * @brief Whitens and encrypts the message into the versioned format
+		 *		  [format][flags][nonce][ciphertext][tag], drawing a fresh
+		 *		  96-bit nonce for every message so one key can be reused.
+		 *
+		 * @param cipher container for the resulting cipher of
+		 *		  VERSIONED_HEADER_BYTES + messageLength + GCM_TAG_BYTES bytes
+		 * @param key AES key
+		 * @param keyLength AES key length
+		 * @param message message bytes
+		 * @param messageLength number of message bytes
+		 * @param options cipher options naming the authenticated cipher
+		 *		  and the associated data
+		 * @param deflated true if the message is a compressed payload
+		 *
+		 * @throw Cryptopp:Exception in case of encryption errors
+		 *
+		 * @return void
+		 */
+		void encryptVersioned(uint8_t* cipher,
+			const uint8_t* key, size_t keyLength,
+			const uint8_t* message, size_t messageLength,
+			const CipherOptions& options, bool deflated);
+
+
+		// ----------------
+		// decryptVersioned
+		// ----------------
+		/**
+		 * @brief Decrypts and verifies a cipher in the versioned format and
+		 *		  unwhitens it to return the original message, still
+		 *		  compressed if the header says it is deflated.
+		 *
+		 * @param message container for the resulting message of
+		 *		  cipherLength - VERSIONED_HEADER_BYTES - GCM_TAG_BYTES bytes
+		 * @param key AES key
+		 * @param keyLength AES key length
+		 * @param cipher cipher bytes
+		 * @param cipherLength number of cipher bytes
+		 * @param options cipher options naming the associated data
+		 *
+		 * @throw std::runtime_error if the cipher is malformed or fails
+		 *		  authentication
+		 *
+		 * @return void
+		 */
+		void decryptVersioned(uint8_t* message,
+			const uint8_t* key, size_t keyLength,
+			const uint8_t* cipher, size_t cipherLength,
+			const CipherOptions& options);
+
+
+		// -------------
+		// openVersioned
+		// -------------
+		/**
+		 * @brief Decrypts and verifies a cipher in the versioned format
+		 *		  without unwhitening it, so '_rng' is left untouched if it
+		 *		  fails.
+		 *
+		 * @param message container for the resulting whitened message of
+		 *		  cipherLength - VERSIONED_HEADER_BYTES - GCM_TAG_BYTES bytes
+		 * @param key AES key
+		 * @param keyLength AES key length
+		 * @param cipher cipher bytes
+		 * @param cipherLength number of cipher bytes
+		 * @param options cipher options naming the associated data
+		 *
+		 * @throw std::runtime_error if the cipher is malformed or fails
+		 *		  authentication
+		 *
+		 * @return void
+		 */
+		void openVersioned(uint8_t* message,
+			const uint8_t* key, size_t keyLength,
+			const uint8_t* cipher, size_t cipherLength,
+			const CipherOptions& options);
+
+
+		// -----------
+		// defaultAead
+		// -----------
+		/**
+		 * @brief Picks the faster authenticated cipher for this CPU:
+		 *		  AES-256-GCM when AES-NI and PCLMULQDQ are available,
+		 *		  ChaCha20-Poly1305 otherwise.
+		 *
+		 * @return authenticated cipher
+		 */
+		static Aead defaultAead();
+
+
+		// -------------
+		// versionedAead
 		// -------------
 		/**
-		 * @brief XORs the given input container with requal number of random
-		 *        bytes obtained using the PCG random number generator.
+		 * @brief Reads the authenticated cipher from the flags of a
+		 *		  versioned header.
+		 *
+		 * @param header versioned header
 		 *
-		 * @param output byte container for the resulting XOR'd output
-		 * @param input byte container for the input data to be XOR'd with
-		 *		  random bytes
+		 * @throw std::runtime_error if the flags are not supported
+		 *
+		 * @return authenticated cipher
+		 */
+		static Aead versionedAead(const uint8_t* header);
+
+
+		// ----------
+		// isDeflated
+		// ----------
+		/**
+		 * @brief Tells whether a versioned header marks the message as
+		 *		  compressed.
+		 *
+		 * @param header versioned header
+		 *
+		 * @return true if the decrypted message must be inflated
+		 */
+		static bool isDeflated(const uint8_t* header);
+
+
+		// -------
+		// sealGcm
+		// -------
+		/**
+		 * @brief Encrypts a whitened body in place with AES-GCM and
+		 *		  appends the tag, authenticating the header and the
+		 *		  associated data along with it without copying them.
+		 *
+		 * @param gcm keyed AES-GCM encryption
+		 * @param iv GCM_NONCE_BYTES nonce
+		 * @param header header bytes, may be empty
+		 * @param headerLength number of header bytes
+		 * @param aad associated data, may be empty
+		 * @param aadLength number of associated data bytes
+		 * @param body whitened body followed by room for the tag
+		 * @param bodyLength number of body bytes
+		 *
+		 * @throw Cryptopp:Exception in case of encryption errors
 		 *
 		 * @return void
 		 */
-	 	void xorRandomData(
-			std::vector<uint8_t>& output,
-			const std::vector<uint8_t>& input
-		);
+		static void sealGcm(CryptoPP::GCM<AES>::Encryption& gcm,
+			const uint8_t* iv,
+			const uint8_t* header, size_t headerLength,
+			const uint8_t* aad, size_t aadLength,
+			uint8_t* body, size_t bodyLength);
+
+
+		// -------
+		// openGcm
+		// -------
+		/**
+		 * @brief Decrypts and verifies an AES-GCM body followed by its tag,
+		 *		  authenticating the header and the associated data along
+		 *		  with it, leaving the message whitened.
+		 *
+		 * @param gcm keyed AES-GCM decryption
+		 * @param iv GCM_NONCE_BYTES nonce
+		 * @param header header bytes, may be empty
+		 * @param headerLength number of header bytes
+		 * @param aad associated data, may be empty
+		 * @param aadLength number of associated data bytes
+		 * @param body encrypted body followed by the tag
+		 * @param bodyLength number of body bytes
+		 * @param message container for the whitened message
+		 *
+		 * @throw Cryptopp:Exception in case of decryption errors
+		 *
+		 * @return true if the cipher is authentic
+		 */
+		static bool openGcm(CryptoPP::GCM<AES>::Decryption& gcm,
+			const uint8_t* iv,
+			const uint8_t* header, size_t headerLength,
+			const uint8_t* aad, size_t aadLength,
+			const uint8_t* body, size_t bodyLength,
+			uint8_t* message);
+
+
+		// ------------
+		// sealChaCha20
+		// ------------
+		/**
+		 * @brief Encrypts the whitened body of a versioned cipher in place
+		 *		  with ChaCha20-Poly1305 and appends the tag, authenticating
+		 *		  the header and the associated data along with it.
+		 *
+		 * @param cipher versioned cipher with the header and whitened body
+		 *		  filled in and room for the tag
+		 * @param key 32-byte key
+		 * @param messageLength number of body bytes
+		 * @param aad associated data, may be empty
+		 * @param aadLength number of associated data bytes
+		 *
+		 * @throw std::length_error if the message is too long
+		 *
+		 * @return void
+		 */
+		static void sealChaCha20(uint8_t* cipher, const uint8_t* key,
+			size_t messageLength, const uint8_t* aad, size_t aadLength);
+
+
+		// ------------
+		// openChaCha20
+		// ------------
+		/**
+		 * @brief Decrypts and verifies the body of a versioned
+		 *		  ChaCha20-Poly1305 cipher, leaving it whitened.
+		 *
+		 * @param message container for the whitened message
+		 * @param key 32-byte key
+		 * @param cipher versioned cipher bytes
+		 * @param messageLength number of body bytes
+		 * @param aad associated data, may be empty
+		 * @param aadLength number of associated data bytes
+		 *
+		 * @throw std::length_error if the message is too long
+		 *
+		 * @return true if the cipher is authentic
+		 */
+		static bool openChaCha20(uint8_t* message, const uint8_t* key,
+			const uint8_t* cipher, size_t messageLength,
+			const uint8_t* aad, size_t aadLength);
+
+
+		// ----------------
+		// getCipherOptions
+		// ----------------
+		/**
+		 * @brief Unwraps an optional options object passed to encrypt or
+		 *		  decrypt, throwing a node.js error if it is not an object
+		 *		  or names an unknown cipher.
+		 *
+		 * @param value node.js value expected to be the options object
+		 * @param options resulting options
+		 *
+		 * @return true if the options could be unwrapped
+		 */
+		static bool getCipherOptions(v8::Local<v8::Value> value,
+			CipherOptions& options);
+
+
+		// --------------
+		// getSegmentSize
+		// --------------
+		/**
+		 * @brief Unwraps an optional segment size argument, defaulting to
+		 *		  SEGMENT_DEFAULT_BYTES, throwing a node.js error if it is not
+		 *		  between SEGMENT_MIN_BYTES and SEGMENT_MAX_BYTES.
+		 *
+		 * @param value node.js value expected to be the segment size
+		 * @param segmentSize resulting segment size
+		 *
+		 * @return true if the argument is a valid segment size
+		 */
+		static bool getSegmentSize(v8::Local<v8::Value> value,
+			uint32_t& segmentSize);
+
+
+		// -------------
+		// EncryptWorker
+		// -------------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  whitening and encrypting a message on the libuv thread pool
+		 *		  and invoking the given callback with the resulting cipher.
+		 */
+		class EncryptWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// object whose '_rng' whitens the message
+				AESXOR256* _obj;
+				// AES key, wiped on destruction
+				CryptoPP::SecByteBlock _key;
+				// message bytes, owned by the buffer kept in persistent storage
+				const uint8_t* _message;
+				size_t _messageLength;
+				// options the call was made with
+				CipherOptions _options;
+				// copy of the associated data '_options' points to
+				std::vector<uint8_t> _aad;
+				// versioned format header, filled in on the main thread
+				std::vector<uint8_t> _header;
+				// ticket for the whitening bytes of this message
+				uint64_t _ticket;
+				// resulting cipher, handed over to node.js when done
+				char* _cipher;
+				size_t _cipherLength;
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data, reserving
+				 *		  the whitening ticket and the nonce on the main thread.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param obj AESXOR256 object the call was made on
+				 * @param key AES key bytes
+				 * @param keyLength AES key length
+				 * @param message message buffer, kept alive until completion
+				 * @param options cipher options
+				 */
+		        EncryptWorker(Nan::Callback* callback,
+		        	AESXOR256* obj,
+		        	const uint8_t* key, size_t keyLength,
+		        	v8::Local<v8::Object> message,
+		        	const CipherOptions& options
+		        );
+
+		        ~EncryptWorker();
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the cipher buffer, handing the cipher memory to
+		         *		  node.js without copying it.
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status
+		         * {code: [statusCode], message: [errorMessage]}
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, whitening the message
+		         *		  once it is this call's turn on '_rng' and encrypting it.
+		         *
+		         * @return void
+		         */
+		        void Execute();
+		};
+
+
+		// -------------
+		// DecryptWorker
+		// -------------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  decrypting and unwhitening a cipher on the libuv thread pool
+		 *		  and invoking the given callback with the resulting message.
+		 */
+		class DecryptWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// object whose '_rng' unwhitens the message
+				AESXOR256* _obj;
+				// AES key, wiped on destruction
+				CryptoPP::SecByteBlock _key;
+				// cipher bytes, owned by the buffer kept in persistent storage
+				const uint8_t* _cipher;
+				size_t _cipherLength;
+				// options the call was made with
+				CipherOptions _options;
+				// copy of the associated data '_options' points to
+				std::vector<uint8_t> _aad;
+				// ticket for the whitening bytes of this message
+				uint64_t _ticket;
+				// resulting message, handed over to node.js when done
+				char* _message;
+				size_t _messageLength;
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data, reserving
+				 *		  the whitening ticket on the main thread.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param obj AESXOR256 object the call was made on
+				 * @param key AES key bytes
+				 * @param keyLength AES key length
+				 * @param cipher cipher buffer, kept alive until completion
+				 * @param options cipher options
+				 */
+		        DecryptWorker(Nan::Callback* callback,
+		        	AESXOR256* obj,
+		        	const uint8_t* key, size_t keyLength,
+		        	v8::Local<v8::Object> cipher,
+		        	const CipherOptions& options
+		        );
+
+		        ~DecryptWorker();
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the message buffer, handing the message memory to
+		         *		  node.js without copying it.
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status
+		         * {code: [statusCode], message: [errorMessage]}
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, decrypting and verifying
+		         *		  the cipher and unwhitening it once it is this call's
+		         *		  turn on '_rng'.
+		         *
+		         * @return void
+		         */
+		        void Execute();
+		};
+
+
+		// ----------
+		// FileWorker
+		// ----------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  streaming a file through the segmented container format on
+		 *		  the libuv thread pool, and invoking the given callback with
+		 *		  the status and throughput of the operation.
+		 */
+		class FileWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// true to encrypt 'source' into 'target', false to decrypt
+				bool _encrypt;
+				// path of the file to read and of the file to replace
+				std::string _source;
+				std::string _target;
+				// AES key, wiped on destruction
+				CryptoPP::SecByteBlock _key;
+				// seed used for segment whitening
+				std::vector<uint64_t> _seed;
+				// container header, filled in on the main thread when encrypting
+				std::vector<uint8_t> _header;
+				// true to read 'source' with O_DIRECT where supported
+				bool _direct;
+				// plaintext bytes processed and time taken
+				uint64_t _bytes;
+				double _seconds;
+
+				// ------
+				// stream
+				// ------
+				/**
+				 * @brief Reads 'source' in aligned chunks, seals or opens
+				 *		  the whole segments in each chunk in parallel and
+				 *		  writes the result to 'target'.
+				 *
+				 * @param input file descriptor of 'source'
+				 * @param inputLength size of 'source'
+				 * @param output file descriptor of the temporary target
+				 *
+				 * @throw std::runtime_error on I/O or authentication errors
+				 *
+				 * @return void
+				 */
+				void stream(int input, uint64_t inputLength, int output);
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param encrypt true to encrypt, false to decrypt
+				 * @param source path of the file to read
+				 * @param target path of the file to create or replace
+				 * @param key AES key bytes
+				 * @param keyLength AES key length
+				 * @param seed seed used for segment whitening
+				 * @param header container header when encrypting, else empty
+				 * @param direct true to read 'source' with O_DIRECT
+				 */
+		        FileWorker(Nan::Callback* callback,
+		        	bool encrypt,
+		        	const std::string& source,
+		        	const std::string& target,
+		        	const uint8_t* key, size_t keyLength,
+		        	const std::vector<uint64_t>& seed,
+		        	const std::vector<uint8_t>& header,
+		        	bool direct
+		        );
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the throughput of the operation
+		         * {bytes: [plaintextBytes], seconds: [seconds],
+		         *  throughput: [bytesPerSecond]}
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status
+		         * {code: [statusCode], message: [errorMessage]}
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, streaming 'source'
+		         *		  into a temporary file that atomically replaces
+		         *		  'target' once complete.
+		         *
+		         * @return void
+		         */
+		        void Execute();
+		};
 
 
 		// ---
@@ -201,9 +1172,14 @@ class AESXOR256 : public Nan::ObjectWrap {
 		 *		  the cipher.
 		 *
 		 * Invoked as:
-		 * 'let cipher = obj.encrypt(key, message)'
+		 * 'let cipher = obj.encrypt(key, message, options)'
 		 * 'key' is the buffer containing the AES key
 		 * 'message' is the buffer containing the message to be encrypted
+		 * 'options' (optional) is an object, {versioned: true} selects the
+		 * versioned format with a random nonce per message, {cipher: [name]}
+		 * also picks 'aes-256-gcm' or 'chacha20-poly1305' ('auto' by default)
+		 * and {compress: true} (or a zlib level) deflates the message first
+		 * and {aad: [buffer]} authenticates associated data without storing it
 		 * 'cipher' is the buffer containing the encrypted cipher
  		 * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
  		 *
@@ -224,9 +1200,12 @@ class AESXOR256 : public Nan::ObjectWrap {
 		 *		  original message.
 		 *
 		 * Invoked as:
-		 * 'let message = obj.decrypt(key, cipher)'
+		 * 'let message = obj.decrypt(key, cipher, options)'
 		 * 'key' is the buffer containing the AES key
 		 * 'cipher' is the buffer containing the cipher to be decrypted
+		 * 'options' (optional) is an object, {versioned: true} expects the
+		 * versioned format and {aad: [buffer]} gives the associated data it was
+		 * encrypted with
 		 * 'message' is the buffer containing the original decypted message
  		 * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
  		 *
@@ -237,6 +1216,240 @@ class AESXOR256 : public Nan::ObjectWrap {
 		 */
 		static NAN_METHOD(decrypt);
 
+
+		// ----------------
+		// encryptSegmented
+		// ----------------
+		/**
+		 * @brief Unwraps the arguments to get the AES key, message and
+		 *		  optional segment size, and encrypts the message into a
+		 *		  segmented container whose segments are sealed in parallel.
+		 *
+		 * Invoked as:
+		 * 'let container = obj.encryptSegmented(key, message, segmentSize)'
+		 * 'key' is the buffer containing the AES key
+		 * 'message' is the buffer containing the message to be encrypted
+		 * 'segmentSize' (optional) is the plaintext size of each segment
+		 * 'container' is the buffer containing the segmented cipher
+ 		 * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ 		 *
+		 * @param info node.js arguments wrapper for AES key, message and
+		 *		  segment size
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(encryptSegmented);
+
+
+		// ----------------
+		// decryptSegmented
+		// ----------------
+		/**
+		 * @brief Unwraps the arguments to get the AES key and segmented
+		 *		  container, and decrypts every segment in parallel to return
+		 *		  the original message.
+		 *
+		 * Invoked as:
+		 * 'let message = obj.decryptSegmented(key, container)'
+		 * 'key' is the buffer containing the AES key
+		 * 'container' is the buffer containing the segmented cipher
+		 * 'message' is the buffer containing the original decrypted message
+ 		 * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ 		 *
+		 * @param info node.js arguments wrapper for AES key and container
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(decryptSegmented);
+
+
+		// ------------
+		// decryptRange
+		// ------------
+		/**
+		 * @brief Unwraps the arguments to get the AES key, segmented
+		 *		  container and plaintext range, and decrypts only the
+		 *		  segments overlapping that range.
+		 *
+		 * Invoked as:
+		 * 'let slice = obj.decryptRange(key, container, offset, length)'
+		 * 'key' is the buffer containing the AES key
+		 * 'container' is the buffer containing the segmented cipher
+		 * 'offset' is the plaintext offset of the first byte required
+		 * 'length' is the number of plaintext bytes required
+		 * 'slice' is the buffer containing the decrypted plaintext range
+ 		 * PreCondition: key buffer size == AESNODE_DEFAULT_KEY_LENGTH_BYTES
+ 		 *
+		 * @param info node.js arguments wrapper for AES key, container and
+		 *		  plaintext range
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(decryptRange);
+
+
+		// ------------
+		// encryptAsync
+		// ------------
+		/**
+		 * @brief Unwraps the arguments to get the AES key, message and
+		 *        options and encrypts the message on the libuv thread pool,
+		 *        keeping a reference to the message buffer instead of
+		 *        copying it.
+		 *
+		 * Invoked as:
+		 * 'obj.encryptAsync(key, message, options, function(status, cipher){})'
+		 * 'key' is the buffer containing the AES key
+		 * 'message' is the buffer containing the message to be encrypted
+		 * 'options' (optional) is an object as accepted by encrypt
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'cipher' is the buffer containing the encrypted cipher
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(encryptAsync);
+
+
+		// ------------
+		// decryptAsync
+		// ------------
+		/**
+		 * @brief Unwraps the arguments to get the AES key, cipher and
+		 *        options and decrypts the cipher on the libuv thread pool,
+		 *        keeping a reference to the cipher buffer instead of
+		 *        copying it.
+		 *
+		 * Invoked as:
+		 * 'obj.decryptAsync(key, cipher, options, function(status, message){})'
+		 * 'key' is the buffer containing the AES key
+		 * 'cipher' is the buffer containing the cipher to be decrypted
+		 * 'options' (optional) is an object as accepted by decrypt
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'message' is the buffer containing the decrypted message
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(decryptAsync);
+
+
+		// -----------
+		// encryptMany
+		// -----------
+		/**
+		 * @brief Unwraps the arguments to get the AES key and a batch of
+		 *        records and encrypts every record in the versioned format
+		 *        with a single key setup, into one contiguous buffer.
+		 *
+		 * Invoked as:
+		 * 'let result = obj.encryptMany(key, records, options)'
+		 * 'key' is the buffer containing the AES key
+		 * 'records' is an array of buffers or a packed {data, offsets} object
+		 * 'options' (optional) is an object, {cipher: [name]} selects the
+		 * cipher
+		 * 'result' is of the form {data: [ciphers], offsets: [Uint32Array]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(encryptMany);
+
+
+		// -----------
+		// decryptMany
+		// -----------
+		/**
+		 * @brief Unwraps the arguments to get the AES key and a batch of
+		 *        versioned ciphers and decrypts every cipher with a single
+		 *        key setup, into one contiguous buffer.
+		 *
+		 * Invoked as:
+		 * 'let result = obj.decryptMany(key, records, options)'
+		 * 'key' is the buffer containing the AES key
+		 * 'records' is an array of buffers or a packed {data, offsets} object
+		 * 'options' (optional) is an object, {aad: [buffer]} gives the associated
+		 * data shared by all records
+		 * 'result' is of the form {data: [messages], offsets: [Uint32Array]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(decryptMany);
+
+
+		// -----------
+		// encryptFile
+		// -----------
+		/**
+		 * @brief Unwraps the arguments and encrypts the source file into a
+		 *        segmented container written to the target file, streaming
+		 *        it on the libuv thread pool.
+		 *
+		 * Invoked as:
+		 * 'obj.encryptFile(source, target, key, options,
+		 *		function(status, stats){})'
+		 * 'source' is the path of the file to encrypt
+		 * 'target' is the path of the container file to create or replace
+		 * 'key' is the buffer containing the AES key
+		 * 'options' (optional) is of the form {segmentSize, direct}
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'stats' is of the form {bytes, seconds, throughput}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(encryptFile);
+
+
+		// -----------
+		// decryptFile
+		// -----------
+		/**
+		 * @brief Unwraps the arguments and decrypts the segmented container
+		 *        in the source file into the target file, streaming it on
+		 *        the libuv thread pool.
+		 *
+		 * Invoked as:
+		 * 'obj.decryptFile(source, target, key, options,
+		 *		function(status, stats){})'
+		 * 'source' is the path of the container file to decrypt
+		 * 'target' is the path of the file to create or replace
+		 * 'key' is the buffer containing the AES key
+		 * 'options' (optional) is of the form {direct}
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'stats' is of the form {bytes, seconds, throughput}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(decryptFile);
+
+
+		// ------------
+		// asyncPending
+		// ------------
+		/**
+		 * @brief Returns the number of encryptAsync/decryptAsync calls
+		 *        still waiting for or using the whitening stream. While it
+		 *        is not 0, encrypt, decrypt, encryptMany and decryptMany
+		 *        throw instead of blocking the event loop.
+		 *
+		 * Invoked as:
+		 * 'let pending = obj.asyncPending()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(asyncPending);
+
 	public:
 
 		// ----
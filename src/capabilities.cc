@@ -0,0 +1,302 @@
+/** @file capabilities.cc
+ *  @brief Definition of the class functions provided in capabilities.h
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *  The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// ----------------------
+// node.js addon includes
+// ----------------------
+#include <node.h>
+#include <nan.h>
+
+// -----------------
+// standard includes
+// -----------------
+#include <string>
+#include <vector>
+
+// -----------------
+// cryptopp includes
+// -----------------
+#include "config.h"
+#include "cpu.h"
+
+// ----------------
+// library includes
+// ----------------
+#include "capabilities.h"
+#include "cpufeatures.h"
+#include "keccak.h"
+
+
+#if CRYPTOPP_BOOL_X64 || CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32
+#define SEIFNODE_CRYPTOPP_X86 1
+#endif
+
+/* Which accelerated code Crypto++ was compiled with. 5.6.x announces it with
+ * CRYPTOPP_BOOL_* macros that are always defined, 6.0 and later define
+ * CRYPTOPP_*_AVAILABLE only when the code is built in. Without these checks
+ * a renamed macro would silently read as 0 and report the portable paths.
+ */
+#if !defined(CRYPTOPP_VERSION)
+#error "Crypto++ version unknown: config.h does not define CRYPTOPP_VERSION"
+#elif CRYPTOPP_VERSION < 600
+#if !defined(CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE) \
+    || !defined(CRYPTOPP_BOOL_SSE2_ASM_AVAILABLE)
+#error "Crypto++ 5.6.x config.h lacks the AES-NI/SSE2 availability macros"
+#endif
+#define SEIFNODE_CRYPTOPP_AESNI CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE
+#define SEIFNODE_CRYPTOPP_CLMUL CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE
+#define SEIFNODE_CRYPTOPP_SSE2_ASM CRYPTOPP_BOOL_SSE2_ASM_AVAILABLE
+#else
+#if defined(CRYPTOPP_AESNI_AVAILABLE)
+#define SEIFNODE_CRYPTOPP_AESNI 1
+#endif
+#if defined(CRYPTOPP_CLMUL_AVAILABLE)
+#define SEIFNODE_CRYPTOPP_CLMUL 1
+#endif
+#if defined(CRYPTOPP_SSE2_ASM_AVAILABLE)
+#define SEIFNODE_CRYPTOPP_SSE2_ASM 1
+#endif
+#endif
+
+#ifndef SEIFNODE_CRYPTOPP_AESNI
+#define SEIFNODE_CRYPTOPP_AESNI 0
+#endif
+#ifndef SEIFNODE_CRYPTOPP_CLMUL
+#define SEIFNODE_CRYPTOPP_CLMUL 0
+#endif
+#ifndef SEIFNODE_CRYPTOPP_SSE2_ASM
+#define SEIFNODE_CRYPTOPP_SSE2_ASM 0
+#endif
+
+
+// ----------
+// aesGcmPath
+// ----------
+/**
+ * @brief Names the code path of Crypto++ AES-GCM: 'aesni-pclmul' when both
+ *        the cipher and GHASH use the instructions, 'aesni-tables' when only
+ *        the cipher does and 'tables' otherwise.
+ *
+ * @return code path
+ */
+std::string Capabilities::aesGcmPath() {
+
+    /* Crypto++ only uses AES-NI and PCLMULQDQ when it was compiled with the
+     * intrinsics, and then only when its own CPUID check succeeds.
+     */
+#if defined(SEIFNODE_CRYPTOPP_X86) && SEIFNODE_CRYPTOPP_AESNI
+    if (CryptoPP::HasAESNI()) {
+        return SEIFNODE_CRYPTOPP_CLMUL && CryptoPP::HasCLMUL()
+            ? "aesni-pclmul" : "aesni-tables";
+    }
+#endif
+
+    return "tables";
+}
+
+
+// -------
+// eccPath
+// -------
+/**
+ * @brief Names the code path of the Crypto++ big integer arithmetic
+ *        behind the ECC field operations: 'sse2' for the x86 SSE2
+ *        assembly, 'int128' for native 64x64->128 bit multiplies and
+ *        'portable' otherwise.
+ *
+ * @return code path
+ */
+std::string Capabilities::eccPath() {
+
+#if defined(SEIFNODE_CRYPTOPP_X86) && SEIFNODE_CRYPTOPP_SSE2_ASM \
+    && !CRYPTOPP_BOOL_X64
+    if (CryptoPP::HasSSE2()) {
+        return "sse2";
+    }
+#endif
+
+#if defined(CRYPTOPP_WORD128_AVAILABLE)
+    return "int128";
+#else
+    return "portable";
+#endif
+}
+
+
+// ----------
+// chachaPath
+// ----------
+/**
+ * @brief Names the code path of the ChaCha20 keystream.
+ *
+ * @return code path
+ */
+static std::string chachaPath() {
+
+    const CpuFeatures& features = cpuFeatures();
+#ifdef SEIFNODE_SIMD
+    if (features.avx2) {
+        return "avx2";
+    }
+    if (features.sse2) {
+        return "sse2";
+    }
+#else
+    (void)features;
+#endif
+
+    return "portable";
+}
+
+
+// -------------------
+// missingAcceleration
+// -------------------
+/**
+ * @brief Lists the primitives that have an accelerated code path but run
+ *        on a portable one in this process, because the CPU lacks the
+ *        instructions or Crypto++ was built without them.
+ *
+ * @return primitive names
+ */
+std::vector<std::string> Capabilities::missingAcceleration() {
+
+    std::vector<std::string> missing;
+
+    if (aesGcmPath() != "aesni-pclmul") {
+        missing.push_back("aesGcm");
+    }
+
+    if (eccPath() == "portable") {
+        missing.push_back("ecc");
+    }
+
+    return missing;
+}
+
+
+// ------------
+// capabilities
+// ------------
+/**
+ * @brief Returns the detected CPU features and the code path of every
+ *        primitive.
+ *
+ * Invoked as:
+ * 'let caps = capabilities()' where 'caps' is of the form
+ * {cpu: {aesni: [bool], ...}, paths: {aesGcm: [path], ...},
+ *  accelerated: [bool], missing: [primitive names]}
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(Capabilities::capabilities) {
+
+    const CpuFeatures& features = cpuFeatures();
+
+    v8::Local<v8::Object> cpu = Nan::New<v8::Object>();
+    const struct {
+        const char* name;
+        bool value;
+    } flags[] = {
+        {"sse2", features.sse2},
+        {"ssse3", features.ssse3},
+        {"sse41", features.sse41},
+        {"avx", features.avx},
+        {"avx2", features.avx2},
+        {"avx512f", features.avx512f},
+        {"avx512vl", features.avx512vl},
+        {"bmi1", features.bmi1},
+        {"bmi2", features.bmi2},
+        {"aesni", features.aesni},
+        {"pclmul", features.pclmul},
+        {"sha", features.sha}
+    };
+    for (const auto& flag : flags) {
+        Nan::Set(cpu, Nan::New(flag.name).ToLocalChecked(),
+            Nan::New(flag.value));
+    }
+
+    // ISAAC comes from portable C++ code in every build.
+    v8::Local<v8::Object> paths = Nan::New<v8::Object>();
+    const struct {
+        const char* name;
+        std::string path;
+    } primitives[] = {
+        {"aesGcm", aesGcmPath()},
+        {"chacha20Poly1305", chachaPath()},
+        {"sha3", Keccak::permutePath()},
+        {"sha3Many", Keccak::manyPath()},
+        {"ecc", eccPath()},
+        {"isaac", "portable"}
+    };
+    for (const auto& primitive : primitives) {
+        Nan::Set(paths, Nan::New(primitive.name).ToLocalChecked(),
+            Nan::New(primitive.path).ToLocalChecked());
+    }
+
+    std::vector<std::string> missing = missingAcceleration();
+    v8::Local<v8::Array> missingArray = Nan::New<v8::Array>(missing.size());
+    for (size_t i = 0; i < missing.size(); ++i) {
+        Nan::Set(missingArray, uint32_t(i),
+            Nan::New(missing[i]).ToLocalChecked());
+    }
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("cpu").ToLocalChecked(), cpu);
+    Nan::Set(result, Nan::New("paths").ToLocalChecked(), paths);
+    Nan::Set(result, Nan::New("accelerated").ToLocalChecked(),
+        Nan::New(missing.empty()));
+    Nan::Set(result, Nan::New("missing").ToLocalChecked(), missingArray);
+
+    info.GetReturnValue().Set(result);
+}
+
+
+// ----
+// Init
+// ----
+/**
+ * @brief Initialization function for the capabilities function exported
+ *        by the addon.
+ *
+ * @param exports node.js module exports
+ *
+ * @return void
+ */
+void Capabilities::Init(v8::Local<v8::Object> exports) {
+
+    Nan::HandleScope scope;
+
+    // Setting node.js module.exports.
+    Nan::Set(exports, Nan::New("capabilities").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<v8::FunctionTemplate>(capabilities))
+            .ToLocalChecked());
+}
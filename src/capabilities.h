@@ -0,0 +1,141 @@
+/** @file capabilities.h
+ *  @brief Header for the native function reporting the CPU features and
+ *		   the code path used by each crypto primitive
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAPABILITIES_H
+#define CAPABILITIES_H
+
+// ----------------------
+// node.js addon includes
+// ----------------------
+#include <node.h>
+#include <nan.h>
+
+// -----------------
+// standard includes
+// -----------------
+#include <string>
+#include <vector>
+
+
+// ------------
+// Capabilities
+// ------------
+
+/*
+ * @class This class gathers the hardware acceleration actually in use by
+ *		  the addon, both from CPUID and from how the linked Crypto++ was
+ *		  configured, and exposes it to node.js.
+ *
+ *		  The functions exposed to node.js are:
+ *		  function capabilities() -> returns {cpu, paths, accelerated,
+ *		  	missing}
+ */
+class Capabilities {
+
+	private:
+
+		// ----------
+		// aesGcmPath
+		// ----------
+		/**
+		 * @brief Names the code path of Crypto++ AES-GCM: 'aesni-pclmul'
+		 *		  when both the cipher and GHASH use the instructions,
+		 *		  'aesni-tables' when only the cipher does and 'tables'
+		 *		  otherwise.
+		 *
+		 * @return code path
+		 */
+		static std::string aesGcmPath();
+
+
+		// -------
+		// eccPath
+		// -------
+		/**
+		 * @brief Names the code path of the Crypto++ big integer arithmetic
+		 *		  behind the ECC field operations: 'sse2' for the x86 SSE2
+		 *		  assembly, 'int128' for native 64x64->128 bit multiplies
+		 *		  and 'portable' otherwise.
+		 *
+		 * @return code path
+		 */
+		static std::string eccPath();
+
+
+		// ------------
+		// capabilities
+		// ------------
+		/**
+		 * @brief Returns the detected CPU features and the code path of
+		 *		  every primitive.
+		 *
+		 * Invoked as:
+		 * 'let caps = capabilities()' where 'caps' is of the form
+		 * {cpu: {aesni: [bool], ...}, paths: {aesGcm: [path], ...},
+		 *	accelerated: [bool], missing: [primitive names]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(capabilities);
+
+	public:
+
+		// -------------------
+		// missingAcceleration
+		// -------------------
+		/**
+		 * @brief Lists the primitives that have an accelerated code path
+		 *		  but run on a portable one in this process, because the
+		 *		  CPU lacks the instructions or Crypto++ was built without
+		 *		  them.
+		 *
+		 * @return primitive names
+		 */
+		static std::vector<std::string> missingAcceleration();
+
+
+		// ----
+		// Init
+		// ----
+		/**
+		 * @brief Initialization function for the capabilities function
+		 *		  exported by the addon.
+		 *
+		 * @param exports node.js module exports
+		 *
+		 * @return void
+		 */
+		static void Init(v8::Local<v8::Object> exports);
+
+};
+
+#endif
@@ -0,0 +1,941 @@
+/** @file chacha20poly1305.cc
+ *  @brief Definition of the class functions provided in chacha20poly1305.h
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *  The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// ----------------
+// library includes
+// ----------------
+#include "chacha20poly1305.h"
+#include "cpufeatures.h"
+#include "securewipe.h"
+
+#ifdef SEIFNODE_SIMD
+#include <immintrin.h>
+#endif
+
+
+// -------
+// helpers
+// -------
+
+static inline uint32_t load32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8)
+        | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+    p[2] = uint8_t(v >> 16);
+    p[3] = uint8_t(v >> 24);
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+    return uint64_t(load32(p)) | (uint64_t(load32(p + 4)) << 32);
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+    store32(p, uint32_t(v));
+    store32(p + 4, uint32_t(v >> 32));
+}
+
+static inline uint32_t rotl32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+
+// ---------------------------------------------------------------------------
+// ChaCha20 block functions
+// ---------------------------------------------------------------------------
+
+#define CHACHA_QUARTERROUND(a, b, c, d) \
+    a += b; d ^= a; d = rotl32(d, 16);  \
+    c += d; b ^= c; b = rotl32(b, 12);  \
+    a += b; d ^= a; d = rotl32(d, 8);   \
+    c += d; b ^= c; b = rotl32(b, 7);
+
+
+// -----------
+// chachaBlock
+// -----------
+/**
+ * @brief Computes one 64-byte ChaCha20 keystream block.
+ *
+ * @param state ChaCha20 state
+ * @param block container for the keystream block
+ *
+ * @return void
+ */
+static void chachaBlock(const uint32_t* state, uint8_t* block) {
+
+    uint32_t x[16];
+    std::copy(state, state + 16, x);
+
+    for (int round = 0; round < 10; ++round) {
+        CHACHA_QUARTERROUND(x[0], x[4], x[8], x[12])
+        CHACHA_QUARTERROUND(x[1], x[5], x[9], x[13])
+        CHACHA_QUARTERROUND(x[2], x[6], x[10], x[14])
+        CHACHA_QUARTERROUND(x[3], x[7], x[11], x[15])
+        CHACHA_QUARTERROUND(x[0], x[5], x[10], x[15])
+        CHACHA_QUARTERROUND(x[1], x[6], x[11], x[12])
+        CHACHA_QUARTERROUND(x[2], x[7], x[8], x[13])
+        CHACHA_QUARTERROUND(x[3], x[4], x[9], x[14])
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        store32(block + 4 * i, x[i] + state[i]);
+    }
+
+    secureWipe(x, sizeof(x));
+}
+
+
+#ifdef SEIFNODE_SIMD
+
+// -------------
+// chachaXorSse2
+// -------------
+/**
+ * @brief XORs 4 consecutive 64-byte blocks with the keystream, one block
+ *        per 32-bit SSE2 lane.
+ *
+ * @param state ChaCha20 state of the first block
+ * @param input 256 input bytes
+ * @param output container for 256 output bytes
+ *
+ * @return void
+ */
+SEIFNODE_TARGET("sse2")
+static void chachaXorSse2(const uint32_t* state, const uint8_t* input,
+    uint8_t* output) {
+
+#define ROTL128(v, n) \
+    _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - n))
+#define QR128(a, b, c, d) \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 16); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 12); \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL128(d, 8);  \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL128(b, 7);
+
+    __m128i s[16];
+    for (int i = 0; i < 16; ++i) {
+        s[i] = _mm_set1_epi32(int(state[i]));
+    }
+    s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+
+    __m128i x[16];
+    for (int i = 0; i < 16; ++i) {
+        x[i] = s[i];
+    }
+
+    for (int round = 0; round < 10; ++round) {
+        QR128(x[0], x[4], x[8], x[12])
+        QR128(x[1], x[5], x[9], x[13])
+        QR128(x[2], x[6], x[10], x[14])
+        QR128(x[3], x[7], x[11], x[15])
+        QR128(x[0], x[5], x[10], x[15])
+        QR128(x[1], x[6], x[11], x[12])
+        QR128(x[2], x[7], x[8], x[13])
+        QR128(x[3], x[4], x[9], x[14])
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm_add_epi32(x[i], s[i]);
+    }
+
+    // Transpose each group of 4 words so that every vector holds one block.
+    for (int group = 0; group < 4; ++group) {
+        __m128i* v = x + 4 * group;
+        __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+        __m128i t1 = _mm_unpackhi_epi32(v[0], v[1]);
+        __m128i t2 = _mm_unpacklo_epi32(v[2], v[3]);
+        __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+
+        __m128i blocks[4] = {
+            _mm_unpacklo_epi64(t0, t2), _mm_unpackhi_epi64(t0, t2),
+            _mm_unpacklo_epi64(t1, t3), _mm_unpackhi_epi64(t1, t3)
+        };
+
+        for (int block = 0; block < 4; ++block) {
+            size_t offset = 64 * block + 16 * group;
+            __m128i in = _mm_loadu_si128((const __m128i*)(input + offset));
+            _mm_storeu_si128((__m128i*)(output + offset),
+                _mm_xor_si128(in, blocks[block]));
+        }
+    }
+
+#undef QR128
+#undef ROTL128
+}
+
+
+// -------------
+// chachaXorAvx2
+// -------------
+/**
+ * @brief XORs 8 consecutive 64-byte blocks with the keystream, one block
+ *        per 32-bit AVX2 lane.
+ *
+ * @param state ChaCha20 state of the first block
+ * @param input 512 input bytes
+ * @param output container for 512 output bytes
+ *
+ * @return void
+ */
+SEIFNODE_TARGET("avx2")
+static void chachaXorAvx2(const uint32_t* state, const uint8_t* input,
+    uint8_t* output) {
+
+    const __m256i rot16 = _mm256_set_epi8(
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i rot8 = _mm256_set_epi8(
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+#define ROTL256(v, n) \
+    _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - n))
+#define QR256(a, b, c, d) \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a);               \
+    d = _mm256_shuffle_epi8(d, rot16);                                     \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);               \
+    b = ROTL256(b, 12);                                                    \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a);               \
+    d = _mm256_shuffle_epi8(d, rot8);                                      \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c);               \
+    b = ROTL256(b, 7);
+
+    __m256i s[16];
+    for (int i = 0; i < 16; ++i) {
+        s[i] = _mm256_set1_epi32(int(state[i]));
+    }
+    s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+    __m256i x[16];
+    for (int i = 0; i < 16; ++i) {
+        x[i] = s[i];
+    }
+
+    for (int round = 0; round < 10; ++round) {
+        QR256(x[0], x[4], x[8], x[12])
+        QR256(x[1], x[5], x[9], x[13])
+        QR256(x[2], x[6], x[10], x[14])
+        QR256(x[3], x[7], x[11], x[15])
+        QR256(x[0], x[5], x[10], x[15])
+        QR256(x[1], x[6], x[11], x[12])
+        QR256(x[2], x[7], x[8], x[13])
+        QR256(x[3], x[4], x[9], x[14])
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        x[i] = _mm256_add_epi32(x[i], s[i]);
+    }
+
+    /* Transpose each group of 4 words within the 128-bit lanes, leaving
+     * words 4g..4g+3 of blocks j and j + 4 in vector 4g + j.
+     */
+    for (int group = 0; group < 4; ++group) {
+        __m256i* v = x + 4 * group;
+        __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+        __m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+        __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+        __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+        v[0] = _mm256_unpacklo_epi64(t0, t2);
+        v[1] = _mm256_unpackhi_epi64(t0, t2);
+        v[2] = _mm256_unpacklo_epi64(t1, t3);
+        v[3] = _mm256_unpackhi_epi64(t1, t3);
+    }
+
+    for (int j = 0; j < 4; ++j) {
+        __m256i halves[4] = {
+            _mm256_permute2x128_si256(x[j], x[4 + j], 0x20),
+            _mm256_permute2x128_si256(x[8 + j], x[12 + j], 0x20),
+            _mm256_permute2x128_si256(x[j], x[4 + j], 0x31),
+            _mm256_permute2x128_si256(x[8 + j], x[12 + j], 0x31)
+        };
+
+        // Blocks j and j + 4.
+        size_t offsets[4] = {
+            size_t(64 * j), size_t(64 * j + 32),
+            size_t(64 * (j + 4)), size_t(64 * (j + 4) + 32)
+        };
+
+        for (int h = 0; h < 4; ++h) {
+            __m256i in = _mm256_loadu_si256(
+                (const __m256i*)(input + offsets[h]));
+            _mm256_storeu_si256((__m256i*)(output + offsets[h]),
+                _mm256_xor_si256(in, halves[h]));
+        }
+    }
+
+#undef QR256
+#undef ROTL256
+}
+
+#endif
+
+
+// ------------
+// xorKeystream
+// ------------
+/**
+ * @brief XORs data with the ChaCha20 keystream of the given key, nonce
+ *        and starting block counter.
+ *
+ * @param state ChaCha20 state, its counter advanced past the blocks used
+ * @param input input bytes
+ * @param length number of bytes
+ * @param output container for the result
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::xorKeystream(uint32_t* state, const uint8_t* input,
+    size_t length, uint8_t* output) {
+
+#ifdef SEIFNODE_SIMD
+    const CpuFeatures& features = cpuFeatures();
+
+    if (features.avx2) {
+        while (length >= 512) {
+            chachaXorAvx2(state, input, output);
+            state[12] += 8;
+            input += 512;
+            output += 512;
+            length -= 512;
+        }
+    }
+
+    if (features.sse2) {
+        while (length >= 256) {
+            chachaXorSse2(state, input, output);
+            state[12] += 4;
+            input += 256;
+            output += 256;
+            length -= 256;
+        }
+    }
+#endif
+
+    uint8_t block[64];
+    while (length > 0) {
+        chachaBlock(state, block);
+        state[12] += 1;
+
+        size_t count = std::min<size_t>(length, 64);
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = input[i] ^ block[i];
+        }
+
+        input += count;
+        output += count;
+        length -= count;
+    }
+
+    secureWipe(block, sizeof(block));
+}
+
+
+// ---------------------------------------------------------------------------
+// Poly1305
+// ---------------------------------------------------------------------------
+
+Poly1305::Poly1305(): _buffered(0) {
+    std::fill(_r, _r + 5, 0);
+    std::fill(_h, _h + 5, 0);
+    std::fill(_pad, _pad + 4, 0);
+}
+
+Poly1305::~Poly1305() {
+    secureWipe(_r, sizeof(_r));
+    secureWipe(_h, sizeof(_h));
+    secureWipe(_pad, sizeof(_pad));
+    secureWipe(_buffer, sizeof(_buffer));
+}
+
+
+// ------
+// setKey
+// ------
+/**
+ * @brief Starts a new tag with a 32-byte one-time key.
+ *
+ * @param key one-time key
+ *
+ * @return void
+ */
+void Poly1305::setKey(const uint8_t* key) {
+
+    _buffered = 0;
+
+#if defined(__SIZEOF_INT128__)
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff, in 44-bit limbs
+    uint64_t t0 = load64(key);
+    uint64_t t1 = load64(key + 8);
+
+    _r[0] = t0 & 0xffc0fffffffull;
+    _r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+    _r[2] = (t1 >> 24) & 0x00ffffffc0full;
+    _r[3] = _r[4] = 0;
+#else
+    // r &= 0xffffffc0ffffffc0ffffffc0fffffff, in 26-bit limbs
+    _r[0] = (load32(key)) & 0x3ffffff;
+    _r[1] = (load32(key + 3) >> 2) & 0x3ffff03;
+    _r[2] = (load32(key + 6) >> 4) & 0x3ffc0ff;
+    _r[3] = (load32(key + 9) >> 6) & 0x3f03fff;
+    _r[4] = (load32(key + 12) >> 8) & 0x00fffff;
+#endif
+
+    for (int i = 0; i < 5; ++i) {
+        _h[i] = 0;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        _pad[i] = load32(key + 16 + 4 * i);
+    }
+}
+
+
+// ------
+// blocks
+// ------
+/**
+ * @brief Absorbs whole 16-byte blocks.
+ *
+ * @param data block bytes
+ * @param length number of bytes, a multiple of 16
+ * @param final true for the padded final partial block
+ *
+ * @return void
+ */
+void Poly1305::blocks(const uint8_t* data, size_t length, bool final) {
+
+#if defined(__SIZEOF_INT128__)
+    typedef unsigned __int128 uint128_t;
+
+    const uint64_t hibit = final ? 0 : (uint64_t(1) << 40);
+    const uint64_t mask44 = 0xfffffffffffull;
+    const uint64_t mask42 = 0x3ffffffffffull;
+
+    uint64_t r0 = _r[0], r1 = _r[1], r2 = _r[2];
+    uint64_t s1 = r1 * (5 << 2);
+    uint64_t s2 = r2 * (5 << 2);
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2];
+
+    while (length >= 16) {
+        uint64_t t0 = load64(data);
+        uint64_t t1 = load64(data + 8);
+
+        // h += m
+        h0 += t0 & mask44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & mask44;
+        h2 += ((t1 >> 24) & mask42) | hibit;
+
+        // h *= r
+        uint128_t d0 = uint128_t(h0) * r0 + uint128_t(h1) * s2
+            + uint128_t(h2) * s1;
+        uint128_t d1 = uint128_t(h0) * r1 + uint128_t(h1) * r0
+            + uint128_t(h2) * s2;
+        uint128_t d2 = uint128_t(h0) * r2 + uint128_t(h1) * r1
+            + uint128_t(h2) * r0;
+
+        // (partial) h %= p
+        uint64_t c = uint64_t(d0 >> 44);
+        h0 = uint64_t(d0) & mask44;
+        d1 += c;
+        c = uint64_t(d1 >> 44);
+        h1 = uint64_t(d1) & mask44;
+        d2 += c;
+        c = uint64_t(d2 >> 42);
+        h2 = uint64_t(d2) & mask42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= mask44;
+        h1 += c;
+
+        data += 16;
+        length -= 16;
+    }
+
+    _h[0] = h0;
+    _h[1] = h1;
+    _h[2] = h2;
+#else
+    const uint64_t hibit = final ? 0 : (uint64_t(1) << 24);
+    const uint64_t mask26 = 0x3ffffff;
+
+    uint64_t r0 = _r[0], r1 = _r[1], r2 = _r[2], r3 = _r[3], r4 = _r[4];
+    uint64_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+
+    while (length >= 16) {
+        // h += m
+        h0 += (load32(data)) & mask26;
+        h1 += (load32(data + 3) >> 2) & mask26;
+        h2 += (load32(data + 6) >> 4) & mask26;
+        h3 += (load32(data + 9) >> 6) & mask26;
+        h4 += (load32(data + 12) >> 8) | hibit;
+
+        // h *= r
+        uint64_t d0 = h0 * r0 + h1 * s4 + h2 * s3 + h3 * s2 + h4 * s1;
+        uint64_t d1 = h0 * r1 + h1 * r0 + h2 * s4 + h3 * s3 + h4 * s2;
+        uint64_t d2 = h0 * r2 + h1 * r1 + h2 * r0 + h3 * s4 + h4 * s3;
+        uint64_t d3 = h0 * r3 + h1 * r2 + h2 * r1 + h3 * r0 + h4 * s4;
+        uint64_t d4 = h0 * r4 + h1 * r3 + h2 * r2 + h3 * r1 + h4 * r0;
+
+        // (partial) h %= p
+        uint64_t c = d0 >> 26;
+        h0 = d0 & mask26;
+        d1 += c;
+        c = d1 >> 26;
+        h1 = d1 & mask26;
+        d2 += c;
+        c = d2 >> 26;
+        h2 = d2 & mask26;
+        d3 += c;
+        c = d3 >> 26;
+        h3 = d3 & mask26;
+        d4 += c;
+        c = d4 >> 26;
+        h4 = d4 & mask26;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= mask26;
+        h1 += c;
+
+        data += 16;
+        length -= 16;
+    }
+
+    _h[0] = h0;
+    _h[1] = h1;
+    _h[2] = h2;
+    _h[3] = h3;
+    _h[4] = h4;
+#endif
+}
+
+
+// ------
+// update
+// ------
+/**
+ * @brief Absorbs message bytes.
+ *
+ * @param data message bytes
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void Poly1305::update(const uint8_t* data, size_t length) {
+
+    // Complete a buffered partial block first.
+    if (_buffered > 0) {
+        size_t count = std::min(length, 16 - _buffered);
+        std::copy(data, data + count, _buffer + _buffered);
+        _buffered += count;
+        data += count;
+        length -= count;
+
+        if (_buffered < 16) {
+            return;
+        }
+
+        blocks(_buffer, 16, false);
+        _buffered = 0;
+    }
+
+    size_t whole = length & ~size_t(15);
+    if (whole > 0) {
+        blocks(data, whole, false);
+        data += whole;
+        length -= whole;
+    }
+
+    std::copy(data, data + length, _buffer);
+    _buffered = length;
+}
+
+
+// ----------
+// padToBlock
+// ----------
+/**
+ * @brief Absorbs zero bytes up to the next 16-byte boundary, as done
+ *        after the AAD and the ciphertext by the AEAD.
+ *
+ * @return void
+ */
+void Poly1305::padToBlock() {
+    if (_buffered > 0) {
+        std::fill(_buffer + _buffered, _buffer + 16, 0);
+        blocks(_buffer, 16, false);
+        _buffered = 0;
+    }
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Computes the 16-byte tag over everything absorbed.
+ *
+ * @param tag container for the tag
+ *
+ * @return void
+ */
+void Poly1305::finish(uint8_t* tag) {
+
+    // A final partial block is terminated by a 1 byte instead of the 2^128 bit.
+    if (_buffered > 0) {
+        _buffer[_buffered] = 1;
+        std::fill(_buffer + _buffered + 1, _buffer + 16, 0);
+        blocks(_buffer, 16, true);
+        _buffered = 0;
+    }
+
+#if defined(__SIZEOF_INT128__)
+    const uint64_t mask44 = 0xfffffffffffull;
+    const uint64_t mask42 = 0x3ffffffffffull;
+
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2];
+
+    // fully carry h
+    uint64_t c = h1 >> 44;
+    h1 &= mask44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= mask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= mask44;
+    h1 += c;
+    c = h1 >> 44;
+    h1 &= mask44;
+    h2 += c;
+    c = h2 >> 42;
+    h2 &= mask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= mask44;
+    h1 += c;
+
+    // compute h + -p
+    uint64_t g0 = h0 + 5;
+    c = g0 >> 44;
+    g0 &= mask44;
+    uint64_t g1 = h1 + c;
+    c = g1 >> 44;
+    g1 &= mask44;
+    uint64_t g2 = h2 + c - (uint64_t(1) << 42);
+
+    // select h if h < p, or h + -p if h >= p
+    c = (g2 >> 63) - 1;
+    g0 &= c;
+    g1 &= c;
+    g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0;
+    h1 = (h1 & c) | g1;
+    h2 = (h2 & c) | g2;
+
+    // h = h + pad
+    uint64_t t0 = uint64_t(_pad[0]) | (uint64_t(_pad[1]) << 32);
+    uint64_t t1 = uint64_t(_pad[2]) | (uint64_t(_pad[3]) << 32);
+
+    h0 += t0 & mask44;
+    c = h0 >> 44;
+    h0 &= mask44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & mask44) + c;
+    c = h1 >> 44;
+    h1 &= mask44;
+    h2 += ((t1 >> 24) & mask42) + c;
+    h2 &= mask42;
+
+    // tag = h % 2^128
+    store64(tag, h0 | (h1 << 44));
+    store64(tag + 8, (h1 >> 20) | (h2 << 24));
+#else
+    const uint64_t mask26 = 0x3ffffff;
+
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+
+    // fully carry h
+    uint64_t c = h1 >> 26;
+    h1 &= mask26;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= mask26;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= mask26;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= mask26;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= mask26;
+    h1 += c;
+
+    // compute h + -p
+    uint64_t g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= mask26;
+    uint64_t g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= mask26;
+    uint64_t g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= mask26;
+    uint64_t g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= mask26;
+    uint64_t g4 = h4 + c - (uint64_t(1) << 26);
+
+    // select h if h < p, or h + -p if h >= p
+    uint64_t mask = (g4 >> 63) - 1;
+    g0 &= mask;
+    g1 &= mask;
+    g2 &= mask;
+    g3 &= mask;
+    g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    // h = h % 2^128
+    uint32_t w0 = uint32_t(h0 | (h1 << 26));
+    uint32_t w1 = uint32_t((h1 >> 6) | (h2 << 20));
+    uint32_t w2 = uint32_t((h2 >> 12) | (h3 << 14));
+    uint32_t w3 = uint32_t((h3 >> 18) | (h4 << 8));
+
+    // tag = (h + pad) % 2^128
+    uint64_t f = uint64_t(w0) + _pad[0];
+    store32(tag, uint32_t(f));
+    f = uint64_t(w1) + _pad[1] + (f >> 32);
+    store32(tag + 4, uint32_t(f));
+    f = uint64_t(w2) + _pad[2] + (f >> 32);
+    store32(tag + 8, uint32_t(f));
+    f = uint64_t(w3) + _pad[3] + (f >> 32);
+    store32(tag + 12, uint32_t(f));
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+// ChaCha20Poly1305
+// ---------------------------------------------------------------------------
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Sets up the cipher for one message and derives the Poly1305
+ *        one-time key from keystream block 0.
+ *
+ * @param key 32-byte key
+ * @param nonce 12-byte nonce, never to be reused with the same key
+ */
+ChaCha20Poly1305::ChaCha20Poly1305(const uint8_t* key, const uint8_t* nonce):
+    _aadLength(0),
+    _messageLength(0),
+    _inMessage(false) {
+
+    // "expand 32-byte k"
+    _state[0] = 0x61707865;
+    _state[1] = 0x3320646e;
+    _state[2] = 0x79622d32;
+    _state[3] = 0x6b206574;
+    for (int i = 0; i < 8; ++i) {
+        _state[4 + i] = load32(key + 4 * i);
+    }
+    _state[12] = 0;
+    for (int i = 0; i < 3; ++i) {
+        _state[13 + i] = load32(nonce + 4 * i);
+    }
+
+    uint8_t block[64];
+    chachaBlock(_state, block);
+    _poly.setKey(block);
+    secureWipe(block, sizeof(block));
+
+    _state[12] = 1;
+}
+
+ChaCha20Poly1305::~ChaCha20Poly1305() {
+    secureWipe(_state, sizeof(_state));
+}
+
+
+// ---------
+// updateAad
+// ---------
+/**
+ * @brief Authenticates associated data that is not encrypted.
+ *
+ * @param aad associated data bytes
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::updateAad(const uint8_t* aad, size_t length) {
+    _poly.update(aad, length);
+    _aadLength += length;
+}
+
+
+// ------------
+// startMessage
+// ------------
+/**
+ * @brief Pads the AAD once the first message bytes arrive.
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::startMessage() {
+    if (!_inMessage) {
+        _poly.padToBlock();
+        _inMessage = true;
+    }
+}
+
+
+// -------
+// encrypt
+// -------
+/**
+ * @brief Encrypts message bytes and authenticates the result.
+ *
+ * @param input message bytes
+ * @param length number of bytes
+ * @param output container for the ciphertext
+ *
+ * @throw std::length_error past MAX_MESSAGE_BYTES
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::encrypt(const uint8_t* input, size_t length,
+    uint8_t* output) {
+
+    if (length > MAX_MESSAGE_BYTES - _messageLength) {
+        throw std::length_error("Message too long for ChaCha20-Poly1305");
+    }
+
+    startMessage();
+    xorKeystream(_state, input, length, output);
+    _poly.update(output, length);
+    _messageLength += length;
+}
+
+
+// -------
+// decrypt
+// -------
+/**
+ * @brief Authenticates ciphertext bytes and decrypts them. The output
+ *        must be discarded unless verify succeeds.
+ *
+ * @param input ciphertext bytes
+ * @param length number of bytes
+ * @param output container for the message
+ *
+ * @throw std::length_error past MAX_MESSAGE_BYTES
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::decrypt(const uint8_t* input, size_t length,
+    uint8_t* output) {
+
+    if (length > MAX_MESSAGE_BYTES - _messageLength) {
+        throw std::length_error("Message too long for ChaCha20-Poly1305");
+    }
+
+    startMessage();
+    _poly.update(input, length);
+    xorKeystream(_state, input, length, output);
+    _messageLength += length;
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Computes the tag over the AAD and the ciphertext.
+ *
+ * @param tag container for the 16-byte tag
+ *
+ * @return void
+ */
+void ChaCha20Poly1305::finish(uint8_t* tag) {
+
+    startMessage();
+    _poly.padToBlock();
+
+    uint8_t lengths[16];
+    store64(lengths, _aadLength);
+    store64(lengths + 8, _messageLength);
+    _poly.update(lengths, sizeof(lengths));
+
+    _poly.finish(tag);
+}
+
+
+// ------
+// verify
+// ------
+/**
+ * @brief Compares the computed tag with the given one in constant time.
+ *
+ * @param tag expected 16-byte tag
+ *
+ * @return true if the tags match
+ */
+bool ChaCha20Poly1305::verify(const uint8_t* tag) {
+
+    uint8_t computed[TAG_BYTES];
+    finish(computed);
+
+    uint8_t difference = 0;
+    for (size_t i = 0; i < TAG_BYTES; ++i) {
+        difference |= computed[i] ^ tag[i];
+    }
+
+    return difference == 0;
+}
@@ -0,0 +1,304 @@
+/** @file chacha20poly1305.h
+ *  @brief Definition of the ChaCha20-Poly1305 AEAD (RFC 8439) used by the
+ *		   node module on hosts without AES/GHASH acceleration
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CHACHA20POLY1305_H
+#define CHACHA20POLY1305_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+
+
+// --------
+// Poly1305
+// --------
+
+/*
+ * @class Incremental Poly1305 one-time authenticator.
+ */
+class Poly1305 {
+
+	private:
+
+		// clamped 'r' and the accumulator, in 44-bit (or 26-bit) limbs
+		uint64_t _r[5];
+		uint64_t _h[5];
+		// 's', the second half of the one-time key
+		uint32_t _pad[4];
+		// partial block and number of bytes in it
+		uint8_t _buffer[16];
+		size_t _buffered;
+
+
+		// ------
+		// blocks
+		// ------
+		/**
+		 * @brief Absorbs whole 16-byte blocks.
+		 *
+		 * @param data block bytes
+		 * @param length number of bytes, a multiple of 16
+		 * @param final true for the padded final partial block
+		 *
+		 * @return void
+		 */
+		void blocks(const uint8_t* data, size_t length, bool final);
+
+	public:
+
+		Poly1305();
+
+		~Poly1305();
+
+
+		// ------
+		// setKey
+		// ------
+		/**
+		 * @brief Starts a new tag with a 32-byte one-time key.
+		 *
+		 * @param key one-time key
+		 *
+		 * @return void
+		 */
+		void setKey(const uint8_t* key);
+
+
+		// ------
+		// update
+		// ------
+		/**
+		 * @brief Absorbs message bytes.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void update(const uint8_t* data, size_t length);
+
+
+		// ----------
+		// padToBlock
+		// ----------
+		/**
+		 * @brief Absorbs zero bytes up to the next 16-byte boundary, as
+		 *		  done after the AAD and the ciphertext by the AEAD.
+		 *
+		 * @return void
+		 */
+		void padToBlock();
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Computes the 16-byte tag over everything absorbed.
+		 *
+		 * @param tag container for the tag
+		 *
+		 * @return void
+		 */
+		void finish(uint8_t* tag);
+};
+
+
+// ----------------
+// ChaCha20Poly1305
+// ----------------
+
+/*
+ * @class Incremental ChaCha20-Poly1305 AEAD as specified in RFC 8439.
+ *
+ *		  The AAD is given first with updateAad (any number of calls), then
+ *		  the message with encrypt or decrypt (any number of calls, all but
+ *		  the last a multiple of 64 bytes), then the tag is computed with
+ *		  finish or checked with verify. Input and output may overlap
+ *		  exactly for in-place processing.
+ *
+ *		  The keystream is generated 8 blocks at a time with AVX2 or 4 at a
+ *		  time with SSE2 when available.
+ *
+ *		  Crypto++ 5.6.5 does ship ChaCha20, but only the original variant
+ *		  with a 64-bit nonce and 64-bit counter, and has neither Poly1305
+ *		  nor the RFC 8439 AEAD with its 96-bit nonce, so the construction
+ *		  is implemented here rather than built on the library's cipher.
+ */
+class ChaCha20Poly1305 {
+
+	private:
+
+		// ChaCha20 state: constants, key, block counter and nonce
+		uint32_t _state[16];
+		// authenticator keyed with the first keystream block
+		Poly1305 _poly;
+		// AAD and message bytes processed so far
+		uint64_t _aadLength;
+		uint64_t _messageLength;
+		// true once the message has started and the AAD is padded
+		bool _inMessage;
+
+
+		// ------------
+		// startMessage
+		// ------------
+		/**
+		 * @brief Pads the AAD once the first message bytes arrive.
+		 *
+		 * @return void
+		 */
+		void startMessage();
+
+	public:
+
+		// key, nonce and tag sizes
+		static const size_t KEY_BYTES = 32;
+		static const size_t NONCE_BYTES = 12;
+		static const size_t TAG_BYTES = 16;
+
+		// message bytes per key and nonce (2^32 - 1 blocks after the first)
+		static const uint64_t MAX_MESSAGE_BYTES = 274877906880ull;
+
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Sets up the cipher for one message.
+		 *
+		 * @param key 32-byte key
+		 * @param nonce 12-byte nonce, never to be reused with the same key
+		 */
+		ChaCha20Poly1305(const uint8_t* key, const uint8_t* nonce);
+
+		~ChaCha20Poly1305();
+
+
+		// ---------
+		// updateAad
+		// ---------
+		/**
+		 * @brief Authenticates associated data that is not encrypted.
+		 *
+		 * @param aad associated data bytes
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void updateAad(const uint8_t* aad, size_t length);
+
+
+		// -------
+		// encrypt
+		// -------
+		/**
+		 * @brief Encrypts message bytes and authenticates the result.
+		 *
+		 * @param input message bytes
+		 * @param length number of bytes
+		 * @param output container for the ciphertext
+		 *
+		 * @throw std::length_error past MAX_MESSAGE_BYTES
+		 *
+		 * @return void
+		 */
+		void encrypt(const uint8_t* input, size_t length, uint8_t* output);
+
+
+		// -------
+		// decrypt
+		// -------
+		/**
+		 * @brief Authenticates ciphertext bytes and decrypts them. The
+		 *		  output must be discarded unless verify succeeds.
+		 *
+		 * @param input ciphertext bytes
+		 * @param length number of bytes
+		 * @param output container for the message
+		 *
+		 * @throw std::length_error past MAX_MESSAGE_BYTES
+		 *
+		 * @return void
+		 */
+		void decrypt(const uint8_t* input, size_t length, uint8_t* output);
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Computes the tag over the AAD and the ciphertext.
+		 *
+		 * @param tag container for the 16-byte tag
+		 *
+		 * @return void
+		 */
+		void finish(uint8_t* tag);
+
+
+		// ------
+		// verify
+		// ------
+		/**
+		 * @brief Compares the computed tag with the given one in constant
+		 *		  time.
+		 *
+		 * @param tag expected 16-byte tag
+		 *
+		 * @return true if the tags match
+		 */
+		bool verify(const uint8_t* tag);
+
+
+		// ------------
+		// xorKeystream
+		// ------------
+		/**
+		 * @brief XORs data with the ChaCha20 keystream of the given key,
+		 *		  nonce and starting block counter.
+		 *
+		 * @param state ChaCha20 state, its counter advanced past the blocks
+		 *		  used
+		 * @param input input bytes
+		 * @param length number of bytes
+		 * @param output container for the result
+		 *
+		 * @return void
+		 */
+		static void xorKeystream(uint32_t* state, const uint8_t* input,
+			size_t length, uint8_t* output);
+};
+
+
+#endif
@@ -0,0 +1,186 @@
+/** @file compression.h
+ *  @brief header/implementation file for the zlib helpers used by the node
+ *		   module to compress messages before encrypting them
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_COMPRESSION_H
+#define SEIFNODE_COMPRESSION_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstdint>
+#include <stdexcept>
+
+// ---------------------------------
+// zlib bundled and exported by node
+// ---------------------------------
+#include <zlib.h>
+
+// ----------------
+// library includes
+// ----------------
+#include "scratchpool.h"
+
+
+/* Compressed payloads are [message length (4 bytes BE)][raw deflate data];
+ * the length lets the receiver allocate the message up front and reject
+ * payloads that do not inflate to exactly that size.
+ */
+static const size_t COMPRESSION_LENGTH_BYTES = 4;
+
+// raw deflate: the zlib header and checksum are redundant under the AEAD tag
+static const int COMPRESSION_WINDOW_BITS = -15;
+
+
+// ---------------
+// compressPayload
+// ---------------
+/**
+ * @brief Deflates a message into a compressed payload.
+ *
+ * @param message message bytes
+ * @param messageLength number of message bytes
+ * @param level zlib compression level, 1 (fastest) to 9 (smallest)
+ * @param payload resulting compressed payload, a scratch buffer so the
+ *		  compressed message is wiped once used
+ *
+ * @return false if compressing would not make the message smaller, in
+ *		   which case it should be sent as is
+ */
+static bool compressPayload(const uint8_t* message, size_t messageLength,
+    int level, ScratchBuffer& payload) {
+
+    if (messageLength > UINT32_MAX) {
+        return false;
+    }
+
+    z_stream stream = z_stream();
+    if (deflateInit2(&stream, level, Z_DEFLATED, COMPRESSION_WINDOW_BITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Unable to initialize compression");
+    }
+
+    // Anything beyond the message length is no gain, stop there.
+    payload.reset(messageLength);
+    if (payload.size() <= COMPRESSION_LENGTH_BYTES) {
+        deflateEnd(&stream);
+        return false;
+    }
+
+    uint8_t* payloadData = payload.data();
+    payloadData[0] = uint8_t(messageLength >> 24);
+    payloadData[1] = uint8_t(messageLength >> 16);
+    payloadData[2] = uint8_t(messageLength >> 8);
+    payloadData[3] = uint8_t(messageLength);
+
+    stream.next_in = const_cast<Bytef*>(message);
+    stream.avail_in = uInt(messageLength);
+    stream.next_out = payloadData + COMPRESSION_LENGTH_BYTES;
+    stream.avail_out = uInt(payload.size() - COMPRESSION_LENGTH_BYTES);
+
+    int result = deflate(&stream, Z_FINISH);
+    size_t compressedLength = COMPRESSION_LENGTH_BYTES + stream.total_out;
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END) {
+        return false;
+    }
+
+    payload.truncate(compressedLength);
+    return true;
+}
+
+
+// ------------------
+// decompressedLength
+// ------------------
+/**
+ * @brief Reads the message length of a compressed payload.
+ *
+ * @param payload compressed payload bytes
+ * @param payloadLength number of payload bytes
+ *
+ * @throw std::runtime_error if the payload is malformed
+ *
+ * @return message length
+ */
+static size_t decompressedLength(const uint8_t* payload,
+    size_t payloadLength) {
+
+    if (payloadLength < COMPRESSION_LENGTH_BYTES) {
+        throw std::runtime_error("Malformed compressed message");
+    }
+
+    return (size_t(payload[0]) << 24) | (size_t(payload[1]) << 16)
+        | (size_t(payload[2]) << 8) | size_t(payload[3]);
+}
+
+
+// -----------------
+// decompressPayload
+// -----------------
+/**
+ * @brief Inflates a compressed payload into the original message.
+ *
+ * @param payload compressed payload bytes
+ * @param payloadLength number of payload bytes
+ * @param message container for the message of
+ *		  decompressedLength(payload, payloadLength) bytes
+ *
+ * @throw std::runtime_error if the payload is malformed
+ *
+ * @return void
+ */
+static void decompressPayload(const uint8_t* payload, size_t payloadLength,
+    uint8_t* message) {
+
+    size_t messageLength = decompressedLength(payload, payloadLength);
+
+    z_stream stream = z_stream();
+    if (inflateInit2(&stream, COMPRESSION_WINDOW_BITS) != Z_OK) {
+        throw std::runtime_error("Unable to initialize decompression");
+    }
+
+    stream.next_in = const_cast<Bytef*>(payload + COMPRESSION_LENGTH_BYTES);
+    stream.avail_in = uInt(payloadLength - COMPRESSION_LENGTH_BYTES);
+    stream.next_out = message;
+    stream.avail_out = uInt(messageLength);
+
+    int result = inflate(&stream, Z_FINISH);
+    bool complete = result == Z_STREAM_END && stream.avail_in == 0
+        && stream.total_out == messageLength;
+    inflateEnd(&stream);
+
+    if (!complete) {
+        throw std::runtime_error("Malformed compressed message");
+    }
+}
+
+
+#endif
@@ -0,0 +1,203 @@
+/** @file cpufeatures.h
+ *  @brief header/implementation file for the runtime CPU feature detection
+ *		   used by the node module to pick the fastest code paths
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_CPUFEATURES_H
+#define SEIFNODE_CPUFEATURES_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) \
+	|| defined(_M_IX86)
+#define SEIFNODE_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/* Lets a single function use instructions beyond the baseline the addon is
+ * compiled for; callers must check cpuFeatures() first.
+ */
+#if defined(SEIFNODE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SEIFNODE_TARGET(features) __attribute__((target(features)))
+#define SEIFNODE_SIMD 1
+#elif defined(SEIFNODE_X86) && defined(_MSC_VER)
+#define SEIFNODE_TARGET(features)
+#define SEIFNODE_SIMD 1
+#else
+#define SEIFNODE_TARGET(features)
+#endif
+
+
+// -----------
+// CpuFeatures
+// -----------
+/*
+ * @struct CPU features relevant to the crypto code paths, each only set
+ *		   when the operating system also saves the registers involved.
+ */
+struct CpuFeatures {
+	bool sse2;
+	bool ssse3;
+	bool sse41;
+	bool avx;
+	bool avx2;
+	bool avx512f;
+	bool avx512vl;
+	bool bmi1;
+	bool bmi2;
+	bool aesni;
+	bool pclmul;
+	bool sha;
+};
+
+
+#ifdef SEIFNODE_X86
+
+// -----
+// cpuid
+// -----
+/**
+ * @brief Runs the cpuid instruction for the given leaf and subleaf.
+ *
+ * @param leaf cpuid leaf
+ * @param subleaf cpuid subleaf
+ * @param regs resulting eax, ebx, ecx and edx
+ *
+ * @return void
+ */
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, int(leaf), int(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = uint32_t(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+
+// ------
+// xgetbv
+// ------
+/**
+ * @brief Reads the extended control register listing the register
+ *        states saved by the operating system.
+ *
+ * @return XCR0
+ */
+static uint64_t xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+
+// -----------------
+// detectCpuFeatures
+// -----------------
+/**
+ * @brief Queries the CPU (and operating system) for the supported
+ *        instruction set extensions.
+ *
+ * @return detected features
+ */
+static CpuFeatures detectCpuFeatures() {
+
+    CpuFeatures features = CpuFeatures();
+
+#ifdef SEIFNODE_X86
+    uint32_t regs[4];
+
+    cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    uint32_t ecx1 = regs[2];
+    uint32_t edx1 = regs[3];
+
+    features.sse2 = (edx1 >> 26) & 1;
+    features.ssse3 = (ecx1 >> 9) & 1;
+    features.sse41 = (ecx1 >> 19) & 1;
+    features.aesni = (ecx1 >> 25) & 1;
+    features.pclmul = (ecx1 >> 1) & 1;
+
+    // AVX state must be enabled by the OS (OSXSAVE and XCR0 bits 1, 2).
+    bool osxsave = (ecx1 >> 27) & 1;
+    uint64_t xcr0 = osxsave ? xgetbv() : 0;
+    bool ymm = (xcr0 & 0x6) == 0x6;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    features.avx = ymm && ((ecx1 >> 28) & 1);
+
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, regs);
+        uint32_t ebx7 = regs[1];
+
+        features.avx2 = features.avx && ((ebx7 >> 5) & 1);
+        features.bmi1 = (ebx7 >> 3) & 1;
+        features.bmi2 = (ebx7 >> 8) & 1;
+        features.avx512f = zmm && ((ebx7 >> 16) & 1);
+        features.avx512vl = features.avx512f && ((ebx7 >> 31) & 1);
+        features.sha = (ebx7 >> 29) & 1;
+    }
+#endif
+
+    return features;
+}
+
+
+// -----------
+// cpuFeatures
+// -----------
+/**
+ * @brief Returns the CPU features, detected once per process.
+ *
+ * @return detected features
+ */
+static const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+
+#endif
@@ -0,0 +1,411 @@
+/** @file fileio.h
+ *  @brief header/implementation file for the file helpers used by the node
+ *		   module to stream files through the ciphers off the main thread
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_FILEIO_H
+#define SEIFNODE_FILEIO_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// -------------------
+// platform includes
+// -------------------
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// ----------------
+// library includes
+// ----------------
+#include "securewipe.h"
+
+
+// alignment of buffers and file offsets used with O_DIRECT
+static const size_t FILEIO_ALIGNMENT_BYTES = 4096;
+
+
+// ----------
+// throwErrno
+// ----------
+/**
+ * @brief Throws a std::runtime_error describing the current errno.
+ *
+ * @param what description of the failed operation
+ *
+ * @return void
+ */
+static void throwErrno(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+
+// -------------
+// AlignedBuffer
+// -------------
+/*
+ * @class Heap buffer aligned to FILEIO_ALIGNMENT_BYTES, as required for
+ *		  O_DIRECT reads, wiped before it is freed.
+ */
+class AlignedBuffer {
+
+	private:
+		uint8_t* _data;
+		size_t _size;
+
+	public:
+		explicit AlignedBuffer(size_t size): _data(nullptr), _size(size) {
+#ifdef _WIN32
+			_data = (uint8_t *)_aligned_malloc(size, FILEIO_ALIGNMENT_BYTES);
+#else
+			void* data = nullptr;
+			if (posix_memalign(&data, FILEIO_ALIGNMENT_BYTES, size) == 0) {
+				_data = (uint8_t *)data;
+			}
+#endif
+			if (_data == nullptr) {
+				throw std::runtime_error("Unable to allocate file buffer");
+			}
+		}
+
+		~AlignedBuffer() {
+			secureWipe(_data, _size);
+#ifdef _WIN32
+			_aligned_free(_data);
+#else
+			free(_data);
+#endif
+		}
+
+		AlignedBuffer(const AlignedBuffer&) = delete;
+		AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+		uint8_t* data() { return _data; }
+		size_t size() const { return _size; }
+};
+
+
+// --------------
+// FileDescriptor
+// --------------
+/*
+ * @class Owns a file descriptor and closes it when going out of scope.
+ */
+class FileDescriptor {
+
+	private:
+		int _fd;
+
+	public:
+		explicit FileDescriptor(int fd = -1): _fd(fd) {}
+
+		~FileDescriptor() {
+			close();
+		}
+
+		FileDescriptor(const FileDescriptor&) = delete;
+		FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+		int get() const { return _fd; }
+
+		void reset(int fd) {
+			close();
+			_fd = fd;
+		}
+
+		int release() {
+			int fd = _fd;
+			_fd = -1;
+			return fd;
+		}
+
+		void close() {
+			if (_fd >= 0) {
+#ifdef _WIN32
+				::_close(_fd);
+#else
+				::close(_fd);
+#endif
+				_fd = -1;
+			}
+		}
+};
+
+
+// ---------------
+// openForReading
+// ---------------
+/**
+ * @brief Opens a file for sequential reading, bypassing the page cache
+ *		  with O_DIRECT when requested and supported, and advising the
+ *		  kernel to read ahead aggressively otherwise.
+ *
+ * @param path path of the file
+ * @param direct true to request O_DIRECT
+ * @param size resulting file size
+ *
+ * @throw std::runtime_error if the file cannot be opened
+ *
+ * @return file descriptor
+ */
+static int openForReading(const std::string& path, bool direct,
+    uint64_t& size) {
+
+    int fd = -1;
+
+#if defined(O_DIRECT)
+    // Not every file system supports O_DIRECT, fall back to buffered reads.
+    if (direct) {
+        fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+    }
+#else
+    (void)direct;
+#endif
+
+    if (fd < 0) {
+#ifdef _WIN32
+        fd = ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    }
+
+    if (fd < 0) {
+        throwErrno("Unable to open '" + path + "'");
+    }
+
+    FileDescriptor owned(fd);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        throwErrno("Unable to read the size of '" + path + "'");
+    }
+    size = uint64_t(info.st_size);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return owned.release();
+}
+
+
+// ------
+// seekTo
+// ------
+/**
+ * @brief Moves the read position of a file to an absolute offset.
+ *
+ * @param fd file descriptor
+ * @param offset byte offset from the start of the file
+ *
+ * @throw std::runtime_error if the position cannot be set
+ *
+ * @return void
+ */
+static void seekTo(int fd, uint64_t offset) {
+#ifdef _WIN32
+    if (::_lseeki64(fd, int64_t(offset), SEEK_SET) < 0) {
+#else
+    if (::lseek(fd, off_t(offset), SEEK_SET) < 0) {
+#endif
+        throwErrno("Unable to seek in file");
+    }
+}
+
+
+// --------
+// readFull
+// --------
+/**
+ * @brief Reads up to 'length' bytes, retrying short reads.
+ *
+ * @param fd file descriptor
+ * @param data destination of the bytes
+ * @param length number of bytes to read
+ *
+ * @throw std::runtime_error on read errors
+ *
+ * @return number of bytes read, less than 'length' only at end of file
+ */
+static size_t readFull(int fd, uint8_t* data, size_t length) {
+
+    size_t done = 0;
+    while (done < length) {
+#ifdef _WIN32
+        int count = ::_read(fd, data + done, unsigned(length - done));
+#else
+        ssize_t count = ::read(fd, data + done, length - done);
+#endif
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwErrno("Unable to read file");
+        }
+        if (count == 0) {
+            break;
+        }
+        done += size_t(count);
+    }
+
+    return done;
+}
+
+
+// ---------
+// writeFull
+// ---------
+/**
+ * @brief Writes all 'length' bytes, retrying short writes.
+ *
+ * @param fd file descriptor
+ * @param data bytes to write
+ * @param length number of bytes to write
+ *
+ * @throw std::runtime_error on write errors
+ *
+ * @return void
+ */
+static void writeFull(int fd, const uint8_t* data, size_t length) {
+
+    size_t done = 0;
+    while (done < length) {
+#ifdef _WIN32
+        int count = ::_write(fd, data + done, unsigned(length - done));
+#else
+        ssize_t count = ::write(fd, data + done, length - done);
+#endif
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwErrno("Unable to write file");
+        }
+        done += size_t(count);
+    }
+}
+
+
+// -------------
+// ReplacingFile
+// -------------
+/*
+ * @class Temporary file next to 'target' that replaces it atomically
+ *		  once complete. Unless committed, the temporary file is removed
+ *		  when going out of scope, so 'target' is never left half written.
+ */
+class ReplacingFile {
+
+	private:
+		std::string _target;
+		std::string _path;
+		FileDescriptor _fd;
+		bool _committed;
+
+	public:
+		explicit ReplacingFile(const std::string& target):
+			_target(target), _path(target + ".XXXXXX"), _committed(false) {
+
+#ifdef _WIN32
+			if (_mktemp_s(&_path[0], _path.size() + 1) != 0) {
+				throwErrno("Unable to create a file next to '" + target + "'");
+			}
+			int fd = ::_open(_path.c_str(),
+				_O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+			int fd = ::mkstemp(&_path[0]);
+#endif
+			if (fd < 0) {
+				throwErrno("Unable to create a file next to '" + target + "'");
+			}
+			_fd.reset(fd);
+		}
+
+		~ReplacingFile() {
+			if (!_committed) {
+				_fd.close();
+				std::remove(_path.c_str());
+			}
+		}
+
+		ReplacingFile(const ReplacingFile&) = delete;
+		ReplacingFile& operator=(const ReplacingFile&) = delete;
+
+		int get() const { return _fd.get(); }
+
+		// ------
+		// commit
+		// ------
+		/**
+		 * @brief Flushes the temporary file to disk and renames it over
+		 *		  the target.
+		 *
+		 * @throw std::runtime_error if flushing or renaming fails
+		 *
+		 * @return void
+		 */
+		void commit() {
+#ifdef _WIN32
+			if (::_commit(_fd.get()) != 0) {
+				throwErrno("Unable to flush '" + _path + "'");
+			}
+			_fd.close();
+			if (!MoveFileExA(_path.c_str(), _target.c_str(),
+					MOVEFILE_REPLACE_EXISTING)) {
+				throw std::runtime_error("Unable to replace '" + _target + "'");
+			}
+#else
+			if (::fsync(_fd.get()) != 0) {
+				throwErrno("Unable to flush '" + _path + "'");
+			}
+			_fd.close();
+			if (::rename(_path.c_str(), _target.c_str()) != 0) {
+				throwErrno("Unable to replace '" + _target + "'");
+			}
+#endif
+			_committed = true;
+		}
+};
+
+
+#endif
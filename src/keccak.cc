@@ -0,0 +1,1277 @@
+/** @file keccak.cc
+ *  @brief Definition of the class functions provided in keccak.h
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
+#include "cpufeatures.h"
+#include "securewipe.h"
+
+#ifdef SEIFNODE_SIMD
+#include <immintrin.h>
+#endif
+
+
+// Keccak-f[1600] round constants
+static const uint64_t ROUND_CONSTANTS[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808aull,
+    0x8000000080008000ull, 0x000000000000808bull, 0x0000000080000001ull,
+    0x8000000080008081ull, 0x8000000000008009ull, 0x000000000000008aull,
+    0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000aull,
+    0x000000008000808bull, 0x800000000000008bull, 0x8000000000008089ull,
+    0x8000000000008003ull, 0x8000000000008002ull, 0x8000000000000080ull,
+    0x000000000000800aull, 0x800000008000000aull, 0x8000000080008081ull,
+    0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull
+};
+
+// final padding bit
+static const uint8_t PAD_LAST = 0x80;
+
+// rate lanes absorbed per block
+static const size_t RATE_LANES = Keccak::SHA3_256_RATE / 8;
+
+// first field of an exported sponge state
+static const uint64_t SPONGE_STATE_TAG = 0x53;
+
+
+/* Theta, rho and pi of one round of Keccak-f[1600] on 25 lanes of type V,
+ * written out lane by lane so that the same code serves the scalar
+ * permutations and the SIMD ones with one input per vector element. Leaves
+ * the lanes to be combined by chi in b0 to b24.
+ */
+#define KECCAK_THETA_RHO_PI(V, XOR, XOR5, ROL, A)                            \
+    V c0 = XOR5(A[0], A[5], A[10], A[15], A[20]);                            \
+    V c1 = XOR5(A[1], A[6], A[11], A[16], A[21]);                            \
+    V c2 = XOR5(A[2], A[7], A[12], A[17], A[22]);                            \
+    V c3 = XOR5(A[3], A[8], A[13], A[18], A[23]);                            \
+    V c4 = XOR5(A[4], A[9], A[14], A[19], A[24]);                            \
+    V d0 = XOR(c4, ROL(c1, 1));                                              \
+    V d1 = XOR(c0, ROL(c2, 1));                                              \
+    V d2 = XOR(c1, ROL(c3, 1));                                              \
+    V d3 = XOR(c2, ROL(c4, 1));                                              \
+    V d4 = XOR(c3, ROL(c0, 1));                                              \
+    V b0 = XOR(A[0], d0);                                                    \
+    V b1 = ROL(XOR(A[6], d1), 44);                                           \
+    V b2 = ROL(XOR(A[12], d2), 43);                                          \
+    V b3 = ROL(XOR(A[18], d3), 21);                                          \
+    V b4 = ROL(XOR(A[24], d4), 14);                                          \
+    V b5 = ROL(XOR(A[3], d3), 28);                                           \
+    V b6 = ROL(XOR(A[9], d4), 20);                                           \
+    V b7 = ROL(XOR(A[10], d0), 3);                                           \
+    V b8 = ROL(XOR(A[16], d1), 45);                                          \
+    V b9 = ROL(XOR(A[22], d2), 61);                                          \
+    V b10 = ROL(XOR(A[1], d1), 1);                                           \
+    V b11 = ROL(XOR(A[7], d2), 6);                                           \
+    V b12 = ROL(XOR(A[13], d3), 25);                                         \
+    V b13 = ROL(XOR(A[19], d4), 8);                                          \
+    V b14 = ROL(XOR(A[20], d0), 18);                                         \
+    V b15 = ROL(XOR(A[4], d4), 27);                                          \
+    V b16 = ROL(XOR(A[5], d0), 36);                                          \
+    V b17 = ROL(XOR(A[11], d1), 10);                                         \
+    V b18 = ROL(XOR(A[17], d2), 15);                                         \
+    V b19 = ROL(XOR(A[23], d3), 56);                                         \
+    V b20 = ROL(XOR(A[2], d2), 62);                                          \
+    V b21 = ROL(XOR(A[8], d3), 55);                                          \
+    V b22 = ROL(XOR(A[14], d4), 39);                                         \
+    V b23 = ROL(XOR(A[15], d0), 41);                                         \
+    V b24 = ROL(XOR(A[21], d1), 2)
+
+
+/* One round of Keccak-f[1600] (theta, rho and pi, chi, iota). CHI(a, b, c)
+ * is a ^ (~b & c).
+ */
+#define KECCAK_ROUND(V, XOR, XOR5, CHI, ROL, IOTA, A, rc)                    \
+    do {                                                                     \
+        KECCAK_THETA_RHO_PI(V, XOR, XOR5, ROL, A);                           \
+        A[0] = CHI(b0, b1, b2);                                              \
+        A[1] = CHI(b1, b2, b3);                                              \
+        A[2] = CHI(b2, b3, b4);                                              \
+        A[3] = CHI(b3, b4, b0);                                              \
+        A[4] = CHI(b4, b0, b1);                                              \
+        A[5] = CHI(b5, b6, b7);                                              \
+        A[6] = CHI(b6, b7, b8);                                              \
+        A[7] = CHI(b7, b8, b9);                                              \
+        A[8] = CHI(b8, b9, b5);                                              \
+        A[9] = CHI(b9, b5, b6);                                              \
+        A[10] = CHI(b10, b11, b12);                                          \
+        A[11] = CHI(b11, b12, b13);                                          \
+        A[12] = CHI(b12, b13, b14);                                          \
+        A[13] = CHI(b13, b14, b10);                                          \
+        A[14] = CHI(b14, b10, b11);                                          \
+        A[15] = CHI(b15, b16, b17);                                          \
+        A[16] = CHI(b16, b17, b18);                                          \
+        A[17] = CHI(b17, b18, b19);                                          \
+        A[18] = CHI(b18, b19, b15);                                          \
+        A[19] = CHI(b19, b15, b16);                                          \
+        A[20] = CHI(b20, b21, b22);                                          \
+        A[21] = CHI(b21, b22, b23);                                          \
+        A[22] = CHI(b22, b23, b24);                                          \
+        A[23] = CHI(b23, b24, b20);                                          \
+        A[24] = CHI(b24, b20, b21);                                          \
+        A[0] = IOTA(A[0], rc);                                               \
+    } while (0)
+
+
+/* One scalar round on a lane-complemented state: lanes 1, 2, 8, 12, 17 and
+ * 20 are kept inverted, which turns chi into AND and OR of plain lanes with
+ * only 5 NOTs per round instead of 25, for CPUs without an and-not
+ * instruction.
+ */
+#define KECCAK_ROUND_COMPLEMENTED(A, rc)                                     \
+    do {                                                                     \
+        KECCAK_THETA_RHO_PI(uint64_t, XOR64, XOR5_64, rotl64, A);            \
+        A[0] = b0 ^ (b1 | b2);                                               \
+        A[1] = b1 ^ (~b2 | b3);                                              \
+        A[2] = b2 ^ (b3 & b4);                                               \
+        A[3] = b3 ^ (b4 | b0);                                               \
+        A[4] = b4 ^ (b0 & b1);                                               \
+        A[5] = b5 ^ (b6 | b7);                                               \
+        A[6] = b6 ^ (b7 & b8);                                               \
+        A[7] = b7 ^ (b8 | ~b9);                                              \
+        A[8] = b8 ^ (b9 | b5);                                               \
+        A[9] = b9 ^ (b5 & b6);                                               \
+        A[10] = b10 ^ (b11 | b12);                                           \
+        A[11] = b11 ^ (b12 & b13);                                           \
+        A[12] = b12 ^ (~b13 & b14);                                          \
+        A[13] = ~b13 ^ (b14 | b10);                                          \
+        A[14] = b14 ^ (b10 & b11);                                           \
+        A[15] = b15 ^ (b16 & b17);                                           \
+        A[16] = b16 ^ (b17 | b18);                                           \
+        A[17] = b17 ^ (~b18 | b19);                                          \
+        A[18] = ~b18 ^ (b19 & b15);                                          \
+        A[19] = b19 ^ (b15 | b16);                                           \
+        A[20] = b20 ^ (~b21 & b22);                                          \
+        A[21] = ~b21 ^ (b22 | b23);                                          \
+        A[22] = b22 ^ (b23 & b24);                                           \
+        A[23] = b23 ^ (b24 | b20);                                           \
+        A[24] = b24 ^ (b20 & b21);                                           \
+        A[0] ^= (rc);                                                        \
+    } while (0)
+
+
+// -------
+// helpers
+// -------
+
+static inline uint64_t load64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        p[i] = uint8_t(v >> (8 * i));
+    }
+}
+
+static inline uint64_t rotl64(uint64_t v, int n) {
+    return (v << n) | (v >> (64 - n));
+}
+
+
+// ---------
+// LaneInput
+// ---------
+/*
+ * @struct One input of a multi-buffer group: its whole blocks, read in
+ *		   place, followed by the padded final block.
+ */
+struct LaneInput {
+    const uint8_t* data;
+    size_t fullBlocks;
+    uint8_t last[Keccak::SHA3_256_RATE];
+};
+
+
+// -------------
+// loadLaneInput
+// -------------
+/**
+ * @brief Prepares an input for multi-buffer hashing.
+ *
+ * @param lane lane input to fill in
+ * @param input input bytes
+ * @param length number of bytes
+ *
+ * @return void
+ */
+static void loadLaneInput(LaneInput& lane, const uint8_t* input,
+    size_t length) {
+
+    lane.data = input;
+    lane.fullBlocks = length / Keccak::SHA3_256_RATE;
+
+    size_t tail = length % Keccak::SHA3_256_RATE;
+    std::memset(lane.last, 0, sizeof(lane.last));
+    if (tail > 0) {
+        std::memcpy(lane.last, input + length - tail, tail);
+    }
+    lane.last[tail] ^= Keccak::SHA3_SUFFIX;
+    lane.last[Keccak::SHA3_256_RATE - 1] ^= PAD_LAST;
+}
+
+
+// ---------
+// laneBlock
+// ---------
+/**
+ * @brief Returns block 'index' of a lane input, null past its end.
+ *
+ * @param lane lane input
+ * @param index block index
+ *
+ * @return block bytes or null
+ */
+static inline const uint8_t* laneBlock(const LaneInput& lane, size_t index) {
+    if (index < lane.fullBlocks) {
+        return lane.data + index * Keccak::SHA3_256_RATE;
+    }
+    return index == lane.fullBlocks ? lane.last : nullptr;
+}
+
+
+#ifdef SEIFNODE_SIMD
+
+// -----------------
+// sha3_256GroupAvx2
+// -----------------
+/**
+ * @brief Hashes up to 4 inputs side by side, one per 64-bit AVX2 lane.
+ *        Lanes whose input is exhausted keep permuting zeros, their digest
+ *        having been taken after their final block.
+ *
+ * @param lanes lane inputs
+ * @param count number of lane inputs, at most 4
+ * @param digests container for the digest of each lane input
+ *
+ * @return void
+ */
+SEIFNODE_TARGET("avx2")
+static void sha3_256GroupAvx2(const LaneInput* lanes, size_t count,
+    uint8_t* const* digests) {
+
+#define XOR256(a, b) _mm256_xor_si256(a, b)
+#define XOR5_256(a, b, c, d, e) XOR256(XOR256(XOR256(a, b), XOR256(c, d)), e)
+#define CHI256(a, b, c) _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+#define ROL256(a, n) \
+    _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+#define IOTA256(a, rc) _mm256_xor_si256(a, _mm256_set1_epi64x(int64_t(rc)))
+
+    __m256i state[25];
+    for (int i = 0; i < 25; ++i) {
+        state[i] = _mm256_setzero_si256();
+    }
+
+    size_t blocks = 0;
+    for (size_t j = 0; j < count; ++j) {
+        blocks = std::max(blocks, lanes[j].fullBlocks + 1);
+    }
+
+    for (size_t b = 0; b < blocks; ++b) {
+
+        const uint8_t* block[4] = {nullptr, nullptr, nullptr, nullptr};
+        for (size_t j = 0; j < count; ++j) {
+            block[j] = laneBlock(lanes[j], b);
+        }
+
+        for (size_t w = 0; w < RATE_LANES; ++w) {
+            uint64_t words[4];
+            for (int j = 0; j < 4; ++j) {
+                words[j] = block[j] ? load64(block[j] + 8 * w) : 0;
+            }
+            state[w] = XOR256(state[w], _mm256_set_epi64x(int64_t(words[3]),
+                int64_t(words[2]), int64_t(words[1]), int64_t(words[0])));
+        }
+
+        for (int round = 0; round < 24; ++round) {
+            KECCAK_ROUND(__m256i, XOR256, XOR5_256, CHI256, ROL256, IOTA256,
+                state, ROUND_CONSTANTS[round]);
+        }
+
+        for (size_t j = 0; j < count; ++j) {
+            if (b != lanes[j].fullBlocks) {
+                continue;
+            }
+            for (size_t w = 0; w < Keccak::SHA3_256_DIGEST_BYTES / 8; ++w) {
+                uint64_t words[4];
+                _mm256_storeu_si256((__m256i*)words, state[w]);
+                store64(digests[j] + 8 * w, words[j]);
+            }
+        }
+    }
+
+#undef XOR256
+#undef XOR5_256
+#undef CHI256
+#undef ROL256
+#undef IOTA256
+}
+
+
+// -------------------
+// sha3_256GroupAvx512
+// -------------------
+/**
+ * @brief Hashes up to 8 inputs side by side, one per 64-bit AVX-512
+ *        lane, using native rotates and three-input logic.
+ *
+ * @param lanes lane inputs
+ * @param count number of lane inputs, at most 8
+ * @param digests container for the digest of each lane input
+ *
+ * @return void
+ */
+SEIFNODE_TARGET("avx512f")
+static void sha3_256GroupAvx512(const LaneInput* lanes, size_t count,
+    uint8_t* const* digests) {
+
+#define XOR512(a, b) _mm512_xor_si512(a, b)
+#define XOR5_512(a, b, c, d, e) _mm512_ternarylogic_epi64( \
+    _mm512_ternarylogic_epi64(a, b, c, 0x96), d, e, 0x96)
+#define CHI512(a, b, c) _mm512_ternarylogic_epi64(a, b, c, 0xd2)
+/* The all-ones zero-masked form is the same instruction, but unlike
+ * _mm512_rol_epi64 it does not pass _mm512_undefined_epi32() through, which
+ * GCC 12 reports under -Wmaybe-uninitialized at -O3.
+ */
+#define ROL512(a, n) _mm512_maskz_rol_epi64(__mmask8(0xff), a, n)
+#define IOTA512(a, rc) _mm512_xor_si512(a, _mm512_set1_epi64(int64_t(rc)))
+
+    __m512i state[25];
+    for (int i = 0; i < 25; ++i) {
+        state[i] = _mm512_setzero_si512();
+    }
+
+    size_t blocks = 0;
+    for (size_t j = 0; j < count; ++j) {
+        blocks = std::max(blocks, lanes[j].fullBlocks + 1);
+    }
+
+    for (size_t b = 0; b < blocks; ++b) {
+
+        const uint8_t* block[8] = {};
+        for (size_t j = 0; j < count; ++j) {
+            block[j] = laneBlock(lanes[j], b);
+        }
+
+        for (size_t w = 0; w < RATE_LANES; ++w) {
+            uint64_t words[8];
+            for (int j = 0; j < 8; ++j) {
+                words[j] = block[j] ? load64(block[j] + 8 * w) : 0;
+            }
+            state[w] = XOR512(state[w], _mm512_loadu_si512(words));
+        }
+
+        for (int round = 0; round < 24; ++round) {
+            KECCAK_ROUND(__m512i, XOR512, XOR5_512, CHI512, ROL512, IOTA512,
+                state, ROUND_CONSTANTS[round]);
+        }
+
+        for (size_t j = 0; j < count; ++j) {
+            if (b != lanes[j].fullBlocks) {
+                continue;
+            }
+            for (size_t w = 0; w < Keccak::SHA3_256_DIGEST_BYTES / 8; ++w) {
+                uint64_t words[8];
+                _mm512_storeu_si512(words, state[w]);
+                store64(digests[j] + 8 * w, words[j]);
+            }
+        }
+    }
+
+#undef XOR512
+#undef XOR5_512
+#undef CHI512
+#undef ROL512
+#undef IOTA512
+}
+
+#endif
+
+
+// scalar lane operations for the round macros
+#define XOR64(a, b) ((a) ^ (b))
+#define XOR5_64(a, b, c, d, e) ((a) ^ (b) ^ (c) ^ (d) ^ (e))
+#define CHI64(a, b, c) ((a) ^ (~(b) & (c)))
+#define IOTA64(a, rc) ((a) ^ (rc))
+
+// lanes kept inverted by the lane-complemented permutation
+static const size_t COMPLEMENTED_LANES[] = {1, 2, 8, 12, 17, 20};
+
+
+// -------------------
+// permuteComplemented
+// -------------------
+/**
+ * @brief Keccak-f[1600] with lane complementing and two rounds per loop
+ *        iteration, the lanes held in registers throughout.
+ *
+ * @param state 25 lanes, lane (x, y) at index x + 5y
+ *
+ * @return void
+ */
+static void permuteComplemented(uint64_t* state) {
+
+    uint64_t a[25];
+    std::memcpy(a, state, sizeof(a));
+    for (size_t lane : COMPLEMENTED_LANES) {
+        a[lane] = ~a[lane];
+    }
+
+    for (int round = 0; round < 24; round += 2) {
+        KECCAK_ROUND_COMPLEMENTED(a, ROUND_CONSTANTS[round]);
+        KECCAK_ROUND_COMPLEMENTED(a, ROUND_CONSTANTS[round + 1]);
+    }
+
+    for (size_t lane : COMPLEMENTED_LANES) {
+        a[lane] = ~a[lane];
+    }
+    std::memcpy(state, a, sizeof(a));
+}
+
+
+#ifdef SEIFNODE_X86
+
+// -----------
+// permuteAndn
+// -----------
+/**
+ * @brief Keccak-f[1600] with two rounds per loop iteration, compiled for
+ *        BMI1 so that chi takes one ANDN per lane and no NOT at all.
+ *
+ * @param state 25 lanes, lane (x, y) at index x + 5y
+ *
+ * @return void
+ */
+SEIFNODE_TARGET("bmi")
+static void permuteAndn(uint64_t* state) {
+
+    uint64_t a[25];
+    std::memcpy(a, state, sizeof(a));
+
+    for (int round = 0; round < 24; round += 2) {
+        KECCAK_ROUND(uint64_t, XOR64, XOR5_64, CHI64, rotl64, IOTA64, a,
+            ROUND_CONSTANTS[round]);
+        KECCAK_ROUND(uint64_t, XOR64, XOR5_64, CHI64, rotl64, IOTA64, a,
+            ROUND_CONSTANTS[round + 1]);
+    }
+
+    std::memcpy(state, a, sizeof(a));
+}
+
+#endif
+
+
+// -------------
+// KeccakBackend
+// -------------
+/*
+ * @struct One implementation of Keccak-f[1600] and the CPU support it
+ *         needs.
+ */
+struct KeccakBackend {
+    const char* path;
+    void (*permute)(uint64_t* state);
+    bool (*supported)();
+};
+
+static bool alwaysSupported() {
+    return true;
+}
+
+#ifdef SEIFNODE_X86
+static bool bmiSupported() {
+    return cpuFeatures().bmi1;
+}
+#endif
+
+// implementations, fastest first
+static const KeccakBackend BACKENDS[] = {
+#ifdef SEIFNODE_X86
+    {"bmi", permuteAndn, bmiSupported},
+#endif
+    {"portable", permuteComplemented, alwaysSupported}
+};
+
+
+// -----------
+// bestBackend
+// -----------
+/**
+ * @brief Picks the fastest implementation the CPU supports.
+ *
+ * @return implementation
+ */
+static const KeccakBackend* bestBackend() {
+    for (const KeccakBackend& backend : BACKENDS) {
+        if (backend.supported()) {
+            return &backend;
+        }
+    }
+    return &BACKENDS[sizeof(BACKENDS) / sizeof(BACKENDS[0]) - 1];
+}
+
+// implementation used by every sponge, chosen when the module loads
+static const KeccakBackend* activeBackend = bestBackend();
+
+
+// -------
+// permute
+// -------
+/**
+ * @brief Applies the 24-round Keccak-f[1600] permutation with the
+ *        implementation picked for the CPU.
+ *
+ * @param state 25 lanes, lane (x, y) at index x + 5y
+ *
+ * @return void
+ */
+void Keccak::permute(uint64_t* state) {
+    activeBackend->permute(state);
+}
+
+
+// -----------
+// permutePath
+// -----------
+/**
+ * @brief Names the implementation taken by permute: 'bmi' or 'portable'.
+ *
+ * @return code path
+ */
+const char* Keccak::permutePath() {
+    return activeBackend->path;
+}
+
+
+// --------------
+// usePermutePath
+// --------------
+/**
+ * @brief Switches permute to the named implementation, for benchmarks and
+ *        cross-checks. Must not be called while anything is hashing.
+ *
+ * @param path 'bmi' or 'portable'
+ *
+ * @return false if the path is unknown or the CPU does not support it
+ */
+bool Keccak::usePermutePath(const char* path) {
+    for (const KeccakBackend& backend : BACKENDS) {
+        if (std::strcmp(backend.path, path) == 0 && backend.supported()) {
+            activeBackend = &backend;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// --------
+// sha3_256
+// --------
+/**
+ * @brief Computes the SHA3-256 hash of the input.
+ *
+ * @param input input bytes
+ * @param length number of bytes
+ * @param digest container for the SHA3_256_DIGEST_BYTES hash
+ *
+ * @return void
+ */
+void Keccak::sha3_256(const uint8_t* input, size_t length, uint8_t* digest) {
+
+    uint64_t state[25] = {};
+
+    // Whole blocks are absorbed in place, the padded tail from a copy.
+    for (; length >= SHA3_256_RATE; length -= SHA3_256_RATE) {
+        for (size_t w = 0; w < RATE_LANES; ++w) {
+            state[w] ^= load64(input + 8 * w);
+        }
+        permute(state);
+        input += SHA3_256_RATE;
+    }
+
+    uint8_t last[SHA3_256_RATE] = {};
+    if (length > 0) {
+        std::memcpy(last, input, length);
+    }
+    last[length] ^= Keccak::SHA3_SUFFIX;
+    last[SHA3_256_RATE - 1] ^= PAD_LAST;
+
+    for (size_t w = 0; w < RATE_LANES; ++w) {
+        state[w] ^= load64(last + 8 * w);
+    }
+    permute(state);
+
+    for (size_t w = 0; w < SHA3_256_DIGEST_BYTES / 8; ++w) {
+        store64(digest + 8 * w, state[w]);
+    }
+}
+
+
+// ------------
+// sha3_256Many
+// ------------
+/**
+ * @brief Computes the SHA3-256 hash of every input, several inputs per
+ *        permutation when the CPU has wide enough vectors.
+ *
+ * @param inputs input bytes of each hash
+ * @param lengths number of bytes of each input
+ * @param count number of inputs
+ * @param digests container for count * SHA3_256_DIGEST_BYTES bytes, hash
+ *        i at offset i * SHA3_256_DIGEST_BYTES
+ *
+ * @return void
+ */
+void Keccak::sha3_256Many(const uint8_t* const* inputs,
+    const size_t* lengths, size_t count, uint8_t* digests) {
+
+    size_t width = 1;
+#ifdef SEIFNODE_SIMD
+    const CpuFeatures& features = cpuFeatures();
+    width = features.avx512f ? 8 : features.avx2 ? 4 : 1;
+#endif
+
+    if (width == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            sha3_256(inputs[i], lengths[i],
+                digests + i * SHA3_256_DIGEST_BYTES);
+        }
+        return;
+    }
+
+#ifdef SEIFNODE_SIMD
+    /* Group inputs of the same number of blocks so that lanes rarely idle
+     * while the longest input of their group is absorbed.
+     */
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return lengths[a] / SHA3_256_RATE < lengths[b] / SHA3_256_RATE;
+    });
+
+    LaneInput lanes[8];
+    uint8_t* laneDigests[8];
+
+    for (size_t first = 0; first < count; first += width) {
+
+        size_t group = std::min(width, count - first);
+
+        // A lone input is cheaper on the scalar permutation.
+        if (group == 1) {
+            size_t i = order[first];
+            sha3_256(inputs[i], lengths[i],
+                digests + i * SHA3_256_DIGEST_BYTES);
+            break;
+        }
+
+        for (size_t j = 0; j < group; ++j) {
+            size_t i = order[first + j];
+            loadLaneInput(lanes[j], inputs[i], lengths[i]);
+            laneDigests[j] = digests + i * SHA3_256_DIGEST_BYTES;
+        }
+
+        if (width == 8) {
+            sha3_256GroupAvx512(lanes, group, laneDigests);
+        } else {
+            sha3_256GroupAvx2(lanes, group, laneDigests);
+        }
+    }
+#endif
+}
+
+
+// --------
+// manyPath
+// --------
+/**
+ * @brief Names the code path taken by sha3_256Many: 'avx512', 'avx2' or
+ *        'portable'.
+ *
+ * @return code path
+ */
+const char* Keccak::manyPath() {
+#ifdef SEIFNODE_SIMD
+    const CpuFeatures& features = cpuFeatures();
+    if (features.avx512f) {
+        return "avx512";
+    }
+    if (features.avx2) {
+        return "avx2";
+    }
+#endif
+    return "portable";
+}
+
+
+// -----------
+// rightEncode
+// -----------
+/**
+ * @brief Encodes an integer as its big-endian bytes followed by their
+ *        count (right_encode of SP 800-185).
+ *
+ * @param value integer to encode
+ * @param output container for up to 9 bytes
+ *
+ * @return number of bytes written
+ */
+size_t Keccak::rightEncode(uint64_t value, uint8_t* output) {
+
+    size_t n = 1;
+    while (n < 8 && (value >> (8 * n)) != 0) {
+        ++n;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        output[i] = uint8_t(value >> (8 * (n - 1 - i)));
+    }
+    output[n] = uint8_t(n);
+    return n + 1;
+}
+
+
+// ----------
+// leftEncode
+// ----------
+/**
+ * @brief Encodes an integer as its big-endian bytes preceded by their
+ *        count (left_encode of SP 800-185).
+ *
+ * @param value integer to encode
+ * @param output container for up to 9 bytes
+ *
+ * @return number of bytes written
+ */
+size_t Keccak::leftEncode(uint64_t value, uint8_t* output) {
+
+    size_t n = rightEncode(value, output + 1) - 1;
+    output[0] = uint8_t(n);
+    return n + 1;
+}
+
+
+
+// --------------
+// KeccakFunction
+// --------------
+
+// ----------
+// writeField
+// ----------
+/**
+ * @brief Appends an exported state field as 8 little-endian bytes.
+ *
+ * @param output exported state
+ * @param value field value
+ *
+ * @return void
+ */
+void KeccakFunction::writeField(std::vector<uint8_t>& output,
+    uint64_t value) {
+
+    uint8_t bytes[8];
+    store64(bytes, value);
+    output.insert(output.end(), bytes, bytes + 8);
+}
+
+
+// ---------
+// readField
+// ---------
+/**
+ * @brief Reads an exported state field.
+ *
+ * @param input cursor over the exported state, advanced past the field
+ * @param end end of the exported state
+ * @param limit largest value accepted
+ *
+ * @throw std::invalid_argument if the state is truncated or the value is
+ *        above the limit
+ *
+ * @return field value
+ */
+uint64_t KeccakFunction::readField(const uint8_t*& input, const uint8_t* end,
+    uint64_t limit) {
+
+    if (end - input < 8) {
+        throw std::invalid_argument("Hash state is truncated");
+    }
+
+    uint64_t value = load64(input);
+    input += 8;
+
+    if (value > limit) {
+        throw std::invalid_argument("Hash state is corrupt");
+    }
+    return value;
+}
+
+
+// -----------
+// expectField
+// -----------
+/**
+ * @brief Reads an exported state field that must equal this function's
+ *        own value, such as its kind or rate.
+ *
+ * @param input cursor over the exported state, advanced past the field
+ * @param end end of the exported state
+ * @param expected required value
+ *
+ * @throw std::invalid_argument if the state is truncated or the value
+ *        differs
+ *
+ * @return void
+ */
+void KeccakFunction::expectField(const uint8_t*& input, const uint8_t* end,
+    uint64_t expected) {
+
+    if (readField(input, end, UINT64_MAX) != expected) {
+        throw std::invalid_argument("Hash state was exported by another "
+            "algorithm");
+    }
+}
+
+
+
+// ------------
+// KeccakSponge
+// ------------
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Sets up an empty sponge.
+ *
+ * @param rate bytes per block, e.g. Keccak::SHA3_256_RATE
+ * @param suffix domain separation bits, e.g. Keccak::SHA3_SUFFIX
+ */
+KeccakSponge::KeccakSponge(size_t rate, uint8_t suffix) :
+    _rate(rate), _suffix(suffix), _position(0), _squeezing(false) {
+
+    std::memset(_initial, 0, sizeof(_initial));
+    std::memcpy(_state, _initial, sizeof(_state));
+}
+
+
+KeccakSponge::~KeccakSponge() {
+    secureWipe(_state, sizeof(_state));
+    secureWipe(_initial, sizeof(_initial));
+}
+
+
+// -----------
+// fingerprint
+// -----------
+/**
+ * @brief Hashes the state restart returns to, which holds the key and
+ *        customization absorbed by absorbPrefix, so an exported state can
+ *        be tied to the sponge it came from.
+ *
+ * @param digest container for the Keccak::SHA3_256_DIGEST_BYTES
+ *        fingerprint
+ *
+ * @return void
+ */
+void KeccakSponge::fingerprint(uint8_t* digest) const {
+
+    uint8_t lanes[sizeof(_initial)];
+    for (size_t i = 0; i < 25; ++i) {
+        store64(lanes + 8 * i, _initial[i]);
+    }
+
+    Keccak::sha3_256(lanes, sizeof(lanes), digest);
+    secureWipe(lanes, sizeof(lanes));
+}
+
+
+// -----------
+// absorbBytes
+// -----------
+/**
+ * @brief XORs bytes into the state, permuting after every full block,
+ *        without checking the squeezing flag.
+ *
+ * @param data input bytes
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void KeccakSponge::absorbBytes(const uint8_t* data, size_t length) {
+
+    while (length > 0) {
+
+        // Whole blocks go in a lane at a time.
+        if (_position == 0 && length >= _rate) {
+            for (size_t w = 0; w < _rate / 8; ++w) {
+                _state[w] ^= load64(data + 8 * w);
+            }
+            Keccak::permute(_state);
+            data += _rate;
+            length -= _rate;
+            continue;
+        }
+
+        size_t count = std::min(length, _rate - _position);
+        for (size_t i = 0; i < count; ++i, ++_position) {
+            _state[_position / 8] ^=
+                uint64_t(data[i]) << (8 * (_position % 8));
+        }
+        data += count;
+        length -= count;
+
+        if (_position == _rate) {
+            Keccak::permute(_state);
+            _position = 0;
+        }
+    }
+}
+
+
+// ------------
+// absorbPrefix
+// ------------
+/**
+ * @brief Absorbs data padded with zeros to a whole number of blocks and
+ *        makes the result the state restart returns to, as done for the
+ *        bytepad prefixes of SP 800-185 and the HMAC key blocks. Must be
+ *        called before any absorb.
+ *
+ * @param data prefix bytes
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void KeccakSponge::absorbPrefix(const uint8_t* data, size_t length) {
+
+    absorbBytes(data, length);
+
+    if (_position != 0) {
+        Keccak::permute(_state);
+        _position = 0;
+    }
+
+    std::memcpy(_initial, _state, sizeof(_initial));
+}
+
+
+// ---------
+// customize
+// ---------
+/**
+ * @brief Turns a SHAKE sponge into cSHAKE by absorbing the function name
+ *        and customization string as the padded prefix. With both empty
+ *        the sponge stays plain SHAKE, as SP 800-185 requires. Must be
+ *        called before any absorb.
+ *
+ * @param name function name bytes
+ * @param nameLength number of name bytes
+ * @param customization customization string bytes
+ * @param customizationLength number of customization bytes
+ *
+ * @return void
+ */
+void KeccakSponge::customize(const uint8_t* name, size_t nameLength,
+    const uint8_t* customization, size_t customizationLength) {
+
+    if (nameLength == 0 && customizationLength == 0) {
+        return;
+    }
+
+    // bytepad(encode_string(N) || encode_string(S), rate)
+    uint8_t encoded[9];
+    std::vector<uint8_t> prefix(encoded, encoded +
+        Keccak::leftEncode(_rate, encoded));
+
+    prefix.insert(prefix.end(), encoded, encoded +
+        Keccak::leftEncode(uint64_t(nameLength) * 8, encoded));
+    prefix.insert(prefix.end(), name, name + nameLength);
+
+    prefix.insert(prefix.end(), encoded, encoded +
+        Keccak::leftEncode(uint64_t(customizationLength) * 8, encoded));
+    prefix.insert(prefix.end(), customization,
+        customization + customizationLength);
+
+    absorbPrefix(prefix.data(), prefix.size());
+    _suffix = Keccak::CSHAKE_SUFFIX;
+}
+
+
+// -----
+// clone
+// -----
+/**
+ * @brief Copies the sponge in its current state.
+ *
+ * @return new heap-allocated copy owned by the caller
+ */
+KeccakFunction* KeccakSponge::clone() const {
+    return new KeccakSponge(*this);
+}
+
+
+// ------
+// absorb
+// ------
+/**
+ * @brief Absorbs message bytes.
+ *
+ * @param data message bytes
+ * @param length number of bytes
+ *
+ * @throw std::logic_error once output has been squeezed
+ *
+ * @return void
+ */
+void KeccakSponge::absorb(const uint8_t* data, size_t length) {
+
+    if (_squeezing) {
+        throw std::logic_error("Keccak sponge is already squeezing");
+    }
+    absorbBytes(data, length);
+}
+
+
+// -------
+// squeeze
+// -------
+/**
+ * @brief Pads the input on the first call, then reads the next output
+ *        bytes.
+ *
+ * @param output container for the output
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void KeccakSponge::squeeze(uint8_t* output, size_t length) {
+
+    if (!_squeezing) {
+        _state[_position / 8] ^= uint64_t(_suffix) << (8 * (_position % 8));
+        _state[(_rate - 1) / 8] ^=
+            uint64_t(PAD_LAST) << (8 * ((_rate - 1) % 8));
+        Keccak::permute(_state);
+        _position = 0;
+        _squeezing = true;
+    }
+
+    while (length > 0) {
+
+        if (_position == _rate) {
+            Keccak::permute(_state);
+            _position = 0;
+        }
+
+        // Whole blocks come out a lane at a time.
+        if (_position == 0 && length >= _rate) {
+            for (size_t w = 0; w < _rate / 8; ++w) {
+                store64(output + 8 * w, _state[w]);
+            }
+            output += _rate;
+            length -= _rate;
+            _position = _rate;
+            continue;
+        }
+
+        size_t count = std::min(length, _rate - _position);
+        for (size_t i = 0; i < count; ++i, ++_position) {
+            output[i] =
+                uint8_t(_state[_position / 8] >> (8 * (_position % 8)));
+        }
+        output += count;
+        length -= count;
+    }
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Does nothing: the input is padded by the first squeeze whatever
+ *        the output length.
+ *
+ * @param outputBits ignored
+ *
+ * @return void
+ */
+void KeccakSponge::finish(uint64_t outputBits) {
+    (void)outputBits;
+}
+
+
+// -------
+// restart
+// -------
+/**
+ * @brief Discards the input absorbed and the output read.
+ *
+ * @return void
+ */
+void KeccakSponge::restart() {
+    std::memcpy(_state, _initial, sizeof(_state));
+    _position = 0;
+    _squeezing = false;
+}
+
+
+// ---------
+// squeezing
+// ---------
+/**
+ * @brief Tells whether output has been read since the last restart.
+ *
+ * @return true once squeeze has been called
+ */
+bool KeccakSponge::squeezing() const {
+    return _squeezing;
+}
+
+
+// -----------
+// exportState
+// -----------
+/**
+ * @brief Appends the rate, suffix, fingerprint of the initial state,
+ *        position and the 25 lanes.
+ *
+ * @param output exported state
+ *
+ * @return void
+ */
+void KeccakSponge::exportState(std::vector<uint8_t>& output) const {
+
+    writeField(output, SPONGE_STATE_TAG);
+    writeField(output, _rate);
+    writeField(output, _suffix);
+
+    uint8_t digest[Keccak::SHA3_256_DIGEST_BYTES];
+    fingerprint(digest);
+    output.insert(output.end(), digest, digest + sizeof(digest));
+
+    writeField(output, _squeezing);
+    writeField(output, _position);
+
+    for (size_t i = 0; i < 25; ++i) {
+        writeField(output, _state[i]);
+    }
+}
+
+
+// -----------
+// importState
+// -----------
+/**
+ * @brief Reads back a state written by exportState from a sponge with the
+ *        same rate, suffix and initial state, so a KMAC or HMAC only takes
+ *        states exported under its own key.
+ *
+ * @param input cursor over the exported state
+ * @param end end of the exported state
+ *
+ * @throw std::invalid_argument if the state does not match
+ *
+ * @return void
+ */
+void KeccakSponge::importState(const uint8_t*& input, const uint8_t* end) {
+
+    expectField(input, end, SPONGE_STATE_TAG);
+    expectField(input, end, _rate);
+    expectField(input, end, _suffix);
+
+    // Compare the fingerprints in constant time, they derive from the key.
+    uint8_t digest[Keccak::SHA3_256_DIGEST_BYTES];
+    fingerprint(digest);
+    if (size_t(end - input) < sizeof(digest)) {
+        throw std::invalid_argument("Hash state is truncated");
+    }
+
+    uint8_t difference = 0;
+    for (size_t i = 0; i < sizeof(digest); ++i) {
+        difference |= digest[i] ^ input[i];
+    }
+    input += sizeof(digest);
+    if (difference != 0) {
+        throw std::invalid_argument("Hash state was exported under another "
+            "key or customization");
+    }
+
+    // Only a squeezing sponge defers the permutation of a full block.
+    bool squeezing = readField(input, end, 1) != 0;
+    size_t position = size_t(readField(input, end,
+        squeezing ? _rate : _rate - 1));
+
+    for (size_t i = 0; i < 25; ++i) {
+        _state[i] = readField(input, end, UINT64_MAX);
+    }
+    _squeezing = squeezing;
+    _position = position;
+}
+
+
+// ----
+// rate
+// ----
+/**
+ * @brief Returns the number of bytes per block.
+ *
+ * @return rate in bytes
+ */
+size_t KeccakSponge::rate() const {
+    return _rate;
+}
+
+
+// ------
+// suffix
+// ------
+/**
+ * @brief Returns the domain separation bits.
+ *
+ * @return suffix byte
+ */
+uint8_t KeccakSponge::suffix() const {
+    return _suffix;
+}
@@ -0,0 +1,651 @@
+/** @file keccak.h
+ *  @brief Definition of the Keccak-f[1600] permutation and the SHA3 and
+ *		   SHAKE functions built on it, including the multi-buffer SIMD
+ *		   SHA3-256 used to hash many small inputs at once
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef KECCAK_H
+#define KECCAK_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// ------
+// Keccak
+// ------
+
+/*
+ * @class Keccak-f[1600] and one-shot SHA3-256 (FIPS 202).
+ *
+ *		  permute runs an unrolled scalar permutation picked for the CPU
+ *		  when the module loads: with ANDN on x86 CPUs with BMI1, with
+ *		  lane complementing elsewhere. Every SHA3 in the module goes
+ *		  through it.
+ *
+ *		  sha3_256Many hashes independent inputs side by side, one per
+ *		  64-bit SIMD lane: 8 at a time with AVX-512, 4 with AVX2, and one
+ *		  by one with the scalar permutation otherwise, picked at runtime.
+ */
+class Keccak {
+
+	public:
+
+		// SHA3-256 rate and digest size
+		static const size_t SHA3_256_RATE = 136;
+		static const size_t SHA3_256_DIGEST_BYTES = 32;
+
+		// SHA3-512 rate and digest size
+		static const size_t SHA3_512_RATE = 72;
+		static const size_t SHA3_512_DIGEST_BYTES = 64;
+
+		// SHAKE128 and SHAKE256 (and cSHAKE) rates
+		static const size_t SHAKE128_RATE = 168;
+		static const size_t SHAKE256_RATE = 136;
+
+		// domain separation bits appended to the message before padding
+		static const uint8_t SHA3_SUFFIX = 0x06;
+		static const uint8_t SHAKE_SUFFIX = 0x1f;
+		static const uint8_t CSHAKE_SUFFIX = 0x04;
+
+
+		// -------
+		// permute
+		// -------
+		/**
+		 * @brief Applies the 24-round Keccak-f[1600] permutation.
+		 *
+		 * @param state 25 lanes, lane (x, y) at index x + 5y
+		 *
+		 * @return void
+		 */
+		static void permute(uint64_t* state);
+
+
+		// -----------
+		// permutePath
+		// -----------
+		/**
+		 * @brief Names the implementation taken by permute, picked for
+		 *		  the CPU when the module loads: 'bmi' (ANDN) or
+		 *		  'portable' (lane complementing).
+		 *
+		 * @return code path
+		 */
+		static const char* permutePath();
+
+
+		// --------------
+		// usePermutePath
+		// --------------
+		/**
+		 * @brief Switches permute to the named implementation, for
+		 *		  benchmarks and cross-checks. Must not be called while
+		 *		  anything is hashing.
+		 *
+		 * @param path 'bmi' or 'portable'
+		 *
+		 * @return false if the path is unknown or the CPU does not
+		 *		   support it
+		 */
+		static bool usePermutePath(const char* path);
+
+
+		// --------
+		// sha3_256
+		// --------
+		/**
+		 * @brief Computes the SHA3-256 hash of the input.
+		 *
+		 * @param input input bytes
+		 * @param length number of bytes
+		 * @param digest container for the SHA3_256_DIGEST_BYTES hash
+		 *
+		 * @return void
+		 */
+		static void sha3_256(const uint8_t* input, size_t length,
+			uint8_t* digest);
+
+
+		// ------------
+		// sha3_256Many
+		// ------------
+		/**
+		 * @brief Computes the SHA3-256 hash of every input, several inputs
+		 *		  per permutation when the CPU has wide enough vectors.
+		 *
+		 * @param inputs input bytes of each hash
+		 * @param lengths number of bytes of each input
+		 * @param count number of inputs
+		 * @param digests container for count * SHA3_256_DIGEST_BYTES
+		 *		  bytes, hash i at offset i * SHA3_256_DIGEST_BYTES
+		 *
+		 * @return void
+		 */
+		static void sha3_256Many(const uint8_t* const* inputs,
+			const size_t* lengths, size_t count, uint8_t* digests);
+
+
+		// --------
+		// manyPath
+		// --------
+		/**
+		 * @brief Names the code path taken by sha3_256Many: 'avx512',
+		 *		  'avx2' or 'portable'.
+		 *
+		 * @return code path
+		 */
+		static const char* manyPath();
+
+
+		// ----------
+		// leftEncode
+		// ----------
+		/**
+		 * @brief Encodes an integer as its big-endian bytes preceded by
+		 *		  their count (left_encode of SP 800-185).
+		 *
+		 * @param value integer to encode
+		 * @param output container for up to 9 bytes
+		 *
+		 * @return number of bytes written
+		 */
+		static size_t leftEncode(uint64_t value, uint8_t* output);
+
+
+		// -----------
+		// rightEncode
+		// -----------
+		/**
+		 * @brief Encodes an integer as its big-endian bytes followed by
+		 *		  their count (right_encode of SP 800-185).
+		 *
+		 * @param value integer to encode
+		 * @param output container for up to 9 bytes
+		 *
+		 * @return number of bytes written
+		 */
+		static size_t rightEncode(uint64_t value, uint8_t* output);
+};
+
+
+// --------------
+// KeccakFunction
+// --------------
+
+/*
+ * @class Interface of the incremental functions built on Keccak: the
+ *		  plain sponge, the tree hash and the MACs.
+ *
+ *		  Data is absorbed with any number of absorb calls. finish ends
+ *		  the input for functions that encode the output length in the
+ *		  result; output is then read with any number of squeeze calls,
+ *		  each continuing where the last one stopped (squeeze alone
+ *		  finishes as an extendable-output function). restart returns to
+ *		  the state right after construction, which may include a
+ *		  precomputed key or prefix, so a function can be cloned as a
+ *		  template.
+ *
+ *		  The running state can also be written out with exportState and
+ *		  read back with importState by a function of the same kind and
+ *		  parameters, e.g. to hash a common prefix once and keep it.
+ */
+class KeccakFunction {
+
+	protected:
+
+		// ----------
+		// writeField
+		// ----------
+		/**
+		 * @brief Appends an exported state field as 8 little-endian
+		 *		  bytes.
+		 *
+		 * @param output exported state
+		 * @param value field value
+		 *
+		 * @return void
+		 */
+		static void writeField(std::vector<uint8_t>& output, uint64_t value);
+
+
+		// ---------
+		// readField
+		// ---------
+		/**
+		 * @brief Reads an exported state field.
+		 *
+		 * @param input cursor over the exported state, advanced past the
+		 *		  field
+		 * @param end end of the exported state
+		 * @param limit largest value accepted
+		 *
+		 * @throw std::invalid_argument if the state is truncated or the
+		 *		  value is above the limit
+		 *
+		 * @return field value
+		 */
+		static uint64_t readField(const uint8_t*& input, const uint8_t* end,
+			uint64_t limit);
+
+
+		// -----------
+		// expectField
+		// -----------
+		/**
+		 * @brief Reads an exported state field that must equal this
+		 *		  function's own value, such as its kind or rate.
+		 *
+		 * @param input cursor over the exported state, advanced past the
+		 *		  field
+		 * @param end end of the exported state
+		 * @param expected required value
+		 *
+		 * @throw std::invalid_argument if the state is truncated or the
+		 *		  value differs
+		 *
+		 * @return void
+		 */
+		static void expectField(const uint8_t*& input, const uint8_t* end,
+			uint64_t expected);
+
+	public:
+
+		virtual ~KeccakFunction() {}
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Copies the function in its current state.
+		 *
+		 * @return new heap-allocated copy owned by the caller
+		 */
+		virtual KeccakFunction* clone() const = 0;
+
+
+		// ------
+		// absorb
+		// ------
+		/**
+		 * @brief Absorbs message bytes.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::logic_error once the input is finished
+		 *
+		 * @return void
+		 */
+		virtual void absorb(const uint8_t* data, size_t length) = 0;
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Ends the input with the given output length. Does
+		 *		  nothing once finished, or for functions whose result does
+		 *		  not depend on the output length.
+		 *
+		 * @param outputBits output length in bits, or 0 for unbounded
+		 *		  output
+		 *
+		 * @return void
+		 */
+		virtual void finish(uint64_t outputBits) = 0;
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Reads the next output bytes, finishing the input as an
+		 *		  extendable-output function first if needed.
+		 *
+		 * @param output container for the output
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		virtual void squeeze(uint8_t* output, size_t length) = 0;
+
+
+		// -------
+		// restart
+		// -------
+		/**
+		 * @brief Discards the input absorbed and the output read.
+		 *
+		 * @return void
+		 */
+		virtual void restart() = 0;
+
+
+		// ---------
+		// squeezing
+		// ---------
+		/**
+		 * @brief Tells whether the input has been finished since the last
+		 *		  restart.
+		 *
+		 * @return true once finish or squeeze has ended the input
+		 */
+		virtual bool squeezing() const = 0;
+
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Appends the running state: the input absorbed so far and
+		 *		  the output position. The bytes are as secret as any key
+		 *		  the function holds.
+		 *
+		 * @param output exported state
+		 *
+		 * @return void
+		 */
+		virtual void exportState(std::vector<uint8_t>& output) const = 0;
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Replaces the running state with one written by
+		 *		  exportState. The state restart returns to is kept. The
+		 *		  function is left unspecified if an exception is thrown.
+		 *
+		 * @param input cursor over the exported state, advanced past the
+		 *		  bytes read
+		 * @param end end of the exported state
+		 *
+		 * @throw std::invalid_argument if the state is malformed or was
+		 *		  exported by a function of another kind or parameters
+		 *
+		 * @return void
+		 */
+		virtual void importState(const uint8_t*& input,
+			const uint8_t* end) = 0;
+};
+
+
+// ------------
+// KeccakSponge
+// ------------
+
+/*
+ * @class Incremental Keccak sponge for the SHA3 hashes and the SHAKE and
+ *		  cSHAKE extendable-output functions (FIPS 202, SP 800-185).
+ *
+ *		  The first squeeze pads the input; finish does nothing as the
+ *		  output length is not part of the input. restart returns to the
+ *		  state right after construction and any prefix absorbed with
+ *		  absorbPrefix or customize.
+ */
+class KeccakSponge : public KeccakFunction {
+
+	private:
+
+		// current state and the state restart returns to
+		uint64_t _state[25];
+		uint64_t _initial[25];
+		// bytes per block and domain separation bits
+		size_t _rate;
+		uint8_t _suffix;
+		// byte offset in the block being absorbed or squeezed
+		size_t _position;
+		// true once the input is padded and output is being read
+		bool _squeezing;
+
+
+		// -----------
+		// absorbBytes
+		// -----------
+		/**
+		 * @brief XORs bytes into the state, permuting after every full
+		 *		  block, without checking the squeezing flag.
+		 *
+		 * @param data input bytes
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void absorbBytes(const uint8_t* data, size_t length);
+
+
+		// -----------
+		// fingerprint
+		// -----------
+		/**
+		 * @brief Hashes the state restart returns to, which holds the
+		 *		  key and customization absorbed by absorbPrefix, so an
+		 *		  exported state can be tied to the sponge it came from.
+		 *
+		 * @param digest container for the Keccak::SHA3_256_DIGEST_BYTES
+		 *		  fingerprint
+		 *
+		 * @return void
+		 */
+		void fingerprint(uint8_t* digest) const;
+
+	public:
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Sets up an empty sponge.
+		 *
+		 * @param rate bytes per block, e.g. Keccak::SHA3_256_RATE
+		 * @param suffix domain separation bits, e.g. Keccak::SHA3_SUFFIX
+		 */
+		KeccakSponge(size_t rate, uint8_t suffix);
+
+		~KeccakSponge();
+
+
+		// ------------
+		// absorbPrefix
+		// ------------
+		/**
+		 * @brief Absorbs data padded with zeros to a whole number of
+		 *		  blocks and makes the result the state restart returns
+		 *		  to, as done for the bytepad prefixes of SP 800-185 and
+		 *		  the HMAC key blocks. Must be called before any absorb.
+		 *
+		 * @param data prefix bytes
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void absorbPrefix(const uint8_t* data, size_t length);
+
+
+		// ---------
+		// customize
+		// ---------
+		/**
+		 * @brief Turns a SHAKE sponge into cSHAKE by absorbing the
+		 *		  function name and customization string as the padded
+		 *		  prefix. With both empty the sponge stays plain SHAKE, as
+		 *		  SP 800-185 requires. Must be called before any absorb.
+		 *
+		 * @param name function name bytes
+		 * @param nameLength number of name bytes
+		 * @param customization customization string bytes
+		 * @param customizationLength number of customization bytes
+		 *
+		 * @return void
+		 */
+		void customize(const uint8_t* name, size_t nameLength,
+			const uint8_t* customization, size_t customizationLength);
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Copies the sponge in its current state.
+		 *
+		 * @return new heap-allocated copy owned by the caller
+		 */
+		KeccakFunction* clone() const override;
+
+
+		// ------
+		// absorb
+		// ------
+		/**
+		 * @brief Absorbs message bytes.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::logic_error once output has been squeezed
+		 *
+		 * @return void
+		 */
+		void absorb(const uint8_t* data, size_t length) override;
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Pads the input on the first call, then reads the next
+		 *		  output bytes.
+		 *
+		 * @param output container for the output
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void squeeze(uint8_t* output, size_t length) override;
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Does nothing: the input is padded by the first squeeze
+		 *		  whatever the output length.
+		 *
+		 * @param outputBits ignored
+		 *
+		 * @return void
+		 */
+		void finish(uint64_t outputBits) override;
+
+
+		// -------
+		// restart
+		// -------
+		/**
+		 * @brief Discards the input absorbed and the output read.
+		 *
+		 * @return void
+		 */
+		void restart() override;
+
+
+		// ---------
+		// squeezing
+		// ---------
+		/**
+		 * @brief Tells whether output has been read since the last
+		 *		  restart.
+		 *
+		 * @return true once squeeze has been called
+		 */
+		bool squeezing() const override;
+
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Appends the rate, suffix, fingerprint of the initial
+		 *		  state, position and the 25 lanes.
+		 *
+		 * @param output exported state
+		 *
+		 * @return void
+		 */
+		void exportState(std::vector<uint8_t>& output) const override;
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Reads back a state written by exportState from a sponge
+		 *		  with the same rate, suffix and initial state, i.e. the same
+		 *		  key and customization.
+		 *
+		 * @param input cursor over the exported state
+		 * @param end end of the exported state
+		 *
+		 * @throw std::invalid_argument if the state does not match
+		 *
+		 * @return void
+		 */
+		void importState(const uint8_t*& input, const uint8_t* end) override;
+
+
+		// ----
+		// rate
+		// ----
+		/**
+		 * @brief Returns the number of bytes per block.
+		 *
+		 * @return rate in bytes
+		 */
+		size_t rate() const;
+
+
+		// ------
+		// suffix
+		// ------
+		/**
+		 * @brief Returns the domain separation bits.
+		 *
+		 * @return suffix byte
+		 */
+		uint8_t suffix() const;
+};
+
+
+#endif
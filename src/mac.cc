@@ -0,0 +1,441 @@
+/** @file mac.cc
+ *  @brief Definition of the class functions provided in mac.h
+ *
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// ----------------
+// library includes
+// ----------------
+#include "mac.h"
+#include "securewipe.h"
+
+
+// function name of the KMAC cSHAKE
+static const char FUNCTION_NAME[] = "KMAC";
+
+// HMAC inner and outer pad bytes
+static const uint8_t HMAC_IPAD = 0x36;
+static const uint8_t HMAC_OPAD = 0x5c;
+
+// first field of an exported KMAC or HMAC state
+static const uint64_t KMAC_STATE_TAG = 0x4b;
+static const uint64_t HMAC_STATE_TAG = 0x48;
+
+
+// ----
+// Kmac
+// ----
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Absorbs the key for the messages to come.
+ *
+ * @param rate Keccak::SHAKE128_RATE for KMAC128 or Keccak::SHAKE256_RATE
+ *        for KMAC256
+ * @param key key bytes
+ * @param keyLength number of key bytes
+ * @param customization customization string bytes
+ * @param customizationLength number of customization bytes
+ */
+Kmac::Kmac(size_t rate, const uint8_t* key, size_t keyLength,
+    const uint8_t* customization, size_t customizationLength) :
+    _sponge(rate, Keccak::SHAKE_SUFFIX), _finished(false) {
+
+    _sponge.customize((const uint8_t*)FUNCTION_NAME,
+        sizeof(FUNCTION_NAME) - 1, customization, customizationLength);
+
+    // bytepad(encode_string(key), rate)
+    uint8_t encoded[9];
+    std::vector<uint8_t> prefix(encoded, encoded +
+        Keccak::leftEncode(rate, encoded));
+
+    prefix.insert(prefix.end(), encoded, encoded +
+        Keccak::leftEncode(uint64_t(keyLength) * 8, encoded));
+    prefix.insert(prefix.end(), key, key + keyLength);
+
+    _sponge.absorbPrefix(prefix.data(), prefix.size());
+    secureWipe(prefix.data(), prefix.size());
+}
+
+
+Kmac::~Kmac() {}
+
+
+// -----
+// clone
+// -----
+/**
+ * @brief Copies the MAC in its current state.
+ *
+ * @return new heap-allocated copy owned by the caller
+ */
+KeccakFunction* Kmac::clone() const {
+    return new Kmac(*this);
+}
+
+
+// ------
+// absorb
+// ------
+/**
+ * @brief Absorbs message bytes.
+ *
+ * @param data message bytes
+ * @param length number of bytes
+ *
+ * @throw std::logic_error once finished
+ *
+ * @return void
+ */
+void Kmac::absorb(const uint8_t* data, size_t length) {
+
+    if (_finished) {
+        throw std::logic_error("KMAC is already finished");
+    }
+    _sponge.absorb(data, length);
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Absorbs the output length. Does nothing once finished.
+ *
+ * @param outputBits tag length in bits, or 0 for KMACXOF
+ *
+ * @return void
+ */
+void Kmac::finish(uint64_t outputBits) {
+
+    if (_finished) {
+        return;
+    }
+
+    uint8_t encoded[9];
+    _sponge.absorb(encoded, Keccak::rightEncode(outputBits, encoded));
+    _finished = true;
+}
+
+
+// -------
+// squeeze
+// -------
+/**
+ * @brief Reads the next tag bytes, finishing as KMACXOF if finish has not
+ *        been called.
+ *
+ * @param output container for the tag
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void Kmac::squeeze(uint8_t* output, size_t length) {
+    finish(0);
+    _sponge.squeeze(output, length);
+}
+
+
+// -------
+// restart
+// -------
+/**
+ * @brief Returns to the keyed state for a new message.
+ *
+ * @return void
+ */
+void Kmac::restart() {
+    _sponge.restart();
+    _finished = false;
+}
+
+
+// ---------
+// squeezing
+// ---------
+/**
+ * @brief Tells whether the message has been finished since the last
+ *        restart.
+ *
+ * @return true once finish or squeeze has been called
+ */
+bool Kmac::squeezing() const {
+    return _finished;
+}
+
+
+// -----------
+// exportState
+// -----------
+/**
+ * @brief Appends the finished flag and the keyed sponge.
+ *
+ * @param output exported state
+ *
+ * @return void
+ */
+void Kmac::exportState(std::vector<uint8_t>& output) const {
+
+    writeField(output, KMAC_STATE_TAG);
+    writeField(output, _finished);
+    _sponge.exportState(output);
+}
+
+
+// -----------
+// importState
+// -----------
+/**
+ * @brief Reads back a state written by exportState from a KMAC
+ *        with the same rate.
+ *
+ * @param input cursor over the exported state
+ * @param end end of the exported state
+ *
+ * @throw std::invalid_argument if the state does not match
+ *
+ * @return void
+ */
+void Kmac::importState(const uint8_t*& input, const uint8_t* end) {
+
+    expectField(input, end, KMAC_STATE_TAG);
+    _finished = readField(input, end, 1) != 0;
+    _sponge.importState(input, end);
+}
+
+
+
+// --------
+// HmacSha3
+// --------
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Absorbs the key blocks for the messages to come.
+ *
+ * @param rate Keccak::SHA3_256_RATE or Keccak::SHA3_512_RATE, also the
+ *        HMAC block size
+ * @param digestBytes digest size of the hash
+ * @param key key bytes, hashed first if longer than a block
+ * @param keyLength number of key bytes
+ */
+HmacSha3::HmacSha3(size_t rate, size_t digestBytes, const uint8_t* key,
+    size_t keyLength) :
+    _inner(rate, Keccak::SHA3_SUFFIX),
+    _outer(rate, Keccak::SHA3_SUFFIX),
+    _digestBytes(digestBytes),
+    _finished(false) {
+
+    // The key padded with zeros to a block, hashed first if too long.
+    std::vector<uint8_t> block(rate, 0);
+    if (keyLength > rate) {
+        KeccakSponge hash(rate, Keccak::SHA3_SUFFIX);
+        hash.absorb(key, keyLength);
+        hash.squeeze(block.data(), digestBytes);
+    } else if (keyLength > 0) {
+        std::memcpy(block.data(), key, keyLength);
+    }
+
+    for (size_t i = 0; i < rate; ++i) {
+        block[i] ^= HMAC_IPAD;
+    }
+    _inner.absorbPrefix(block.data(), rate);
+
+    for (size_t i = 0; i < rate; ++i) {
+        block[i] ^= HMAC_IPAD ^ HMAC_OPAD;
+    }
+    _outer.absorbPrefix(block.data(), rate);
+
+    secureWipe(block.data(), block.size());
+}
+
+
+HmacSha3::~HmacSha3() {}
+
+
+// -----
+// clone
+// -----
+/**
+ * @brief Copies the MAC in its current state.
+ *
+ * @return new heap-allocated copy owned by the caller
+ */
+KeccakFunction* HmacSha3::clone() const {
+    return new HmacSha3(*this);
+}
+
+
+// ------
+// absorb
+// ------
+/**
+ * @brief Absorbs message bytes into the inner hash.
+ *
+ * @param data message bytes
+ * @param length number of bytes
+ *
+ * @throw std::logic_error once finished
+ *
+ * @return void
+ */
+void HmacSha3::absorb(const uint8_t* data, size_t length) {
+
+    if (_finished) {
+        throw std::logic_error("HMAC is already finished");
+    }
+    _inner.absorb(data, length);
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Absorbs the inner hash into the outer one. Does nothing once
+ *        finished.
+ *
+ * @param outputBits ignored, the tag length is fixed
+ *
+ * @return void
+ */
+void HmacSha3::finish(uint64_t outputBits) {
+
+    (void)outputBits;
+    if (_finished) {
+        return;
+    }
+
+    uint8_t digest[Keccak::SHA3_512_DIGEST_BYTES];
+    _inner.squeeze(digest, _digestBytes);
+    _outer.absorb(digest, _digestBytes);
+    _finished = true;
+}
+
+
+// -------
+// squeeze
+// -------
+/**
+ * @brief Finishes if needed and reads the tag bytes.
+ *
+ * @param output container for the tag
+ * @param length number of bytes, at most the digest size
+ *
+ * @return void
+ */
+void HmacSha3::squeeze(uint8_t* output, size_t length) {
+    finish(0);
+    _outer.squeeze(output, length);
+}
+
+
+// -------
+// restart
+// -------
+/**
+ * @brief Returns to the keyed state for a new message.
+ *
+ * @return void
+ */
+void HmacSha3::restart() {
+    _inner.restart();
+    _outer.restart();
+    _finished = false;
+}
+
+
+// ---------
+// squeezing
+// ---------
+/**
+ * @brief Tells whether the message has been finished since the last
+ *        restart.
+ *
+ * @return true once finish or squeeze has been called
+ */
+bool HmacSha3::squeezing() const {
+    return _finished;
+}
+
+
+// -----------
+// exportState
+// -----------
+/**
+ * @brief Appends the finished flag and both keyed sponges.
+ *
+ * @param output exported state
+ *
+ * @return void
+ */
+void HmacSha3::exportState(std::vector<uint8_t>& output) const {
+
+    writeField(output, HMAC_STATE_TAG);
+    writeField(output, _digestBytes);
+    writeField(output, _finished);
+    _inner.exportState(output);
+    _outer.exportState(output);
+}
+
+
+// -----------
+// importState
+// -----------
+/**
+ * @brief Reads back a state written by exportState from an HMAC
+ *        with the same hash.
+ *
+ * @param input cursor over the exported state
+ * @param end end of the exported state
+ *
+ * @throw std::invalid_argument if the state does not match
+ *
+ * @return void
+ */
+void HmacSha3::importState(const uint8_t*& input, const uint8_t* end) {
+
+    expectField(input, end, HMAC_STATE_TAG);
+    expectField(input, end, _digestBytes);
+    _finished = readField(input, end, 1) != 0;
+    _inner.importState(input, end);
+    _outer.importState(input, end);
+}
@@ -0,0 +1,353 @@
+/** @file mac.h
+ *  @brief Definition of the keyed SHA3 functions, KMAC (SP 800-185) and
+ *		   HMAC-SHA3, with the key absorbed once into a reusable state
+ *
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MAC_H
+#define MAC_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
+
+
+// ----
+// Kmac
+// ----
+
+/*
+ * @class Incremental KMAC128/256 as specified in SP 800-185.
+ *
+ *		  The padded key is absorbed once at construction and kept as
+ *		  the state restart returns to, so each message only costs its
+ *		  own permutations. The output length is encoded in the tag:
+ *		  finish sets it before the tag is read, and squeeze without
+ *		  finish gives KMACXOF.
+ */
+class Kmac : public KeccakFunction {
+
+	private:
+
+		// cSHAKE("KMAC", customization) keyed with bytepad(key)
+		KeccakSponge _sponge;
+		// true once the output length is absorbed
+		bool _finished;
+
+	public:
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Absorbs the key for the messages to come.
+		 *
+		 * @param rate Keccak::SHAKE128_RATE for KMAC128 or
+		 *		  Keccak::SHAKE256_RATE for KMAC256
+		 * @param key key bytes
+		 * @param keyLength number of key bytes
+		 * @param customization customization string bytes
+		 * @param customizationLength number of customization bytes
+		 */
+		Kmac(size_t rate, const uint8_t* key, size_t keyLength,
+			const uint8_t* customization, size_t customizationLength);
+
+		~Kmac();
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Copies the MAC in its current state.
+		 *
+		 * @return new heap-allocated copy owned by the caller
+		 */
+		KeccakFunction* clone() const override;
+
+
+		// ------
+		// absorb
+		// ------
+		/**
+		 * @brief Absorbs message bytes.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::logic_error once finished
+		 *
+		 * @return void
+		 */
+		void absorb(const uint8_t* data, size_t length) override;
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Absorbs the output length. Does nothing once finished.
+		 *
+		 * @param outputBits tag length in bits, or 0 for KMACXOF
+		 *
+		 * @return void
+		 */
+		void finish(uint64_t outputBits) override;
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Reads the next tag bytes, finishing as KMACXOF if finish
+		 *		  has not been called.
+		 *
+		 * @param output container for the tag
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void squeeze(uint8_t* output, size_t length) override;
+
+
+		// -------
+		// restart
+		// -------
+		/**
+		 * @brief Returns to the keyed state for a new message.
+		 *
+		 * @return void
+		 */
+		void restart() override;
+
+
+		// ---------
+		// squeezing
+		// ---------
+		/**
+		 * @brief Tells whether the message has been finished since the
+		 *		  last restart.
+		 *
+		 * @return true once finish or squeeze has been called
+		 */
+		bool squeezing() const override;
+
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Appends the finished flag and the keyed sponge.
+		 *
+		 * @param output exported state
+		 *
+		 * @return void
+		 */
+		void exportState(std::vector<uint8_t>& output) const override;
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Reads back a state written by exportState from a KMAC
+		 *		  with the same rate.
+		 *
+		 * @param input cursor over the exported state
+		 * @param end end of the exported state
+		 *
+		 * @throw std::invalid_argument if the state does not match
+		 *
+		 * @return void
+		 */
+		void importState(const uint8_t*& input, const uint8_t* end) override;
+};
+
+
+// --------
+// HmacSha3
+// --------
+
+/*
+ * @class Incremental HMAC (RFC 2104) over SHA3-256 or SHA3-512.
+ *
+ *		  The inner and outer key blocks are absorbed once at
+ *		  construction and kept as the states restart returns to. The tag
+ *		  is as long as the digest of the hash.
+ */
+class HmacSha3 : public KeccakFunction {
+
+	private:
+
+		// SHA3 keyed with the key XOR ipad and with the key XOR opad
+		KeccakSponge _inner;
+		KeccakSponge _outer;
+		// digest size of the hash
+		size_t _digestBytes;
+		// true once the inner hash is absorbed by the outer one
+		bool _finished;
+
+	public:
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Absorbs the key blocks for the messages to come.
+		 *
+		 * @param rate Keccak::SHA3_256_RATE or Keccak::SHA3_512_RATE,
+		 *		  also the HMAC block size
+		 * @param digestBytes digest size of the hash
+		 * @param key key bytes, hashed first if longer than a block
+		 * @param keyLength number of key bytes
+		 */
+		HmacSha3(size_t rate, size_t digestBytes, const uint8_t* key,
+			size_t keyLength);
+
+		~HmacSha3();
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Copies the MAC in its current state.
+		 *
+		 * @return new heap-allocated copy owned by the caller
+		 */
+		KeccakFunction* clone() const override;
+
+
+		// ------
+		// absorb
+		// ------
+		/**
+		 * @brief Absorbs message bytes into the inner hash.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::logic_error once finished
+		 *
+		 * @return void
+		 */
+		void absorb(const uint8_t* data, size_t length) override;
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Absorbs the inner hash into the outer one. Does nothing
+		 *		  once finished.
+		 *
+		 * @param outputBits ignored, the tag length is fixed
+		 *
+		 * @return void
+		 */
+		void finish(uint64_t outputBits) override;
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Finishes if needed and reads the tag bytes.
+		 *
+		 * @param output container for the tag
+		 * @param length number of bytes, at most the digest size
+		 *
+		 * @return void
+		 */
+		void squeeze(uint8_t* output, size_t length) override;
+
+
+		// -------
+		// restart
+		// -------
+		/**
+		 * @brief Returns to the keyed state for a new message.
+		 *
+		 * @return void
+		 */
+		void restart() override;
+
+
+		// ---------
+		// squeezing
+		// ---------
+		/**
+		 * @brief Tells whether the message has been finished since the
+		 *		  last restart.
+		 *
+		 * @return true once finish or squeeze has been called
+		 */
+		bool squeezing() const override;
+
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Appends the finished flag and both keyed sponges.
+		 *
+		 * @param output exported state
+		 *
+		 * @return void
+		 */
+		void exportState(std::vector<uint8_t>& output) const override;
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Reads back a state written by exportState from an HMAC
+		 *		  with the same hash.
+		 *
+		 * @param input cursor over the exported state
+		 * @param end end of the exported state
+		 *
+		 * @throw std::invalid_argument if the state does not match
+		 *
+		 * @return void
+		 */
+		void importState(const uint8_t*& input, const uint8_t* end) override;
+};
+
+
+#endif
@@ -0,0 +1,184 @@
+/** @file parallel.h
+ *  @brief header/implementation file for the helper used by the node module
+ *		   to spread independent work items across the available cores
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_PARALLEL_H
+#define SEIFNODE_PARALLEL_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+// -------------
+// helperThreads
+// -------------
+/**
+ * @brief Returns the process-wide number of helper threads parallelFor may
+ *		  still start: one per core besides the caller. Calls running at
+ *		  the same time, e.g. on several libuv workers, share this budget
+ *		  instead of each starting a thread per core.
+ *
+ * @return budget shared by all translation units
+ */
+inline std::atomic<long>& helperThreads() {
+    static std::atomic<long> budget(long(std::max<unsigned>(1,
+        std::thread::hardware_concurrency())) - 1);
+    return budget;
+}
+
+
+// ------------------
+// claimHelperThreads
+// ------------------
+/**
+ * @brief Takes up to 'wanted' helper threads from the shared budget.
+ *
+ * @param wanted number of helper threads the caller could use
+ *
+ * @return number taken, to be given back once the threads are joined
+ */
+inline size_t claimHelperThreads(size_t wanted) {
+    std::atomic<long>& budget = helperThreads();
+    long available = budget.load();
+    long taken;
+    do {
+        taken = std::min(available, long(wanted));
+        if (taken <= 0) {
+            return 0;
+        }
+    } while (!budget.compare_exchange_weak(available, available - taken));
+    return size_t(taken);
+}
+
+
+// -----------
+// parallelFor
+// -----------
+/**
+ * @brief Splits the index range [0, count) into contiguous slices and runs
+ *		  'task' on each slice, one slice per hardware thread. The calling
+ *		  thread processes the first slice itself, so small ranges never pay
+ *		  for a thread start, and any slice no thread could be started for.
+ *		  Threads come out of the budget of helperThreads, so concurrent
+ *		  calls never run more threads than there are cores.
+ *
+ * @param count number of independent work items
+ * @param minPerThread minimum number of items worth handing to a thread
+ * @param task callable invoked as task(begin, end) for each slice
+ *
+ * @throw the first exception thrown by any slice, after all slices are done
+ *
+ * @return void
+ */
+template <typename Task>
+static void parallelFor(size_t count, size_t minPerThread, Task task) {
+
+    if (count == 0) {
+        return;
+    }
+
+    size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t threads = std::min(hardware,
+        std::max<size_t>(1, count / std::max<size_t>(1, minPerThread)));
+
+    // Only as many helpers as the other callers have left free.
+    size_t claimed = threads > 1 ? claimHelperThreads(threads - 1) : 0;
+    threads = claimed + 1;
+
+    // Given back on every way out, once the threads below are joined.
+    struct Claim {
+        size_t count;
+        ~Claim() {
+            helperThreads().fetch_add(long(count));
+        }
+    } claim = {claimed};
+
+    if (threads == 1) {
+        task(size_t(0), count);
+        return;
+    }
+
+    // Items per slice, rounded up so that 'threads' slices cover the range.
+    size_t perThread = (count + threads - 1) / threads;
+
+    std::vector<std::exception_ptr> errors(threads);
+    auto runSlice = [&task, &errors, count, perThread](size_t t) {
+        size_t begin = t * perThread;
+        size_t end = std::min(count, begin + perThread);
+        if (begin >= end) {
+            return;
+        }
+        try {
+            task(begin, end);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    /* Slices from 'inlineFrom' on run on the calling thread, i.e. those a
+     * thread could not be started for when the system is out of threads.
+     */
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    size_t inlineFrom = threads;
+
+    for (size_t t = 1; t < threads; ++t) {
+        try {
+            pool.emplace_back(runSlice, t);
+        } catch (const std::system_error&) {
+            inlineFrom = t;
+            break;
+        }
+    }
+
+    runSlice(0);
+    for (size_t t = inlineFrom; t < threads; ++t) {
+        runSlice(t);
+    }
+
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+
+#endif
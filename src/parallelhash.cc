@@ -0,0 +1,322 @@
+/** @file parallelhash.cc
+ *  @brief Definition of the class functions provided in parallelhash.h
+ *
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// ----------------
+// library includes
+// ----------------
+#include "parallelhash.h"
+#include "parallel.h"
+
+
+// leaf size used unless another one is chosen
+const size_t ParallelHash::DEFAULT_BLOCK_SIZE = 8192;
+
+// whole leaves hashed per batch, bounding the leaf hash buffer
+const size_t ParallelHash::LEAVES_PER_BATCH = 1024;
+
+// leaves worth handing to a thread
+const size_t ParallelHash::LEAVES_PER_THREAD = 16;
+
+// function name of the outer cSHAKE
+static const char FUNCTION_NAME[] = "ParallelHash";
+
+// first field of an exported ParallelHash state
+static const uint64_t STATE_TAG = 0x50;
+
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Sets up an empty ParallelHash.
+ *
+ * @param rate Keccak::SHAKE128_RATE for ParallelHash128 or
+ *        Keccak::SHAKE256_RATE for ParallelHash256
+ * @param blockSize leaf size in bytes, at least 1
+ * @param customization customization string bytes
+ * @param customizationLength number of customization bytes
+ */
+ParallelHash::ParallelHash(size_t rate, size_t blockSize,
+    const uint8_t* customization, size_t customizationLength) :
+    _outer(rate, Keccak::SHAKE_SUFFIX),
+    _leaf(rate, Keccak::SHAKE_SUFFIX),
+    _blockSize(blockSize),
+    // leaf hashes of twice the security strength: 256 or 512 bits
+    _leafDigestBytes(rate == Keccak::SHAKE128_RATE ? 32 : 64),
+    _leafFill(0),
+    _leafCount(0),
+    _finished(false) {
+
+    _outer.customize((const uint8_t*)FUNCTION_NAME,
+        sizeof(FUNCTION_NAME) - 1, customization, customizationLength);
+    restart();
+}
+
+
+ParallelHash::~ParallelHash() {}
+
+
+// -----
+// clone
+// -----
+/**
+ * @brief Copies the tree hash in its current state.
+ *
+ * @return new heap-allocated copy owned by the caller
+ */
+KeccakFunction* ParallelHash::clone() const {
+    return new ParallelHash(*this);
+}
+
+
+// --------
+// emitLeaf
+// --------
+/**
+ * @brief Absorbs the hash of the partial leaf into the outer sponge and
+ *        starts a new leaf.
+ *
+ * @return void
+ */
+void ParallelHash::emitLeaf() {
+
+    uint8_t digest[64];
+    _leaf.squeeze(digest, _leafDigestBytes);
+    _outer.absorb(digest, _leafDigestBytes);
+    _leaf.restart();
+
+    _leafFill = 0;
+    ++_leafCount;
+}
+
+
+// ------
+// absorb
+// ------
+/**
+ * @brief Absorbs message bytes, hashing the whole leaves they complete in
+ *        parallel.
+ *
+ * @param data message bytes
+ * @param length number of bytes
+ *
+ * @throw std::logic_error once output has been squeezed
+ *
+ * @return void
+ */
+void ParallelHash::absorb(const uint8_t* data, size_t length) {
+
+    if (_finished) {
+        throw std::logic_error("ParallelHash is already finished");
+    }
+
+    // Topping up the partial leaf first.
+    if (_leafFill > 0) {
+        size_t count = std::min(length, _blockSize - _leafFill);
+        _leaf.absorb(data, count);
+        _leafFill += count;
+        data += count;
+        length -= count;
+
+        if (_leafFill == _blockSize) {
+            emitLeaf();
+        }
+    }
+
+    // Whole leaves are independent: hash a batch of them side by side,
+    // then absorb their hashes in order.
+    std::vector<uint8_t> digests;
+
+    while (length >= _blockSize) {
+
+        size_t leaves = std::min(length / _blockSize, LEAVES_PER_BATCH);
+        digests.resize(leaves * _leafDigestBytes);
+
+        parallelFor(leaves, LEAVES_PER_THREAD, [&](size_t begin, size_t end) {
+            KeccakSponge leaf(_leaf);
+            for (size_t i = begin; i < end; ++i) {
+                leaf.restart();
+                leaf.absorb(data + i * _blockSize, _blockSize);
+                leaf.squeeze(&digests[i * _leafDigestBytes],
+                    _leafDigestBytes);
+            }
+        });
+
+        _outer.absorb(digests.data(), digests.size());
+        _leafCount += leaves;
+        data += leaves * _blockSize;
+        length -= leaves * _blockSize;
+    }
+
+    if (length > 0) {
+        _leaf.absorb(data, length);
+        _leafFill = length;
+    }
+}
+
+
+// ------
+// finish
+// ------
+/**
+ * @brief Hashes the last partial leaf and absorbs the leaf count and the
+ *        output length. Does nothing once finished.
+ *
+ * @param outputBits output length in bits, or 0 for ParallelHashXOF
+ *
+ * @return void
+ */
+void ParallelHash::finish(uint64_t outputBits) {
+
+    if (_finished) {
+        return;
+    }
+
+    if (_leafFill > 0) {
+        emitLeaf();
+    }
+
+    uint8_t encoded[9];
+    _outer.absorb(encoded, Keccak::rightEncode(_leafCount, encoded));
+    _outer.absorb(encoded, Keccak::rightEncode(outputBits, encoded));
+    _finished = true;
+}
+
+
+// -------
+// squeeze
+// -------
+/**
+ * @brief Reads the next output bytes, finishing as ParallelHashXOF if
+ *        finish has not been called.
+ *
+ * @param output container for the output
+ * @param length number of bytes
+ *
+ * @return void
+ */
+void ParallelHash::squeeze(uint8_t* output, size_t length) {
+    finish(0);
+    _outer.squeeze(output, length);
+}
+
+
+// -------
+// restart
+// -------
+/**
+ * @brief Discards the input absorbed and the output read.
+ *
+ * @return void
+ */
+void ParallelHash::restart() {
+
+    _outer.restart();
+    _leaf.restart();
+
+    uint8_t encoded[9];
+    _outer.absorb(encoded, Keccak::leftEncode(_blockSize, encoded));
+
+    _leafFill = 0;
+    _leafCount = 0;
+    _finished = false;
+}
+
+
+// ---------
+// squeezing
+// ---------
+/**
+ * @brief Tells whether the input has been finished since the last restart.
+ *
+ * @return true once finish or squeeze has been called
+ */
+bool ParallelHash::squeezing() const {
+    return _finished;
+}
+
+
+// -----------
+// exportState
+// -----------
+/**
+ * @brief Appends the block size, the leaf counters and both sponges.
+ *
+ * @param output exported state
+ *
+ * @return void
+ */
+void ParallelHash::exportState(std::vector<uint8_t>& output) const {
+
+    writeField(output, STATE_TAG);
+    writeField(output, _blockSize);
+    writeField(output, _finished);
+    writeField(output, _leafFill);
+    writeField(output, _leafCount);
+
+    _outer.exportState(output);
+    _leaf.exportState(output);
+}
+
+
+// -----------
+// importState
+// -----------
+/**
+ * @brief Reads back a state written by exportState from a
+ *        ParallelHash with the same rate and block size.
+ *
+ * @param input cursor over the exported state
+ * @param end end of the exported state
+ *
+ * @throw std::invalid_argument if the state does not match
+ *
+ * @return void
+ */
+void ParallelHash::importState(const uint8_t*& input, const uint8_t* end) {
+
+    expectField(input, end, STATE_TAG);
+    expectField(input, end, _blockSize);
+
+    _finished = readField(input, end, 1) != 0;
+    _leafFill = size_t(readField(input, end, _blockSize - 1));
+    _leafCount = readField(input, end, UINT64_MAX);
+
+    _outer.importState(input, end);
+    _leaf.importState(input, end);
+}
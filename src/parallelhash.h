@@ -0,0 +1,233 @@
+/** @file parallelhash.h
+ *  @brief Definition of the ParallelHash tree hash (SP 800-185), hashing
+ *		   the leaves of large inputs on all cores
+ *
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PARALLELHASH_H
+#define PARALLELHASH_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
+
+
+// ------------
+// ParallelHash
+// ------------
+
+/*
+ * @class Incremental ParallelHash128/256 as specified in SP 800-185.
+ *
+ *		  The input is cut into leaves of a fixed block size, each leaf is
+ *		  hashed with SHAKE on its own, and the leaf hashes are absorbed
+ *		  by an outer cSHAKE. Whole leaves of every absorb call are hashed
+ *		  concurrently, one slice of leaves per hardware thread.
+ *
+ *		  The output length is encoded in the hash: finish sets it before
+ *		  output is read, and squeeze without finish gives ParallelHashXOF.
+ */
+class ParallelHash : public KeccakFunction {
+
+	private:
+
+		// outer cSHAKE absorbing the block size and the leaf hashes
+		KeccakSponge _outer;
+		// SHAKE of the partial leaf being filled
+		KeccakSponge _leaf;
+		// leaf size in bytes and leaf hash size
+		size_t _blockSize;
+		size_t _leafDigestBytes;
+		// bytes in the partial leaf and leaves absorbed so far
+		size_t _leafFill;
+		uint64_t _leafCount;
+		// true once the leaf count and output length are absorbed
+		bool _finished;
+
+
+		// --------
+		// emitLeaf
+		// --------
+		/**
+		 * @brief Absorbs the hash of the partial leaf into the outer
+		 *		  sponge and starts a new leaf.
+		 *
+		 * @return void
+		 */
+		void emitLeaf();
+
+	public:
+
+		// leaf size used unless another one is chosen
+		static const size_t DEFAULT_BLOCK_SIZE;
+
+		// whole leaves hashed per batch, bounding the leaf hash buffer
+		static const size_t LEAVES_PER_BATCH;
+
+		// leaves worth handing to a thread
+		static const size_t LEAVES_PER_THREAD;
+
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Sets up an empty ParallelHash.
+		 *
+		 * @param rate Keccak::SHAKE128_RATE for ParallelHash128 or
+		 *		  Keccak::SHAKE256_RATE for ParallelHash256
+		 * @param blockSize leaf size in bytes, at least 1
+		 * @param customization customization string bytes
+		 * @param customizationLength number of customization bytes
+		 */
+		ParallelHash(size_t rate, size_t blockSize,
+			const uint8_t* customization, size_t customizationLength);
+
+		~ParallelHash();
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Copies the tree hash in its current state.
+		 *
+		 * @return new heap-allocated copy owned by the caller
+		 */
+		KeccakFunction* clone() const override;
+
+
+		// ------
+		// absorb
+		// ------
+		/**
+		 * @brief Absorbs message bytes, hashing the whole leaves they
+		 *		  complete in parallel.
+		 *
+		 * @param data message bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::logic_error once output has been squeezed
+		 *
+		 * @return void
+		 */
+		void absorb(const uint8_t* data, size_t length) override;
+
+
+		// ------
+		// finish
+		// ------
+		/**
+		 * @brief Hashes the last partial leaf and absorbs the leaf count
+		 *		  and the output length. Does nothing once finished.
+		 *
+		 * @param outputBits output length in bits, or 0 for
+		 *		  ParallelHashXOF
+		 *
+		 * @return void
+		 */
+		void finish(uint64_t outputBits) override;
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Reads the next output bytes, finishing as
+		 *		  ParallelHashXOF if finish has not been called.
+		 *
+		 * @param output container for the output
+		 * @param length number of bytes
+		 *
+		 * @return void
+		 */
+		void squeeze(uint8_t* output, size_t length) override;
+
+
+		// -------
+		// restart
+		// -------
+		/**
+		 * @brief Discards the input absorbed and the output read.
+		 *
+		 * @return void
+		 */
+		void restart() override;
+
+
+		// ---------
+		// squeezing
+		// ---------
+		/**
+		 * @brief Tells whether the input has been finished since the last
+		 *		  restart.
+		 *
+		 * @return true once finish or squeeze has been called
+		 */
+		bool squeezing() const override;
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Appends the block size, the leaf counters and both sponges.
+		 *
+		 * @param output exported state
+		 *
+		 * @return void
+		 */
+		void exportState(std::vector<uint8_t>& output) const override;
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Reads back a state written by exportState from a
+		 *		  ParallelHash with the same rate and block size.
+		 *
+		 * @param input cursor over the exported state
+		 * @param end end of the exported state
+		 *
+		 * @throw std::invalid_argument if the state does not match
+		 *
+		 * @return void
+		 */
+		void importState(const uint8_t*& input, const uint8_t* end) override;
+};
+
+
+#endif
@@ -0,0 +1,250 @@
+/** @file prefetchring.cc
+ *  @brief Definition of the class functions provided in prefetchring.h
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <cstring>
+
+// ----------------
+// library includes
+// ----------------
+#include "prefetchring.h"
+#include "scratchpool.h"
+#include "securewipe.h"
+
+
+const size_t PrefetchRing::REFILL_CHUNK_BYTES = 4096;
+
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Fills the ring up to the high watermark on the calling thread
+ *        and starts the background thread.
+ *
+ * @param capacity ring size in bytes, a power of two
+ * @param lowWatermark occupancy below which the ring is refilled
+ * @param highWatermark occupancy the ring is refilled to, at most
+ *        'capacity'
+ * @param generate function producing the random bytes
+ *
+ * @throw whatever 'generate' throws for the first fill, or
+ *        std::system_error if the thread cannot be started
+ */
+PrefetchRing::PrefetchRing(size_t capacity, size_t lowWatermark,
+    size_t highWatermark, const Generator& generate
+): _ring(nullptr),
+    _capacity(capacity),
+    _scratchCapacity(0),
+    _lowWatermark(lowWatermark),
+    _highWatermark(highWatermark),
+    _generate(generate),
+    _head(0),
+    _tail(0),
+    _served(0),
+    _servedBytes(0),
+    _stalls(0),
+    _refills(0),
+    _stop(false),
+    _sleeping(false),
+    _running(true) {
+
+    _ring = ScratchPool::acquire(_capacity, _scratchCapacity);
+
+    // A failure here, e.g. an RNG that is not seeded, goes to the caller.
+    try {
+        _generate(_ring, _highWatermark);
+    } catch (...) {
+        ScratchPool::release(_ring, _capacity, _scratchCapacity);
+        throw;
+    }
+    _head.store(_highWatermark);
+
+    // Without a thread the destructor never runs, so wipe the bytes here.
+    try {
+        _thread = std::thread(&PrefetchRing::run, this);
+    } catch (...) {
+        ScratchPool::release(_ring, _capacity, _scratchCapacity);
+        throw;
+    }
+}
+
+PrefetchRing::~PrefetchRing() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+
+    // Unserved random bytes are wiped along with the memory.
+    ScratchPool::release(_ring, _capacity, _scratchCapacity);
+}
+
+
+// ---------
+// occupancy
+// ---------
+/**
+ * @brief Returns the number of bytes ready to be served.
+ *
+ * @return number of bytes
+ */
+size_t PrefetchRing::occupancy() const {
+    return size_t(_head.load() - _tail.load());
+}
+
+
+// ---
+// run
+// ---
+/**
+ * @brief Body of the background thread, refilling the ring between the
+ *        watermarks until stopped.
+ *
+ * @return void
+ */
+void PrefetchRing::run() {
+
+    while (!_stop) {
+
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        size_t used = size_t(head - _tail.load(std::memory_order_acquire));
+
+        /* Full enough: sleep until a request drops the ring below the low
+         * watermark. '_sleeping' is set before the occupancy is checked
+         * again and take stores the read position before testing
+         * '_sleeping', so one of the two sides sees the other.
+         */
+        if (used >= _highWatermark) {
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleeping = true;
+            _wake.wait(lock, [this] {
+                return _stop || occupancy() < _lowWatermark;
+            });
+            _sleeping = false;
+            if (!_stop) {
+                ++_refills;
+            }
+            continue;
+        }
+
+        // Generate in place, never past the end of the ring memory.
+        size_t offset = size_t(head & (_capacity - 1));
+        size_t chunk = std::min(std::min(_capacity - used,
+            _capacity - offset), REFILL_CHUNK_BYTES);
+
+        try {
+            _generate(_ring + offset, chunk);
+        } catch (...) {
+            // Requests find the ring empty and generate inline instead.
+            break;
+        }
+
+        _head.store(head + chunk, std::memory_order_release);
+    }
+
+    _running = false;
+}
+
+
+// ----
+// take
+// ----
+/**
+ * @brief Copies random bytes out of the ring. To be called from one
+ *        thread only.
+ *
+ * @param output container for the random bytes
+ * @param length number of bytes
+ *
+ * @return false, counting a stall, if the ring holds fewer bytes
+ */
+bool PrefetchRing::take(uint8_t* output, size_t length) {
+
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    size_t available = size_t(_head.load(std::memory_order_acquire) - tail);
+
+    if (available < length) {
+        ++_stalls;
+        return false;
+    }
+
+    // Copy out, in two parts when wrapping, and wipe what was served.
+    size_t offset = size_t(tail & (_capacity - 1));
+    size_t first = std::min(length, _capacity - offset);
+
+    std::memcpy(output, _ring + offset, first);
+    secureWipe(_ring + offset, first);
+    std::memcpy(output + first, _ring, length - first);
+    secureWipe(_ring, length - first);
+
+    _tail.store(tail + length);
+
+    ++_served;
+    _servedBytes += length;
+
+    // Wake the thread when crossing the low watermark.
+    if (available - length < _lowWatermark && _sleeping) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _wake.notify_one();
+    }
+
+    return true;
+}
+
+
+// -----
+// stats
+// -----
+/**
+ * @brief Returns the occupancy and counters, from the consumer thread.
+ *
+ * @return statistics
+ */
+PrefetchRing::Stats PrefetchRing::stats() const {
+
+    Stats stats;
+    stats.capacity = _capacity;
+    stats.lowWatermark = _lowWatermark;
+    stats.highWatermark = _highWatermark;
+    stats.occupancy = occupancy();
+    stats.served = _served;
+    stats.servedBytes = _servedBytes;
+    stats.stalls = _stalls;
+    stats.refills = _refills;
+    stats.running = _running;
+
+    return stats;
+}
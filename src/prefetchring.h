@@ -0,0 +1,202 @@
+/** @file prefetchring.h
+ *  @brief Header for the ring buffer of random bytes generated ahead of
+ *		   time by a background thread for the RNG's small requests
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PREFETCHRING_H
+#define PREFETCHRING_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// ------------
+// PrefetchRing
+// ------------
+
+/*
+ * @class Ring buffer of random bytes kept topped up by a background thread.
+ *
+ *		  The thread refills the ring up to the high watermark and then
+ *		  sleeps. It is woken once a request brings the ring below the low
+ *		  watermark. Bytes are handed to a single consumer thread with a
+ *		  memcpy. No lock is taken on that path: the two threads only
+ *		  exchange the write and read positions. Served bytes are wiped
+ *		  from the ring.
+ */
+class PrefetchRing {
+
+	public:
+
+		// fills the given memory with random bytes, may throw
+		typedef std::function<void(uint8_t*, size_t)> Generator;
+
+		// -----
+		// Stats
+		// -----
+		/*
+		 * @struct Occupancy and counters reported by stats.
+		 */
+		struct Stats {
+			size_t capacity;
+			size_t lowWatermark;
+			size_t highWatermark;
+			// bytes ready to be served
+			size_t occupancy;
+			// requests served from the ring and their bytes
+			uint64_t served;
+			uint64_t servedBytes;
+			// requests that found too few bytes in the ring
+			uint64_t stalls;
+			// times the thread was woken to top the ring up
+			uint64_t refills;
+			// false once the thread stopped because generation failed
+			bool running;
+		};
+
+		// most bytes generated per step of the background thread
+		static const size_t REFILL_CHUNK_BYTES;
+
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Fills the ring up to the high watermark on the calling
+		 *		  thread and starts the background thread.
+		 *
+		 * @param capacity ring size in bytes, a power of two
+		 * @param lowWatermark occupancy below which the ring is refilled
+		 * @param highWatermark occupancy the ring is refilled to, at most
+		 *		  'capacity'
+		 * @param generate function producing the random bytes
+		 *
+		 * @throw whatever 'generate' throws for the first fill, or
+		 *		  std::system_error if the thread cannot be started
+		 */
+		PrefetchRing(size_t capacity, size_t lowWatermark,
+			size_t highWatermark, const Generator& generate);
+
+		// stops the background thread and wipes the ring
+		~PrefetchRing();
+
+
+		// ----
+		// take
+		// ----
+		/**
+		 * @brief Copies random bytes out of the ring. To be called from one
+		 *		  thread only.
+		 *
+		 * @param output container for the random bytes
+		 * @param length number of bytes
+		 *
+		 * @return false, counting a stall, if the ring holds fewer bytes
+		 */
+		bool take(uint8_t* output, size_t length);
+
+
+		// -----
+		// stats
+		// -----
+		/**
+		 * @brief Returns the occupancy and counters, from the consumer
+		 *		  thread.
+		 *
+		 * @return statistics
+		 */
+		Stats stats() const;
+
+	private:
+
+		// ring memory, from ScratchPool, and its size
+		uint8_t* _ring;
+		size_t _capacity;
+		size_t _scratchCapacity;
+		size_t _lowWatermark;
+		size_t _highWatermark;
+		Generator _generate;
+
+		/* bytes written by the thread and read by the consumer since the
+		 * start, on separate cache lines
+		 */
+		std::atomic<uint64_t> _head;
+		char _headPadding[64];
+		std::atomic<uint64_t> _tail;
+		char _tailPadding[64];
+
+		// consumer counters
+		uint64_t _served;
+		uint64_t _servedBytes;
+		uint64_t _stalls;
+		// thread counter
+		std::atomic<uint64_t> _refills;
+
+		// sleeping thread and its wake-up
+		std::atomic<bool> _stop;
+		std::atomic<bool> _sleeping;
+		std::atomic<bool> _running;
+		std::mutex _sleepMutex;
+		std::condition_variable _wake;
+		std::thread _thread;
+
+
+		// ---
+		// run
+		// ---
+		/**
+		 * @brief Body of the background thread, refilling the ring
+		 *		  between the watermarks until stopped.
+		 *
+		 * @return void
+		 */
+		void run();
+
+
+		// ---------
+		// occupancy
+		// ---------
+		/**
+		 * @brief Returns the number of bytes ready to be served.
+		 *
+		 * @return number of bytes
+		 */
+		size_t occupancy() const;
+};
+
+
+#endif
@@ -0,0 +1,219 @@
+/** @file records.h
+ *  @brief header/implementation file for the batch arguments and results
+ *		   shared by the functions processing many records in one call
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_RECORDS_H
+#define SEIFNODE_RECORDS_H
+
+// ----------------------
+// node.js addon includes
+// ----------------------
+#include <node.h>
+#include <node_buffer.h>
+#include <nan.h>
+
+// -----------------
+// standard includes
+// -----------------
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+// ------
+// Record
+// ------
+/*
+ * @struct One record of a batch, pointing into a node.js buffer.
+ */
+struct Record {
+	const uint8_t* data;
+	size_t length;
+};
+
+
+// --------------
+// fitsNodeBuffer
+// --------------
+/**
+ * @brief Checks that a result of the given size can be allocated with
+ *        Nan::NewBuffer, whose length parameter is a uint32 even on node.js
+ *        builds where node::Buffer::kMaxLength is larger.
+ *
+ * @param length number of bytes
+ *
+ * @return true if the buffer can be allocated without truncation
+ */
+static inline bool fitsNodeBuffer(uint64_t length) {
+    return length <= UINT32_MAX
+        && length <= uint64_t(node::Buffer::kMaxLength);
+}
+
+
+// ------------------
+// getRecordsArgument
+// ------------------
+/**
+ * @brief Unwraps the records of a batch given either as an array of
+ *        buffers or as a packed {data, offsets} object, where record i is
+ *        data[offsets[i], offsets[i + 1]), throwing a node.js error if
+ *        they are malformed.
+ *
+ * @param value node.js value expected to hold the records
+ * @param records resulting records
+ *
+ * @return true if the records could be unwrapped
+ */
+static bool getRecordsArgument(v8::Local<v8::Value> value,
+    std::vector<Record>& records) {
+
+    records.clear();
+
+    // An array of buffers, one per record.
+    if (value->IsArray()) {
+
+        v8::Local<v8::Array> array = value.As<v8::Array>();
+        records.reserve(array->Length());
+
+        for (uint32_t i = 0; i < array->Length(); ++i) {
+            v8::Local<v8::Value> element = Nan::Get(array, i).ToLocalChecked();
+            if (!node::Buffer::HasInstance(element)) {
+                Nan::ThrowError("Incorrect Arguments. Every record must be a "
+                                "buffer");
+                return false;
+            }
+
+            v8::Local<v8::Object> bufferObj =
+                Nan::To<v8::Object>(element).ToLocalChecked();
+            records.push_back(Record{
+                (const uint8_t *)node::Buffer::Data(bufferObj),
+                node::Buffer::Length(bufferObj)
+            });
+        }
+
+        return true;
+    }
+
+    // A packed buffer with an offset table.
+    if (!value->IsObject()) {
+        Nan::ThrowError("Incorrect Arguments. Please provide an array of "
+                        "buffers or a {data, offsets} object for 'records'");
+        return false;
+    }
+
+    v8::Local<v8::Object> packed = Nan::To<v8::Object>(value).ToLocalChecked();
+    v8::Local<v8::Value> data = Nan::Get(packed,
+        Nan::New("data").ToLocalChecked()).ToLocalChecked();
+    v8::Local<v8::Value> offsetsValue = Nan::Get(packed,
+        Nan::New("offsets").ToLocalChecked()).ToLocalChecked();
+
+    if (!node::Buffer::HasInstance(data)
+        || !(offsetsValue->IsArray() || offsetsValue->IsUint32Array())) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide an array of "
+                        "buffers or a {data, offsets} object for 'records'");
+        return false;
+    }
+
+    v8::Local<v8::Object> bufferObj = Nan::To<v8::Object>(data).ToLocalChecked();
+    const uint8_t* packedData = (const uint8_t *)node::Buffer::Data(bufferObj);
+    size_t packedLength = node::Buffer::Length(bufferObj);
+
+    std::vector<uint64_t> offsets;
+    if (offsetsValue->IsUint32Array()) {
+        Nan::TypedArrayContents<uint32_t> table(offsetsValue);
+        offsets.assign(*table, *table + table.length());
+    } else {
+        v8::Local<v8::Array> table = offsetsValue.As<v8::Array>();
+        offsets.resize(table->Length());
+        for (uint32_t i = 0; i < table->Length(); ++i) {
+            v8::Local<v8::Value> entry = Nan::Get(table, i).ToLocalChecked();
+            if (!entry->IsNumber() || Nan::To<int64_t>(entry).FromJust() < 0) {
+                Nan::ThrowError("Incorrect Arguments. Offsets must be "
+                                "non-negative numbers");
+                return false;
+            }
+            offsets[i] = Nan::To<int64_t>(entry).FromJust();
+        }
+    }
+
+    // Offsets must start at 0, never decrease and end inside the data.
+    if (offsets.empty() || offsets[0] != 0
+        || offsets.back() > packedLength
+        || !std::is_sorted(offsets.begin(), offsets.end())) {
+
+        Nan::ThrowError("Incorrect Arguments. Offsets must start at 0, be "
+                        "ascending and lie inside 'data'");
+        return false;
+    }
+
+    records.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        records.push_back(Record{
+            packedData + offsets[i], size_t(offsets[i + 1] - offsets[i])
+        });
+    }
+
+    return true;
+}
+
+
+// -------------
+// packedRecords
+// -------------
+/**
+ * @brief Creates the {data, offsets} object returned by the batch
+ *        functions, 'offsets' being a Uint32Array with one entry per
+ *        record plus the total length.
+ *
+ * @param data buffer holding all records back to back
+ * @param offsets record offsets into 'data'
+ *
+ * @return node.js object
+ */
+static v8::Local<v8::Object> packedRecords(v8::Local<v8::Object> data,
+    const std::vector<uint32_t>& offsets) {
+
+    v8::Local<v8::ArrayBuffer> tableBuffer = v8::ArrayBuffer::New(
+        v8::Isolate::GetCurrent(), offsets.size() * sizeof(uint32_t));
+    v8::Local<v8::Uint32Array> table =
+        v8::Uint32Array::New(tableBuffer, 0, offsets.size());
+
+    Nan::TypedArrayContents<uint32_t> tableData(table);
+    std::copy(offsets.begin(), offsets.end(), *tableData);
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("data").ToLocalChecked(), data);
+    Nan::Set(result, Nan::New("offsets").ToLocalChecked(), table);
+
+    return result;
+}
+
+
+#endif
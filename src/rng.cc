@@ -32,23 +32,19 @@
 // -----------------
 // standard includes
 // -----------------
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <exception>
 #include <mutex>
+#include <stdexcept>
 
 // ----------------------
 // node.js addon includes
 // ----------------------
 #include <node_buffer.h>
 
-// -----------------
-// cryptopp includes
-// -----------------
-#include <sha3.h>
-using CryptoPP::SHA3_256;
-
 // ----------------
 // library includes
 // ----------------
@@ -62,6 +58,56 @@ using CryptoPP::SHA3_256;
 // javascript object constructor
 Nan::Persistent<v8::Function> RNG::constructor;
 
+const size_t RNG::PREFETCH_DEFAULT_CAPACITY = 64 * 1024;
+const size_t RNG::PREFETCH_DEFAULT_MAX_REQUEST = 1024;
+
+// bounds of the prefetch ring capacity
+static const size_t PREFETCH_MIN_CAPACITY = 4 * 1024;
+static const size_t PREFETCH_MAX_CAPACITY = 16 * 1024 * 1024;
+
+// initializeAsync status codes, following those of IsaacRandomPool::STATUS
+static const int SEED_NOT_ENOUGH_ENTROPY = -3;
+static const int SEED_CANCELLED = -4;
+static const int SEED_ERROR = -5;
+
+
+RNG::RNG() :
+    _prefetchMaxRequest(0),
+    _seedState(SEED_UNKNOWN),
+    _cancelSeeding(false) {
+
+}
+
+
+// --------
+// stateKey
+// --------
+/**
+ * @brief Derives the key encrypting the RNG state on disk from the given
+ *        buffer: used as is from 32 bytes on, hashed with SHA3-256 to the
+ *        AES key size when shorter.
+ *
+ * @param data key buffer bytes
+ * @param length number of bytes
+ *
+ * @return key
+ */
+static std::vector<uint8_t> stateKey(const uint8_t* data, size_t length) {
+
+    std::vector<uint8_t> digest;
+    if (length < 32) {
+
+        digest.resize(Keccak::SHA3_256_DIGEST_BYTES);
+        hashBuffer(digest, data, int(length));
+
+    } else {
+
+        digest.assign(data, data + length);
+    }
+
+    return digest;
+}
+
 // -----------
 // Constructor
 // -----------
@@ -71,29 +117,46 @@ Nan::Persistent<v8::Function> RNG::constructor;
  *
  * @param initCallback callback to be invoked after async
  *        operation
- * @param prng isaac RNG object pointer
+ * @param obj RNG object owning the isaac RNG
  * @param fileId file identifier of RNG state on disk
  * @param digest key used to encrypt/decrypt RNG state on disk
+ * @param progressCallback callback invoked after every seeding attempt,
+ *        null to check for saved state instead
  */
 RNG::Worker::Worker(Nan::Callback* initCallback,
-    IsaacRandomPool* prng,
+    RNG* obj,
     const std::string& fileId,
-    const std::vector<uint8_t>& digest
-): Nan::AsyncWorker(initCallback),
-_prng(prng),
+    const std::vector<uint8_t>& digest,
+    Nan::Callback* progressCallback
+): Nan::AsyncProgressQueueWorker<SeedingProgress>(initCallback),
+_obj(obj),
+_prng(&obj->prng),
 _fileId(fileId),
 _digest(digest),
-_isLoaded(false) {
-
+_result(IsaacRandomPool::STATUS::SUCCESS),
+_code(0),
+_isLoaded(false),
+_isSeeding(progressCallback != nullptr),
+_progress(progressCallback),
+_start(std::chrono::steady_clock::now()) {
+
+    // Keep the object, and with it 'prng', alive until completion.
+    SaveToPersistent("object", obj->handle());
 }
 
 RNG::Worker::Worker(Nan::Callback* initCallback,
-    IsaacRandomPool* prng,
+    RNG* obj,
     bool isLoaded
-): Nan::AsyncWorker(initCallback),
-_prng(prng),
-_isLoaded(isLoaded) {
-
+): Nan::AsyncProgressQueueWorker<SeedingProgress>(initCallback),
+_obj(obj),
+_prng(&obj->prng),
+_result(IsaacRandomPool::STATUS::SUCCESS),
+_code(0),
+_isLoaded(isLoaded),
+_isSeeding(false),
+_start(std::chrono::steady_clock::now()) {
+
+    SaveToPersistent("object", obj->handle());
 }
 
 
@@ -106,8 +169,8 @@ _isLoaded(isLoaded) {
  *        loop, invoking the given callback with result of the
  *        async operation of checking saved RNG state.
  *
- * The keys are returned as the second argument to the callback
- * {enc: [publicKey], dec: [privateKey]}
+ * The status is returned as the first argument to the callback
+ * {code: [statusCode], message: [statusMessage]}
  *
  * @return void
  */
@@ -116,7 +179,7 @@ void RNG::Worker::HandleOKCallback () {
     v8::Local<v8::Object> status = Nan::New<v8::Object>();
     Nan::Set(status,
         Nan::New<v8::String>("code").ToLocalChecked(),
-        Nan::New<v8::Integer>((int)_result));
+        Nan::New<v8::Integer>(_code));
     Nan::Set(status,
         Nan::New<v8::String>("message").ToLocalChecked(),
         Nan::New<v8::String>("Success").ToLocalChecked());
@@ -149,7 +212,7 @@ void RNG::Worker::HandleErrorCallback () {
     v8::Local<v8::Object> error = Nan::New<v8::Object>();
     Nan::Set(error,
         Nan::New<v8::String>("code").ToLocalChecked(),
-        Nan::New<v8::Integer>((int)_result));
+        Nan::New<v8::Integer>(_code));
     Nan::Set(error,
         Nan::New<v8::String>("message").ToLocalChecked(),
         Nan::New<v8::String>(ErrorMessage()).ToLocalChecked());
@@ -162,27 +225,149 @@ void RNG::Worker::HandleErrorCallback () {
 
 
 
+// ----------------------
+// HandleProgressCallback
+// ----------------------
+/**
+ * @brief Executed inside the main event loop for the progress sent by
+ *        seed, invoking the progress callback once per attempt with
+ * {attempt, maxAttempts, multiplier, strength, elapsed, seeded}
+ *
+ * @param data progress of the attempts
+ * @param count number of attempts
+ *
+ * @return void
+ */
+void RNG::Worker::HandleProgressCallback(const SeedingProgress* data,
+    size_t count) {
+    Nan::HandleScope scope;
+
+    if (!_progress) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+
+        v8::Local<v8::Object> progress = Nan::New<v8::Object>();
+        Nan::Set(progress, Nan::New("attempt").ToLocalChecked(),
+            Nan::New<v8::Integer>(data[i].attempt));
+        Nan::Set(progress, Nan::New("maxAttempts").ToLocalChecked(),
+            Nan::New<v8::Integer>(MAX_ENTROPY_GEN_MULTIPLIER));
+        Nan::Set(progress, Nan::New("multiplier").ToLocalChecked(),
+            Nan::New<v8::Integer>(data[i].multiplier));
+        Nan::Set(progress, Nan::New("strength").ToLocalChecked(),
+            Nan::New(_strength).ToLocalChecked());
+        Nan::Set(progress, Nan::New("elapsed").ToLocalChecked(),
+            Nan::New<v8::Number>(data[i].elapsed));
+        Nan::Set(progress, Nan::New("seeded").ToLocalChecked(),
+            Nan::New(data[i].seeded));
+
+        v8::Local<v8::Value> argv[] = {progress};
+        _progress->Call(1, argv);
+    }
+}
+
+
+
+// ----
+// seed
+// ----
+/**
+ * @brief Seeds the RNG, retrying with more entropy until it succeeds,
+ *        fails for good or is cancelled.
+ *
+ * @param progress channel for the progress of every attempt
+ *
+ * @return void
+ */
+void RNG::Worker::seed(const ExecutionProgress& progress) {
+
+    // Read by initializeAsync before seeding started.
+    _strength = _obj->_entropyStrength;
+
+    /* Same retries as initialize, with more data collected each time for
+     * higher entropy, and a chance to cancel between attempts.
+     */
+    for (int multiplier = 0; multiplier < MAX_ENTROPY_GEN_MULTIPLIER;
+        ++multiplier) {
+
+        if (_obj->_cancelSeeding) {
+            _code = SEED_CANCELLED;
+            SetErrorMessage("Initialization cancelled");
+            _obj->_seedState = SEED_FAILED;
+            return;
+        }
+
+        /* Each attempt holds '_mutex' so that generation already running
+         * on another thread finishes first; later calls see
+         * SEED_IN_PROGRESS and throw.
+         */
+        bool seeded;
+        try {
+            std::lock_guard<std::mutex> lock(_obj->_mutex);
+            seeded = _prng->Initialize(_fileId, multiplier, _digest);
+        } catch (const std::exception& ex) {
+            // Hardware errors end the seeding.
+            _code = SEED_ERROR;
+            SetErrorMessage(ex.what());
+            _obj->_seedState = SEED_FAILED;
+            return;
+        }
+
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - _start;
+        SeedingProgress attempt = {multiplier + 1, multiplier,
+            elapsed.count(), seeded};
+        progress.Send(&attempt, 1);
+
+        if (seeded) {
+            _obj->_seedState = SEED_READY;
+            return;
+        }
+    }
+
+    _code = SEED_NOT_ENOUGH_ENTROPY;
+    SetErrorMessage("Not enough entropy!");
+    _obj->_seedState = SEED_FAILED;
+}
+
+
+
 // -------
 // Execute
 // -------
 /**
- * @brief Executed in a separate thread, asynchronously
- *        checking if RNG has saved state on the disk and
- *        communicating the status of the operation via the
- *        Worker class.
+ * @brief Executed in a separate thread, asynchronously checking if RNG
+ *        has saved state on the disk, saving it or seeding the RNG and
+ *        communicating the status of the operation via the Worker class.
+ *
+ * @param progress channel for the progress of seeding
  *
  * @return void
  */
-void RNG::Worker::Execute() {
-    // Check if the RNG has state on disk and is initialized in memory.
+void RNG::Worker::Execute(const ExecutionProgress& progress) {
 
-    if (_isLoaded == false) {
-        _result = _prng->IsInitialized(_fileId, _digest);
-    } else {
-        _result = _prng->SaveState();
+    if (_isSeeding) {
+        seed(progress);
+        return;
     }
 
+    // Check if the RNG has state on disk and is initialized in memory.
+    {
+        std::lock_guard<std::mutex> lock(_obj->_mutex);
+        if (_isLoaded == false) {
+            _result = _prng->IsInitialized(_fileId, _digest);
+        } else {
+            _result = _prng->SaveState();
+        }
+    }
+    _code = (int)_result;
+
     if (_result == IsaacRandomPool::STATUS::SUCCESS) {
+        // State loaded from disk seeds the RNG.
+        if (_isLoaded == false) {
+            _obj->_seedState = SEED_READY;
+        }
         return;
     }
 
@@ -200,6 +385,251 @@ void RNG::Worker::Execute() {
 
 
 
+// -----------
+// BytesWorker
+// -----------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param obj RNG object the call was made on
+ * @param length number of random bytes to generate
+ */
+RNG::BytesWorker::BytesWorker(Nan::Callback* callback,
+    RNG* obj,
+    size_t length
+): Nan::AsyncWorker(callback),
+    _obj(obj),
+    _output(nullptr),
+    _length(length) {
+
+    // Keep the object, and with it 'prng', alive until completion.
+    SaveToPersistent("object", obj->handle());
+}
+
+RNG::BytesWorker::~BytesWorker() {
+    free(_output);
+}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the
+ *        random bytes, handing their memory to node.js without copying
+ *        it.
+ *
+ * @return void
+ */
+void RNG::BytesWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Object> output =
+        Nan::NewBuffer(_output, _length).ToLocalChecked();
+    _output = nullptr;
+
+    v8::Local<v8::Value> argv[] = {status, output};
+
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void RNG::BytesWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, allocating the output and
+ *        filling it from 'prng'.
+ *
+ * @return void
+ */
+void RNG::BytesWorker::Execute() {
+
+    // At least one byte so that an empty request still gets memory to own.
+    _output = (char *)malloc(_length > 0 ? _length : 1);
+    if (_output == nullptr) {
+        SetErrorMessage("Unable to allocate the random bytes");
+        return;
+    }
+
+    try {
+
+        _obj->generate((uint8_t *)_output, _length);
+
+    } catch (const std::exception& ex) {
+
+        // Error thrown when invoked before RNG has been initialized.
+        SetErrorMessage(ex.what());
+    }
+}
+
+
+
+// --------
+// generate
+// --------
+/**
+ * @brief Fills memory with random bytes from 'prng', waiting for any
+ *        generation running on another thread.
+ *
+ * @param output container for the random bytes
+ * @param length number of bytes
+ *
+ * @throw std::exception when the RNG has not been initialized or is
+ *        being seeded
+ *
+ * @return void
+ */
+void RNG::generate(uint8_t* output, size_t length) {
+
+    /* Seeding holds '_mutex' for whole entropy gathering attempts, so
+     * refuse before waiting on it; the check is repeated under the lock
+     * for seeding started while waiting.
+     */
+    if (_seedState == SEED_IN_PROGRESS) {
+        throw std::runtime_error("RNG is being initialized");
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_seedState == SEED_IN_PROGRESS) {
+        throw std::runtime_error("RNG is being initialized");
+    }
+    if (_seedState == SEED_FAILED) {
+        throw std::runtime_error("RNG initialization failed or was "
+                                 "cancelled");
+    }
+
+    prng.GenerateBlock(output, length);
+}
+
+
+
+// ------------
+// checkSeeding
+// ------------
+/**
+ * @brief Throws a node.js error if initializeAsync is still seeding the
+ *        RNG, for the calls that would touch its state.
+ *
+ * @return true if the RNG is not being seeded
+ */
+bool RNG::checkSeeding() {
+
+    if (_seedState == SEED_IN_PROGRESS) {
+        Nan::ThrowError("RNG is being initialized");
+        return false;
+    }
+
+    return true;
+}
+
+
+
+// ----
+// draw
+// ----
+/**
+ * @brief Fills memory with random bytes for a call made on the main
+ *        thread, copying them from the prefetch ring when it is running
+ *        and holds enough of them.
+ *
+ * @param output container for the random bytes
+ * @param length number of bytes
+ *
+ * @throw std::exception when the RNG has not been initialized
+ *
+ * @return void
+ */
+void RNG::draw(uint8_t* output, size_t length) {
+
+    if (_prefetch && length <= _prefetchMaxRequest
+        && _prefetch->take(output, length)) {
+        return;
+    }
+
+    generate(output, length);
+}
+
+
+
+// -----------------
+// getPrefetchOption
+// -----------------
+/**
+ * @brief Reads a size option of startPrefetch, a non-negative integer,
+ *        throwing a node.js error otherwise.
+ *
+ * @param options options object
+ * @param key option name
+ * @param defaultValue value when the option is not given
+ * @param value resulting value
+ *
+ * @return true if the option could be read
+ */
+static bool getPrefetchOption(v8::Local<v8::Object> options, const char* key,
+    size_t defaultValue, size_t& value) {
+
+    v8::Local<v8::Value> option = Nan::Get(options,
+        Nan::New(key).ToLocalChecked()).ToLocalChecked();
+
+    value = defaultValue;
+    if (option->IsUndefined()) {
+        return true;
+    }
+
+    if (!option->IsUint32()) {
+        Nan::ThrowError((std::string("Incorrect Arguments. '") + key +
+            "' must be a non-negative integer").c_str());
+        return false;
+    }
+
+    value = Nan::To<uint32_t>(option).FromJust();
+    return true;
+}
+
+
+
 // ---
 // New
 // ---
@@ -272,6 +702,10 @@ NAN_METHOD(RNG::isInitialized) {
 
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
     // Check arguments.
     if (!node::Buffer::HasInstance(info[0])) {
 
@@ -303,26 +737,18 @@ NAN_METHOD(RNG::isInitialized) {
     /* If the size of key buffer is less than AES key size then hash the given
      * data to get key of the required size.
      */
-    std::vector<uint8_t> digest;
-    if (bufferLength < 32) {
+    std::vector<uint8_t> digest = stateKey(bufferData, bufferLength);
 
-        digest.resize(CryptoPP::SHA3_256::DIGESTSIZE);
-        std::string bufferString(reinterpret_cast<const char*>(bufferData),
-            reinterpret_cast<const char*>(bufferData) + bufferLength);
-        hashString(digest, bufferString);
-
-    } else {
-
-        digest.reserve(CryptoPP::SHA3_256::DIGESTSIZE);
-        std::copy(bufferData, bufferData + bufferLength,
-            std::back_inserter(digest));
-    }
+    /* State loaded from disk replaces 'prng', so the prefetch thread must
+     * not serve bytes generated from the old one.
+     */
+    obj->_prefetch.reset();
 
     // Unwrap the third argument to get given callback function.
     Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
 
     // Initialize the async worker and queue it.
-    Worker* worker = new Worker(callback, &obj->prng, fileId, digest);
+    Worker* worker = new Worker(callback, obj, fileId, digest);
 
     Nan::AsyncQueueWorker(worker);
 
@@ -345,11 +771,17 @@ NAN_METHOD(RNG::entropyStrength) {
     // Get a reference to the wrapped object from the argument.
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
-    std::string strength = obj->prng.EntropyStrength();
+    /* While seeding holds '_mutex', answer with the strength read when
+     * it started rather than waiting for the current attempt.
+     */
+    if (obj->_seedState != SEED_IN_PROGRESS) {
+        std::lock_guard<std::mutex> lock(obj->_mutex);
+        obj->_entropyStrength = obj->prng.EntropyStrength();
+    }
     // Return strength of underlying RNG used for key generation.
     info.GetReturnValue().Set(
         v8::String::NewFromUtf8(Nan::GetCurrentContext()->GetIsolate(),
-        strength.c_str())
+        obj->_entropyStrength.c_str())
     );
 }
 
@@ -374,6 +806,10 @@ NAN_METHOD(RNG::initialize) {
 
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
     // Check arguments
     if (!node::Buffer::HasInstance(info[0])) {
 
@@ -405,28 +841,21 @@ NAN_METHOD(RNG::initialize) {
     /* If the size of key buffer is less than AES key size then hash the given
      * data to get key of the required size.
      */
-    std::vector<uint8_t> digest;
-    if (bufferLength < 32) {
-
-        digest.resize(CryptoPP::SHA3_256::DIGESTSIZE);
-        std::string bufferString(reinterpret_cast<const char*>(bufferData),
-            reinterpret_cast<const char*>(bufferData) + bufferLength);
-        hashString(digest, bufferString);
-
-    } else {
-
-        digest.reserve(CryptoPP::SHA3_256::DIGESTSIZE);
-        std::copy(bufferData, bufferData + bufferLength,
-            std::back_inserter(digest));
-    }
+    std::vector<uint8_t> digest = stateKey(bufferData, bufferLength);
 
     /* Initialize the global Isaac rng object and check if
      * initialization succeeded. if it fails, increase the multiplier argument
      * which causes more data to be collected to get higher entropy.
      */
+    // The prefetch thread must not serve bytes from the state being replaced.
+    obj->_prefetch.reset();
+
     int multiplier = 0;
 
     try {
+        // Waits for generation running on the thread pool to finish.
+        std::lock_guard<std::mutex> lock(obj->_mutex);
+
         for (; multiplier < MAX_ENTROPY_GEN_MULTIPLIER; ++multiplier) {
 
             if (obj->prng.Initialize(fileId, multiplier, digest)) {
@@ -436,22 +865,130 @@ NAN_METHOD(RNG::initialize) {
     } catch (const std::exception& ex) {
 
         // If there is any hardware error, catch and throw the error to node.js
+        obj->_seedState = SEED_FAILED;
         Nan::ThrowError(ex.what());
         return;
     }
 
     // If initialization fails after max retries, throw an error to node.js.
     if (multiplier == MAX_ENTROPY_GEN_MULTIPLIER) {
+        obj->_seedState = SEED_FAILED;
         Nan::ThrowError("Not enough entropy!");
         return;
     }
 
+    obj->_seedState = SEED_READY;
     info.GetReturnValue().Set(Nan::True());
 
 }
 
 
 
+// ---------------
+// initializeAsync
+// ---------------
+/**
+ * @brief Unwraps the arguments to get the key and the file name for rng
+ *        state and seeds the RNG on the libuv thread pool, retrying with
+ *        more entropy like initialize. Until the callback reports success
+ *        the RNG refuses to generate.
+ *
+ * Invoked as:
+ * 'obj.initializeAsync(key, filename, function(progress){},
+ *  function(status){})' where
+ * 'key' is a buffer containing the disk encryption/decryption key
+ * 'filename' is the name of the RNG saved state file on disk
+ * 'progress' is of the form {attempt, maxAttempts, multiplier, strength,
+ *  elapsed: [milliseconds], seeded: [bool]}
+ * 'status' is of the form {code: [statusCode], message: [message]}
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::initializeAsync) {
+
+    v8::Local<v8::Context> context = Nan::GetCurrentContext();
+
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    // Check arguments.
+    if (!node::Buffer::HasInstance(info[0]) || !info[2]->IsFunction()
+        || !info[3]->IsFunction()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide a key buffer, "
+                        "a progress and a callback function -> 'function "
+                        "initializeAsync(key, filename, progress, callback)'");
+        return;
+    }
+
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
+    v8::Local<v8::Object> bufferObj =
+        Nan::To<v8::Object>(info[0]).ToLocalChecked();
+
+    uint8_t* bufferData = (uint8_t*)node::Buffer::Data(bufferObj);
+    size_t bufferLength = node::Buffer::Length(bufferObj);
+
+    std::string fileId = "./";
+    if (!info[1]->IsUndefined()) {
+
+        v8::String::Utf8Value str(context->GetIsolate(), info[1]->ToString(context));
+        fileId = *str;
+
+    }
+
+    std::vector<uint8_t> digest = stateKey(bufferData, bufferLength);
+
+    // The prefetch thread must not draw on the state being replaced.
+    obj->_prefetch.reset();
+
+    // Cached for the progress reports and entropyStrength while seeding.
+    {
+        std::lock_guard<std::mutex> lock(obj->_mutex);
+        obj->_entropyStrength = obj->prng.EntropyStrength();
+    }
+
+    obj->_cancelSeeding = false;
+    obj->_seedState = SEED_IN_PROGRESS;
+
+    Nan::Callback *progress = new Nan::Callback(info[2].As<v8::Function>());
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    Worker* worker = new Worker(callback, obj, fileId, digest, progress);
+
+    Nan::AsyncQueueWorker(worker);
+}
+
+
+
+// ----------------
+// cancelInitialize
+// ----------------
+/**
+ * @brief Makes a running initializeAsync stop before its next attempt and
+ *        call back with a cancellation error. The RNG stays unusable until
+ *        it is initialized again.
+ *
+ * Invoked as:
+ * 'obj.cancelInitialize()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::cancelInitialize) {
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    if (obj->_seedState == SEED_IN_PROGRESS) {
+        obj->_cancelSeeding = true;
+    }
+}
+
+
+
 // --------
 // getBytes
 // --------
@@ -473,19 +1010,23 @@ NAN_METHOD(RNG::getBytes) {
 
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
     // Unwrap the first argument to get the number of required random bytes.
     uint32_t val = 0;
     if (!info[0]->IsUndefined()) {
         val = info[0]->NumberValue();
     }
 
-    // Initialize 'output' vector containing the random bytes.
-    std::vector<uint8_t> output(val);
+    // Generate the random bytes straight into the node.js buffer returned.
+    v8::Local<v8::Object> output = Nan::NewBuffer(val).ToLocalChecked();
 
     // Invoke 'GenerateBlock' on the isaac RNG to get the required random bytes.
     try {
 
-        obj->prng.GenerateBlock(output.data(), val);
+        obj->draw((uint8_t *)node::Buffer::Data(output), val);
 
     } catch (const std::exception& ex) {
 
@@ -494,12 +1035,301 @@ NAN_METHOD(RNG::getBytes) {
         return;
     }
 
-    // Copy the random bytes into node.js buffer.
-    auto slowBuffer = Nan::CopyBuffer((const char*)output.data(),
-        val).ToLocalChecked();
-
     // Set node.js buffer as return value of the function.
-    info.GetReturnValue().Set(slowBuffer);
+    info.GetReturnValue().Set(output);
+}
+
+
+
+// ----
+// fill
+// ----
+/**
+ * @brief Unwraps the arguments to get a buffer or typed array and the
+ *        byte range to fill, and writes random output straight into its
+ *        memory without allocating.
+ *
+ * Invoked as:
+ * 'obj.fill(buffer, offset, length)' where
+ * 'buffer' is a node.js buffer, typed array or DataView, possibly over a
+ *  SharedArrayBuffer
+ * 'offset' (optional) is the first byte to fill, 0 by default
+ * 'length' (optional) is the number of bytes to fill, up to the end by
+ *  default
+ * The given 'buffer' is returned.
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::fill) {
+
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
+    // Checking arguments.
+    if (!info[0]->IsArrayBufferView()
+        || !(info[1]->IsUndefined() || info[1]->IsUint32())
+        || !(info[2]->IsUndefined() || info[2]->IsUint32())) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide a buffer or "
+                        "typed array and optionally a byte offset and length "
+                        "-> 'function fill(buffer, offset, length)'");
+        return;
+    }
+
+    // Byte view of the memory, whatever the element type.
+    Nan::TypedArrayContents<uint8_t> contents(info[0]);
+    uint8_t* data = *contents;
+    size_t size = contents.length();
+
+    size_t offset = 0;
+    if (!info[1]->IsUndefined()) {
+        offset = Nan::To<uint32_t>(info[1]).FromJust();
+    }
+
+    size_t length = offset <= size ? size - offset : 0;
+    if (!info[2]->IsUndefined()) {
+        length = Nan::To<uint32_t>(info[2]).FromJust();
+    }
+
+    if (offset > size || length > size - offset) {
+
+        Nan::ThrowError("Incorrect Arguments. 'offset' and 'length' must lie "
+                        "inside the buffer");
+        return;
+    }
+
+    try {
+
+        obj->draw(data + offset, length);
+
+    } catch (const std::exception& ex) {
+
+        // Error thrown when fill invoked before RNG has been initialized.
+        Nan::ThrowError(ex.what());
+        return;
+    }
+
+    info.GetReturnValue().Set(info[0]);
+}
+
+
+
+// -------------
+// startPrefetch
+// -------------
+/**
+ * @brief Starts serving getBytes and fill requests of at most
+ *        'maxRequest' bytes from a ring of random bytes, kept between the
+ *        watermarks by a background thread. Restarts the ring if it is
+ *        already running.
+ *
+ * Invoked as:
+ * 'obj.startPrefetch(options)' where 'options' (optional) is of the form
+ * {capacity: [ring bytes, a power of two, 64 KiB by default],
+ *  lowWatermark: [refill threshold, capacity / 4 by default],
+ *  highWatermark: [refill target, capacity by default],
+ *  maxRequest: [largest request served, 1 KiB by default]}
+ * PreCondition: the RNG has been initialized
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::startPrefetch) {
+
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
+    if (!info[0]->IsUndefined() && !info[0]->IsObject()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide an options "
+                        "object -> 'function startPrefetch(options)'");
+        return;
+    }
+
+    v8::Local<v8::Object> options = info[0]->IsObject()
+        ? Nan::To<v8::Object>(info[0]).ToLocalChecked()
+        : Nan::New<v8::Object>();
+
+    size_t capacity;
+    size_t lowWatermark;
+    size_t highWatermark;
+    size_t maxRequest;
+
+    if (!getPrefetchOption(options, "capacity", PREFETCH_DEFAULT_CAPACITY,
+            capacity)
+        || !getPrefetchOption(options, "lowWatermark", capacity / 4,
+            lowWatermark)
+        || !getPrefetchOption(options, "highWatermark", capacity,
+            highWatermark)
+        || !getPrefetchOption(options, "maxRequest",
+            PREFETCH_DEFAULT_MAX_REQUEST, maxRequest)) {
+        return;
+    }
+
+    if (capacity < PREFETCH_MIN_CAPACITY || capacity > PREFETCH_MAX_CAPACITY
+        || (capacity & (capacity - 1)) != 0) {
+
+        Nan::ThrowError("Incorrect Arguments. 'capacity' must be a power of "
+                        "two between 4 KiB and 16 MiB");
+        return;
+    }
+
+    if (lowWatermark >= highWatermark || highWatermark > capacity
+        || maxRequest > highWatermark) {
+
+        Nan::ThrowError("Incorrect Arguments. Watermarks must satisfy "
+                        "'lowWatermark' < 'highWatermark' <= 'capacity' and "
+                        "'maxRequest' <= 'highWatermark'");
+        return;
+    }
+
+    // Stop any running ring before its replacement draws on 'prng'.
+    obj->_prefetch.reset();
+
+    try {
+
+        obj->_prefetch.reset(new PrefetchRing(capacity, lowWatermark,
+            highWatermark, [obj](uint8_t* output, size_t length) {
+                obj->generate(output, length);
+            }));
+
+    } catch (const std::exception& ex) {
+
+        // Error thrown when invoked before RNG has been initialized.
+        Nan::ThrowError(ex.what());
+        return;
+    }
+
+    obj->_prefetchMaxRequest = maxRequest;
+}
+
+
+
+// ------------
+// stopPrefetch
+// ------------
+/**
+ * @brief Stops the background thread and wipes the ring. Requests are
+ *        generated inline again.
+ *
+ * Invoked as:
+ * 'obj.stopPrefetch()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::stopPrefetch) {
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    obj->_prefetch.reset();
+}
+
+
+
+// -------------
+// prefetchStats
+// -------------
+/**
+ * @brief Returns the ring occupancy and counters.
+ *
+ * Invoked as:
+ * 'let stats = obj.prefetchStats()' where 'stats' is of the form
+ * {enabled: [bool], running: [bool], capacity, lowWatermark,
+ *  highWatermark, occupancy: [bytes ready], served: [requests served from
+ *  the ring], servedBytes, stalls: [requests that found the ring short],
+ *  refills: [times the thread woke to refill]}
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::prefetchStats) {
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    PrefetchRing::Stats stats = PrefetchRing::Stats();
+    if (obj->_prefetch) {
+        stats = obj->_prefetch->stats();
+    }
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("enabled").ToLocalChecked(),
+        Nan::New(bool(obj->_prefetch)));
+    Nan::Set(result, Nan::New("running").ToLocalChecked(),
+        Nan::New(stats.running));
+
+    const struct {
+        const char* name;
+        double value;
+    } counters[] = {
+        {"capacity", double(stats.capacity)},
+        {"lowWatermark", double(stats.lowWatermark)},
+        {"highWatermark", double(stats.highWatermark)},
+        {"occupancy", double(stats.occupancy)},
+        {"served", double(stats.served)},
+        {"servedBytes", double(stats.servedBytes)},
+        {"stalls", double(stats.stalls)},
+        {"refills", double(stats.refills)}
+    };
+    for (const auto& counter : counters) {
+        Nan::Set(result, Nan::New(counter.name).ToLocalChecked(),
+            Nan::New<v8::Number>(counter.value));
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+
+
+// -------------
+// getBytesAsync
+// -------------
+/**
+ * @brief Unwraps the arguments to get the number of random bytes
+ *        required and generates them on the libuv thread pool.
+ *
+ * Invoked as:
+ * 'obj.getBytesAsync(numBytes, function(status, buffer){})' where
+ * 'numBytes' is the number of required random bytes
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'buffer' is a node.js buffer
+ *
+ * @param info node.js arguments wrapper containing number of random
+ *        bytes required and the callback function
+ *
+ * @return void
+ */
+NAN_METHOD(RNG::getBytesAsync) {
+
+    RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
+
+    // Checking arguments.
+    if (!info[0]->IsUint32()
+        || Nan::To<uint32_t>(info[0]).FromJust() > node::Buffer::kMaxLength
+        || !info[1]->IsFunction()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide the number of "
+                        "random bytes and a callback function -> 'function "
+                        "getBytesAsync(numBytes, callback)'");
+        return;
+    }
+
+    size_t length = Nan::To<uint32_t>(info[0]).FromJust();
+
+    Nan::Callback *callback = new Nan::Callback(info[1].As<v8::Function>());
+
+    BytesWorker* worker = new BytesWorker(callback, obj, length);
+
+    Nan::AsyncQueueWorker(worker);
 }
 
 
@@ -520,11 +1350,15 @@ NAN_METHOD(RNG::getBytes) {
 NAN_METHOD(RNG::saveState) {
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
     // Unwrap the first argument to get given callback function.
     Nan::Callback *callback = new Nan::Callback(info[0].As<v8::Function>());
 
     // Initialize the async worker and queue it.
-    Worker* worker = new Worker(callback, &obj->prng, true);
+    Worker* worker = new Worker(callback, obj, true);
 
     Nan::AsyncQueueWorker(worker);
 }
@@ -546,6 +1380,15 @@ NAN_METHOD(RNG::saveState) {
 NAN_METHOD(RNG::destroy) {
     RNG* obj = ObjectWrap::Unwrap<RNG>(info.Holder());
 
+    if (!obj->checkSeeding()) {
+        return;
+    }
+
+    // The prefetch thread must not outlive the RNG state.
+    obj->_prefetch.reset();
+
+    // Waits for generation running on the thread pool to finish.
+    std::lock_guard<std::mutex> lock(obj->_mutex);
     obj->prng.Destroy();
 }
 
@@ -575,9 +1418,16 @@ void RNG::Init(v8::Local<v8::Object> exports) {
 
     // Prototype
     Nan::SetPrototypeMethod(tpl, "getBytes", getBytes);
+    Nan::SetPrototypeMethod(tpl, "getBytesAsync", getBytesAsync);
+    Nan::SetPrototypeMethod(tpl, "fill", fill);
+    Nan::SetPrototypeMethod(tpl, "startPrefetch", startPrefetch);
+    Nan::SetPrototypeMethod(tpl, "stopPrefetch", stopPrefetch);
+    Nan::SetPrototypeMethod(tpl, "prefetchStats", prefetchStats);
     Nan::SetPrototypeMethod(tpl, "isInitialized", isInitialized);
     Nan::SetPrototypeMethod(tpl, "entropyStrength", entropyStrength);
     Nan::SetPrototypeMethod(tpl, "initialize", initialize);
+    Nan::SetPrototypeMethod(tpl, "initializeAsync", initializeAsync);
+    Nan::SetPrototypeMethod(tpl, "cancelInitialize", cancelInitialize);
     Nan::SetPrototypeMethod(tpl, "saveState", saveState);
     Nan::SetPrototypeMethod(tpl, "destroy", destroy);
 
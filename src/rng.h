@@ -34,6 +34,10 @@
 #ifndef RNG_H
 #define RNG_H
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -49,6 +53,8 @@
 // ----------------
 #include <isaacRandomPool.h>
 
+#include "prefetchring.h"
+
 
 // ---
 // RNG
@@ -61,7 +67,19 @@
  * 		  The functions exposed to node.js are:
  *		  function isInitialized(key, filename, callback)
  *		  function initialize(key, filename)
+ *		  function initializeAsync(key, filename, progress, callback) ->
+ *		  seeds the RNG on the libuv thread pool
+ *		  function cancelInitialize() -> stops initializeAsync after the
+ *		  current attempt
  *		  function getBytes(n) -> returns node.js buffer with 'n' random bytes
+ *		  function getBytesAsync(n, callback) -> generates 'n' random bytes on
+ *		  the libuv thread pool
+ *		  function fill(buffer, offset, length) -> writes random bytes into
+ *		  existing memory
+ *		  function startPrefetch(options) -> serves small requests from a
+ *		  ring topped up by a background thread
+ *		  function stopPrefetch() -> stops the background thread
+ *		  function prefetchStats() -> returns ring occupancy and counters
  *		  function destroy() -> save RNG state to disk and destroy the object
  */
 class RNG : public Nan::ObjectWrap {
@@ -74,20 +92,122 @@ class RNG : public Nan::ObjectWrap {
 		// isaac RNG object
 		IsaacRandomPool prng;
 
+		/* serializes every use of 'prng' (generation, seeding, loading,
+		 * saving and destroying it) between the main thread and the thread
+		 * pool
+		 */
+		std::mutex _mutex;
+
+		/* opt-in ring of bytes generated ahead of time, destroyed before
+		 * 'prng', and the largest request it serves
+		 */
+		std::unique_ptr<PrefetchRing> _prefetch;
+		size_t _prefetchMaxRequest;
+
+		/* seeding state checked by generate: bytes are only handed out
+		 * once a seeding started from javascript has fully succeeded
+		 */
+		enum SeedState {
+			SEED_UNKNOWN,
+			SEED_IN_PROGRESS,
+			SEED_FAILED,
+			SEED_READY
+		};
+		std::atomic<int> _seedState;
+		// set by cancelInitialize, checked between seeding attempts
+		std::atomic<bool> _cancelSeeding;
+		/* strength of the entropy sources, cached when seeding starts so
+		 * entropyStrength does not wait for it
+		 */
+		std::string _entropyStrength;
+
+		// default ring settings of startPrefetch
+		static const size_t PREFETCH_DEFAULT_CAPACITY;
+		static const size_t PREFETCH_DEFAULT_MAX_REQUEST;
+
+
+		// --------
+		// generate
+		// --------
+		/**
+		 * @brief Fills memory with random bytes from 'prng', waiting for any
+		 *		  generation running on another thread.
+		 *
+		 * @param output container for the random bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::exception when the RNG has not been initialized or is
+		 *		  being seeded
+		 *
+		 * @return void
+		 */
+		void generate(uint8_t* output, size_t length);
+
+
+		// ------------
+		// checkSeeding
+		// ------------
+		/**
+		 * @brief Throws a node.js error if initializeAsync is still seeding
+		 *		  the RNG, for the calls that would touch its state.
+		 *
+		 * @return true if the RNG is not being seeded
+		 */
+		bool checkSeeding();
+
+
+		// ----
+		// draw
+		// ----
+		/**
+		 * @brief Fills memory with random bytes for a call made on the main
+		 *		  thread, copying them from the prefetch ring when it is
+		 *		  running and holds enough of them.
+		 *
+		 * @param output container for the random bytes
+		 * @param length number of bytes
+		 *
+		 * @throw std::exception when the RNG has not been initialized
+		 *
+		 * @return void
+		 */
+		void draw(uint8_t* output, size_t length);
+
+		// ---------------
+		// SeedingProgress
+		// ---------------
+		/*
+		 * @struct Progress of initializeAsync, sent after every attempt.
+		 */
+		struct SeedingProgress {
+			// attempt just made, from 1 to MAX_ENTROPY_GEN_MULTIPLIER
+			int attempt;
+			// entropy gathering multiplier of the attempt
+			int multiplier;
+			// time since initializeAsync was called, in milliseconds
+			double elapsed;
+			// true if the attempt seeded the RNG
+			bool seeded;
+		};
+
 		// ------
 		// Worker
 		// ------
 		/*
 		 * @class This class represents the node.js async worker responsible for
-		 *		  checking if the RNG has saved state on the disk and invoke the
-		 *		  given callback function with the status of the operation and
+		 *		  checking if the RNG has saved state on the disk, saving it or
+		 *		  seeding the RNG with fresh entropy, and invoking the given
+		 *		  callback function with the status of the operation. Seeding
+		 *		  reports every attempt as progress.
 		 */
-		class Worker: public Nan::AsyncWorker {
+		class Worker: public Nan::AsyncProgressQueueWorker<SeedingProgress> {
 
 		    private:
 		    	// ----
 				// data
 				// ----
+				// RNG object owning the isaac RNG
+				RNG* _obj;
 				// pointer to isaac RNG object
 				IsaacRandomPool* _prng;
 				// file identifier of RNG state on disk
@@ -96,10 +216,34 @@ class RNG : public Nan::ObjectWrap {
 		        std::vector<uint8_t> _digest;
 		        // status of operation of checking if RNG state is saved on disk
 		        IsaacRandomPool::STATUS _result;
+		        // status code given to the callback
+		        int _code;
 		        /* boolean indicating whether the Worker is going to save or
 		         * load the RNG state
 		         */
 		        bool _isLoaded;
+		        // true when the Worker seeds the RNG with fresh entropy
+		        bool _isSeeding;
+		        // function invoked with every SeedingProgress
+		        std::unique_ptr<Nan::Callback> _progress;
+		        // strength of the entropy sources, read before seeding
+		        std::string _strength;
+		        // when the Worker was created
+		        std::chrono::steady_clock::time_point _start;
+
+
+		        // ----
+				// seed
+				// ----
+				/**
+		         * @brief Seeds the RNG, retrying with more entropy until it
+		         *		  succeeds, fails for good or is cancelled.
+		         *
+		         * @param progress channel for the progress of every attempt
+		         *
+		         * @return void
+		         */
+		        void seed(const ExecutionProgress& progress);
 
 		    public:
 		    	// -----------
@@ -111,18 +255,21 @@ class RNG : public Nan::ObjectWrap {
 				 *
 				 * @param initCallback callback to be invoked after async
 				 *		  operation
-				 * @param prng isaac RNG object pointer
+				 * @param obj RNG object owning the isaac RNG
 				 * @param fileId file identifier of RNG state on disk
 				 * @param digest key used to encrypt/decrypt RNG state on disk
+				 * @param progressCallback callback invoked after every seeding
+				 *		  attempt, null to check for saved state instead
 				 */
 		        Worker(Nan::Callback* initCallback,
-		        	IsaacRandomPool* prng,
+		        	RNG* obj,
 		        	const std::string& fileId,
-            		const std::vector<uint8_t>& digest
+            		const std::vector<uint8_t>& digest,
+            		Nan::Callback* progressCallback = nullptr
             	);
 
             	Worker(Nan::Callback* initCallback,
-				    IsaacRandomPool* prng,
+				    RNG* obj,
 				    bool isLoaded
 				);
 
@@ -136,8 +283,8 @@ class RNG : public Nan::ObjectWrap {
 		         * 		  loop, invoking the given callback with result of the
 		         *		  async operation of checking saved RNG state.
 		         *
-		         * The keys are returned as the second argument to the callback
-		         * {enc: [publicKey], dec: [privateKey]}
+		         * The status is returned as the first argument to the callback
+		         * {code: [statusCode], message: [statusMessage]}
 		         *
 		         * @return void
 		         */
@@ -161,14 +308,109 @@ class RNG : public Nan::ObjectWrap {
 		        void HandleErrorCallback();
 
 
+		        // ----------------------
+				// HandleProgressCallback
+				// ----------------------
+		        /**
+		         * @brief Executed inside the main event loop for the progress
+		         *		  sent by seed, invoking the progress callback once per
+		         *		  attempt with
+		         * {attempt, maxAttempts, multiplier, strength, elapsed, seeded}
+		         *
+		         * @param data progress of the attempts
+		         * @param count number of attempts
+		         *
+		         * @return void
+		         */
+		        void HandleProgressCallback(const SeedingProgress* data,
+		        	size_t count);
+
+
 		        // -------
 				// Execute
 				// -------
 				/**
 		         * @brief Executed in a separate thread, asynchronously
-		         *		  checking if RNG has saved state on the disk and
-		         *		  communicating the status of the operation via the
-		         *		  Worker class.
+		         *		  checking if RNG has saved state on the disk, saving it
+		         *		  or seeding the RNG and communicating the status of the
+		         *		  operation via the Worker class.
+		         *
+		         * @param progress channel for the progress of seeding
+		         *
+		         * @return void
+		         */
+		        void Execute(const ExecutionProgress& progress);
+		};
+
+
+		// -----------
+		// BytesWorker
+		// -----------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  generating random bytes on the libuv thread pool into memory
+		 *		  it owns, which becomes the callback's buffer without a copy.
+		 */
+		class BytesWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// object whose 'prng' generates the bytes
+				RNG* _obj;
+				// random bytes, handed over to node.js when done
+				char* _output;
+				size_t _length;
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param obj RNG object the call was made on
+				 * @param length number of random bytes to generate
+				 */
+		        BytesWorker(Nan::Callback* callback,
+		        	RNG* obj,
+		        	size_t length
+		        );
+
+		        ~BytesWorker();
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the random bytes, handing their memory to node.js
+		         *		  without copying it.
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status
+		         * {code: [statusCode], message: [errorMessage]}
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, allocating the output
+		         *		  and filling it from 'prng'.
 		         *
 		         * @return void
 		         */
@@ -249,6 +491,49 @@ class RNG : public Nan::ObjectWrap {
 		static NAN_METHOD(initialize);
 
 
+		// ---------------
+		// initializeAsync
+		// ---------------
+		/**
+		 * @brief Unwraps the arguments to get the key and the file name
+		 *        for rng state and seeds the RNG on the libuv thread pool,
+		 *        retrying with more entropy like initialize. Until the
+		 *        callback reports success the RNG refuses to generate.
+		 *
+		 * Invoked as:
+		 * 'obj.initializeAsync(key, filename, function(progress){},
+		 *	function(status){})' where
+		 * 'key' is a buffer containing the disk encryption/decryption key
+		 * 'filename' is the name of the RNG saved state file on disk
+		 * 'progress' is of the form {attempt, maxAttempts, multiplier,
+		 *	strength, elapsed: [milliseconds], seeded: [bool]}
+		 * 'status' is of the form {code: [statusCode], message: [message]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(initializeAsync);
+
+
+		// ----------------
+		// cancelInitialize
+		// ----------------
+		/**
+		 * @brief Makes a running initializeAsync stop before its next
+		 *        attempt and call back with a cancellation error. The RNG
+		 *        stays unusable until it is initialized again.
+		 *
+		 * Invoked as:
+		 * 'obj.cancelInitialize()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(cancelInitialize);
+
+
 		// --------
 		// getBytes
 		// --------
@@ -269,6 +554,112 @@ class RNG : public Nan::ObjectWrap {
 		static NAN_METHOD(getBytes);
 
 
+		// ----
+		// fill
+		// ----
+		/**
+		 * @brief Unwraps the arguments to get a buffer or typed array and
+		 *        the byte range to fill, and writes random output straight
+		 *        into its memory without allocating.
+		 *
+		 * Invoked as:
+		 * 'obj.fill(buffer, offset, length)' where
+		 * 'buffer' is a node.js buffer, typed array or DataView, possibly
+		 * 	over a SharedArrayBuffer
+		 * 'offset' (optional) is the first byte to fill, 0 by default
+		 * 'length' (optional) is the number of bytes to fill, up to the end
+		 * 	by default
+		 * The given 'buffer' is returned.
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(fill);
+
+
+		// -------------
+		// startPrefetch
+		// -------------
+		/**
+		 * @brief Starts serving getBytes and fill requests of at most
+		 *        'maxRequest' bytes from a ring of random bytes, kept
+		 *        between the watermarks by a background thread. Restarts
+		 *        the ring if it is already running.
+		 *
+		 * Invoked as:
+		 * 'obj.startPrefetch(options)' where 'options' (optional) is of the
+		 * form {capacity: [ring bytes, a power of two, 64 KiB by default],
+		 *	lowWatermark: [refill threshold, capacity / 4 by default],
+		 *	highWatermark: [refill target, capacity by default],
+		 *	maxRequest: [largest request served, 1 KiB by default]}
+		 * PreCondition: the RNG has been initialized
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(startPrefetch);
+
+
+		// ------------
+		// stopPrefetch
+		// ------------
+		/**
+		 * @brief Stops the background thread and wipes the ring. Requests
+		 *        are generated inline again.
+		 *
+		 * Invoked as:
+		 * 'obj.stopPrefetch()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(stopPrefetch);
+
+
+		// -------------
+		// prefetchStats
+		// -------------
+		/**
+		 * @brief Returns the ring occupancy and counters.
+		 *
+		 * Invoked as:
+		 * 'let stats = obj.prefetchStats()' where 'stats' is of the form
+		 * {enabled: [bool], running: [bool], capacity, lowWatermark,
+		 *	highWatermark, occupancy: [bytes ready], served: [requests
+		 *	served from the ring], servedBytes, stalls: [requests that found
+		 *	the ring short], refills: [times the thread woke to refill]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(prefetchStats);
+
+
+		// -------------
+		// getBytesAsync
+		// -------------
+		/**
+		 * @brief Unwraps the arguments to get the number of random bytes
+		 *        required and generates them on the libuv thread pool.
+		 *
+		 * Invoked as:
+		 * 'obj.getBytesAsync(numBytes, function(status, buffer){})' where
+		 * 'numBytes' is the number of required random bytes
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'buffer' is a node.js buffer
+		 *
+		 * @param info node.js arguments wrapper containing number of random
+		 *        bytes required and the callback function
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(getBytesAsync);
+
+
 		// ---------
 		// saveState
 		// ---------
@@ -301,6 +692,9 @@ class RNG : public Nan::ObjectWrap {
 
 	public:
 
+		RNG();
+
+
 		// ----
 		// Init
 		// ----
@@ -0,0 +1,393 @@
+/** @file scratchpool.cc
+ *  @brief Definition of the class functions provided in scratchpool.h
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+// ----------------------
+// node.js addon includes
+// ----------------------
+#include <node.h>
+#include <nan.h>
+
+// -----------------
+// standard includes
+// -----------------
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// ----------------
+// library includes
+// ----------------
+#include "scratchpool.h"
+#include "securewipe.h"
+
+
+const size_t ScratchPool::MIN_CLASS_BYTES = 64;
+const size_t ScratchPool::MAX_CLASS_BYTES = 1024 * 1024;
+
+const size_t ScratchPool::MAX_CACHED_PER_CLASS = 4;
+const size_t ScratchPool::MAX_CACHED_BYTES = 4 * 1024 * 1024;
+
+// size classes MIN_CLASS_BYTES << i for i < CLASS_COUNT (64 bytes to 1 MiB)
+static const size_t CLASS_COUNT = 15;
+
+
+// ----------
+// PoolCounts
+// ----------
+/*
+ * @struct Allocator statistics shared by all threads.
+ */
+struct PoolCounts {
+    std::atomic<uint64_t> acquired;
+    std::atomic<uint64_t> reused;
+    std::atomic<uint64_t> allocated;
+    std::atomic<uint64_t> released;
+    std::atomic<uint64_t> freed;
+    std::atomic<uint64_t> cachedBytes;
+};
+
+static PoolCounts counts;
+
+
+// -----------
+// ThreadCache
+// -----------
+/*
+ * @struct Free lists of one thread, freed when the thread exits.
+ */
+struct ThreadCache {
+
+    uint8_t* buffers[CLASS_COUNT][ScratchPool::MAX_CACHED_PER_CLASS];
+    size_t cached[CLASS_COUNT];
+    size_t bytes;
+
+    ThreadCache() : buffers(), cached(), bytes(0) {}
+
+    ~ThreadCache() {
+        for (size_t c = 0; c < CLASS_COUNT; ++c) {
+            for (size_t i = 0; i < cached[c]; ++i) {
+                free(buffers[c][i]);
+            }
+            counts.freed += cached[c];
+        }
+        counts.cachedBytes -= bytes;
+    }
+};
+
+static thread_local ThreadCache threadCache;
+
+
+// ---------
+// sizeClass
+// ---------
+/**
+ * @brief Finds the smallest size class holding the given number of bytes.
+ *
+ * @param length number of bytes, at most MAX_CLASS_BYTES
+ *
+ * @return size class index
+ */
+static size_t sizeClass(size_t length) {
+    size_t c = 0;
+    while ((ScratchPool::MIN_CLASS_BYTES << c) < length) {
+        ++c;
+    }
+    return c;
+}
+
+
+// -------
+// acquire
+// -------
+/**
+ * @brief Hands out a buffer of at least the given size, from the calling
+ *        thread's free list when possible.
+ *
+ * @param length number of bytes required
+ * @param capacity resulting size of the buffer, to be given back to
+ *        release
+ *
+ * @throw std::bad_alloc if the memory cannot be allocated
+ *
+ * @return buffer
+ */
+uint8_t* ScratchPool::acquire(size_t length, size_t& capacity) {
+
+    capacity = 0;
+    if (length == 0) {
+        return nullptr;
+    }
+
+    counts.acquired++;
+
+    // Oversized buffers go straight to malloc.
+    if (length > MAX_CLASS_BYTES) {
+        uint8_t* buffer = static_cast<uint8_t*>(malloc(length));
+        if (buffer == nullptr) {
+            throw std::bad_alloc();
+        }
+        counts.allocated++;
+        capacity = length;
+        return buffer;
+    }
+
+    size_t c = sizeClass(length);
+    capacity = MIN_CLASS_BYTES << c;
+
+    ThreadCache& cache = threadCache;
+    if (cache.cached[c] > 0) {
+        cache.bytes -= capacity;
+        counts.cachedBytes -= capacity;
+        counts.reused++;
+        return cache.buffers[c][--cache.cached[c]];
+    }
+
+    uint8_t* buffer = static_cast<uint8_t*>(malloc(capacity));
+    if (buffer == nullptr) {
+        throw std::bad_alloc();
+    }
+    counts.allocated++;
+    return buffer;
+}
+
+
+// -------
+// release
+// -------
+/**
+ * @brief Wipes the used part of a buffer and caches it on the calling
+ *        thread, or frees it when the cache is full.
+ *
+ * @param buffer buffer from acquire, may be null
+ * @param used number of bytes that may have been written
+ * @param capacity size of the buffer as returned by acquire
+ *
+ * @return void
+ */
+void ScratchPool::release(uint8_t* buffer, size_t used, size_t capacity) {
+
+    if (buffer == nullptr) {
+        return;
+    }
+
+    secureWipe(buffer, used);
+    counts.released++;
+
+    if (capacity <= MAX_CLASS_BYTES) {
+
+        size_t c = sizeClass(capacity);
+        ThreadCache& cache = threadCache;
+
+        if (cache.cached[c] < MAX_CACHED_PER_CLASS
+            && cache.bytes + capacity <= MAX_CACHED_BYTES) {
+
+            cache.buffers[c][cache.cached[c]++] = buffer;
+            cache.bytes += capacity;
+            counts.cachedBytes += capacity;
+            return;
+        }
+    }
+
+    free(buffer);
+    counts.freed++;
+}
+
+
+// ------------
+// scratchStats
+// ------------
+/**
+ * @brief Returns the allocator statistics, summed over all threads since
+ *        the module was loaded.
+ *
+ * Invoked as:
+ * 'let stats = scratchStats()' where 'stats' is of the form
+ * {acquired: [buffers handed out], reused: [of which from a free list],
+ *  allocated: [malloc calls], released: [buffers given back],
+ *  freed: [free calls], cachedBytes: [bytes held in free lists]}
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(ScratchPool::scratchStats) {
+
+    const struct {
+        const char* name;
+        uint64_t value;
+    } stats[] = {
+        {"acquired", counts.acquired},
+        {"reused", counts.reused},
+        {"allocated", counts.allocated},
+        {"released", counts.released},
+        {"freed", counts.freed},
+        {"cachedBytes", counts.cachedBytes}
+    };
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    for (const auto& stat : stats) {
+        Nan::Set(result, Nan::New(stat.name).ToLocalChecked(),
+            Nan::New<v8::Number>(double(stat.value)));
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+
+// ----
+// Init
+// ----
+/**
+ * @brief Initialization function for the scratchStats function exported
+ *        by the addon.
+ *
+ * @param exports node.js module exports
+ *
+ * @return void
+ */
+void ScratchPool::Init(v8::Local<v8::Object> exports) {
+
+    Nan::HandleScope scope;
+
+    // Setting node.js module.exports.
+    Nan::Set(exports, Nan::New("scratchStats").ToLocalChecked(),
+        Nan::GetFunction(Nan::New<v8::FunctionTemplate>(scratchStats))
+            .ToLocalChecked());
+}
+
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Takes a buffer of the given size from the pool.
+ *
+ * @param size number of bytes, may be 0
+ *
+ * @throw std::bad_alloc if the memory cannot be allocated
+ */
+ScratchBuffer::ScratchBuffer(size_t size) : _data(nullptr), _size(0),
+    _used(0), _capacity(0) {
+
+    reset(size);
+}
+
+ScratchBuffer::ScratchBuffer(ScratchBuffer&& other) : _data(other._data),
+    _size(other._size), _used(other._used), _capacity(other._capacity) {
+
+    other._data = nullptr;
+    other._size = other._used = other._capacity = 0;
+}
+
+ScratchBuffer& ScratchBuffer::operator=(ScratchBuffer&& other) {
+
+    if (this != &other) {
+        ScratchPool::release(_data, _used, _capacity);
+        _data = other._data;
+        _size = other._size;
+        _used = other._used;
+        _capacity = other._capacity;
+        other._data = nullptr;
+        other._size = other._used = other._capacity = 0;
+    }
+    return *this;
+}
+
+ScratchBuffer::~ScratchBuffer() {
+    ScratchPool::release(_data, _used, _capacity);
+}
+
+
+// -----
+// reset
+// -----
+/**
+ * @brief Gives the current buffer back and takes one of the given size.
+ *
+ * @param size number of bytes, may be 0
+ *
+ * @throw std::bad_alloc if the memory cannot be allocated
+ *
+ * @return void
+ */
+void ScratchBuffer::reset(size_t size) {
+
+    ScratchPool::release(_data, _used, _capacity);
+    _data = nullptr;
+    _size = _used = _capacity = 0;
+
+    _data = ScratchPool::acquire(size, _capacity);
+    _size = _used = size;
+}
+
+
+// --------
+// truncate
+// --------
+/**
+ * @brief Shrinks the buffer without giving any memory back; the bytes cut
+ *        off are still wiped on release.
+ *
+ * @param size new number of bytes, at most size()
+ *
+ * @return void
+ */
+void ScratchBuffer::truncate(size_t size) {
+    if (size < _size) {
+        _size = size;
+    }
+}
+
+
+// ----
+// data
+// ----
+/**
+ * @brief Returns the buffer bytes.
+ *
+ * @return buffer, null when the size is 0
+ */
+uint8_t* ScratchBuffer::data() const {
+    return _data;
+}
+
+
+// ----
+// size
+// ----
+/**
+ * @brief Returns the number of bytes in use.
+ *
+ * @return buffer size
+ */
+size_t ScratchBuffer::size() const {
+    return _size;
+}
@@ -0,0 +1,247 @@
+/** @file scratchpool.h
+ *  @brief Header for the per-thread pool of scratch buffers used by the
+ *		   native crypto calls instead of short-lived heap allocations
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SCRATCHPOOL_H
+#define SCRATCHPOOL_H
+
+// ----------------------
+// node.js addon includes
+// ----------------------
+#include <node.h>
+#include <nan.h>
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+
+
+// -----------
+// ScratchPool
+// -----------
+
+/*
+ * @class This class keeps, for every thread, a free list of scratch
+ *		  buffers per power-of-two size class so that steady-state calls
+ *		  reuse memory instead of going through malloc and free. Buffers
+ *		  are wiped when released, before being cached or freed.
+ *
+ *		  Buffers above MAX_CLASS_BYTES are not cached, and each thread
+ *		  caches at most MAX_CACHED_PER_CLASS buffers per class and
+ *		  MAX_CACHED_BYTES in total.
+ *
+ *		  The functions exposed to node.js are:
+ *		  function scratchStats() -> returns {acquired, reused, allocated,
+ *		  	released, freed, cachedBytes}
+ */
+class ScratchPool {
+
+	private:
+
+		// ------------
+		// scratchStats
+		// ------------
+		/**
+		 * @brief Returns the allocator statistics, summed over all
+		 *		  threads since the module was loaded.
+		 *
+		 * Invoked as:
+		 * 'let stats = scratchStats()' where 'stats' is of the form
+		 * {acquired: [buffers handed out], reused: [of which from a free
+		 *	list], allocated: [malloc calls], released: [buffers given
+		 *	back], freed: [free calls], cachedBytes: [bytes held in free
+		 *	lists]}
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(scratchStats);
+
+	public:
+
+		// smallest and largest cached size classes
+		static const size_t MIN_CLASS_BYTES;
+		static const size_t MAX_CLASS_BYTES;
+
+		// per-thread cache limits
+		static const size_t MAX_CACHED_PER_CLASS;
+		static const size_t MAX_CACHED_BYTES;
+
+
+		// -------
+		// acquire
+		// -------
+		/**
+		 * @brief Hands out a buffer of at least the given size, from the
+		 *		  calling thread's free list when possible.
+		 *
+		 * @param length number of bytes required
+		 * @param capacity resulting size of the buffer, to be given back
+		 *		  to release
+		 *
+		 * @throw std::bad_alloc if the memory cannot be allocated
+		 *
+		 * @return buffer
+		 */
+		static uint8_t* acquire(size_t length, size_t& capacity);
+
+
+		// -------
+		// release
+		// -------
+		/**
+		 * @brief Wipes the used part of a buffer and caches it on the
+		 *		  calling thread, or frees it when the cache is full.
+		 *
+		 * @param buffer buffer from acquire, may be null
+		 * @param used number of bytes that may have been written
+		 * @param capacity size of the buffer as returned by acquire
+		 *
+		 * @return void
+		 */
+		static void release(uint8_t* buffer, size_t used, size_t capacity);
+
+
+		// ----
+		// Init
+		// ----
+		/**
+		 * @brief Initialization function for the scratchStats function
+		 *		  exported by the addon.
+		 *
+		 * @param exports node.js module exports
+		 *
+		 * @return void
+		 */
+		static void Init(v8::Local<v8::Object> exports);
+
+};
+
+
+// -------------
+// ScratchBuffer
+// -------------
+
+/*
+ * @class Scratch buffer taken from the calling thread's ScratchPool and
+ *		  given back (wiped) when it goes out of scope. It must be
+ *		  destroyed on the thread that created it.
+ */
+class ScratchBuffer {
+
+	private:
+
+		uint8_t* _data;
+		// bytes in use, bytes ever in use and bytes available
+		size_t _size;
+		size_t _used;
+		size_t _capacity;
+
+	public:
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Takes a buffer of the given size from the pool.
+		 *
+		 * @param size number of bytes, may be 0
+		 *
+		 * @throw std::bad_alloc if the memory cannot be allocated
+		 */
+		explicit ScratchBuffer(size_t size = 0);
+
+		ScratchBuffer(ScratchBuffer&& other);
+
+		ScratchBuffer& operator=(ScratchBuffer&& other);
+
+		ScratchBuffer(const ScratchBuffer&) = delete;
+
+		ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+		~ScratchBuffer();
+
+
+		// -----
+		// reset
+		// -----
+		/**
+		 * @brief Gives the current buffer back and takes one of the given
+		 *		  size.
+		 *
+		 * @param size number of bytes, may be 0
+		 *
+		 * @throw std::bad_alloc if the memory cannot be allocated
+		 *
+		 * @return void
+		 */
+		void reset(size_t size);
+
+
+		// --------
+		// truncate
+		// --------
+		/**
+		 * @brief Shrinks the buffer without giving any memory back; the
+		 *		  bytes cut off are still wiped on release.
+		 *
+		 * @param size new number of bytes, at most size()
+		 *
+		 * @return void
+		 */
+		void truncate(size_t size);
+
+
+		// ----
+		// data
+		// ----
+		/**
+		 * @brief Returns the buffer bytes.
+		 *
+		 * @return buffer, null when the size is 0
+		 */
+		uint8_t* data() const;
+
+
+		// ----
+		// size
+		// ----
+		/**
+		 * @brief Returns the number of bytes in use.
+		 *
+		 * @return buffer size
+		 */
+		size_t size() const;
+};
+
+#endif
@@ -0,0 +1,71 @@
+/** @file securewipe.h
+ *  @brief header/implementation file for the helper used by the node module
+ *		   to wipe key material and other secrets from memory
+ *
+ *  @author Aashish Sheshadri
+ *  @author Rohit Harchandani
+ *
+ *	The MIT License (MIT)
+ *
+ *  Copyright (c) 2015, 2016, 2017 PayPal
+ *
+ *	Permission is hereby granted, free of charge, to any person obtaining a copy
+ *	of this software and associated documentation files (the "Software"), to
+ *	deal in the Software without restriction, including without limitation the
+ *	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *	sell copies of the Software, and to permit persons to whom the Software is
+ *	furnished to do so, subject to the following conditions:
+ *
+ *	The above copyright notice and this permission notice shall be included in
+ *	all copies or substantial portions of the Software.
+ *
+ *	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *	DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SEIFNODE_SECUREWIPE_H
+#define SEIFNODE_SECUREWIPE_H
+
+// -----------------
+// standard includes
+// -----------------
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// ----------
+// secureWipe
+// ----------
+/**
+ * @brief Zeroes memory in a way the compiler may not drop as a dead store,
+ *		  even when the memory is about to go out of scope or be freed.
+ *		  Every wipe of secret data in the module goes through here.
+ *
+ * @param data bytes to zero, may be null when length is 0
+ * @param length number of bytes
+ *
+ * @return void
+ */
+static inline void secureWipe(void* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    std::memset(data, 0, length);
+    __asm__ __volatile__("" : : "r"(data) : "memory");
+#else
+    volatile uint8_t* p = static_cast<volatile uint8_t*>(data);
+    while (length--) {
+        *p++ = 0;
+    }
+#endif
+}
+
+
+#endif
@@ -71,9 +71,6 @@ namespace ASN1 = CryptoPP::ASN1;
 
 #include "cryptlib.h"
 
-#include "sha3.h"
-using CryptoPP::SHA3_256;
-
 #include "osrng.h"
 using CryptoPP::AutoSeededRandomPool;
 
@@ -610,8 +607,8 @@ SEIFECC::STATUS SEIFECC::loadKeys(
     StringSource ss2(privStr, true,
         new CryptoPP::HexEncoder(new StringSink(encodedPriv)));
 
-    // Hash the hex encoded private key string using CryptoPP SHA3_256.
-    std::vector<uint8_t> digest(CryptoPP::SHA3_256::DIGESTSIZE);
+    // Hash the hex encoded private key string using SHA3-256.
+    std::vector<uint8_t> digest(Keccak::SHA3_256_DIGEST_BYTES);
     hashString(digest, encodedPriv);
 
     // Using the default file name for the RNG saved state.
@@ -764,13 +761,11 @@ NAN_METHOD(SEIFECC::New) {
          */
         std::vector<uint8_t> digest;
         if (bufferLength < 32) {
-            digest.resize(CryptoPP::SHA3_256::DIGESTSIZE);
-            std::string bufferString(reinterpret_cast<const char*>(bufferData),
-                reinterpret_cast<const char*>(bufferData) + bufferLength);
-            hashString(digest, bufferString);
+            digest.resize(Keccak::SHA3_256_DIGEST_BYTES);
+            hashBuffer(digest, bufferData, int(bufferLength));
 
         } else {
-            digest.reserve(CryptoPP::SHA3_256::DIGESTSIZE);
+            digest.reserve(Keccak::SHA3_256_DIGEST_BYTES);
             std::copy(bufferData, bufferData + bufferLength,
                 std::back_inserter(digest));
         }
@@ -30,7 +30,9 @@
 // -----------------
 // standard includes
 // -----------------
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <array>
 
@@ -39,24 +41,381 @@
 // ----------------------
 #include <node_buffer.h>
 
-// -----------------
-// cryptopp includes
-// -----------------
-#include "sha3.h"
-using CryptoPP::SHA3_256;
-
 // ----------------
 // library includes
 // ----------------
 #include <isaacRandomPool.h>
 
+#include "fileio.h"
+#include "keccak.h"
+#include "mac.h"
+#include "parallelhash.h"
+#include "records.h"
+#include "scratchpool.h"
+#include "securewipe.h"
 #include "seifsha3.h"
-#include "util.h"
 
 
 // javascript object constructor
 Nan::Persistent<v8::Function> SEIFSHA3::constructor;
 
+// string code units converted to UTF-8 and hashed at a time
+static const int STRING_CHUNK_UNITS = 4096;
+
+// bytes read from disk at a time by hashFile
+static const size_t FILE_CHUNK_BYTES = 8 * 1024 * 1024;
+
+// largest file offset or length taken from javascript (2^53)
+static const double MAX_FILE_RANGE = 9007199254740992.0;
+
+// version byte leading the buffers of exportState
+static const uint8_t STATE_FORMAT = 1;
+
+
+// -----------
+// Sha3Variant
+// -----------
+/*
+ * @struct Parameters of an algorithm selectable at construction.
+ */
+struct Sha3Variant {
+
+    // construction built on the Keccak sponge
+    enum Kind {
+        SPONGE,
+        CSHAKE,
+        PARALLEL_HASH,
+        KMAC,
+        HMAC
+    };
+
+    const char* name;
+    Kind kind;
+    size_t rate;
+    uint8_t suffix;
+    // default number of output bytes
+    size_t outputLength;
+    // true for SHAKE, cSHAKE, ParallelHash and KMAC, whose output length
+    // is variable
+    bool xof;
+};
+
+/* Variable output defaults to twice the security strength, as long as the
+ * SHA3 digest of the same strength.
+ */
+static const Sha3Variant VARIANTS[] = {
+    {"sha3-256", Sha3Variant::SPONGE, Keccak::SHA3_256_RATE,
+        Keccak::SHA3_SUFFIX, 32, false},
+    {"sha3-512", Sha3Variant::SPONGE, Keccak::SHA3_512_RATE,
+        Keccak::SHA3_SUFFIX, 64, false},
+    {"shake128", Sha3Variant::SPONGE, Keccak::SHAKE128_RATE,
+        Keccak::SHAKE_SUFFIX, 32, true},
+    {"shake256", Sha3Variant::SPONGE, Keccak::SHAKE256_RATE,
+        Keccak::SHAKE_SUFFIX, 64, true},
+    {"cshake128", Sha3Variant::CSHAKE, Keccak::SHAKE128_RATE,
+        Keccak::SHAKE_SUFFIX, 32, true},
+    {"cshake256", Sha3Variant::CSHAKE, Keccak::SHAKE256_RATE,
+        Keccak::SHAKE_SUFFIX, 64, true},
+    {"parallelhash128", Sha3Variant::PARALLEL_HASH, Keccak::SHAKE128_RATE,
+        Keccak::SHAKE_SUFFIX, 32, true},
+    {"parallelhash256", Sha3Variant::PARALLEL_HASH, Keccak::SHAKE256_RATE,
+        Keccak::SHAKE_SUFFIX, 64, true},
+    {"kmac128", Sha3Variant::KMAC, Keccak::SHAKE128_RATE,
+        Keccak::SHAKE_SUFFIX, 32, true},
+    {"kmac256", Sha3Variant::KMAC, Keccak::SHAKE256_RATE,
+        Keccak::SHAKE_SUFFIX, 64, true},
+    {"hmac-sha3-256", Sha3Variant::HMAC, Keccak::SHA3_256_RATE,
+        Keccak::SHA3_SUFFIX, 32, false},
+    {"hmac-sha3-512", Sha3Variant::HMAC, Keccak::SHA3_512_RATE,
+        Keccak::SHA3_SUFFIX, 64, false}
+};
+
+
+
+// --------------
+// getBytesOption
+// --------------
+/**
+ * @brief Reads a key or customization option given as a buffer or a
+ *        string (taken as UTF-8), throwing a node.js error for any other
+ *        type. The bytes are copied into a scratch buffer, wiped when it is
+ *        released, and the UTF-8 conversion of a string is wiped at once,
+ *        so a MAC key leaves no copy behind on any return path.
+ *
+ * @param options options object
+ * @param key option name
+ * @param bytes resulting option bytes, empty when absent
+ *
+ * @return true if the option could be read
+ */
+static bool getBytesOption(v8::Local<v8::Object> options,
+    const char* key, ScratchBuffer& bytes) {
+
+    v8::Local<v8::Value> value = Nan::Get(options,
+        Nan::New(key).ToLocalChecked()).ToLocalChecked();
+
+    if (value->IsUndefined()) {
+        bytes.reset(0);
+    } else if (node::Buffer::HasInstance(value)) {
+        size_t length = node::Buffer::Length(value);
+        bytes.reset(length);
+        std::copy(node::Buffer::Data(value),
+            node::Buffer::Data(value) + length, bytes.data());
+    } else if (value->IsString()) {
+        Nan::Utf8String utf8(value);
+        size_t length = size_t(utf8.length());
+        bytes.reset(length);
+        std::copy(*utf8, *utf8 + length, bytes.data());
+        secureWipe(*utf8, length);
+    } else {
+        Nan::ThrowError((std::string("Incorrect Arguments. '") + key +
+            "' must be a buffer or a string").c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+
+// ------------
+// absorbString
+// ------------
+/**
+ * @brief Absorbs the UTF-8 encoding of a string, reading it out of V8 in
+ *        fixed-size chunks rather than materializing the whole encoding.
+ *        One-byte strings skip the UTF-16 decoding, and ASCII chunks are
+ *        hashed as read. Lone surrogates become U+FFFD, as with
+ *        String::Utf8Value.
+ *
+ * @param hash sponge, tree hash or MAC state
+ * @param isolate current isolate
+ * @param str string to absorb
+ *
+ * @return void
+ */
+template <typename Hash>
+static void absorbString(Hash& hash, v8::Isolate* isolate,
+    v8::Local<v8::String> str) {
+
+    const int length = str->Length();
+
+    // Up to 3 UTF-8 bytes per code unit (4 per surrogate pair).
+    uint8_t utf8[3 * STRING_CHUNK_UNITS];
+
+    if (str->IsOneByte()) {
+        uint8_t latin1[STRING_CHUNK_UNITS];
+
+        for (int start = 0; start < length; start += STRING_CHUNK_UNITS) {
+            int count = std::min(STRING_CHUNK_UNITS, length - start);
+            str->WriteOneByte(isolate, latin1, start, count,
+                v8::String::NO_NULL_TERMINATION);
+
+            uint8_t high = 0;
+            for (int i = 0; i < count; ++i) {
+                high |= latin1[i];
+            }
+            if (high < 0x80) {
+                hash.absorb(latin1, count);
+                continue;
+            }
+
+            size_t n = 0;
+            for (int i = 0; i < count; ++i) {
+                uint8_t c = latin1[i];
+                if (c < 0x80) {
+                    utf8[n++] = c;
+                } else {
+                    utf8[n++] = uint8_t(0xc0 | (c >> 6));
+                    utf8[n++] = uint8_t(0x80 | (c & 0x3f));
+                }
+            }
+            hash.absorb(utf8, n);
+        }
+        return;
+    }
+
+    uint16_t units[STRING_CHUNK_UNITS];
+
+    for (int start = 0; start < length; ) {
+        int count = std::min(STRING_CHUNK_UNITS, length - start);
+        str->Write(isolate, units, start, count,
+            v8::String::NO_NULL_TERMINATION);
+
+        // Leave a high surrogate ending the chunk to the next chunk.
+        if (start + count < length && count > 1
+            && units[count - 1] >= 0xd800 && units[count - 1] <= 0xdbff) {
+            --count;
+        }
+
+        size_t n = 0;
+        for (int i = 0; i < count; ++i) {
+            uint32_t c = units[i];
+
+            if (c >= 0xd800 && c <= 0xdbff && i + 1 < count
+                && units[i + 1] >= 0xdc00 && units[i + 1] <= 0xdfff) {
+                c = 0x10000 + ((c - 0xd800) << 10) + (units[++i] - 0xdc00);
+            } else if (c >= 0xd800 && c <= 0xdfff) {
+                c = 0xfffd;
+            }
+
+            if (c < 0x80) {
+                utf8[n++] = uint8_t(c);
+            } else if (c < 0x800) {
+                utf8[n++] = uint8_t(0xc0 | (c >> 6));
+                utf8[n++] = uint8_t(0x80 | (c & 0x3f));
+            } else if (c < 0x10000) {
+                utf8[n++] = uint8_t(0xe0 | (c >> 12));
+                utf8[n++] = uint8_t(0x80 | ((c >> 6) & 0x3f));
+                utf8[n++] = uint8_t(0x80 | (c & 0x3f));
+            } else {
+                utf8[n++] = uint8_t(0xf0 | (c >> 18));
+                utf8[n++] = uint8_t(0x80 | ((c >> 12) & 0x3f));
+                utf8[n++] = uint8_t(0x80 | ((c >> 6) & 0x3f));
+                utf8[n++] = uint8_t(0x80 | (c & 0x3f));
+            }
+        }
+        hash.absorb(utf8, n);
+
+        start += count;
+    }
+}
+
+
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Initilizes the object for one algorithm.
+ *
+ * @param state empty state of the algorithm, owned by the object
+ * @param outputLength default number of output bytes
+ * @param xof true for an extendable-output function
+ * @param multiBuffer true if hashMany may use the multi-buffer SHA3-256
+ */
+SEIFSHA3::SEIFSHA3(KeccakFunction* state, size_t outputLength, bool xof,
+    bool multiBuffer) : _state(state), _outputLength(outputLength),
+    _xof(xof), _multiBuffer(multiBuffer) {}
+
+
+
+// ---------------
+// getOutputLength
+// ---------------
+/**
+ * @brief Unwraps an optional output length, which only extendable-output
+ *        functions accept, throwing a node.js error otherwise.
+ *
+ * @param value node.js value expected to be the length, or undefined for
+ *        the default
+ * @param length resulting number of output bytes
+ *
+ * @return true if the length could be unwrapped
+ */
+bool SEIFSHA3::getOutputLength(v8::Local<v8::Value> value, size_t& length) {
+
+    if (value->IsUndefined()) {
+        length = _outputLength;
+        return true;
+    }
+
+    if (!_xof) {
+        Nan::ThrowError("Incorrect Arguments. Output length only applies to "
+                        "SHAKE, cSHAKE, ParallelHash and KMAC");
+        return false;
+    }
+
+    if (!value->IsUint32() || Nan::To<uint32_t>(value).FromJust() == 0
+        || Nan::To<uint32_t>(value).FromJust() > node::Buffer::kMaxLength) {
+        Nan::ThrowError("Incorrect Arguments. Output length must be a "
+                        "positive integer");
+        return false;
+    }
+
+    length = Nan::To<uint32_t>(value).FromJust();
+    return true;
+}
+
+
+
+// -----------
+// absorbValue
+// -----------
+/**
+ * @brief Absorbs a buffer in place, or the UTF-8 encoding of any other
+ *        value converted to a string.
+ *
+ * @param hash sponge, tree hash or MAC state
+ * @param isolate current isolate
+ * @param value buffer or string to absorb
+ *
+ * @return false if the value could not be converted to a string
+ */
+template <typename Hash>
+static bool absorbValue(Hash& hash, v8::Isolate* isolate,
+    v8::Local<v8::Value> value) {
+
+    if (node::Buffer::HasInstance(value)) {
+        v8::Local<v8::Object> bufferObj =
+            Nan::To<v8::Object>(value).ToLocalChecked();
+
+        hash.absorb((uint8_t*)node::Buffer::Data(bufferObj),
+            node::Buffer::Length(bufferObj));
+        return true;
+    }
+
+    // Hash the UTF-8 encoding chunk by chunk, without copying it whole.
+    v8::Local<v8::String> str;
+    if (!Nan::To<v8::String>(value).ToLocal(&str)) {
+        return false;
+    }
+    absorbString(hash, isolate, str);
+    return true;
+}
+
+
+
+// ----------------
+// getFileRangePart
+// ----------------
+/**
+ * @brief Reads the 'offset' or 'length' option of hashFile, a
+ *        non-negative integer, throwing a node.js error otherwise.
+ *
+ * @param options options object
+ * @param key option name
+ * @param value resulting value
+ * @param present set to true if the option is given
+ *
+ * @return true if the option could be read
+ */
+static bool getFileRangePart(v8::Local<v8::Object> options, const char* key,
+    uint64_t& value, bool& present) {
+
+    v8::Local<v8::Value> option = Nan::Get(options,
+        Nan::New(key).ToLocalChecked()).ToLocalChecked();
+
+    present = !option->IsUndefined();
+    if (!present) {
+        return true;
+    }
+
+    double number = option->IsNumber()
+        ? Nan::To<double>(option).FromJust() : -1;
+
+    if (!(number >= 0 && number <= MAX_FILE_RANGE)
+        || number != double(uint64_t(number))) {
+        Nan::ThrowError((std::string("Incorrect Arguments. '") + key +
+            "' must be a non-negative integer").c_str());
+        return false;
+    }
+
+    value = uint64_t(number);
+    return true;
+}
+
 
 
 // ---
@@ -66,8 +425,15 @@ Nan::Persistent<v8::Function> SEIFSHA3::constructor;
  * @brief Creates the node object and corresponding underlying object.
  *
  * Invoked as:
- * 'let obj = new SEIFSHA3()' or
- * 'let obj = SEIFSHA3()'
+ * 'let obj = new SEIFSHA3(algorithm, options)' or
+ * 'let obj = SEIFSHA3(algorithm, options)' where
+ * 'algorithm' is 'sha3-256' (default), 'sha3-512', 'shake128',
+ * 'shake256', 'cshake128', 'cshake256', 'parallelhash128',
+ * 'parallelhash256', 'kmac128', 'kmac256', 'hmac-sha3-256' or
+ * 'hmac-sha3-512'
+ * 'options' is an optional {name, customization} object of buffers or
+ * strings customizing cSHAKE, {blockSize, customization} for
+ * ParallelHash, {key, customization} for KMAC or {key} for HMAC
  *
  * @param info node.js arguments wrapper
  *
@@ -79,8 +445,131 @@ NAN_METHOD(SEIFSHA3::New) {
 
     if (info.IsConstructCall()) {
 
-        // Invoked as constructor: 'let obj = new SEIFSHA3()'.
-        SEIFSHA3* obj = new SEIFSHA3();
+        // Looking up the algorithm, SHA3-256 unless one is named.
+        const Sha3Variant* variant = &VARIANTS[0];
+
+        if (!info[0]->IsUndefined()) {
+            std::string name = *Nan::Utf8String(info[0]);
+
+            variant = nullptr;
+            for (const Sha3Variant& candidate : VARIANTS) {
+                if (name == candidate.name) {
+                    variant = &candidate;
+                }
+            }
+
+            if (variant == nullptr) {
+                Nan::ThrowError("Incorrect Arguments. Algorithm must be "
+                                "'sha3-256', 'sha3-512', 'shake128', "
+                                "'shake256', 'cshake128', 'cshake256', "
+                                "'parallelhash128', 'parallelhash256', "
+                                "'kmac128', 'kmac256', 'hmac-sha3-256' or "
+                                "'hmac-sha3-512'");
+                return;
+            }
+        }
+
+        ScratchBuffer name;
+        ScratchBuffer customization;
+        ScratchBuffer key;
+        bool hasKey = false;
+        size_t blockSize = ParallelHash::DEFAULT_BLOCK_SIZE;
+
+        if (!info[1]->IsUndefined()) {
+
+            if (!info[1]->IsObject()) {
+                Nan::ThrowError("Incorrect Arguments. 'options' must be an "
+                                "object");
+                return;
+            }
+
+            v8::Local<v8::Object> options =
+                Nan::To<v8::Object>(info[1]).ToLocalChecked();
+
+            if (!getBytesOption(options, "name", name)
+                || !getBytesOption(options, "customization", customization)
+                || !getBytesOption(options, "key", key)) {
+                return;
+            }
+            hasKey = !Nan::Get(options,
+                Nan::New("key").ToLocalChecked()).ToLocalChecked()
+                ->IsUndefined();
+
+            bool customizable = variant->kind == Sha3Variant::CSHAKE
+                || variant->kind == Sha3Variant::PARALLEL_HASH
+                || variant->kind == Sha3Variant::KMAC;
+            if ((variant->kind != Sha3Variant::CSHAKE && name.size() != 0)
+                || (!customizable && customization.size() != 0)) {
+                Nan::ThrowError("Incorrect Arguments. 'name' only applies "
+                                "to cSHAKE, 'customization' to cSHAKE, "
+                                "ParallelHash and KMAC");
+                return;
+            }
+
+            v8::Local<v8::Value> size = Nan::Get(options,
+                Nan::New("blockSize").ToLocalChecked()).ToLocalChecked();
+
+            if (!size->IsUndefined()) {
+                if (variant->kind != Sha3Variant::PARALLEL_HASH
+                    || !size->IsUint32()
+                    || Nan::To<uint32_t>(size).FromJust() == 0) {
+                    Nan::ThrowError("Incorrect Arguments. 'blockSize' must "
+                                    "be a positive integer and only "
+                                    "applies to ParallelHash");
+                    return;
+                }
+                blockSize = Nan::To<uint32_t>(size).FromJust();
+            }
+        }
+
+        // The MAC key is required, and meaningless elsewhere.
+        bool keyed = variant->kind == Sha3Variant::KMAC
+            || variant->kind == Sha3Variant::HMAC;
+
+        if (keyed != hasKey) {
+            Nan::ThrowError(keyed
+                ? "Incorrect Arguments. 'key' is required by KMAC and HMAC"
+                : "Incorrect Arguments. 'key' only applies to KMAC and "
+                  "HMAC");
+            return;
+        }
+
+        // Absorbing the key and customization once; every message starts
+        // from a copy of the resulting state.
+        const uint8_t* customBytes = customization.data();
+        const uint8_t* keyBytes = key.data();
+        KeccakFunction* function = nullptr;
+
+        switch (variant->kind) {
+            case Sha3Variant::SPONGE:
+            case Sha3Variant::CSHAKE: {
+                KeccakSponge* sponge = new KeccakSponge(variant->rate,
+                    variant->suffix);
+                sponge->customize(name.data(), name.size(),
+                    customBytes, customization.size());
+                function = sponge;
+                break;
+            }
+            case Sha3Variant::PARALLEL_HASH:
+                function = new ParallelHash(variant->rate, blockSize,
+                    customBytes, customization.size());
+                break;
+            case Sha3Variant::KMAC:
+                function = new Kmac(variant->rate, keyBytes, key.size(),
+                    customBytes, customization.size());
+                break;
+            case Sha3Variant::HMAC:
+                function = new HmacSha3(variant->rate,
+                    variant->outputLength, keyBytes, key.size());
+                break;
+        }
+
+        // 'key' is wiped as it goes out of scope.
+
+        // Invoked as constructor: 'let obj = new SEIFSHA3(algorithm)'.
+        SEIFSHA3* obj = new SEIFSHA3(function, variant->outputLength,
+            variant->xof, variant->kind == Sha3Variant::SPONGE
+            && !variant->xof && variant->rate == Keccak::SHA3_256_RATE);
 
         obj->Wrap(info.This());
         info.GetReturnValue().Set(info.This());
@@ -113,10 +602,10 @@ NAN_METHOD(SEIFSHA3::New) {
  *        the hash of the given input as a buffer object.
  *
  * Invoked as:
- * 'let hash = obj.hash(stringData)' where
+ * 'let hash = obj.hash(stringData, outputLength)' where
  * 'stringData' is the string data to be hashed
- * 'hash' is the output buffer containing the SHA3-256 hash
- * To generate the output we are using Crypto++ SHA3-256 hash functions
+ * 'outputLength' is the output length in bytes, when variable
+ * 'hash' is the output buffer containing the hash
  *
  * @param info node.js arguments wrapper containing string value to be
  *        hashed
@@ -127,6 +616,8 @@ NAN_METHOD(SEIFSHA3::hash) {
 
     v8::Local<v8::Context> context = Nan::GetCurrentContext();
 
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
     // Checking arguments and unwrapping them to get the string data.
     if (info[0]->IsUndefined()) {
         Nan::ThrowError("Incorrect Arguments. Value to be hashed not "
@@ -134,37 +625,765 @@ NAN_METHOD(SEIFSHA3::hash) {
         return;
     }
 
+    size_t outputLength;
+    if (!obj->getOutputLength(info[1], outputLength)) {
+        return;
+    }
+
     // Output buffer containing the hash
-    std::vector<uint8_t> digest(CryptoPP::SHA3_256::DIGESTSIZE);
+    v8::Local<v8::Object> digest = Nan::NewBuffer(
+        outputLength).ToLocalChecked();
+    uint8_t* output = (uint8_t*)node::Buffer::Data(digest);
+
+    // Hashing the buffer in place, or the string, with an empty copy of
+    // the object's state.
+    std::unique_ptr<KeccakFunction> function(obj->_state->clone());
+    function->restart();
+    if (!absorbValue(*function, context->GetIsolate(), info[0])) {
+        return;
+    }
+    function->finish(uint64_t(outputLength) * 8);
+    function->squeeze(output, outputLength);
+
+    // Set node.js buffer as return value of the function.
+    info.GetReturnValue().Set(digest);
+}
+
+
+
+// ------
+// update
+// ------
+/**
+ * @brief Unwraps the arguments to get the string or buffer data and
+ *        absorbs it into the object's state.
+ *
+ * Invoked as:
+ * 'obj.update(data)' where
+ * 'data' is a buffer or a string (hashed as UTF-8)
+ * Returns the object itself so that calls can be chained. Throws once
+ * squeeze has been called, until the object is reset.
+ *
+ * @param info node.js arguments wrapper containing the data
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::update) {
+
+    v8::Local<v8::Context> context = Nan::GetCurrentContext();
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    // Checking arguments.
+    if (info[0]->IsUndefined()) {
+        Nan::ThrowError("Incorrect Arguments. Value to be hashed not "
+                        "provided");
+        return;
+    }
+
+    if (obj->_state->squeezing()) {
+        Nan::ThrowError("Cannot update after squeeze. Call digest() or "
+                        "reset() first");
+        return;
+    }
+
+    // Absorb the buffer in place, or the UTF-8 bytes of the string.
+    if (!absorbValue(*obj->_state, context->GetIsolate(), info[0])) {
+        return;
+    }
+
+    info.GetReturnValue().Set(info.Holder());
+}
+
+
+
+// ------
+// digest
+// ------
+/**
+ * @brief Returns the hash of all the data absorbed since the object was
+ *        created or last reset, and resets it.
+ *
+ * Invoked as:
+ * 'let hash = obj.digest(outputLength)' where
+ * 'outputLength' is the output length in bytes, when variable
+ * 'hash' is the output buffer containing the hash, or the next output
+ * bytes if squeeze has been called
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::digest) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    size_t outputLength;
+    if (!obj->getOutputLength(info[0], outputLength)) {
+        return;
+    }
+
+    v8::Local<v8::Object> digest = Nan::NewBuffer(
+        outputLength).ToLocalChecked();
+    uint8_t* output = (uint8_t*)node::Buffer::Data(digest);
+
+    obj->_state->finish(uint64_t(outputLength) * 8);
+    obj->_state->squeeze(output, outputLength);
+    obj->_state->restart();
+
+    // Set node.js buffer as return value of the function.
+    info.GetReturnValue().Set(digest);
+}
+
+
+
+// -------
+// squeeze
+// -------
+/**
+ * @brief Returns the next bytes of output of a SHAKE or cSHAKE object,
+ *        finishing the input on the first call so that any amount of
+ *        output can be read in pieces from one absorb pass.
+ *
+ * Invoked as:
+ * 'let output = obj.squeeze(length)' where
+ * 'length' is the number of bytes to read
+ * 'output' is the buffer holding them
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::squeeze) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    if (info[0]->IsUndefined()) {
+        Nan::ThrowError("Incorrect Arguments. Number of bytes to squeeze "
+                        "not provided");
+        return;
+    }
+
+    size_t length;
+    if (!obj->getOutputLength(info[0], length)) {
+        return;
+    }
+
+    // ParallelHash and KMAC objects squeeze ParallelHashXOF and KMACXOF
+    // output.
+    v8::Local<v8::Object> output = Nan::NewBuffer(length).ToLocalChecked();
+    obj->_state->squeeze((uint8_t*)node::Buffer::Data(output), length);
+
+    info.GetReturnValue().Set(output);
+}
+
+
+
+// -----
+// reset
+// -----
+/**
+ * @brief Discards the data absorbed so far.
+ *
+ * Invoked as:
+ * 'obj.reset()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::reset) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+    obj->_state->restart();
+}
+
+
+
+// -----
+// clone
+// -----
+/**
+ * @brief Creates an object of the same algorithm holding a copy of the
+ *        data absorbed so far, so that a common prefix is hashed once and
+ *        each copy then carries on with its own suffix.
+ *
+ * Invoked as:
+ * 'let copy = obj.clone()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::clone) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    // Construct a default object, then give it a copy of this state.
+    v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
+    v8::Local<v8::Object> instance;
+    if (!Nan::NewInstance(cons, 0, nullptr).ToLocal(&instance)) {
+        return;
+    }
+
+    SEIFSHA3* copy = ObjectWrap::Unwrap<SEIFSHA3>(instance);
+    copy->_state.reset(obj->_state->clone());
+    copy->_outputLength = obj->_outputLength;
+    copy->_xof = obj->_xof;
+    copy->_multiBuffer = obj->_multiBuffer;
+
+    info.GetReturnValue().Set(instance);
+}
+
+
+
+// -----------
+// exportState
+// -----------
+/**
+ * @brief Returns the object's state, i.e. the data absorbed so far and
+ *        any output already squeezed, as a buffer that importState
+ *        restores. The state of a keyed object is as secret as the key.
+ *
+ * Invoked as:
+ * 'let state = obj.exportState()'
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::exportState) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    std::vector<uint8_t> state(1, STATE_FORMAT);
+    obj->_state->exportState(state);
+
+    v8::Local<v8::Object> output = Nan::CopyBuffer(
+        (const char*)state.data(), state.size()).ToLocalChecked();
+    secureWipe(state.data(), state.size());
+
+    info.GetReturnValue().Set(output);
+}
+
+
+
+// -----------
+// importState
+// -----------
+/**
+ * @brief Replaces the object's state with a buffer returned by
+ *        exportState of an object of the same algorithm and options. reset
+ *        still returns to this object's own initial state.
+ *
+ * Invoked as:
+ * 'obj.importState(state)' where
+ * 'state' is the buffer returned by exportState
+ * Returns the object itself so that calls can be chained.
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::importState) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
 
-    // Check if first argument is a buffer or a string and hash accordingly.
     if (!node::Buffer::HasInstance(info[0])) {
-        v8::String::Utf8Value str(context->GetIsolate(), info[0]->ToString(context));
+        Nan::ThrowError("Incorrect Arguments. State must be a buffer");
+        return;
+    }
+
+    v8::Local<v8::Object> bufferObj =
+        Nan::To<v8::Object>(info[0]).ToLocalChecked();
+    const uint8_t* input = (const uint8_t*)node::Buffer::Data(bufferObj);
+    const uint8_t* end = input + node::Buffer::Length(bufferObj);
+
+    if (input == end || *input != STATE_FORMAT) {
+        Nan::ThrowError("Incorrect Arguments. Unknown hash state format");
+        return;
+    }
+    ++input;
+
+    // Import into a copy so that a bad state leaves the object unchanged.
+    std::unique_ptr<KeccakFunction> state(obj->_state->clone());
+    try {
+
+        state->importState(input, end);
+        if (input != end) {
+            throw std::invalid_argument("Hash state has trailing bytes");
+        }
+
+    } catch (const std::exception& e) {
+
+        Nan::ThrowError((std::string("Incorrect Arguments. ") + e.what())
+            .c_str());
+        return;
+    }
+
+    obj->_state.swap(state);
+    info.GetReturnValue().Set(info.Holder());
+}
+
+
+
+// ----------
+// HashWorker
+// ----------
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param data buffer to be hashed, kept alive until completion
+ * @param function state of the algorithm, copied empty
+ * @param outputLength number of output bytes
+ */
+SEIFSHA3::HashWorker::HashWorker(Nan::Callback* callback,
+    v8::Local<v8::Object> data, const KeccakFunction& function,
+    size_t outputLength
+): Nan::AsyncWorker(callback),
+    _data((const uint8_t *)node::Buffer::Data(data)),
+    _dataLength(node::Buffer::Length(data)),
+    _function(function.clone()),
+    _digest(outputLength) {
+
+    // Keep the buffer alive without copying it.
+    SaveToPersistent("data", data);
+    _function->restart();
+}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the hash
+ *        buffer.
+ *
+ * @return void
+ */
+void SEIFSHA3::HashWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {
+        status,
+        Nan::CopyBuffer((const char*)_digest.data(), _digest.size())
+            .ToLocalChecked()
+    };
+
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void SEIFSHA3::HashWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, hashing the buffer.
+ *
+ * @return void
+ */
+void SEIFSHA3::HashWorker::Execute() {
+
+    try {
+
+        // ParallelHash further spreads the leaves over the free cores.
+        _function->absorb(_data, _dataLength);
+        _function->finish(uint64_t(_digest.size()) * 8);
+        _function->squeeze(_digest.data(), _digest.size());
+
+    } catch (const std::exception& e) {
+
+        // e.g. std::system_error when a ParallelHash thread cannot start
+        SetErrorMessage(e.what());
+    }
+}
+
+
+
+// ---------
+// hashAsync
+// ---------
+/**
+ * @brief Unwraps the arguments to get the buffer and hashes it on the
+ *        libuv thread pool, keeping a reference to the buffer instead of
+ *        copying it.
+ *
+ * Invoked as:
+ * 'obj.hashAsync(buffer, outputLength, function(status, hash){})' where
+ * 'buffer' is the buffer to be hashed
+ * 'outputLength' is the output length in bytes, when variable, or
+ * undefined
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'hash' is the output buffer containing the hash
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::hashAsync) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    // Checking arguments.
+    if (info.Length() < 3
+        || !node::Buffer::HasInstance(info[0])
+        || !info[2]->IsFunction()) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide a buffer, an "
+                        "output length or undefined, and a callback "
+                        "function -> 'function hashAsync(buffer, "
+                        "outputLength, callback)'");
+        return;
+    }
+
+    size_t outputLength;
+    if (!obj->getOutputLength(info[1], outputLength)) {
+        return;
+    }
+
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    Nan::AsyncQueueWorker(new HashWorker(callback,
+        Nan::To<v8::Object>(info[0]).ToLocalChecked(), *obj->_state,
+        outputLength));
+}
+
+
+
+// --------
+// hashMany
+// --------
+/**
+ * @brief Unwraps the arguments to get a batch of records and returns all
+ *        their hashes in one buffer. SHA3-256 hashes several records per
+ *        Keccak permutation with SIMD when available.
+ *
+ * Invoked as:
+ * 'let hashes = obj.hashMany(records, outputLength)' where
+ * 'records' is an array of buffers or a packed {data, offsets} object
+ * 'outputLength' is the output length in bytes, when variable
+ * 'hashes' is a buffer holding the n-byte hash of record i at offset n * i
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::hashMany) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    std::vector<Record> records;
+    if (!getRecordsArgument(info[0], records)) {
+        return;
+    }
+
+    size_t outputLength;
+    if (!obj->getOutputLength(info[1], outputLength)) {
+        return;
+    }
+
+    if (!fitsNodeBuffer(uint64_t(records.size()) * outputLength)) {
+        Nan::ThrowError("Incorrect Arguments. Output too large for one "
+                        "buffer");
+        return;
+    }
+
+    // Hash straight into the node.js buffer returned to the caller.
+    v8::Local<v8::Object> digests = Nan::NewBuffer(
+        records.size() * outputLength).ToLocalChecked();
+    uint8_t* output = (uint8_t*)node::Buffer::Data(digests);
+
+    if (obj->_multiBuffer) {
+
+        std::vector<const uint8_t*> inputs(records.size());
+        std::vector<size_t> lengths(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            inputs[i] = records[i].data;
+            lengths[i] = records[i].length;
+        }
+
+        Keccak::sha3_256Many(inputs.data(), lengths.data(), records.size(),
+            output);
 
-        /* Using crypto++ sha3-256 hash function to hash data and store in
-         * 'digest' array. Definition of 'hashString' can be found in 'util.h'.
-         */
-        hashString(digest, *str);
     } else {
-        // Unwrap the first argument to get the input buffer to be hashed
-        v8::Local<v8::Object> bufferObj =
-            Nan::To<v8::Object>(info[0]).ToLocalChecked();
 
-        uint8_t* bufferData = (uint8_t*)node::Buffer::Data(bufferObj);
-        size_t bufferLength = node::Buffer::Length(bufferObj);
+        // The other algorithms take one record at a time, each from a
+        // copy of the state holding the absorbed key or customization.
+        std::unique_ptr<KeccakFunction> function(obj->_state->clone());
+        for (size_t i = 0; i < records.size(); ++i) {
+            function->restart();
+            function->absorb(records[i].data, records[i].length);
+            function->finish(uint64_t(outputLength) * 8);
+            function->squeeze(output + i * outputLength, outputLength);
+        }
+    }
+
+    info.GetReturnValue().Set(digests);
+}
+
+
+
+// ----------
+// FileWorker
+// ----------
+
+// -----------
+// Constructor
+// -----------
+/**
+ * Constructor
+ * @brief Initilizes and constructs internal data.
+ *
+ * @param callback callback to be invoked after async operation
+ * @param path path of the file to hash
+ * @param offset first byte to hash
+ * @param length number of bytes to hash
+ * @param toEnd true to hash from 'offset' to the end of the file,
+ *        ignoring 'length'
+ * @param function state of the algorithm, copied empty
+ * @param outputLength number of output bytes
+ */
+SEIFSHA3::FileWorker::FileWorker(Nan::Callback* callback,
+    const std::string& path, uint64_t offset, uint64_t length, bool toEnd,
+    const KeccakFunction& function, size_t outputLength
+): Nan::AsyncWorker(callback),
+    _path(path),
+    _offset(offset),
+    _length(length),
+    _toEnd(toEnd),
+    _function(function.clone()),
+    _digest(outputLength) {
+
+    _function->restart();
+}
+
+
+// ----------------
+// HandleOKCallback
+// ----------------
+/**
+ * @brief Invokes the given callback with a success status and the hash
+ *        buffer.
+ *
+ * @return void
+ */
+void SEIFSHA3::FileWorker::HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> status = Nan::New<v8::Object>();
+    Nan::Set(status,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(0)
+    );
+    Nan::Set(status,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>("Success").ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {
+        status,
+        Nan::CopyBuffer((const char*)_digest.data(), _digest.size())
+            .ToLocalChecked()
+    };
 
-        /* Using crypto++ sha3-256 hash function to hash data and store in
-         * 'digest' array. Definition of 'hashBuffer' can be found in 'util.h'.
-         */
-        hashBuffer(digest, bufferData, bufferLength);
+    callback->Call(2, argv);
+}
+
+
+// -------------------
+// HandleErrorCallback
+// -------------------
+/**
+ * @brief Invokes the given callback with the error status
+ * {code: [statusCode], message: [errorMessage]}
+ *
+ * @return void
+ */
+void SEIFSHA3::FileWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Object> error = Nan::New<v8::Object>();
+    Nan::Set(error,
+        Nan::New<v8::String>("code").ToLocalChecked(),
+        Nan::New<v8::Integer>(-1)
+    );
+    Nan::Set(error,
+        Nan::New<v8::String>("message").ToLocalChecked(),
+        Nan::New<v8::String>(ErrorMessage()).ToLocalChecked()
+    );
+
+    v8::Local<v8::Value> argv[] = {error, Nan::Undefined()};
+
+    callback->Call(2, argv);
+}
+
+
+// -------
+// Execute
+// -------
+/**
+ * @brief Executed in a separate thread, reading the file in large
+ *        sequential chunks and hashing them.
+ *
+ * @return void
+ */
+void SEIFSHA3::FileWorker::Execute() {
+
+    try {
+
+        // Opened with sequential read-ahead advice.
+        uint64_t size;
+        FileDescriptor input(openForReading(_path, false, size));
+
+        if (_offset > size) {
+            throw std::runtime_error("Range starts past the end of '" +
+                _path + "'");
+        }
+        if (_toEnd) {
+            _length = size - _offset;
+        } else if (_length > size - _offset) {
+            throw std::runtime_error("Range ends past the end of '" +
+                _path + "'");
+        }
+
+        if (_offset > 0) {
+            seekTo(input.get(), _offset);
+        }
+
+        AlignedBuffer chunk(size_t(std::min<uint64_t>(FILE_CHUNK_BYTES,
+            std::max<uint64_t>(_length, 1))));
+
+        for (uint64_t remaining = _length; remaining > 0; ) {
+            size_t wanted = size_t(std::min<uint64_t>(remaining,
+                chunk.size()));
+
+            if (readFull(input.get(), chunk.data(), wanted) != wanted) {
+                throw std::runtime_error("'" + _path + "' was truncated "
+                    "while being hashed");
+            }
+
+            _function->absorb(chunk.data(), wanted);
+            remaining -= wanted;
+        }
+
+    } catch (const std::exception& e) {
+        SetErrorMessage(e.what());
+        return;
     }
 
-    // Copying digest hash value to node.js buffer.
-    auto slowBuffer = Nan::CopyBuffer((const char*)digest.data(),
-        digest.size()).ToLocalChecked();
+    _function->finish(uint64_t(_digest.size()) * 8);
+    _function->squeeze(_digest.data(), _digest.size());
+}
 
-    // Set node.js buffer as return value of the function.
-    info.GetReturnValue().Set(slowBuffer);
+
+
+// --------
+// hashFile
+// --------
+/**
+ * @brief Unwraps the arguments and hashes a file, or a byte range of it,
+ *        on the libuv thread pool, reading it in large chunks instead of
+ *        through a javascript buffer.
+ *
+ * Invoked as:
+ * 'obj.hashFile(path, options, function(status, hash){})' where
+ * 'path' is the path of the file to hash
+ * 'options' (optional) is of the form {offset, length, outputLength}
+ * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+ * 'hash' is the output buffer containing the hash
+ *
+ * @param info node.js arguments wrapper
+ *
+ * @return void
+ */
+NAN_METHOD(SEIFSHA3::hashFile) {
+
+    SEIFSHA3* obj = ObjectWrap::Unwrap<SEIFSHA3>(info.Holder());
+
+    // The callback is the last argument, options may be left out.
+    int callbackIndex = info.Length() - 1;
+
+    // Checking arguments.
+    if (info.Length() < 2 || info.Length() > 3
+        || !info[0]->IsString()
+        || !info[callbackIndex]->IsFunction()
+        || (callbackIndex == 2 && !info[1]->IsObject())) {
+
+        Nan::ThrowError("Incorrect Arguments. Please provide a path and a "
+                        "callback function -> 'function hashFile(path, "
+                        "options, callback)'");
+        return;
+    }
+
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    bool hasOffset = false;
+    bool hasLength = false;
+    size_t outputLength = obj->_outputLength;
+
+    if (callbackIndex == 2) {
+        v8::Local<v8::Object> options =
+            Nan::To<v8::Object>(info[1]).ToLocalChecked();
+
+        if (!getFileRangePart(options, "offset", offset, hasOffset)
+            || !getFileRangePart(options, "length", length, hasLength)
+            || !obj->getOutputLength(Nan::Get(options,
+                Nan::New("outputLength").ToLocalChecked()).ToLocalChecked(),
+                outputLength)) {
+            return;
+        }
+    }
+
+    Nan::Callback *callback =
+        new Nan::Callback(info[callbackIndex].As<v8::Function>());
+
+    Nan::AsyncQueueWorker(new FileWorker(callback,
+        *Nan::Utf8String(info[0]), offset, length, !hasLength,
+        *obj->_state, outputLength));
 }
 
 
@@ -193,6 +1412,16 @@ void SEIFSHA3::Init(v8::Local<v8::Object> exports) {
 
     // Prototype
     Nan::SetPrototypeMethod(tpl, "hash", hash);
+    Nan::SetPrototypeMethod(tpl, "update", update);
+    Nan::SetPrototypeMethod(tpl, "digest", digest);
+    Nan::SetPrototypeMethod(tpl, "squeeze", squeeze);
+    Nan::SetPrototypeMethod(tpl, "reset", reset);
+    Nan::SetPrototypeMethod(tpl, "clone", clone);
+    Nan::SetPrototypeMethod(tpl, "exportState", exportState);
+    Nan::SetPrototypeMethod(tpl, "importState", importState);
+    Nan::SetPrototypeMethod(tpl, "hashAsync", hashAsync);
+    Nan::SetPrototypeMethod(tpl, "hashMany", hashMany);
+    Nan::SetPrototypeMethod(tpl, "hashFile", hashFile);
 
     constructor.Reset(context->GetIsolate(), tpl->GetFunction(context));
 
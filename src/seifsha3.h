@@ -1,6 +1,6 @@
 /** @file seifsha3.h
  *  @brief Class header for native object wrapped in javascript object
- *		   responsible for performing Crypto++ SHA3 hash function
+ *		   responsible for performing the SHA3 and SHAKE hash functions
  *
  *  @author Aashish Sheshadri
  *  @author Rohit Harchandani
@@ -31,6 +31,13 @@
 #ifndef SEIFSHA3_H
 #define SEIFSHA3_H
 
+// -----------------
+// standard includes
+// -----------------
+#include <memory>
+#include <string>
+#include <vector>
+
 // ----------------------
 // node.js addon includes
 // ----------------------
@@ -38,6 +45,11 @@
 #include <node_object_wrap.h>
 #include <nan.h>
 
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
+
 
 // --------
 // SEIFSHA3
@@ -45,10 +57,39 @@
 
 /*
  * @class This class represents native object wrapped inside a javascript
- * 		  object, exposing Crypto++ SHA3 function.
+ * 		  object, exposing the SHA3 hash functions.
+ *
+ *		  Each object is bound to one algorithm chosen at construction:
+ *		  SHA3-256 (the default), SHA3-512, the SHAKE128/SHAKE256
+ *		  extendable-output functions and their customizable cSHAKE
+ *		  forms, the ParallelHash128/256 tree hashes that spread large
+ *		  inputs over all cores, or the KMAC128/256 and HMAC-SHA3-256/512
+ *		  message authentication codes; the output length of all but
+ *		  SHA3 and HMAC is chosen per call. Keys and customization strings
+ *		  are absorbed once at construction, and every message starts
+ *		  from a copy of that state. Besides the one-shot hash, every
+ *		  object keeps a state so that data arriving in chunks can be
+ *		  hashed as it comes.
  *
  *		  The functions exposed to node.js are:
- *		  function hash(data) -> returns SHA3-256 hash of the data
+ *		  function hash(data, outputLength) -> returns the hash of the data
+ *		  function update(data) -> absorbs data into the object's state
+ *		  function digest(outputLength) -> returns the hash of the data
+ *		  	absorbed and resets the state
+ *		  function squeeze(length) -> returns the next bytes of SHAKE output
+ *		  	of the data absorbed
+ *		  function reset() -> discards the data absorbed
+ *		  function clone() -> returns a copy of the object and the data
+ *		  	absorbed
+ *		  function exportState() -> returns the object's state as a buffer
+ *		  function importState(state) -> restores a state returned by
+ *		  	exportState
+ *		  function hashAsync(buffer, outputLength, callback) -> hashes the
+ *		  	buffer on the libuv thread pool
+ *		  function hashMany(records, outputLength) -> returns the hashes of
+ *		  	all records back to back in one buffer
+ *		  function hashFile(path, options, callback) -> hashes a file or a
+ *		  	byte range of it on the libuv thread pool
  */
 class SEIFSHA3 : public Nan::ObjectWrap {
 
@@ -57,6 +98,199 @@ class SEIFSHA3 : public Nan::ObjectWrap {
 		// javascript object constructor
 		static Nan::Persistent<v8::Function> constructor;
 
+		// sponge, tree hash or MAC of the data absorbed by update
+		std::unique_ptr<KeccakFunction> _state;
+		// output bytes of hash and digest when no length is given
+		size_t _outputLength;
+		// true for SHAKE, cSHAKE, ParallelHash and KMAC, whose output
+		// length is variable
+		bool _xof;
+		// true for SHA3-256, which hashMany runs on the multi-buffer path
+		bool _multiBuffer;
+
+
+		// -----------
+		// Constructor
+		// -----------
+		/**
+		 * Constructor
+		 * @brief Initilizes the object for one algorithm.
+		 *
+		 * @param state empty state of the algorithm, owned by the object
+		 * @param outputLength default number of output bytes
+		 * @param xof true for an extendable-output function
+		 * @param multiBuffer true if hashMany may use the multi-buffer
+		 *		  SHA3-256
+		 */
+		SEIFSHA3(KeccakFunction* state, size_t outputLength, bool xof,
+			bool multiBuffer);
+
+
+		// ---------------
+		// getOutputLength
+		// ---------------
+		/**
+		 * @brief Unwraps an optional output length, which only
+		 *		  extendable-output functions accept, throwing a node.js
+		 *		  error otherwise.
+		 *
+		 * @param value node.js value expected to be the length, or
+		 *		  undefined for the default
+		 * @param length resulting number of output bytes
+		 *
+		 * @return true if the length could be unwrapped
+		 */
+		bool getOutputLength(v8::Local<v8::Value> value, size_t& length);
+
+		// ----------
+		// HashWorker
+		// ----------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  hashing a buffer on the libuv thread pool and invoking the
+		 *		  given callback with the resulting hash.
+		 */
+		class HashWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// data bytes, owned by the buffer kept in persistent storage
+				const uint8_t* _data;
+				size_t _dataLength;
+				// empty copy of the object's state
+				std::unique_ptr<KeccakFunction> _function;
+				// resulting hash
+				std::vector<uint8_t> _digest;
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param data buffer to be hashed, kept alive until completion
+				 * @param function state of the algorithm, copied empty
+				 * @param outputLength number of output bytes
+				 */
+		        HashWorker(Nan::Callback* callback, v8::Local<v8::Object> data,
+		        	const KeccakFunction& function, size_t outputLength);
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the hash buffer.
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status.
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, hashing the buffer.
+		         *
+		         * @return void
+		         */
+		        void Execute();
+		};
+
+		// ----------
+		// FileWorker
+		// ----------
+		/*
+		 * @class This class represents the node.js async worker responsible for
+		 *		  streaming a file, or a byte range of it, through the hash
+		 *		  on the libuv thread pool and invoking the given callback
+		 *		  with the resulting hash.
+		 */
+		class FileWorker: public Nan::AsyncWorker {
+
+		    private:
+		    	// ----
+				// data
+				// ----
+				// path of the file and byte range to hash
+				std::string _path;
+				uint64_t _offset;
+				uint64_t _length;
+				bool _toEnd;
+				// empty copy of the object's state
+				std::unique_ptr<KeccakFunction> _function;
+				// resulting hash
+				std::vector<uint8_t> _digest;
+
+		    public:
+		    	// -----------
+				// Constructor
+				// -----------
+				/**
+				 * Constructor
+				 * @brief Initilizes and constructs internal data.
+				 *
+				 * @param callback callback to be invoked after async operation
+				 * @param path path of the file to hash
+				 * @param offset first byte to hash
+				 * @param length number of bytes to hash
+				 * @param toEnd true to hash from 'offset' to the end of the
+				 *		  file, ignoring 'length'
+				 * @param function state of the algorithm, copied empty
+				 * @param outputLength number of output bytes
+				 */
+		        FileWorker(Nan::Callback* callback, const std::string& path,
+		        	uint64_t offset, uint64_t length, bool toEnd,
+		        	const KeccakFunction& function, size_t outputLength);
+
+		        // ----------------
+				// HandleOKCallback
+				// ----------------
+		        /**
+		         * @brief Invokes the given callback with a success status and
+		         *		  the hash buffer.
+		         *
+		         * @return void
+		         */
+		        void HandleOKCallback();
+
+		        // -------------------
+				// HandleErrorCallback
+				// -------------------
+		        /**
+		         * @brief Invokes the given callback with the error status.
+		         *
+		         * @return void
+		         */
+		        void HandleErrorCallback();
+
+		        // -------
+				// Execute
+				// -------
+				/**
+		         * @brief Executed in a separate thread, reading the file in
+		         *		  large sequential chunks and hashing them.
+		         *
+		         * @return void
+		         */
+		        void Execute();
+		};
+
 		// ---
 		// New
 		// ---
@@ -64,8 +298,15 @@ class SEIFSHA3 : public Nan::ObjectWrap {
 		 * @brief Creates the node object and corresponding underlying object.
 		 *
 		 * Invoked as:
-		 * 'let obj = new SEIFSHA3()' or
-		 * 'let obj = SEIFSHA3()'
+		 * 'let obj = new SEIFSHA3(algorithm, options)' or
+		 * 'let obj = SEIFSHA3(algorithm, options)' where
+		 * 'algorithm' is 'sha3-256' (default), 'sha3-512', 'shake128',
+		 * 'shake256', 'cshake128', 'cshake256', 'parallelhash128',
+		 * 'parallelhash256', 'kmac128', 'kmac256', 'hmac-sha3-256' or
+		 * 'hmac-sha3-512'
+		 * 'options' is an optional {name, customization} object of buffers
+		 * or strings customizing cSHAKE, {blockSize, customization} for
+		 * ParallelHash, {key, customization} for KMAC or {key} for HMAC
 		 *
 		 * @param info node.js arguments wrapper
 		 *
@@ -82,10 +323,10 @@ class SEIFSHA3 : public Nan::ObjectWrap {
 		 *        the hash of the given input as a buffer object.
 		 *
 		 * Invoked as:
-		 * 'let hash = obj.hash(stringData)' where
+		 * 'let hash = obj.hash(stringData, outputLength)' where
 		 * 'stringData' is the string data to be hashed
-		 * 'hash' is the output buffer containing the SHA3-256 hash
-		 * To generate the output we are using Crypto++ SHA3-256 hash functions
+		 * 'outputLength' is the output length in bytes, when variable
+		 * 'hash' is the output buffer containing the hash
 		 *
 		 * @param info node.js arguments wrapper containing string value to be
 		 *        hashed
@@ -94,6 +335,211 @@ class SEIFSHA3 : public Nan::ObjectWrap {
 		 */
 		static NAN_METHOD(hash);
 
+
+		// ------
+		// update
+		// ------
+		/**
+		 * @brief Unwraps the arguments to get the string or buffer data and
+		 *        absorbs it into the object's state.
+		 *
+		 * Invoked as:
+		 * 'obj.update(data)' where
+		 * 'data' is a buffer or a string (hashed as UTF-8)
+		 * Returns the object itself so that calls can be chained. Throws
+		 * once squeeze has been called, until the object is reset.
+		 *
+		 * @param info node.js arguments wrapper containing the data
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(update);
+
+
+		// ------
+		// digest
+		// ------
+		/**
+		 * @brief Returns the hash of all the data absorbed since the
+		 *        object was created or last reset, and resets it.
+		 *
+		 * Invoked as:
+		 * 'let hash = obj.digest(outputLength)' where
+		 * 'outputLength' is the output length in bytes, when variable
+		 * 'hash' is the output buffer containing the hash, or the next
+		 * output bytes if squeeze has been called
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(digest);
+
+
+		// -------
+		// squeeze
+		// -------
+		/**
+		 * @brief Returns the next bytes of output of a SHAKE, cSHAKE,
+		 *        ParallelHashXOF or KMACXOF object, finishing the input on
+		 *        the first call so that any amount of output can be read
+		 *        in pieces from one absorb pass.
+		 *
+		 * Invoked as:
+		 * 'let output = obj.squeeze(length)' where
+		 * 'length' is the number of bytes to read
+		 * 'output' is the buffer holding them
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(squeeze);
+
+
+		// -----
+		// reset
+		// -----
+		/**
+		 * @brief Discards the data absorbed so far.
+		 *
+		 * Invoked as:
+		 * 'obj.reset()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(reset);
+
+
+		// -----
+		// clone
+		// -----
+		/**
+		 * @brief Creates an object of the same algorithm holding a copy
+		 *        of the data absorbed so far, so that a common prefix is
+		 *        hashed once and each copy then carries on with its own
+		 *        suffix.
+		 *
+		 * Invoked as:
+		 * 'let copy = obj.clone()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(clone);
+
+
+		// -----------
+		// exportState
+		// -----------
+		/**
+		 * @brief Returns the object's state, i.e. the data absorbed so
+		 *        far and any output already squeezed, as a buffer that
+		 *        importState restores. The state of a keyed object is as
+		 *        secret as the key.
+		 *
+		 * Invoked as:
+		 * 'let state = obj.exportState()'
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(exportState);
+
+
+		// -----------
+		// importState
+		// -----------
+		/**
+		 * @brief Replaces the object's state with a buffer returned by
+		 *        exportState of an object of the same algorithm and
+		 *        options. reset still returns to this object's own initial
+		 *        state.
+		 *
+		 * Invoked as:
+		 * 'obj.importState(state)' where
+		 * 'state' is the buffer returned by exportState
+		 * Returns the object itself so that calls can be chained.
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(importState);
+
+
+		// ---------
+		// hashAsync
+		// ---------
+		/**
+		 * @brief Unwraps the arguments to get the buffer and hashes it on
+		 *        the libuv thread pool, keeping a reference to the buffer
+		 *        instead of copying it.
+		 *
+		 * Invoked as:
+		 * 'obj.hashAsync(buffer, outputLength, function(status, hash){})'
+		 * where
+		 * 'buffer' is the buffer to be hashed
+		 * 'outputLength' is the output length in bytes, when variable,
+		 * or undefined
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'hash' is the output buffer containing the hash
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(hashAsync);
+
+
+		// --------
+		// hashMany
+		// --------
+		/**
+		 * @brief Unwraps the arguments to get a batch of records and
+		 *        returns all their hashes in one buffer. SHA3-256 hashes
+		 *        several records per Keccak permutation with SIMD when
+		 *        available.
+		 *
+		 * Invoked as:
+		 * 'let hashes = obj.hashMany(records, outputLength)' where
+		 * 'records' is an array of buffers or a packed {data, offsets} object
+		 * 'outputLength' is the output length in bytes, when variable
+		 * 'hashes' is a buffer holding the n-byte hash of record i at
+		 * offset n * i
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(hashMany);
+
+
+		// --------
+		// hashFile
+		// --------
+		/**
+		 * @brief Unwraps the arguments and hashes a file, or a byte range
+		 *        of it, on the libuv thread pool, reading it in large
+		 *        chunks instead of through a javascript buffer.
+		 *
+		 * Invoked as:
+		 * 'obj.hashFile(path, options, function(status, hash){})' where
+		 * 'path' is the path of the file to hash
+		 * 'options' (optional) is of the form {offset, length, outputLength}
+		 * 'status' is of the form {code: [statusCode], message: [statusMessage]}
+		 * 'hash' is the output buffer containing the hash
+		 *
+		 * @param info node.js arguments wrapper
+		 *
+		 * @return void
+		 */
+		static NAN_METHOD(hashFile);
+
 	public:
 
 		// ----
@@ -37,28 +37,27 @@
 #include <vector>
 #include <string>
 
-// -----------------
-// cryptopp includes
-// -----------------
-#include "sha3.h"
-using CryptoPP::SHA3_256;
+// ----------------
+// library includes
+// ----------------
+#include "keccak.h"
 
 
 // ----------
 // hashString
 // ----------
 /**
- * @brief creates a SHA3-256 hash of the given string using CryptoPP
+ * @brief creates a SHA3-256 hash of the given string using the module's
+ * Keccak
  * @param digest output vector in which the hash to be stored
  * @param str input string to be hashed
  * PreCondition: 'digest' should be of appropriate size
- * (CryptoPP::SHA3_256::DIGESTSIZE)
+ * (Keccak::SHA3_256_DIGEST_BYTES)
  * @return void
  */
 static void hashString(std::vector<uint8_t>& digest, const std::string& str) {
-    CryptoPP::SHA3_256 hash;
-    hash.Update(reinterpret_cast<const uint8_t*>(str.c_str()), str.size());
-    hash.Final(digest.data());
+    Keccak::sha3_256(reinterpret_cast<const uint8_t*>(str.data()),
+        str.size(), digest.data());
 }
 
 
@@ -66,12 +65,13 @@ static void hashString(std::vector<uint8_t>& digest, const std::string& str) {
 // hashBuffer
 // ----------
 /**
- * @brief creates a SHA3-256 hash of the given buffer using CryptoPP
+ * @brief creates a SHA3-256 hash of the given buffer using the module's
+ * Keccak
  * @param digest output vector in which the hash to be stored
  * @param input input buffer to be hashed
  * @param inputLen length of input buffer to be hashed
  * PreCondition: 'digest' should be of appropriate size
- * (CryptoPP::SHA3_256::DIGESTSIZE)
+ * (Keccak::SHA3_256_DIGEST_BYTES)
  * @return void
  */
 static void hashBuffer(
@@ -79,9 +79,7 @@ static void hashBuffer(
 	const uint8_t* input,
 	int inputLen
 ) {
-    CryptoPP::SHA3_256 hash;
-    hash.Update(input, inputLen);
-    hash.Final(digest.data());
+    Keccak::sha3_256(input, size_t(inputLen), digest.data());
 }
 
 
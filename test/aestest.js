@@ -1,5 +1,8 @@
 let addon = require('seifnode');
 let assert = require("assert");
+let fs = require("fs");
+let os = require("os");
+let path = require("path");
 
 // buffer containing seed for ocg random number generator used by AESXOR
 let seedBuffer = new Buffer([0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
@@ -125,4 +128,534 @@ describe("seifnode AESXOR object", function() {
 			"Error thrown");
 		});
 	});
+
+	// Testing the versioned format with random per-message nonces.
+	describe("#encrypt() versioned", function() {
+
+		let versionedKey = Buffer.alloc(32, 0x24);
+
+		/* Test should encrypt the same message twice under one key into
+		 * different ciphers carrying a 14 byte header and a 16 byte tag.
+		 */
+		it("should use a fresh nonce for every message", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let first = test.encrypt(versionedKey, msg, {versioned: true});
+			let second = test.encrypt(versionedKey, msg, {versioned: true});
+
+			assert.equal(msg.length + 14 + 16, first.length);
+			assert.equal(0x01, first[0]);
+			assert.notEqual(true, first.slice(2, 14).equals(second.slice(2, 14)));
+		});
+
+		/* Test should decrypt versioned ciphers with a peer object created
+		 * from the same seed, in the order they were encrypted.
+		 */
+		it("should decrypt versioned ciphers and return the same messages",
+			function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let longMsg = Buffer.alloc(1001, 0x5a);
+			let first = sender.encrypt(versionedKey, msg, {versioned: true});
+			let second = sender.encrypt(versionedKey, longMsg,
+				{versioned: true});
+
+			assert.equal(true, receiver.decrypt(versionedKey, first,
+				{versioned: true}).equals(msg));
+			assert.equal(true, receiver.decrypt(versionedKey, second,
+				{versioned: true}).equals(longMsg));
+		});
+
+		/* Test should reject a versioned cipher whose header was modified as
+		 * the header is authenticated along with the message.
+		 */
+		it("should give an error when the header is modified", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let versioned = test.encrypt(versionedKey, msg, {versioned: true});
+			versioned[2] ^= 0x01;
+
+			assert.throws(function() {
+				test.decrypt(versionedKey, versioned, {versioned: true});
+			}, Error);
+		});
+	});
+
+	// Testing the ChaCha20-Poly1305 cipher of the versioned format.
+	describe("#encrypt() chacha20-poly1305", function() {
+
+		let chachaKey = Buffer.alloc(32, 0x42);
+		let chacha = {cipher: "chacha20-poly1305"};
+
+		/* Test should mark the cipher in the header flags and decrypt it
+		 * back whatever cipher the receiver would pick by default.
+		 */
+		it("should encrypt and decrypt with ChaCha20-Poly1305", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let longMsg = Buffer.alloc(1500, 0x3c);
+			let first = sender.encrypt(chachaKey, msg, chacha);
+			let second = sender.encrypt(chachaKey, longMsg, chacha);
+
+			assert.equal(msg.length + 14 + 16, first.length);
+			assert.equal(0x01, first[0]);
+			assert.equal(0x01, first[1]);
+
+			assert.equal(true, receiver.decrypt(chachaKey, first,
+				{versioned: true}).equals(msg));
+			assert.equal(true, receiver.decrypt(chachaKey, second,
+				{versioned: true}).equals(longMsg));
+		});
+
+		/* Test should reject a ChaCha20-Poly1305 cipher relabelled as an
+		 * AES-GCM one as the flags are authenticated.
+		 */
+		it("should give an error when the flags are modified", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let cipher = test.encrypt(chachaKey, msg, chacha);
+			cipher[1] = 0x00;
+
+			assert.throws(function() {
+				test.decrypt(chachaKey, cipher, {versioned: true});
+			}, Error);
+		});
+
+		/* Test should reject an unknown cipher name.
+		 */
+		it("should give an error for an unknown cipher", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			assert.throws(function() {
+				test.encrypt(chachaKey, msg, {cipher: "des"});
+			}, Error);
+		});
+	});
+
+	// Testing compression before encryption in the versioned format.
+	describe("#encrypt() compressed", function() {
+
+		let compressKey = Buffer.alloc(32, 0x51);
+		let json = Buffer.from(JSON.stringify(new Array(200).fill(
+			{id: 1, name: "record", valid: true})));
+
+		/* Test should produce a smaller cipher for repetitive data and
+		 * decrypt it back without any option naming the compression.
+		 */
+		it("should compress, encrypt and decrypt a message", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let cipher = sender.encrypt(compressKey, json, {compress: true});
+
+			assert.equal(true, cipher.length < json.length);
+			assert.equal(0x02, cipher[1] & 0x02);
+			assert.equal(true, receiver.decrypt(compressKey, cipher,
+				{versioned: true}).equals(json));
+		});
+
+		/* Test should leave messages that do not shrink uncompressed.
+		 */
+		it("should not compress incompressible messages", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+			let random = require("crypto").randomBytes(1000);
+
+			let cipher = test.encrypt(compressKey, random, {compress: true});
+
+			assert.equal(random.length + 14 + 16, cipher.length);
+			assert.equal(0, cipher[1] & 0x02);
+		});
+
+		/* Test should inflate compressed records of a batch in place.
+		 */
+		it("should decrypt a batch of compressed records", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let ciphers = sender.encryptMany(compressKey, [json, msg, json],
+				{compress: 9});
+			let messages = receiver.decryptMany(compressKey, ciphers);
+
+			assert.equal(json.length * 2 + msg.length, messages.data.length);
+			assert.equal(true, messages.data.slice(messages.offsets[1],
+				messages.offsets[2]).equals(msg));
+			assert.equal(true, messages.data.slice(messages.offsets[2],
+				messages.offsets[3]).equals(json));
+		});
+	});
+
+	// Testing associated data in the versioned format.
+	describe("#encrypt() with associated data", function() {
+
+		let aadKey = Buffer.alloc(32, 0x61);
+		let metadata = Buffer.from("record-id:42");
+
+		/* Test should not store the associated data in the cipher and
+		 * should decrypt only when given the same associated data.
+		 */
+		it("should authenticate the associated data", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let cipher = sender.encrypt(aadKey, msg, {aad: metadata});
+
+			assert.equal(msg.length + 14 + 16, cipher.length);
+			assert.throws(function() {
+				receiver.decrypt(aadKey, cipher,
+					{aad: Buffer.from("record-id:43")});
+			}, Error);
+			assert.equal(true, receiver.decrypt(aadKey, cipher,
+				{aad: metadata}).equals(msg));
+		});
+
+		/* Test should bind the associated data with either cipher.
+		 */
+		it("should authenticate the associated data with ChaCha20-Poly1305",
+			function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let cipher = test.encrypt(aadKey, msg,
+				{aad: metadata, cipher: "chacha20-poly1305"});
+
+			assert.throws(function() {
+				test.decrypt(aadKey, cipher, {versioned: true});
+			}, Error);
+		});
+	});
+
+	// Testing the async variants of 'encrypt' and 'decrypt'.
+	describe("#encryptAsync()", function() {
+
+		let asyncKey = Buffer.alloc(32, 0x33);
+		let largeMsg = Buffer.alloc(300 * 1024, 0x7e);
+
+		/* Test should encrypt a large message on the thread pool and decrypt
+		 * it back with a peer object created from the same seed.
+		 */
+		it("should encrypt and decrypt a large message asynchronously",
+			function(done) {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			sender.encryptAsync(asyncKey, largeMsg, function(status, cipher) {
+
+				assert.equal(0, status.code);
+				assert.equal(largeMsg.length + 16, cipher.length);
+
+				receiver.decryptAsync(asyncKey, cipher,
+					function(status, decryptedMsg) {
+
+					assert.equal(0, status.code);
+					assert.equal(true, decryptedMsg.equals(largeMsg));
+					done();
+				});
+			});
+		});
+
+		/* Test should keep the whitening order of calls made back to back,
+		 * whether they run on the thread pool or inline.
+		 */
+		it("should whiten messages in call order", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let first = sender.encryptAsync(asyncKey, largeMsg,
+				{versioned: true, asyncThreshold: 0});
+			let second = sender.encryptAsync(asyncKey, msg, {versioned: true});
+
+			return Promise.all([first, second]).then(function(ciphers) {
+				assert.equal(true, receiver.decrypt(asyncKey, ciphers[0],
+					{versioned: true}).equals(largeMsg));
+				assert.equal(true, receiver.decrypt(asyncKey, ciphers[1],
+					{versioned: true}).equals(msg));
+			});
+		});
+
+		/* Test should refuse sync calls, instead of blocking the event loop,
+		 * while async calls are pending on the object.
+		 */
+		it("should throw on sync calls while async calls are pending",
+			function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let pending = test.encryptAsync(asyncKey, largeMsg,
+				{asyncThreshold: 0});
+			assert.equal(1, test.asyncPending());
+			assert.throws(function() {
+				test.encrypt(asyncKey, msg);
+			}, /pending/);
+
+			return pending.then(function() {
+				assert.equal(0, test.asyncPending());
+				assert.equal(msg.length + 16,
+					test.encrypt(asyncKey, msg).length);
+			});
+		});
+
+		/* Test should report an authentication failure through the status
+		 * object given to the callback.
+		 */
+		it("should give an error status when decrypting with wrong key",
+			function(done) {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let cipher = test.encrypt(asyncKey, largeMsg);
+			let wrongKey = Buffer.alloc(32, 0x34);
+
+			test.decryptAsync(wrongKey, cipher, function(status, message) {
+
+				assert.notEqual(0, status.code);
+				assert.equal(undefined, message);
+				done();
+			});
+		});
+	});
+
+	// Testing the batch functions.
+	describe("#encryptMany()", function() {
+
+		let batchKey = Buffer.alloc(32, 0x55);
+		let rows = [];
+		for (let i = 0; i < 100; ++i) {
+			rows.push(Buffer.alloc(i * 3, i));
+		}
+
+		/* Test should encrypt a batch into one contiguous buffer with an
+		 * offset table and decrypt it back in packed form.
+		 */
+		it("should encrypt and decrypt a batch of records", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let ciphers = sender.encryptMany(batchKey, rows);
+			assert.equal(rows.length + 1, ciphers.offsets.length);
+			assert.equal(ciphers.data.length,
+				ciphers.offsets[rows.length]);
+
+			let messages = receiver.decryptMany(batchKey, ciphers);
+			for (let i = 0; i < rows.length; ++i) {
+				assert.equal(true, messages.data.slice(messages.offsets[i],
+					messages.offsets[i + 1]).equals(rows[i]));
+			}
+		});
+
+		/* Test should produce ciphers that decrypt one by one, in batch
+		 * order, as versioned ciphers.
+		 */
+		it("should produce ciphers decryptable one by one in order",
+			function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let ciphers = sender.encryptMany(batchKey, rows.slice(0, 3));
+			for (let i = 0; i < 3; ++i) {
+				let cipher = ciphers.data.slice(ciphers.offsets[i],
+					ciphers.offsets[i + 1]);
+				assert.equal(true, receiver.decrypt(batchKey, cipher,
+					{versioned: true}).equals(rows[i]));
+			}
+		});
+
+		/* Test should name the record failing authentication.
+		 */
+		it("should give an error when a record is modified", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let ciphers = test.encryptMany(batchKey, rows.slice(0, 3));
+			ciphers.data[ciphers.offsets[2] - 1] ^= 0x01;
+
+			assert.throws(function() {
+				test.decryptMany(batchKey, ciphers);
+			}, /Record 1/);
+		});
+
+		/* Test should leave the whitening stream in step when a batch fails
+		 * authentication.
+		 */
+		it("should stay in step after a failed batch", function() {
+
+			let sender = addon.AESXOR256(seedBuffer);
+			let receiver = addon.AESXOR256(seedBuffer);
+
+			let ciphers = sender.encryptMany(batchKey, rows.slice(0, 3));
+			let tampered = Buffer.from(ciphers.data);
+			tampered[ciphers.offsets[3] - 1] ^= 0x01;
+
+			assert.throws(function() {
+				receiver.decryptMany(batchKey,
+					{data: tampered, offsets: ciphers.offsets});
+			}, /Record 2/);
+
+			let messages = receiver.decryptMany(batchKey, ciphers);
+			for (let i = 0; i < 3; ++i) {
+				assert.equal(true, messages.data.slice(messages.offsets[i],
+					messages.offsets[i + 1]).equals(rows[i]));
+			}
+		});
+	});
+
+	// Testing the file functions.
+	describe("#encryptFile()", function() {
+
+		let fileKey = Buffer.alloc(32, 0x66);
+		let dir = fs.mkdtempSync(path.join(os.tmpdir(), "seifnode-"));
+		let plainFile = path.join(dir, "plain.bin");
+		let cipherFile = path.join(dir, "cipher.bin");
+		let decryptedFile = path.join(dir, "decrypted.bin");
+
+		let content = Buffer.alloc(3 * 1024 * 1024 + 17);
+		for (let i = 0; i < content.length; ++i) {
+			content[i] = (i * 7) % 256;
+		}
+		fs.writeFileSync(plainFile, content);
+
+		/* Test should encrypt a file into a segmented container that can
+		 * be decrypted both from the file and in memory.
+		 */
+		it("should encrypt and decrypt a file", function(done) {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			test.encryptFile(plainFile, cipherFile, fileKey,
+				{segmentSize: 64 * 1024}, function(status, stats) {
+
+				assert.equal(0, status.code);
+				assert.equal(content.length, stats.bytes);
+				assert.equal(true, test.decryptSegmented(fileKey,
+					fs.readFileSync(cipherFile)).equals(content));
+
+				test.decryptFile(cipherFile, decryptedFile, fileKey,
+					function(status, stats) {
+
+					assert.equal(0, status.code);
+					assert.equal(content.length, stats.bytes);
+					assert.equal(true,
+						fs.readFileSync(decryptedFile).equals(content));
+					done();
+				});
+			});
+		});
+
+		/* Test should leave the target untouched when the container fails
+		 * authentication.
+		 */
+		it("should not replace the target when decryption fails",
+			function(done) {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let damaged = fs.readFileSync(cipherFile);
+			damaged[damaged.length - 1] ^= 0x01;
+			fs.writeFileSync(cipherFile, damaged);
+			fs.writeFileSync(decryptedFile, "previous");
+
+			test.decryptFile(cipherFile, decryptedFile, fileKey,
+				function(status, stats) {
+
+				assert.notEqual(0, status.code);
+				assert.equal("previous", fs.readFileSync(decryptedFile, "utf8"));
+				assert.deepEqual(["cipher.bin", "decrypted.bin", "plain.bin"],
+					fs.readdirSync(dir).sort());
+				done();
+			});
+		});
+	});
+
+	// Testing the segmented container format.
+	describe("#encryptSegmented()", function() {
+
+		// message spanning several segments with a short final segment
+		let largeMsg = Buffer.alloc(10000);
+		for (let i = 0; i < largeMsg.length; ++i) {
+			largeMsg[i] = i % 251;
+		}
+		let segmentKey = Buffer.alloc(32, 0x42);
+
+		/* Test should encrypt a message into segments and decrypt the whole
+		 * container back to the original message.
+		 */
+		it("should encrypt and decrypt a segmented container", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let container = test.encryptSegmented(segmentKey, largeMsg, 1024);
+			let decryptedMsg = test.decryptSegmented(segmentKey, container);
+
+			// 21 byte header plus a 16 byte tag for each of the 10 segments
+			assert.equal(largeMsg.length + 21 + 10 * 16, container.length);
+			assert.equal(true, decryptedMsg.equals(largeMsg));
+		});
+
+		/* Test should draw a fresh salt for every container so two
+		 * containers of the same message under one key share neither their
+		 * salt nor their ciphertext.
+		 */
+		it("should salt every container with its own segment key", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let first = test.encryptSegmented(segmentKey, largeMsg, 1024);
+			let second = test.encryptSegmented(segmentKey, largeMsg, 1024);
+
+			assert.equal(false, first.slice(5, 21).equals(second.slice(5, 21)));
+			assert.equal(false, first.slice(21).equals(second.slice(21)));
+			assert.equal(true,
+				test.decryptSegmented(segmentKey, second).equals(largeMsg));
+		});
+
+		/* Test should decrypt arbitrary plaintext ranges, including ranges
+		 * crossing segment boundaries and ending in the final segment.
+		 */
+		it("should decrypt only the requested range", function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let container = test.encryptSegmented(segmentKey, largeMsg, 1024);
+
+			[[0, 1], [1000, 100], [2048, 1024], [9990, 10], [0, 10000]]
+				.forEach(function(range) {
+
+				let slice = test.decryptRange(segmentKey, container, range[0],
+					range[1]);
+				assert.equal(true, slice.equals(
+					largeMsg.slice(range[0], range[0] + range[1])));
+			});
+		});
+
+		/* Test should detect a container truncated at a segment boundary as
+		 * the last remaining segment was not sealed as the final one.
+		 */
+		it("should give an error when decrypting a truncated container",
+			function() {
+
+			let test = addon.AESXOR256(seedBuffer);
+
+			let container = test.encryptSegmented(segmentKey, largeMsg, 1024);
+			let truncated = container.slice(0, 21 + 5 * (1024 + 16));
+
+			assert.throws(function() {
+				test.decryptSegmented(segmentKey, truncated);
+			}, Error);
+		});
+	});
 });
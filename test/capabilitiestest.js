@@ -0,0 +1,31 @@
+let addon = require('seifnode');
+let assert = require("assert");
+
+// Mocha tests for the capabilities function.
+describe("seifnode capabilities", function() {
+
+	// Test should report a code path for every primitive.
+	it("should report the code path of every primitive", function() {
+		let caps = addon.capabilities();
+
+		["aesGcm", "chacha20Poly1305", "sha3", "sha3Many", "ecc",
+			"isaac"].forEach(function(primitive) {
+			assert.equal("string", typeof caps.paths[primitive]);
+		});
+
+		assert.equal("boolean", typeof caps.cpu.aesni);
+		assert.equal("boolean", typeof caps.cpu.avx2);
+		assert.notEqual(-1, ["bmi", "portable"].indexOf(caps.paths.sha3));
+	});
+
+	// Test should only report as accelerated when nothing is missing.
+	it("should list the primitives missing acceleration", function() {
+		let caps = addon.capabilities();
+
+		assert.equal(true, Array.isArray(caps.missing));
+		assert.equal(caps.missing.length === 0, caps.accelerated);
+		if (caps.paths.aesGcm !== "aesni-pclmul") {
+			assert.notEqual(-1, caps.missing.indexOf("aesGcm"));
+		}
+	});
+});
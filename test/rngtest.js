@@ -148,6 +148,287 @@ describe("seifnode RNG object", function() {
 		});
 	});
 
+	// Testing 'getBytesAsync' functionality.
+	describe("#getBytesAsync()", function() {
+
+		// Large requests are generated on the thread pool.
+		it("should call back with the given number of random bytes",
+			function(done) {
+
+			let test = new addon.RNG();
+			let largeNumBytes = 1024 * 1024;
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				test.getBytesAsync(largeNumBytes, function(status, buffer) {
+					assert.equal(0, status.code);
+					assert.equal(largeNumBytes, buffer.length);
+					assert.notDeepEqual(Buffer.alloc(largeNumBytes), buffer);
+					done();
+				});
+			});
+		});
+
+		// Without a callback a Promise is returned, for any size.
+		it("should return a Promise when no callback is given",
+			function(done) {
+
+			let test = new addon.RNG();
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				Promise.all([
+					test.getBytesAsync(numBytes),
+					test.getBytesAsync(numBytes, {asyncThreshold: 0})
+				]).then(function(buffers) {
+					assert.equal(numBytes, buffers[0].length);
+					assert.equal(numBytes, buffers[1].length);
+					assert.notDeepEqual(buffers[0], buffers[1]);
+					done();
+				}).catch(done);
+			});
+		});
+
+		// An uninitialized RNG reports an error status instead of throwing.
+		it("should call back with an error before initialization",
+			function(done) {
+
+			let test = new addon.RNG();
+
+			test.getBytesAsync(numBytes, {asyncThreshold: 0},
+				function(status, buffer) {
+					assert.equal(-1, status.code);
+					assert.equal(undefined, buffer);
+					done();
+				});
+		});
+	});
+
+	// Testing 'fill' functionality.
+	describe("#fill()", function() {
+
+		// Only the given byte range is overwritten, in place.
+		it("should fill the given range of an existing buffer",
+			function(done) {
+
+			let test = new addon.RNG();
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				let buffer = Buffer.alloc(3 * numBytes);
+				assert.equal(buffer, test.fill(buffer, numBytes, numBytes));
+
+				assert.deepEqual(Buffer.alloc(numBytes),
+					buffer.slice(0, numBytes));
+				assert.notDeepEqual(Buffer.alloc(numBytes),
+					buffer.slice(numBytes, 2 * numBytes));
+				assert.deepEqual(Buffer.alloc(numBytes),
+					buffer.slice(2 * numBytes));
+				done();
+			});
+		});
+
+		// Typed arrays and shared memory are filled through a byte view.
+		it("should fill typed arrays and SharedArrayBuffer views",
+			function(done) {
+
+			let test = new addon.RNG();
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				let words = test.fill(new Uint32Array(numBytes / 4));
+				assert.notEqual(-1, words.findIndex(function(word) {
+					return word !== 0;
+				}));
+
+				let shared = new Uint8Array(new SharedArrayBuffer(numBytes));
+				test.fill(new DataView(shared.buffer), 0, numBytes);
+				assert.notDeepEqual(Buffer.alloc(numBytes),
+					Buffer.from(shared));
+				done();
+			});
+		});
+
+		// Ranges past the end of the memory are rejected.
+		it("should throw on a range outside the buffer", function() {
+			let test = new addon.RNG();
+
+			assert.throws(function() {
+				test.fill(Buffer.alloc(numBytes), 1, numBytes);
+			});
+			assert.throws(function() {
+				test.fill([0, 0, 0]);
+			});
+		});
+	});
+
+	// Testing the prefetch ring.
+	describe("#startPrefetch()", function() {
+
+		// Small requests are served from the ring once it is started.
+		it("should serve small requests from the prefetch ring",
+			function(done) {
+
+			let test = new addon.RNG();
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				assert.equal(false, test.prefetchStats().enabled);
+				test.startPrefetch({capacity: 4096, lowWatermark: 1024,
+					highWatermark: 4096, maxRequest: 64});
+
+				let buffers = [];
+				for (let i = 0; i < 8; ++i) {
+					buffers.push(test.getBytes(numBytes));
+				}
+				test.fill(Buffer.alloc(numBytes));
+				assert.equal(1024, test.getBytes(1024).length);
+
+				let stats = test.prefetchStats();
+				assert.equal(true, stats.enabled);
+				assert.equal(4096, stats.capacity);
+				assert.equal(9, stats.served + stats.stalls);
+				assert.equal(true, stats.served > 0);
+				assert.equal(stats.served * numBytes, stats.servedBytes);
+				assert.equal(true, stats.occupancy <= stats.capacity);
+				assert.notDeepEqual(buffers[0], buffers[1]);
+
+				test.stopPrefetch();
+				assert.equal(false, test.prefetchStats().enabled);
+				assert.equal(numBytes, test.getBytes(numBytes).length);
+				done();
+			});
+		});
+
+		// Reloading the state drops bytes generated from the old one.
+		it("should stop the ring when the state is reloaded", function(done) {
+
+			let test = new addon.RNG();
+
+			test.isInitialized(hash, stateFile, function(result) {
+				assert.equal(0, result.code);
+
+				test.startPrefetch({capacity: 4096});
+				assert.equal(true, test.prefetchStats().enabled);
+
+				test.isInitialized(hash, stateFile, function(result) {
+					assert.equal(0, result.code);
+					assert.equal(numBytes, test.getBytes(numBytes).length);
+					done();
+				});
+				assert.equal(false, test.prefetchStats().enabled);
+			});
+		});
+
+		// Bad ring settings and an uninitialized RNG are rejected.
+		it("should throw on invalid options or before initialization",
+			function() {
+
+			let test = new addon.RNG();
+
+			assert.throws(function() {
+				test.startPrefetch({capacity: 5000});
+			});
+			assert.throws(function() {
+				test.startPrefetch({lowWatermark: 8192, highWatermark: 4096});
+			});
+			assert.throws(function() {
+				test.startPrefetch();
+			});
+			assert.equal(false, test.prefetchStats().enabled);
+		});
+	});
+
+	// Testing 'initializeAsync' functionality.
+	describe("#initializeAsync()", function() {
+
+		/* The RNG refuses to generate until the seeding reports success and
+		 * every attempt is reported as progress.
+		 */
+		it("should seed the rng off the main thread with progress",
+			function(done) {
+
+			let test = new addon.RNG();
+			let attempts = [];
+			this.timeout(150000);
+
+			test.initializeAsync(hash, stateFile, {
+				onProgress: function(progress) {
+					attempts.push(progress);
+				}
+			}, function(status) {
+				assert.equal(0, status.code);
+
+				assert.notEqual(0, attempts.length);
+				attempts.forEach(function(progress, i) {
+					assert.equal(i + 1, progress.attempt);
+					assert.equal("number", typeof progress.elapsed);
+					assert.equal("string", typeof progress.strength);
+				});
+				assert.equal(true, attempts[attempts.length - 1].seeded);
+
+				assert.equal(numBytes, test.getBytes(numBytes).length);
+				test.destroy();
+				done();
+			});
+
+			assert.throws(function() {
+				test.getBytes(numBytes);
+			}, /being initialized/);
+		});
+
+		/* Sync calls made while seeding must throw at once instead of
+		 * waiting for the entropy gathering attempt to end.
+		 */
+		it("should refuse getBytes without waiting for seeding",
+			function() {
+
+			let test = new addon.RNG();
+			this.timeout(150000);
+
+			let seeding = test.initializeAsync(hash, stateFile);
+
+			let start = Date.now();
+			assert.throws(function() {
+				test.getBytes(numBytes);
+			}, /being initialized/);
+			assert.throws(function() {
+				test.fill(Buffer.alloc(numBytes));
+			}, /being initialized/);
+			assert.equal("string", typeof test.entropyStrength());
+			assert.equal(true, Date.now() - start < 100);
+
+			return seeding.then(function() {
+				test.destroy();
+			}, function() {});
+		});
+
+		/* A cancelled seeding leaves the rng unusable, unless the first
+		 * attempt already succeeded.
+		 */
+		it("should stop when cancelled", function() {
+			let test = new addon.RNG();
+			this.timeout(150000);
+
+			let seeding = test.initializeAsync(hash, stateFile);
+			test.cancelInitialize();
+
+			return seeding.then(function() {
+				assert.equal(numBytes, test.getBytes(numBytes).length);
+			}, function(err) {
+				assert.equal("Initialization cancelled", err.message);
+				assert.throws(function() {
+					test.getBytes(numBytes);
+				});
+			});
+		});
+	});
+
 	after(function() {
 		if (fs.existsSync(stateFile)) {
 			fs.unlinkSync(stateFile);
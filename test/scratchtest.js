@@ -0,0 +1,47 @@
+let addon = require('seifnode');
+let assert = require("assert");
+let crypto = require("crypto");
+
+// Mocha tests for the scratch buffer pool.
+describe("seifnode scratchStats", function() {
+
+	// Test should report every counter.
+	it("should report the allocator statistics", function() {
+		let stats = addon.scratchStats();
+
+		["acquired", "reused", "allocated", "released", "freed",
+			"cachedBytes"].forEach(function(name) {
+			assert.equal("number", typeof stats[name]);
+		});
+		assert.equal(true, stats.acquired >= stats.reused);
+	});
+
+	// Test should reuse pooled buffers once warmed up. Only the pool's own
+	// malloc and free calls are counted, not those of zlib or containers.
+	it("should reuse pooled scratch buffers in steady state", function() {
+		let seed = crypto.randomBytes(16);
+		let encryptor = addon.AESXOR256(seed);
+		let decryptor = addon.AESXOR256(seed);
+		let key = crypto.randomBytes(32);
+		let message = Buffer.from(JSON.stringify(
+			new Array(200).fill({id: 1, name: "seifnode"})));
+		let options = {compress: true};
+
+		for (let i = 0; i < 10; ++i) {
+			decryptor.decrypt(key, encryptor.encrypt(key, message, options),
+				{versioned: true});
+		}
+
+		let before = addon.scratchStats();
+		for (let i = 0; i < 100; ++i) {
+			let cipher = encryptor.encrypt(key, message, options);
+			assert.equal(true, message.equals(
+				decryptor.decrypt(key, cipher, {versioned: true})));
+		}
+		let after = addon.scratchStats();
+
+		assert.equal(true, after.acquired >= before.acquired + 200);
+		assert.equal(before.allocated, after.allocated);
+		assert.equal(before.freed, after.freed);
+	});
+});
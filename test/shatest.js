@@ -1,5 +1,10 @@
 let addon = require('seifnode');
 let assert = require("assert");
+let crypto = require("crypto");
+let fs = require("fs");
+let os = require("os");
+let path = require("path");
+let stream = require("stream");
 
 // Mocha tests for SEIFSHA3 object.
 describe("seifnode SEIFSHA3 hash object", function() {
@@ -19,4 +24,348 @@ describe("seifnode SEIFSHA3 hash object", function() {
 		// Comparing returned hash buffer with the known hash value buffer.
 		assert.equal(true, hash.equals(testhash));
 	});
+
+	// Test should hash chunks to the same value as the whole input.
+	it("should hash data incrementally with update() and digest()",
+		function() {
+		let test = new addon.SEIFSHA3();
+		let data = Buffer.alloc(100000, 0x61);
+
+		for (let i = 0; i < data.length; i += 7777) {
+			test.update(data.slice(i, i + 7777));
+		}
+
+		assert.equal(true, test.digest().equals(test.hash(data)));
+		assert.equal(true, test.update("ab").update("c").digest()
+			.equals(test.hash("abc")));
+	});
+
+	// Test should start over after digest() and reset().
+	it("should reset the state after digest() and reset()", function() {
+		let test = new addon.SEIFSHA3();
+		let empty = test.hash(Buffer.alloc(0));
+
+		test.update("abc");
+		test.digest();
+		assert.equal(true, test.digest().equals(empty));
+
+		test.update("abc");
+		test.reset();
+		assert.equal(true, test.update("\u00e9").digest()
+			.equals(test.hash(Buffer.from("\u00e9", "utf8"))));
+	});
+
+	// Test should hash long and non-ASCII strings as their UTF-8 bytes.
+	it("should hash strings as their UTF-8 encoding", function() {
+		let test = new addon.SEIFSHA3();
+		let strings = [
+			"\u00e9".repeat(10000),
+			"a".repeat(4095) + "\ud83d\ude00" + "\u4e2d".repeat(5000),
+			"a\u0000b",
+			"lone \ud800 surrogate"
+		];
+
+		strings.forEach(function(str) {
+			assert.equal(true, test.hash(str)
+				.equals(test.hash(Buffer.from(str, "utf8"))));
+		});
+	});
+
+	// Test should hash a large buffer on the thread pool.
+	it("should hash a large buffer asynchronously", function(done) {
+		let test = new addon.SEIFSHA3();
+		let data = Buffer.alloc(1024 * 1024, 0x5a);
+
+		test.hashAsync(data, function(status, hash) {
+			assert.equal(0, status.code);
+			assert.equal(true, hash.equals(test.hash(data)));
+			done();
+		});
+	});
+
+	// Test should return a Promise when no callback is given.
+	it("should return a Promise from hashAsync", function() {
+		let test = new addon.SEIFSHA3();
+
+		return Promise.all([
+			test.hashAsync("abc"),
+			test.hashAsync(Buffer.from("abc"), {asyncThreshold: 0})
+		]).then(function(hashes) {
+			assert.equal(true, hashes[0].equals(test.hash("abc")));
+			assert.equal(true, hashes[1].equals(test.hash("abc")));
+		});
+	});
+
+	// Test should hash every record of a batch like hash() does.
+	it("should hash a batch of records with hashMany()", function() {
+		let test = new addon.SEIFSHA3();
+		let records = [];
+		for (let i = 0; i < 37; ++i) {
+			records.push(Buffer.alloc(i * 11, i));
+		}
+
+		let hashes = test.hashMany(records);
+		assert.equal(records.length * 32, hashes.length);
+		records.forEach(function(record, i) {
+			assert.equal(true,
+				hashes.slice(32 * i, 32 * i + 32).equals(test.hash(record)));
+		});
+
+		let packed = test.hashMany({
+			data: Buffer.concat(records.slice(0, 3)),
+			offsets: [0, 0, 11, 33]
+		});
+		assert.equal(true, packed.equals(hashes.slice(0, 96)));
+	});
+
+	// Test should compute known answers of the other algorithms.
+	it("should compute SHA3-512, SHAKE and cSHAKE hash values", function() {
+		assert.equal(addon.SEIFSHA3("sha3-512").hash("abc").toString("hex"),
+			"b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e" +
+			"10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0");
+		assert.equal(addon.SEIFSHA3("shake128").hash("").toString("hex"),
+			"7f9c2ba4e88f827d616045507605853ed73b8093f6efbc88eb1a6eacfa66ef26");
+		assert.equal(addon.SEIFSHA3("shake256").hash("", 16).toString("hex"),
+			"46b9dd2b0ba88d13233b3feb743eeb24");
+
+		let cshake = addon.SEIFSHA3("cshake128",
+			{customization: "Email Signature"});
+		assert.equal(cshake.hash(Buffer.from([0, 1, 2, 3])).toString("hex"),
+			"c1c36925b6409a04f1b504fcbca9d82b4017277cb5ed2b2065fc1d3814d5aaf5");
+
+		assert.throws(function() { addon.SEIFSHA3("md5"); });
+		assert.throws(function() { addon.SEIFSHA3().hash("abc", 16); });
+		assert.throws(function() {
+			addon.SEIFSHA3("shake128", {customization: "x"});
+		});
+	});
+
+	// Test should read SHAKE output in pieces from one absorb pass.
+	it("should squeeze SHAKE output incrementally", function() {
+		let test = new addon.SEIFSHA3("shake256");
+		let data = Buffer.alloc(1000, 0x33);
+		let expected = test.hash(data, 1000);
+
+		test.update(data);
+		let pieces = [test.squeeze(1), test.squeeze(135), test.squeeze(300)];
+		assert.throws(function() { test.update("more"); });
+		pieces.push(test.digest(564));
+
+		assert.equal(true, Buffer.concat(pieces).equals(expected));
+		assert.equal(true, test.update(data).digest(1000).equals(expected));
+		assert.throws(function() { addon.SEIFSHA3().squeeze(32); });
+	});
+
+	// Test should apply the algorithm and output length to every record.
+	it("should hash records with the object's algorithm", function() {
+		let test = new addon.SEIFSHA3("shake128");
+		let records = [Buffer.from("a"), Buffer.alloc(500, 1)];
+
+		let hashes = test.hashMany(records, 48);
+		assert.equal(96, hashes.length);
+		assert.equal(true, hashes.slice(48).equals(test.hash(records[1], 48)));
+
+		return test.hashAsync(records[1], {outputLength: 48,
+			asyncThreshold: 0}).then(function(hash) {
+			assert.equal(true, hash.equals(test.hash(records[1], 48)));
+		});
+	});
+
+	// Test should compute ParallelHash known answers, in one call or in
+	// chunks, whatever the number of threads.
+	it("should compute ParallelHash hash values", function() {
+		let data = Buffer.from("000102030405060710111213141516172021222324252627",
+			"hex");
+		let test = new addon.SEIFSHA3("parallelhash128", {blockSize: 8});
+		let expected = "ba8dc1d1d979331d3f813603c67f7260" +
+			"9ab5e44b94a0b8f9af46514454a2b4f5";
+
+		assert.equal(test.hash(data).toString("hex"), expected);
+		assert.equal(test.update(data.slice(0, 5)).update(data.slice(5))
+			.digest().toString("hex"), expected);
+
+		let large = Buffer.alloc(3 * 1024 * 1024 + 17, 0x6b);
+		let tree = new addon.SEIFSHA3("parallelhash256",
+			{blockSize: 4096, customization: "archive"});
+		tree.update(large.slice(0, 1000)).update(large.slice(1000));
+		assert.equal(true, tree.digest().equals(tree.hash(large)));
+
+		assert.throws(function() {
+			addon.SEIFSHA3("sha3-256", {blockSize: 8});
+		});
+	});
+
+	// Test should compute KMAC known answers and match HMAC-SHA3 from
+	// OpenSSL, from the same keyed object for many messages.
+	it("should compute KMAC and HMAC-SHA3 values", function() {
+		let key = Buffer.alloc(32);
+		for (let i = 0; i < key.length; ++i) {
+			key[i] = 0x40 + i;
+		}
+		let data = Buffer.from([0x00, 0x01, 0x02, 0x03]);
+
+		let kmac = new addon.SEIFSHA3("kmac128", {key: key});
+		assert.equal(kmac.hash(data).toString("hex"),
+			"e5780b0d3ea6f7d3a429c5706aa43a00" +
+			"fadbd7d49628839e3187243f456ee14e");
+
+		let tagged = new addon.SEIFSHA3("kmac128",
+			{key: key, customization: "My Tagged Application"});
+		assert.equal(tagged.update(data.slice(0, 1)).update(data.slice(1))
+			.digest().toString("hex"),
+			"3b1fba963cd8b0b59e8c1a6d71888b71" +
+			"43651af8ba0a7070c0979e2811324aa5");
+
+		let hmac = new addon.SEIFSHA3("hmac-sha3-256", {key: key});
+		let messages = [data, Buffer.alloc(0), Buffer.alloc(500, 0x61)];
+		let tags = hmac.hashMany(messages);
+
+		messages.forEach(function(message, i) {
+			let expected = crypto.createHmac("sha3-256", key)
+				.update(message).digest();
+			assert.equal(true, hmac.hash(message).equals(expected));
+			assert.equal(true,
+				tags.slice(i * 32, (i + 1) * 32).equals(expected));
+		});
+
+		assert.throws(function() {
+			addon.SEIFSHA3("kmac256");
+		});
+		assert.throws(function() {
+			addon.SEIFSHA3("sha3-256", {key: key});
+		});
+	});
+
+	// Test should fork a hashed prefix with clone() and carry it across
+	// objects with exportState() and importState().
+	it("should clone, export and import hash states", function() {
+		let prefix = Buffer.alloc(1000, 0x70);
+		let suffixes = ["a", "bb", "ccc"];
+
+		["sha3-256", "shake128", "parallelhash256"].forEach(function(algorithm) {
+			let options = algorithm === "parallelhash256"
+				? {blockSize: 64} : undefined;
+			let base = new addon.SEIFSHA3(algorithm, options);
+			base.update(prefix);
+
+			let state = base.exportState();
+			suffixes.forEach(function(suffix) {
+				let expected = base.hash(Buffer.concat([prefix,
+					Buffer.from(suffix)]));
+
+				assert.equal(true,
+					base.clone().update(suffix).digest().equals(expected));
+				assert.equal(true, new addon.SEIFSHA3(algorithm, options)
+					.importState(state).update(suffix).digest()
+					.equals(expected));
+			});
+
+			// The clones leave the original state untouched.
+			assert.equal(true, base.digest().equals(base.hash(prefix)));
+		});
+
+		let mac = new addon.SEIFSHA3("kmac128", {key: "secret"});
+		let forked = mac.update(prefix).clone();
+		assert.equal(true, forked.update("x").digest().equals(
+			mac.hash(Buffer.concat([prefix, Buffer.from("x")]))));
+
+		// Keyed states only import into objects holding the same key.
+		let macState = new addon.SEIFSHA3("kmac128", {key: "secret"})
+			.update(prefix).exportState();
+		assert.throws(function() {
+			new addon.SEIFSHA3("kmac128", {key: "other"}).importState(macState);
+		}, /another key/);
+		assert.throws(function() {
+			new addon.SEIFSHA3("hmac-sha3-256", {key: "other"}).importState(
+				new addon.SEIFSHA3("hmac-sha3-256", {key: "secret"})
+					.update(prefix).exportState());
+		}, /another key/);
+		assert.equal(true, new addon.SEIFSHA3("kmac128", {key: "secret"})
+			.importState(macState).update("x").digest().equals(
+				mac.hash(Buffer.concat([prefix, Buffer.from("x")]))));
+
+		let state = new addon.SEIFSHA3().update(prefix).exportState();
+		assert.throws(function() {
+			new addon.SEIFSHA3("sha3-512").importState(state);
+		});
+		assert.throws(function() {
+			new addon.SEIFSHA3().importState(state.slice(0, 100));
+		});
+	});
+
+	// Test should hash the chunks piped through a hash stream while passing
+	// them on unchanged.
+	it("should hash piped chunks with createHashStream()", function(done) {
+		let chunks = [Buffer.from("upload "), Buffer.alloc(100000, 0x2a),
+			Buffer.from("end")];
+		let whole = Buffer.concat(chunks);
+		let hashStream = addon.createHashStream("sha3-512");
+		let written = [];
+
+		stream.pipeline(stream.Readable.from(chunks), hashStream,
+			new stream.Writable({
+				write: function(chunk, encoding, callback) {
+					written.push(chunk);
+					callback();
+				}
+			}),
+			function(err) {
+				assert.ifError(err);
+				assert.equal(true, Buffer.concat(written).equals(whole));
+				assert.equal(true, hashStream.digest.equals(
+					new addon.SEIFSHA3("sha3-512").hash(whole)));
+
+				// Without pass-through the digest is the only output.
+				let prefixed = new addon.SEIFSHA3().update(chunks[0]);
+				let sink = prefixed.createHashStream({passThrough: false});
+				sink.on("data", function(digest) {
+					assert.equal(true, digest.equals(
+						new addon.SEIFSHA3().hash(whole)));
+					done();
+				});
+				sink.write(chunks[1]);
+				sink.end(chunks[2]);
+			});
+	});
+
+	// Test should hash a file, or a range of it, like the same bytes in
+	// memory.
+	it("should hash a file and a byte range with hashFile()", function(done) {
+		let test = new addon.SEIFSHA3();
+		let dir = fs.mkdtempSync(path.join(os.tmpdir(), "seifnode-"));
+		let file = path.join(dir, "data.bin");
+
+		let content = Buffer.alloc(9 * 1024 * 1024 + 5);
+		for (let i = 0; i < content.length; ++i) {
+			content[i] = (i * 13) % 251;
+		}
+		fs.writeFileSync(file, content);
+
+		test.hashFile(file, function(status, hash) {
+			assert.equal(0, status.code);
+			assert.equal(true, hash.equals(test.hash(content)));
+
+			test.hashFile(file, {offset: 1000, length: 50000},
+				function(status, hash) {
+
+				assert.equal(0, status.code);
+				assert.equal(true,
+					hash.equals(test.hash(content.slice(1000, 51000))));
+
+				test.hashFile(file, {offset: content.length - 1, length: 2},
+					function(status, hash) {
+
+					assert.equal(-1, status.code);
+					assert.equal(undefined, hash);
+
+					test.hashFile(path.join(dir, "missing.bin"),
+						function(status) {
+
+						assert.equal(-1, status.code);
+						done();
+					});
+				});
+			});
+		});
+	});
 });